@@ -0,0 +1,294 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-alloc.c
+ * \brief	Implementation of the free-space allocator of the in-place storage engine.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-alloc.h"
+
+// Uses following header(s)
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Marks the end of a list.
+ *
+ */
+#define GP_NVM_ALLOC_NIL UINT32_MAX
+
+/**
+ * @brief      Size class of an extent.
+ *
+ */
+static inline uint32_t
+_gp_nvm_alloc_class(uint32_t size)
+{
+	return 31 - __builtin_clz(size | 1);
+}
+
+/**
+ * @brief      Get an unused extent from the pool, growing the pool when needed.
+ *
+ * @return     The index of the extent or GP_NVM_ALLOC_NIL when out of memory.
+ */
+static uint32_t
+_gp_nvm_alloc_new_extent(gp_nvm_alloc_t *alloc)
+{
+	if( alloc->pool_free == GP_NVM_ALLOC_NIL ){
+		uint32_t pool_size = alloc->pool_size ? alloc->pool_size * 2 : 16;
+		gp_nvm_extent_t *pool = realloc(alloc->pool, pool_size * sizeof(gp_nvm_extent_t));
+		if( pool == NULL ){
+			return GP_NVM_ALLOC_NIL;
+		}
+		for( uint32_t i = alloc->pool_size; i<pool_size; i++ ){
+			pool[i].next = i + 1 < pool_size ? i + 1 : GP_NVM_ALLOC_NIL;
+		}
+		alloc->pool = pool;
+		alloc->pool_free = alloc->pool_size;
+		alloc->pool_size = pool_size;
+	}
+	uint32_t i = alloc->pool_free;
+	alloc->pool_free = alloc->pool[i].next;
+	return i;
+}
+
+/**
+ * @brief      Unlink a free extent from its size class and the offset maps, and return it to the pool.
+ *
+ */
+static void
+_gp_nvm_alloc_unlink(gp_nvm_alloc_t *alloc, uint32_t i)
+{
+	gp_nvm_extent_t *extent = &alloc->pool[i];
+	if( extent->prev != GP_NVM_ALLOC_NIL ){
+		alloc->pool[extent->prev].next = extent->next;
+	} else {
+		alloc->heads[_gp_nvm_alloc_class(extent->size)] = extent->next;
+	}
+	if( extent->next != GP_NVM_ALLOC_NIL ){
+		alloc->pool[extent->next].prev = extent->prev;
+	}
+	gp_nvm_index_remove(&alloc->by_start, extent->offset);
+	gp_nvm_index_remove(&alloc->by_end, extent->offset + extent->size);
+	alloc->free_extents--;
+	alloc->free_bytes -= extent->size;
+
+	extent->next = alloc->pool_free;
+	alloc->pool_free = i;
+}
+
+/**
+ * @brief      Look up the free extent in an offset map.
+ *
+ * @return     The index of the extent or GP_NVM_ALLOC_NIL when there is none.
+ */
+static uint32_t
+_gp_nvm_alloc_lookup(const gp_nvm_index_t *map, uint32_t offset)
+{
+	gp_nvm_index_entry_t *entry = gp_nvm_index_find(map, offset);
+	return entry != NULL ? entry->offset : GP_NVM_ALLOC_NIL;
+}
+
+/**
+ * @brief      Initialize an allocator without free extents.
+ *
+ * @param[out] alloc  The allocator.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_alloc_init(gp_nvm_alloc_t *alloc)
+{
+	memset(alloc, 0, sizeof(gp_nvm_alloc_t));
+	alloc->pool_free = GP_NVM_ALLOC_NIL;
+	for( int c = 0; c<GP_NVM_ALLOC_NUM_CLASSES; c++ ){
+		alloc->heads[c] = GP_NVM_ALLOC_NIL;
+	}
+	if( gp_nvm_index_init(&alloc->by_start) != 0 || gp_nvm_index_init(&alloc->by_end) != 0 ){
+		gp_nvm_alloc_deinit(alloc);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Release the memory of the allocator.
+ *
+ * @param[in]  alloc  The allocator.
+ */
+void
+gp_nvm_alloc_deinit(gp_nvm_alloc_t *alloc)
+{
+	free(alloc->pool);
+	gp_nvm_index_deinit(&alloc->by_start);
+	gp_nvm_index_deinit(&alloc->by_end);
+	memset(alloc, 0, sizeof(gp_nvm_alloc_t));
+}
+
+/**
+ * @brief      Add a free extent, merging it with adjacent free extents.
+ *
+ * @param[in]  alloc   The allocator.
+ * @param[in]  offset  The offset of the extent in NVM.
+ * @param[in]  size    The size of the extent (number of bytes).
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_alloc_free(	gp_nvm_alloc_t *alloc,
+					uint32_t offset,
+					uint32_t size)
+{
+	alloc->frees++;
+
+	// merge with the free extent that ends where this one starts
+	uint32_t before = _gp_nvm_alloc_lookup(&alloc->by_end, offset);
+	if( before != GP_NVM_ALLOC_NIL ){
+		offset = alloc->pool[before].offset;
+		size += alloc->pool[before].size;
+		_gp_nvm_alloc_unlink(alloc, before);
+		alloc->merges++;
+	}
+	// merge with the free extent that starts where this one ends
+	uint32_t after = _gp_nvm_alloc_lookup(&alloc->by_start, offset + size);
+	if( after != GP_NVM_ALLOC_NIL ){
+		size += alloc->pool[after].size;
+		_gp_nvm_alloc_unlink(alloc, after);
+		alloc->merges++;
+	}
+
+	uint32_t i = _gp_nvm_alloc_new_extent(alloc);
+	if( i == GP_NVM_ALLOC_NIL ){
+		return 1;
+	}
+	int added;
+	gp_nvm_index_entry_t *start = gp_nvm_index_insert(&alloc->by_start, offset, &added);
+	if( start == NULL ){
+		return 1;
+	}
+	start->offset = i;
+	gp_nvm_index_entry_t *end = gp_nvm_index_insert(&alloc->by_end, offset + size, &added);
+	if( end == NULL ){
+		gp_nvm_index_remove(&alloc->by_start, offset);
+		return 1;
+	}
+	end->offset = i;
+
+	uint32_t c = _gp_nvm_alloc_class(size);
+	alloc->pool[i].offset = offset;
+	alloc->pool[i].size = size;
+	alloc->pool[i].prev = GP_NVM_ALLOC_NIL;
+	alloc->pool[i].next = alloc->heads[c];
+	if( alloc->heads[c] != GP_NVM_ALLOC_NIL ){
+		alloc->pool[alloc->heads[c]].prev = i;
+	}
+	alloc->heads[c] = i;
+	alloc->free_extents++;
+	alloc->free_bytes += size;
+	return 0;
+}
+
+/**
+ * @brief      Take a free extent of at least size bytes out of the allocator.
+ *
+ * The extent can be larger than requested, the caller decides to split it.
+ *
+ * @param[in]  alloc        The allocator.
+ * @param[in]  size         The minimum size of the extent (number of bytes).
+ * @param[out] offset       Pointer were the offset of the extent can be stored.
+ * @param[out] extent_size  Pointer were the size of the extent can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no free extent is large enough)
+ */
+int
+gp_nvm_alloc_take(	gp_nvm_alloc_t *alloc,
+					uint32_t size,
+					uint32_t *offset,
+					uint32_t *extent_size)
+{
+	for( uint32_t c = _gp_nvm_alloc_class(size); c<GP_NVM_ALLOC_NUM_CLASSES; c++ ){
+		// extents in a larger class always fit, so only the first class needs a first-fit search
+		for( uint32_t i = alloc->heads[c]; i != GP_NVM_ALLOC_NIL; i = alloc->pool[i].next ){
+			alloc->search_steps++;
+			if( alloc->pool[i].size >= size ){
+				*offset = alloc->pool[i].offset;
+				*extent_size = alloc->pool[i].size;
+				_gp_nvm_alloc_unlink(alloc, i);
+				alloc->allocs++;
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief      Take the free extent that ends at end out of the allocator.
+ *
+ * @param[in]  alloc        The allocator.
+ * @param[in]  end          The end offset of the extent, e.g. the end of the data region.
+ * @param[out] offset       Pointer were the offset of the extent can be stored.
+ * @param[out] extent_size  Pointer were the size of the extent can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no free extent ends at end)
+ */
+int
+gp_nvm_alloc_take_end(	gp_nvm_alloc_t *alloc,
+						uint32_t end,
+						uint32_t *offset,
+						uint32_t *extent_size)
+{
+	uint32_t i = _gp_nvm_alloc_lookup(&alloc->by_end, end);
+	if( i == GP_NVM_ALLOC_NIL ){
+		return 1;
+	}
+	*offset = alloc->pool[i].offset;
+	*extent_size = alloc->pool[i].size;
+	_gp_nvm_alloc_unlink(alloc, i);
+	return 0;
+}
+
+/**
+ * @brief      Copy the allocator statistics.
+ *
+ * @param[in]  alloc  The allocator.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_alloc_get_stats(	const gp_nvm_alloc_t *alloc,
+						gp_nvm_alloc_stats_t *stats)
+{
+	memset(stats, 0, sizeof(gp_nvm_alloc_stats_t));
+	stats->free_extents = alloc->free_extents;
+	stats->free_bytes = alloc->free_bytes;
+	stats->allocs = alloc->allocs;
+	stats->frees = alloc->frees;
+	stats->search_steps = alloc->search_steps;
+	stats->merges = alloc->merges;
+	stats->splits = alloc->splits;
+	stats->end_allocs = alloc->end_allocs;
+
+	// the largest extent is in the highest non-empty size class
+	for( int c = GP_NVM_ALLOC_NUM_CLASSES - 1; c>=0 && stats->largest_free == 0 && alloc->free_extents > 0; c-- ){
+		for( uint32_t i = alloc->heads[c]; i != GP_NVM_ALLOC_NIL; i = alloc->pool[i].next ){
+			if( alloc->pool[i].size > stats->largest_free ){
+				stats->largest_free = alloc->pool[i].size;
+			}
+		}
+	}
+	if( stats->free_bytes > 0 ){
+		stats->fragmentation = 1.0 - (double) stats->largest_free / stats->free_bytes;
+	}
+}
+
+/** @} */
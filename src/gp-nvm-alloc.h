@@ -0,0 +1,154 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-alloc.h
+ * \brief	Header file for the free-space allocator of the in-place storage engine.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The allocator keeps track of free extents in the data region. An extent is the space of a record,
+ * its size includes the record header. Free extents are kept in segregated lists per size class,
+ * size class c holds extents with a size in [2^c, 2^(c+1)).
+ * An allocation searches the list of its own size class first-fit and falls back to any extent of a
+ * larger size class, so holes are reused before the data region grows.
+ * A freed extent is merged with the free extents right before and after it, these are found
+ * through two hash maps keyed on the start and end offset of every free extent.
+ */
+
+#ifndef __GP_NVM_ALLOC_H__
+#define __GP_NVM_ALLOC_H__
+
+#include <stdint.h>
+#include "gp-nvm.h"
+#include "gp-nvm-index.h"
+
+/**
+ * @brief      Number of size classes.
+ *
+ */
+#define GP_NVM_ALLOC_NUM_CLASSES 32
+
+/**
+ * @brief      Free extent.
+ *
+ * Extents are kept in a pool, prev and next are the indices of the neighbours in the same list.
+ */
+typedef struct gp_nvm_extent {
+	uint32_t offset;
+	uint32_t size;
+	uint32_t prev;
+	uint32_t next;
+} gp_nvm_extent_t;
+
+/**
+ * @brief      Free-space allocator.
+ *
+ * The offset field of the entries in by_start and by_end holds the pool index of the extent.
+ * Splitting extents, growing the data region and compacting it is done by the store, it updates the counters
+ * for those. Compact bytes are the bytes of the records the compaction moved, reclaimed bytes the bytes the
+ * data region shrank by.
+ */
+typedef struct gp_nvm_alloc {
+	gp_nvm_extent_t *pool;
+	uint32_t pool_size;
+	uint32_t pool_free;
+	uint32_t heads[GP_NVM_ALLOC_NUM_CLASSES];
+	gp_nvm_index_t by_start;
+	gp_nvm_index_t by_end;
+	uint32_t free_extents;
+	uint64_t free_bytes;
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t search_steps;
+	uint64_t merges;
+	uint64_t splits;
+	uint64_t end_allocs;
+	uint64_t compact_bytes;
+	uint64_t reclaimed_bytes;
+} gp_nvm_alloc_t;
+
+/**
+ * @brief      Initialize an allocator without free extents.
+ *
+ * @param[out] alloc  The allocator.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_alloc_init(gp_nvm_alloc_t *alloc);
+
+/**
+ * @brief      Release the memory of the allocator.
+ *
+ * @param[in]  alloc  The allocator.
+ */
+void
+gp_nvm_alloc_deinit(gp_nvm_alloc_t *alloc);
+
+/**
+ * @brief      Add a free extent, merging it with adjacent free extents.
+ *
+ * @param[in]  alloc   The allocator.
+ * @param[in]  offset  The offset of the extent in NVM.
+ * @param[in]  size    The size of the extent (number of bytes).
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_alloc_free(	gp_nvm_alloc_t *alloc,
+					uint32_t offset,
+					uint32_t size);
+
+/**
+ * @brief      Take a free extent of at least size bytes out of the allocator.
+ *
+ * The extent can be larger than requested, the caller decides to split it.
+ *
+ * @param[in]  alloc        The allocator.
+ * @param[in]  size         The minimum size of the extent (number of bytes).
+ * @param[out] offset       Pointer were the offset of the extent can be stored.
+ * @param[out] extent_size  Pointer were the size of the extent can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no free extent is large enough)
+ */
+int
+gp_nvm_alloc_take(	gp_nvm_alloc_t *alloc,
+					uint32_t size,
+					uint32_t *offset,
+					uint32_t *extent_size);
+
+/**
+ * @brief      Take the free extent that ends at end out of the allocator.
+ *
+ * @param[in]  alloc        The allocator.
+ * @param[in]  end          The end offset of the extent, e.g. the end of the data region.
+ * @param[out] offset       Pointer were the offset of the extent can be stored.
+ * @param[out] extent_size  Pointer were the size of the extent can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no free extent ends at end)
+ */
+int
+gp_nvm_alloc_take_end(	gp_nvm_alloc_t *alloc,
+						uint32_t end,
+						uint32_t *offset,
+						uint32_t *extent_size);
+
+/**
+ * @brief      Copy the allocator statistics.
+ *
+ * @param[in]  alloc  The allocator.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_alloc_get_stats(	const gp_nvm_alloc_t *alloc,
+						gp_nvm_alloc_stats_t *stats);
+
+#endif /* __GP_NVM_ALLOC_H__ */
+
+/** @} */
@@ -0,0 +1,293 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-async.c
+ * \brief	Implementation of the asynchronous write pipeline of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-async.h"
+
+// Uses following header(s)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Store a group of queued sets and call their completion callbacks.
+ *
+ * Only the last set of every attribute is passed to the store callback.
+ *
+ * @param[in]  async  The pipeline.
+ * @param[in]  head   The first set of the group in the queue.
+ * @param[in]  count  The number of sets in the group.
+ */
+static void
+_gp_nvm_async_run(gp_nvm_async_t *async, uint32_t head, uint32_t count)
+{
+	uint32_t n = 0;
+
+	for( uint32_t i = 0; i<count; i++ ){
+		gp_nvm_async_entry_t *entry = &async->entries[(head + i) % async->size];
+		int added;
+		gp_nvm_index_entry_t *slot = gp_nvm_index_insert(&async->map, entry->attr_id, &added);
+		if( slot == NULL ){
+			// without a slot the set isn't merged, it is stored after the earlier sets of the attribute
+			async->group[n++] = entry;
+		} else if( !added ){
+			async->group[slot->offset] = entry;
+			async->merged++;
+		} else {
+			slot->offset = n;
+			async->group[n++] = entry;
+		}
+	}
+	async->store(async->store_arg, async->group, n);
+	async->groups++;
+
+	// merged sets complete with the result of the last set of their attribute
+	for( uint32_t i = 0; i<count; i++ ){
+		gp_nvm_async_entry_t *entry = &async->entries[(head + i) % async->size];
+		gp_nvm_index_entry_t *slot = gp_nvm_index_find(&async->map, entry->attr_id);
+		gp_nvm_result_t result = slot != NULL ? async->group[slot->offset]->result : entry->result;
+		if( entry->cb != NULL ){
+			entry->cb(entry->attr_id, result, entry->arg);
+		}
+	}
+	for( uint32_t i = 0; i<n; i++ ){
+		gp_nvm_index_remove(&async->map, async->group[i]->attr_id);
+	}
+}
+
+#if GP_NVM_CONF_THREADS
+/**
+ * @brief      I/O worker thread, stores all queued sets until the pipeline is stopped.
+ *
+ */
+static void*
+_gp_nvm_async_worker(void *arg)
+{
+	gp_nvm_async_t *async = arg;
+
+	pthread_mutex_lock(&async->lock);
+	for( ;; ){
+		while( async->count == 0 && !async->stop ){
+			pthread_cond_wait(&async->work, &async->lock);
+		}
+		// the queue is drained before the worker stops
+		if( async->count == 0 ){
+			break;
+		}
+
+		// submissions go after the group, so the group can be stored without the lock
+		uint32_t head = async->head;
+		uint32_t count = async->count;
+		pthread_mutex_unlock(&async->lock);
+		_gp_nvm_async_run(async, head, count);
+		pthread_mutex_lock(&async->lock);
+
+		async->head = (head + count) % async->size;
+		async->count -= count;
+		pthread_cond_broadcast(&async->idle);
+	}
+	pthread_mutex_unlock(&async->lock);
+	return NULL;
+}
+
+/**
+ * @brief      Allocate the queue and start the worker, the caller holds the lock.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_gp_nvm_async_start(gp_nvm_async_t *async)
+{
+	async->entries = calloc(async->size, sizeof(gp_nvm_async_entry_t));
+	async->group = calloc(async->size, sizeof(gp_nvm_async_entry_t*));
+	if( async->entries == NULL || async->group == NULL || gp_nvm_index_init(&async->map) != 0 ){
+		goto error;
+	}
+	if( pthread_create(&async->worker, NULL, _gp_nvm_async_worker, async) != 0 ){
+		fprintf(stderr, "GP-NVM: can't start the I/O worker\n");
+		goto error;
+	}
+	async->running = 1;
+	return 0;
+
+error:
+	free(async->entries);
+	free(async->group);
+	gp_nvm_index_deinit(&async->map);
+	async->entries = NULL;
+	async->group = NULL;
+	return 1;
+}
+#endif
+
+/**
+ * @brief      Initialize the pipeline, no memory is allocated and no thread is started yet.
+ *
+ * @param[out] async      The pipeline.
+ * @param[in]  size       The number of sets in the submission queue, 0 selects GP_NVM_CONF_ASYNC_QUEUE_SIZE.
+ * @param[in]  store      The callback that stores a group of sets.
+ * @param[in]  store_arg  The first argument of the callback.
+ */
+void
+gp_nvm_async_init(	gp_nvm_async_t *async,
+					uint32_t size,
+					gp_nvm_async_store_fn_t store,
+					void *store_arg)
+{
+	memset(async, 0, sizeof(gp_nvm_async_t));
+	async->size = size ? size : GP_NVM_CONF_ASYNC_QUEUE_SIZE;
+	async->store = store;
+	async->store_arg = store_arg;
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->work, NULL);
+	pthread_cond_init(&async->idle, NULL);
+#endif
+}
+
+/**
+ * @brief      Complete all queued sets, stop the worker and release the memory of the pipeline.
+ *
+ * @param[in]  async  The pipeline.
+ */
+void
+gp_nvm_async_deinit(gp_nvm_async_t *async)
+{
+	// the pipeline was never initialized
+	if( async->store == NULL ){
+		return;
+	}
+#if GP_NVM_CONF_THREADS
+	if( async->running ){
+		pthread_mutex_lock(&async->lock);
+		async->stop = 1;
+		pthread_cond_signal(&async->work);
+		pthread_mutex_unlock(&async->lock);
+		pthread_join(async->worker, NULL);
+	}
+	pthread_mutex_destroy(&async->lock);
+	pthread_cond_destroy(&async->work);
+	pthread_cond_destroy(&async->idle);
+#endif
+	free(async->entries);
+	free(async->group);
+	gp_nvm_index_deinit(&async->map);
+	memset(async, 0, sizeof(gp_nvm_async_t));
+}
+
+/**
+ * @brief      Queue the set of an attribute, the value is copied.
+ *
+ * @param[in]  async    The pipeline.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL if the caller polls.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the pipeline wasn't initialized)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full, the worker can't be started or the value is longer than GP_NVM_CONF_ASYNC_VALUE_SIZE)
+ */
+gp_nvm_result_t
+gp_nvm_async_submit(	gp_nvm_async_t *async,
+						uint32_t attr_id,
+						uint32_t length,
+						const uint8_t* p_value,
+						gp_nvm_async_cb_t cb,
+						void *arg)
+{
+	if( async->store == NULL ){
+		return GP_NVM_FAIL;
+	}
+	if( length > GP_NVM_CONF_ASYNC_VALUE_SIZE ){
+		return GP_NVM_MEM_FULL;
+	}
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_lock(&async->lock);
+	if( (!async->running && _gp_nvm_async_start(async) != 0) || async->count == async->size ){
+		pthread_mutex_unlock(&async->lock);
+		return GP_NVM_MEM_FULL;
+	}
+	gp_nvm_async_entry_t *entry = &async->entries[(async->head + async->count) % async->size];
+	entry->attr_id = attr_id;
+	entry->len = length;
+	entry->cb = cb;
+	entry->arg = arg;
+	entry->result = GP_NVM_SUCCESS;
+	memcpy(entry->value, p_value, length);
+	async->count++;
+	async->submitted++;
+	pthread_cond_signal(&async->work);
+	pthread_mutex_unlock(&async->lock);
+#else
+	// without a worker the set completes right away
+	gp_nvm_async_entry_t entry = { .attr_id = attr_id, .len = length, .cb = cb, .arg = arg };
+	gp_nvm_async_entry_t *group = &entry;
+	memcpy(entry.value, p_value, length);
+	async->submitted++;
+	async->store(async->store_arg, &group, 1);
+	async->groups++;
+	if( cb != NULL ){
+		cb(attr_id, entry.result, arg);
+	}
+#endif
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Return the number of sets that were queued but aren't completed yet.
+ *
+ * @param[in]  async  The pipeline.
+ */
+uint32_t
+gp_nvm_async_pending(gp_nvm_async_t *async)
+{
+	uint32_t count;
+	if( async->store == NULL ){
+		return 0;
+	}
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_lock(&async->lock);
+	count = async->count;
+	pthread_mutex_unlock(&async->lock);
+#else
+	count = async->count;
+#endif
+	return count;
+}
+
+/**
+ * @brief      Wait until all queued sets are completed.
+ *
+ * This may not be called from a completion callback.
+ *
+ * @param[in]  async  The pipeline.
+ */
+void
+gp_nvm_async_wait(gp_nvm_async_t *async)
+{
+#if GP_NVM_CONF_THREADS
+	if( async->store == NULL ){
+		return;
+	}
+	pthread_mutex_lock(&async->lock);
+	while( async->count > 0 ){
+		pthread_cond_wait(&async->idle, &async->lock);
+	}
+	pthread_mutex_unlock(&async->lock);
+#else
+	(void) async;
+#endif
+}
+
+/** @} */
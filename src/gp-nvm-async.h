@@ -0,0 +1,156 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-async.h
+ * \brief	Header file for the asynchronous write pipeline of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * Asynchronous sets are copied into a bounded submission queue and return immediately, an I/O worker
+ * thread stores them. The worker takes all queued sets at once: when an attribute was set several times
+ * only its last value is stored, the other sets are merged into it. The remaining sets are passed to the
+ * store callback together, so they can be written with as few vectored writes as possible.
+ * After the store the completion callback of every set is called from the worker thread, merged sets get
+ * the result of the set they were merged into.
+ * The queue and the worker are only created by the first asynchronous set.
+ * Without GP_NVM_CONF_THREADS the sets are stored and completed before the submission returns.
+ */
+
+#ifndef __GP_NVM_ASYNC_H__
+#define __GP_NVM_ASYNC_H__
+
+#include "gp-nvm.h"
+#include "gp-nvm-index.h"
+#include "gp-nvm-sync.h"
+
+/**
+ * @brief      Default number of sets in the submission queue.
+ *
+ */
+#ifndef GP_NVM_CONF_ASYNC_QUEUE_SIZE
+#define GP_NVM_CONF_ASYNC_QUEUE_SIZE 64
+#endif
+
+/**
+ * @brief      Maximum length of the value of an asynchronous set, the value is copied into the queue entry.
+ *
+ */
+#ifndef GP_NVM_CONF_ASYNC_VALUE_SIZE
+#define GP_NVM_CONF_ASYNC_VALUE_SIZE 255
+#endif
+
+/**
+ * @brief      Queued asynchronous set.
+ *
+ * The result is filled in by the store callback for the sets it stores.
+ */
+typedef struct gp_nvm_async_entry {
+	uint32_t attr_id;
+	uint32_t len;
+	gp_nvm_async_cb_t cb;
+	void *arg;
+	gp_nvm_result_t result;
+	uint8_t value[GP_NVM_CONF_ASYNC_VALUE_SIZE];
+} gp_nvm_async_entry_t;
+
+/**
+ * @brief      Callback that stores a group of sets of different attributes.
+ *
+ */
+typedef void (*gp_nvm_async_store_fn_t)(void *arg, gp_nvm_async_entry_t **entries, uint32_t num_entries);
+
+/**
+ * @brief      Asynchronous write pipeline.
+ *
+ * The queue is a ring of size entries, the worker owns the count entries starting at head until it
+ * completed them. The map holds the last set of every attribute in the group the worker is storing.
+ */
+typedef struct gp_nvm_async {
+	gp_nvm_async_entry_t *entries;
+	uint32_t size;
+	uint32_t head;
+	uint32_t count;
+	gp_nvm_index_t map;
+	gp_nvm_async_entry_t **group;
+	gp_nvm_async_store_fn_t store;
+	void *store_arg;
+	int running;
+	int stop;
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t idle;
+	pthread_t worker;
+#endif
+	uint64_t submitted;
+	uint64_t merged;
+	uint64_t groups;
+} gp_nvm_async_t;
+
+/**
+ * @brief      Initialize the pipeline, no memory is allocated and no thread is started yet.
+ *
+ * @param[out] async      The pipeline.
+ * @param[in]  size       The number of sets in the submission queue, 0 selects GP_NVM_CONF_ASYNC_QUEUE_SIZE.
+ * @param[in]  store      The callback that stores a group of sets.
+ * @param[in]  store_arg  The first argument of the callback.
+ */
+void
+gp_nvm_async_init(	gp_nvm_async_t *async,
+					uint32_t size,
+					gp_nvm_async_store_fn_t store,
+					void *store_arg);
+
+/**
+ * @brief      Complete all queued sets, stop the worker and release the memory of the pipeline.
+ *
+ * @param[in]  async  The pipeline.
+ */
+void
+gp_nvm_async_deinit(gp_nvm_async_t *async);
+
+/**
+ * @brief      Queue the set of an attribute, the value is copied.
+ *
+ * @param[in]  async    The pipeline.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL if the caller polls.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the pipeline wasn't initialized)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full, the worker can't be started or the value is longer than GP_NVM_CONF_ASYNC_VALUE_SIZE)
+ */
+gp_nvm_result_t
+gp_nvm_async_submit(	gp_nvm_async_t *async,
+						uint32_t attr_id,
+						uint32_t length,
+						const uint8_t* p_value,
+						gp_nvm_async_cb_t cb,
+						void *arg);
+
+/**
+ * @brief      Return the number of sets that were queued but aren't completed yet.
+ *
+ * @param[in]  async  The pipeline.
+ */
+uint32_t
+gp_nvm_async_pending(gp_nvm_async_t *async);
+
+/**
+ * @brief      Wait until all queued sets are completed.
+ *
+ * This may not be called from a completion callback.
+ *
+ * @param[in]  async  The pipeline.
+ */
+void
+gp_nvm_async_wait(gp_nvm_async_t *async);
+
+#endif /* __GP_NVM_ASYNC_H__ */
+
+/** @} */
@@ -0,0 +1,367 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-batch.c
+ * \brief	Implementation of atomic batches of attribute sets of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-batch.h"
+
+// Uses following header(s)
+#include "nvm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Size of the buffer of zeros that fills the unused capacity of records.
+ *
+ */
+#define GP_NVM_BATCH_ZERO_SIZE 256
+
+/**
+ * @brief      Zeros written to the unused capacity of records.
+ *
+ */
+static const uint8_t gp_nvm_batch_zeros[GP_NVM_BATCH_ZERO_SIZE];
+
+/**
+ * @brief      Number of zero buffers needed for the unused capacity of a record.
+ *
+ */
+static uint32_t
+_gp_nvm_batch_zero_bufs(const gp_nvm_record_hdr_t *hdr)
+{
+	return (hdr->capacity - hdr->len + GP_NVM_BATCH_ZERO_SIZE - 1) / GP_NVM_BATCH_ZERO_SIZE;
+}
+
+/**
+ * @brief      Compare two records on their offset (for qsort).
+ *
+ */
+static int
+_gp_nvm_batch_cmp_offset(const void *a, const void *b)
+{
+	const gp_nvm_batch_record_t *ra = a;
+	const gp_nvm_batch_record_t *rb = b;
+	return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+/**
+ * @brief      Compare two records on their sequence number (for qsort).
+ *
+ */
+static int
+_gp_nvm_batch_cmp_seq(const void *a, const void *b)
+{
+	const gp_nvm_batch_record_t *ra = a;
+	const gp_nvm_batch_record_t *rb = b;
+	return (ra->hdr.seq > rb->hdr.seq) - (ra->hdr.seq < rb->hdr.seq);
+}
+
+/**
+ * @brief      Append a record to a growing array of records.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+static int
+_gp_nvm_batch_push(gp_nvm_batch_record_t **records, uint32_t *num, uint32_t *max, uint32_t offset, const gp_nvm_record_hdr_t *hdr)
+{
+	if( *num == *max ){
+		uint32_t grown = *max ? *max * 2 : 16;
+		gp_nvm_batch_record_t *p = realloc(*records, grown * sizeof(gp_nvm_batch_record_t));
+		if( p == NULL ){
+			return 1;
+		}
+		*records = p;
+		*max = grown;
+	}
+	(*records)[*num].offset = offset;
+	(*records)[*num].hdr = *hdr;
+	(*records)[*num].value = NULL;
+	(*num)++;
+	return 0;
+}
+
+/**
+ * @brief      Start a batch, sets that were staged before are dropped.
+ *
+ * @param[in]  batch  The batch.
+ */
+void
+gp_nvm_batch_init(gp_nvm_batch_t *batch)
+{
+	batch->active = 1;
+	batch->num_entries = 0;
+	batch->data_len = 0;
+}
+
+/**
+ * @brief      Stop the batch and release its memory.
+ *
+ * @param[in]  batch  The batch.
+ */
+void
+gp_nvm_batch_deinit(gp_nvm_batch_t *batch)
+{
+	free(batch->entries);
+	free(batch->data);
+	free(batch->records);
+	memset(batch, 0, sizeof(gp_nvm_batch_t));
+}
+
+/**
+ * @brief      Make room for a value of length bytes at the end of the data buffer of a batch.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+static int
+_gp_nvm_batch_reserve(gp_nvm_batch_t *batch, uint32_t length)
+{
+	if( batch->data_len + length > batch->data_size ){
+		uint32_t grown = batch->data_size ? batch->data_size : 256;
+		while( grown < batch->data_len + length ){
+			grown *= 2;
+		}
+		uint8_t *data = realloc(batch->data, grown);
+		if( data == NULL ){
+			return 1;
+		}
+		batch->data = data;
+		batch->data_size = grown;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Copy a value to the end of the data buffer of a batch and point an entry at it.
+ *
+ */
+static void
+_gp_nvm_batch_put(	gp_nvm_batch_t *batch,
+					gp_nvm_batch_entry_t *entry,
+					uint32_t length,
+					const uint8_t* p_value,
+					uint32_t codec)
+{
+	if( length > 0 ){
+		memcpy(batch->data + batch->data_len, p_value, length);
+	}
+	entry->len = length;
+	entry->data = batch->data_len;
+	entry->codec = codec;
+	batch->data_len += length;
+}
+
+/**
+ * @brief      Stage the set of an attribute, a later set of the same attribute replaces it.
+ *
+ * @param[in]  batch    The batch.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, it is copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_stage(	gp_nvm_batch_t *batch,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value)
+{
+	for( uint32_t i = 0; i<batch->num_entries; i++ ){
+		if( batch->entries[i].attr_id == attr_id ){
+			// the value is appended to the data buffer, the value of a replaced set is left behind
+			if( _gp_nvm_batch_reserve(batch, length) != 0 ){
+				return 1;
+			}
+			_gp_nvm_batch_put(batch, &batch->entries[i], length, p_value, GP_NVM_CODEC_NONE);
+			return 0;
+		}
+	}
+	return gp_nvm_batch_append(batch, attr_id, length, p_value, GP_NVM_CODEC_NONE);
+}
+
+/**
+ * @brief      Stage the set of an attribute that isn't staged yet, without searching the staged sets.
+ *
+ * @param[in]  batch    The batch.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value.
+ * @param[in]  p_value  Pointer to the value in RAM, it is copied.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_append(	gp_nvm_batch_t *batch,
+						uint32_t attr_id,
+						uint32_t length,
+						const uint8_t* p_value,
+						uint32_t codec)
+{
+	if( _gp_nvm_batch_reserve(batch, length) != 0 ){
+		return 1;
+	}
+	if( batch->num_entries == batch->max_entries ){
+		uint32_t grown = batch->max_entries ? batch->max_entries * 2 : 16;
+		gp_nvm_batch_entry_t *entries = realloc(batch->entries, grown * sizeof(gp_nvm_batch_entry_t));
+		if( entries == NULL ){
+			return 1;
+		}
+		batch->entries = entries;
+		// one more record than entries for the commit record
+		gp_nvm_batch_record_t *records = realloc(batch->records, (grown + 1) * sizeof(gp_nvm_batch_record_t));
+		if( records == NULL ){
+			return 1;
+		}
+		batch->records = records;
+		batch->max_entries = grown;
+	}
+	gp_nvm_batch_entry_t *entry = &batch->entries[batch->num_entries++];
+	entry->attr_id = attr_id;
+	_gp_nvm_batch_put(batch, entry, length, p_value, codec);
+	return 0;
+}
+
+/**
+ * @brief      Write records to the NVM, records that are adjacent are written with one vectored update.
+ *
+ * The records are sorted on their offset.
+ *
+ * @param[in]  dev          The NVM device.
+ * @param[in]  records      The records.
+ * @param[in]  num_records  The number of records.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_batch_write(	nvm_dev_t *dev,
+					gp_nvm_batch_record_t *records,
+					uint32_t num_records)
+{
+	qsort(records, num_records, sizeof(gp_nvm_batch_record_t), _gp_nvm_batch_cmp_offset);
+
+	uint32_t first = 0;
+	while( first < num_records ){
+		// find the run of records that are adjacent, every record needs a buffer for its header,
+		// its value and every GP_NVM_BATCH_ZERO_SIZE bytes of unused capacity
+		uint32_t last = first;
+		uint32_t end = records[first].offset + GP_NVM_RECORD_SIZE(records[first].hdr.capacity);
+		uint32_t iovcnt = 2 + _gp_nvm_batch_zero_bufs(&records[first].hdr);
+		while( last + 1 < num_records && records[last + 1].offset == end ){
+			last++;
+			end += GP_NVM_RECORD_SIZE(records[last].hdr.capacity);
+			iovcnt += 2 + _gp_nvm_batch_zero_bufs(&records[last].hdr);
+		}
+
+		// the run is written with one vectored update, the unused capacity of the records is written as zeros
+		nvm_iovec_t *iov = malloc(iovcnt * sizeof(nvm_iovec_t));
+		if( iov == NULL ){
+			return 1;
+		}
+		uint32_t n = 0;
+		for( uint32_t i = first; i<=last; i++ ){
+			gp_nvm_store_seal_hdr(&records[i].hdr);
+			iov[n].base = &records[i].hdr;
+			iov[n++].len = sizeof(gp_nvm_record_hdr_t);
+			iov[n].base = records[i].value;
+			iov[n++].len = records[i].hdr.len;
+			for( uint32_t pad = records[i].hdr.capacity - records[i].hdr.len; pad > 0; ){
+				iov[n].base = gp_nvm_batch_zeros;
+				iov[n].len = pad < GP_NVM_BATCH_ZERO_SIZE ? pad : GP_NVM_BATCH_ZERO_SIZE;
+				pad -= iov[n++].len;
+			}
+		}
+		int result = nvm_dev_updatev(dev, records[first].offset, iov, n);
+		free(iov);
+		if( result != 0 ){
+			return 1;
+		}
+		first = last + 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Add a record with the batch flag or a commit record found at offset.
+ *
+ * @param[in]  recovery  The recovery state.
+ * @param[in]  offset    The offset of the record in NVM.
+ * @param[in]  hdr       The header of the record.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_recovery_add(	gp_nvm_batch_recovery_t *recovery,
+							uint32_t offset,
+							const gp_nvm_record_hdr_t *hdr)
+{
+	if( hdr->type == GP_NVM_RECORD_COMMIT ){
+		return _gp_nvm_batch_push(&recovery->commits, &recovery->num_commits, &recovery->max_commits, offset, hdr);
+	}
+	return _gp_nvm_batch_push(&recovery->pending, &recovery->num_pending, &recovery->max_pending, offset, hdr);
+}
+
+/**
+ * @brief      Check if the commit record was found for a record with the batch flag.
+ *
+ * The commit records are sorted the first time this is called, no records can be added afterwards.
+ *
+ * @param[in]  recovery  The recovery state.
+ * @param[in]  seq       The sequence number of the record.
+ *
+ * @return     1: The batch of the record was committed.
+ * @return     0: The batch of the record wasn't committed.
+ */
+int
+gp_nvm_batch_recovery_committed(	gp_nvm_batch_recovery_t *recovery,
+									uint32_t seq)
+{
+	if( !recovery->sorted ){
+		qsort(recovery->commits, recovery->num_commits, sizeof(gp_nvm_batch_record_t), _gp_nvm_batch_cmp_seq);
+		recovery->sorted = 1;
+	}
+
+	// the batch of a record is committed by the first commit record after it
+	uint32_t lo = 0;
+	uint32_t hi = recovery->num_commits;
+	while( lo < hi ){
+		uint32_t mid = lo + (hi - lo) / 2;
+		if( recovery->commits[mid].hdr.seq <= seq ){
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if( lo == recovery->num_commits ){
+		return 0;
+	}
+	const gp_nvm_record_hdr_t *commit = &recovery->commits[lo].hdr;
+	return seq >= commit->seq - commit->attr_id;
+}
+
+/**
+ * @brief      Release the memory of the recovery state.
+ *
+ * @param[in]  recovery  The recovery state.
+ */
+void
+gp_nvm_batch_recovery_deinit(gp_nvm_batch_recovery_t *recovery)
+{
+	free(recovery->pending);
+	free(recovery->commits);
+	memset(recovery, 0, sizeof(gp_nvm_batch_recovery_t));
+}
+
+/** @} */
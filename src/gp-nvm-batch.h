@@ -0,0 +1,189 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-batch.h
+ * \brief	Header file for atomic batches of attribute sets of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A batch stages sets in RAM until it is committed. At commit the storage engine writes a record with
+ * the batch flag for every staged attribute, records that are adjacent on the NVM are written with one
+ * vectored update. The batch becomes valid when the commit record is written after them.
+ * The records of a batch have the sequence numbers right before the commit record, and the attribute ID
+ * field of the commit record holds the number of records in the batch.
+ * At boot-time records with the batch flag are only used when the commit record of their batch is found,
+ * so a crash during a commit leaves either all sets of the batch or none of them.
+ */
+
+#ifndef __GP_NVM_BATCH_H__
+#define __GP_NVM_BATCH_H__
+
+#include "gp-nvm-store.h"
+
+/**
+ * @brief      Staged set of an attribute.
+ *
+ * The value is stored in the data buffer of the batch at offset data, with codec GP_NVM_CODEC_NONE
+ * until it is compressed in place before the commit.
+ */
+typedef struct gp_nvm_batch_entry {
+	uint32_t attr_id;
+	uint32_t len;
+	uint32_t data;
+	uint32_t codec;
+} gp_nvm_batch_entry_t;
+
+/**
+ * @brief      Record that is written or found as part of a batch.
+ *
+ */
+typedef struct gp_nvm_batch_record {
+	uint32_t offset;
+	gp_nvm_record_hdr_t hdr;
+	const uint8_t *value;
+} gp_nvm_batch_record_t;
+
+/**
+ * @brief      Batch of staged attribute sets.
+ *
+ * The records array is scratch space for the storage engine, it has room for a record per entry and the commit record.
+ */
+typedef struct gp_nvm_batch {
+	int active;
+	uint32_t num_entries;
+	uint32_t max_entries;
+	gp_nvm_batch_entry_t *entries;
+	uint8_t *data;
+	uint32_t data_len;
+	uint32_t data_size;
+	gp_nvm_batch_record_t *records;
+} gp_nvm_batch_t;
+
+/**
+ * @brief      Batch records and commit records found while scanning the NVM at boot-time.
+ *
+ */
+typedef struct gp_nvm_batch_recovery {
+	int sorted;
+	gp_nvm_batch_record_t *pending;
+	uint32_t num_pending;
+	uint32_t max_pending;
+	gp_nvm_batch_record_t *commits;
+	uint32_t num_commits;
+	uint32_t max_commits;
+} gp_nvm_batch_recovery_t;
+
+/**
+ * @brief      Start a batch, sets that were staged before are dropped.
+ *
+ * @param[in]  batch  The batch.
+ */
+void
+gp_nvm_batch_init(gp_nvm_batch_t *batch);
+
+/**
+ * @brief      Stop the batch and release its memory.
+ *
+ * @param[in]  batch  The batch.
+ */
+void
+gp_nvm_batch_deinit(gp_nvm_batch_t *batch);
+
+/**
+ * @brief      Stage the set of an attribute, a later set of the same attribute replaces it.
+ *
+ * @param[in]  batch    The batch.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, it is copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_stage(	gp_nvm_batch_t *batch,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value);
+
+/**
+ * @brief      Stage the set of an attribute that isn't staged yet, without searching the staged sets.
+ *
+ * The value can already be encoded with a codec, e.g. when it is imported as it was stored.
+ *
+ * @param[in]  batch    The batch.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value.
+ * @param[in]  p_value  Pointer to the value in RAM, it is copied.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_append(	gp_nvm_batch_t *batch,
+						uint32_t attr_id,
+						uint32_t length,
+						const uint8_t* p_value,
+						uint32_t codec);
+
+/**
+ * @brief      Write records to the NVM, records that are adjacent are written with one vectored update.
+ *
+ * The records are sorted on their offset.
+ *
+ * @param[in]  dev          The NVM device.
+ * @param[in]  records      The records.
+ * @param[in]  num_records  The number of records.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_batch_write(	nvm_dev_t *dev,
+					gp_nvm_batch_record_t *records,
+					uint32_t num_records);
+
+/**
+ * @brief      Add a record with the batch flag or a commit record found at offset.
+ *
+ * @param[in]  recovery  The recovery state.
+ * @param[in]  offset    The offset of the record in NVM.
+ * @param[in]  hdr       The header of the record.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_batch_recovery_add(	gp_nvm_batch_recovery_t *recovery,
+							uint32_t offset,
+							const gp_nvm_record_hdr_t *hdr);
+
+/**
+ * @brief      Check if the commit record was found for a record with the batch flag.
+ *
+ * The commit records are sorted the first time this is called, no records can be added afterwards.
+ *
+ * @param[in]  recovery  The recovery state.
+ * @param[in]  seq       The sequence number of the record.
+ *
+ * @return     1: The batch of the record was committed.
+ * @return     0: The batch of the record wasn't committed.
+ */
+int
+gp_nvm_batch_recovery_committed(	gp_nvm_batch_recovery_t *recovery,
+									uint32_t seq);
+
+/**
+ * @brief      Release the memory of the recovery state.
+ *
+ * @param[in]  recovery  The recovery state.
+ */
+void
+gp_nvm_batch_recovery_deinit(gp_nvm_batch_recovery_t *recovery);
+
+#endif /* __GP_NVM_BATCH_H__ */
+
+/** @} */
@@ -0,0 +1,346 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-cache.c
+ * \brief	Implementation of the write-back value cache of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-cache.h"
+
+// Uses following header(s)
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Look up the cache entry of an attribute.
+ *
+ * @return     NULL when the attribute isn't cached.
+ */
+static gp_nvm_cache_entry_t*
+_gp_nvm_cache_find(const gp_nvm_cache_t *cache, uint32_t attr_id)
+{
+	gp_nvm_index_entry_t *slot = gp_nvm_index_find(&cache->map, attr_id);
+	return slot != NULL ? &cache->entries[slot->offset] : NULL;
+}
+
+/**
+ * @brief      Write back an entry if it is dirty.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_cache_clean(gp_nvm_cache_t *cache, gp_nvm_cache_entry_t *entry)
+{
+	if( !entry->dirty ){
+		return GP_NVM_SUCCESS;
+	}
+	gp_nvm_result_t result = cache->writeback(cache->writeback_arg, entry->attr_id, entry->len, entry->value);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	entry->dirty = 0;
+	cache->dirty--;
+	cache->writebacks++;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Remove an entry from the cache.
+ *
+ */
+static void
+_gp_nvm_cache_drop(gp_nvm_cache_t *cache, gp_nvm_cache_entry_t *entry)
+{
+	if( entry->dirty ){
+		cache->dirty--;
+	}
+	gp_nvm_index_remove(&cache->map, entry->attr_id);
+	entry->used = 0;
+	entry->dirty = 0;
+}
+
+/**
+ * @brief      Find an unused entry, evicting an entry with the CLOCK algorithm when all entries are used.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_cache_victim(gp_nvm_cache_t *cache, uint32_t *victim)
+{
+	// every entry is passed at most twice: once to clear its referenced bit and once to evict it
+	for( uint32_t steps = 0; steps < 2 * cache->num_entries; steps++ ){
+		gp_nvm_cache_entry_t *entry = &cache->entries[cache->hand];
+		uint32_t n = cache->hand;
+		cache->hand = (cache->hand + 1) % cache->num_entries;
+		if( entry->used && entry->referenced ){
+			entry->referenced = 0;
+			continue;
+		}
+		if( entry->used ){
+			gp_nvm_result_t result = _gp_nvm_cache_clean(cache, entry);
+			if( result != GP_NVM_SUCCESS ){
+				return result;
+			}
+			_gp_nvm_cache_drop(cache, entry);
+			cache->evictions++;
+		}
+		*victim = n;
+		return GP_NVM_SUCCESS;
+	}
+	return GP_NVM_MEM_FULL;
+}
+
+/**
+ * @brief      Create a cache of size bytes.
+ *
+ * @param[out] cache          The cache.
+ * @param[in]  size           The size of the arena in bytes, it holds at least one entry.
+ * @param[in]  writeback      The callback that writes dirty values back.
+ * @param[in]  writeback_arg  The first argument of the callback.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_cache_init(	gp_nvm_cache_t *cache,
+					uint32_t size,
+					gp_nvm_cache_writeback_fn_t writeback,
+					void *writeback_arg)
+{
+	memset(cache, 0, sizeof(gp_nvm_cache_t));
+	cache->num_entries = size / sizeof(gp_nvm_cache_entry_t);
+	if( cache->num_entries == 0 ){
+		cache->num_entries = 1;
+	}
+	cache->writeback = writeback;
+	cache->writeback_arg = writeback_arg;
+	cache->entries = calloc(cache->num_entries, sizeof(gp_nvm_cache_entry_t));
+	if( cache->entries == NULL || gp_nvm_index_init(&cache->map) != 0 ){
+		gp_nvm_cache_deinit(cache);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Release the memory of the cache, dirty values are dropped.
+ *
+ * @param[in]  cache  The cache.
+ */
+void
+gp_nvm_cache_deinit(gp_nvm_cache_t *cache)
+{
+	free(cache->entries);
+	gp_nvm_index_deinit(&cache->map);
+	memset(cache, 0, sizeof(gp_nvm_cache_t));
+}
+
+/**
+ * @brief      Copy the value of an attribute from the cache.
+ *
+ * The length is always stored, the value only when it fits in size bytes.
+ *
+ * @param[in]  cache     The cache.
+ * @param[in]  attr_id   The attribute identifier.
+ * @param[in]  size      The size of the buffer at p_value.
+ * @param[out] p_length  Pointer were the length can be stored.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     1: The attribute was in the cache.
+ * @return     0: The attribute wasn't in the cache.
+ */
+int
+gp_nvm_cache_get(	gp_nvm_cache_t *cache,
+					uint32_t attr_id,
+					uint32_t size,
+					uint32_t* p_length,
+					uint8_t* p_value)
+{
+	gp_nvm_cache_entry_t *entry = _gp_nvm_cache_find(cache, attr_id);
+	if( entry == NULL ){
+		cache->misses++;
+		return 0;
+	}
+	if( entry->len <= size ){
+		memcpy(p_value, entry->value, entry->len);
+	}
+	*p_length = entry->len;
+	entry->referenced = 1;
+	cache->hits++;
+	return 1;
+}
+
+/**
+ * @brief      Store the value of an attribute in the cache, an entry is evicted when the cache is full.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  dirty    1 if the value still has to be written back, 0 if it was read from the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the value is too large, the attribute is not cached)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the write back of the evicted entry failed)
+ */
+gp_nvm_result_t
+gp_nvm_cache_put(	gp_nvm_cache_t *cache,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value,
+					int dirty)
+{
+	gp_nvm_cache_entry_t *entry = _gp_nvm_cache_find(cache, attr_id);
+
+	if( length > GP_NVM_CONF_CACHE_VALUE_SIZE ){
+		// the cached value would be older than the value the caller writes to the NVM
+		if( entry != NULL ){
+			_gp_nvm_cache_drop(cache, entry);
+		}
+		return GP_NVM_FAIL;
+	}
+
+	if( entry == NULL ){
+		uint32_t n;
+		gp_nvm_result_t result = _gp_nvm_cache_victim(cache, &n);
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+		int added;
+		gp_nvm_index_entry_t *slot = gp_nvm_index_insert(&cache->map, attr_id, &added);
+		if( slot == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+		slot->offset = n;
+		entry = &cache->entries[n];
+		entry->attr_id = attr_id;
+		entry->used = 1;
+		entry->dirty = 0;
+	} else if( entry->dirty && dirty ){
+		cache->absorbed++;
+	}
+
+	if( dirty && !entry->dirty ){
+		cache->dirty++;
+	}
+	entry->dirty |= dirty;
+	entry->referenced = 1;
+	entry->len = length;
+	memcpy(entry->value, p_value, length);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Drop the cache entry of an attribute, also when it is dirty.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     1: The attribute was in the cache.
+ * @return     0: The attribute wasn't in the cache.
+ */
+int
+gp_nvm_cache_invalidate(	gp_nvm_cache_t *cache,
+							uint32_t attr_id)
+{
+	gp_nvm_cache_entry_t *entry = _gp_nvm_cache_find(cache, attr_id);
+	if( entry == NULL ){
+		return 0;
+	}
+	_gp_nvm_cache_drop(cache, entry);
+	return 1;
+}
+
+/**
+ * @brief      Check whether the cache entry of an attribute still has to be written back.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     1: The attribute is cached and dirty.
+ * @return     0: The attribute isn't cached or its cached value is on the NVM.
+ */
+int
+gp_nvm_cache_is_dirty(	const gp_nvm_cache_t *cache,
+						uint32_t attr_id)
+{
+	const gp_nvm_cache_entry_t *entry = _gp_nvm_cache_find(cache, attr_id);
+	return entry != NULL && entry->dirty;
+}
+
+/**
+ * @brief      Write back the cache entry of an attribute if it is dirty, the entry stays cached.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_cache_clean(	gp_nvm_cache_t *cache,
+					uint32_t attr_id)
+{
+	gp_nvm_cache_entry_t *entry = _gp_nvm_cache_find(cache, attr_id);
+	if( entry == NULL ){
+		return GP_NVM_SUCCESS;
+	}
+	return _gp_nvm_cache_clean(cache, entry);
+}
+
+/**
+ * @brief      Write back all dirty entries.
+ *
+ * @param[in]  cache  The cache.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_cache_flush(gp_nvm_cache_t *cache)
+{
+	for( uint32_t i = 0; i<cache->num_entries && cache->dirty > 0; i++ ){
+		if( cache->entries[i].used ){
+			gp_nvm_result_t result = _gp_nvm_cache_clean(cache, &cache->entries[i]);
+			if( result != GP_NVM_SUCCESS ){
+				return result;
+			}
+		}
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Copy the cache statistics.
+ *
+ * @param[in]  cache  The cache.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_cache_get_stats(	const gp_nvm_cache_t *cache,
+						gp_nvm_cache_stats_t *stats)
+{
+	memset(stats, 0, sizeof(gp_nvm_cache_stats_t));
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->absorbed = cache->absorbed;
+	stats->writebacks = cache->writebacks;
+	stats->evictions = cache->evictions;
+	stats->num_entries = cache->num_entries;
+	stats->cached = cache->map.num_entries;
+	stats->dirty = cache->dirty;
+}
+
+/** @} */
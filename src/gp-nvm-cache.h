@@ -0,0 +1,204 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-cache.h
+ * \brief	Header file for the write-back value cache of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The cache keeps the values of recently used attributes in RAM. All cache entries are carved from
+ * one arena that is allocated when the cache is created, every entry has room for a value of
+ * GP_NVM_CONF_CACHE_VALUE_SIZE bytes. Larger values are not cached.
+ * A set only updates the cache entry and marks it dirty, repeated sets of the same attribute are absorbed.
+ * Dirty entries are written back through a callback on flush or when they are evicted.
+ * Entries are evicted with the CLOCK algorithm: the hand skips and clears entries that were used since
+ * it last passed them.
+ */
+
+#ifndef __GP_NVM_CACHE_H__
+#define __GP_NVM_CACHE_H__
+
+#include "gp-nvm.h"
+#include "gp-nvm-index.h"
+
+/**
+ * @brief      Maximum length of a value that is cached.
+ *
+ */
+#ifndef GP_NVM_CONF_CACHE_VALUE_SIZE
+#define GP_NVM_CONF_CACHE_VALUE_SIZE 64
+#endif
+
+/**
+ * @brief      Callback that writes a value back to the storage engine.
+ *
+ */
+typedef gp_nvm_result_t (*gp_nvm_cache_writeback_fn_t)(void *arg, uint32_t attr_id, uint32_t length, const uint8_t* p_value);
+
+/**
+ * @brief      Cache entry.
+ *
+ */
+typedef struct gp_nvm_cache_entry {
+	uint32_t attr_id;
+	uint32_t len;
+	uint8_t used;
+	uint8_t dirty;
+	uint8_t referenced;
+	uint8_t value[GP_NVM_CONF_CACHE_VALUE_SIZE];
+} gp_nvm_cache_entry_t;
+
+/**
+ * @brief      Value cache.
+ *
+ * The offset field of the entries in the map holds the number of the cache entry of an attribute.
+ */
+typedef struct gp_nvm_cache {
+	gp_nvm_cache_entry_t *entries;
+	uint32_t num_entries;
+	uint32_t hand;
+	gp_nvm_index_t map;
+	gp_nvm_cache_writeback_fn_t writeback;
+	void *writeback_arg;
+	uint32_t dirty;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t absorbed;
+	uint64_t writebacks;
+	uint64_t evictions;
+} gp_nvm_cache_t;
+
+/**
+ * @brief      Create a cache of size bytes.
+ *
+ * @param[out] cache          The cache.
+ * @param[in]  size           The size of the arena in bytes, it holds at least one entry.
+ * @param[in]  writeback      The callback that writes dirty values back.
+ * @param[in]  writeback_arg  The first argument of the callback.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_cache_init(	gp_nvm_cache_t *cache,
+					uint32_t size,
+					gp_nvm_cache_writeback_fn_t writeback,
+					void *writeback_arg);
+
+/**
+ * @brief      Release the memory of the cache, dirty values are dropped.
+ *
+ * @param[in]  cache  The cache.
+ */
+void
+gp_nvm_cache_deinit(gp_nvm_cache_t *cache);
+
+/**
+ * @brief      Copy the value of an attribute from the cache.
+ *
+ * The length is always stored, the value only when it fits in size bytes.
+ *
+ * @param[in]  cache     The cache.
+ * @param[in]  attr_id   The attribute identifier.
+ * @param[in]  size      The size of the buffer at p_value.
+ * @param[out] p_length  Pointer were the length can be stored.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     1: The attribute was in the cache.
+ * @return     0: The attribute wasn't in the cache.
+ */
+int
+gp_nvm_cache_get(	gp_nvm_cache_t *cache,
+					uint32_t attr_id,
+					uint32_t size,
+					uint32_t* p_length,
+					uint8_t* p_value);
+
+/**
+ * @brief      Store the value of an attribute in the cache, an entry is evicted when the cache is full.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  dirty    1 if the value still has to be written back, 0 if it was read from the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the value is too large, the attribute is not cached)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the write back of the evicted entry failed)
+ */
+gp_nvm_result_t
+gp_nvm_cache_put(	gp_nvm_cache_t *cache,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value,
+					int dirty);
+
+/**
+ * @brief      Drop the cache entry of an attribute, also when it is dirty.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     1: The attribute was in the cache.
+ * @return     0: The attribute wasn't in the cache.
+ */
+int
+gp_nvm_cache_invalidate(	gp_nvm_cache_t *cache,
+							uint32_t attr_id);
+
+/**
+ * @brief      Check whether the cache entry of an attribute still has to be written back.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     1: The attribute is cached and dirty.
+ * @return     0: The attribute isn't cached or its cached value is on the NVM.
+ */
+int
+gp_nvm_cache_is_dirty(	const gp_nvm_cache_t *cache,
+						uint32_t attr_id);
+
+/**
+ * @brief      Write back the cache entry of an attribute if it is dirty, the entry stays cached.
+ *
+ * @param[in]  cache    The cache.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_cache_clean(	gp_nvm_cache_t *cache,
+					uint32_t attr_id);
+
+/**
+ * @brief      Write back all dirty entries.
+ *
+ * @param[in]  cache  The cache.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_cache_flush(gp_nvm_cache_t *cache);
+
+/**
+ * @brief      Copy the cache statistics.
+ *
+ * @param[in]  cache  The cache.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_cache_get_stats(	const gp_nvm_cache_t *cache,
+						gp_nvm_cache_stats_t *stats);
+
+#endif /* __GP_NVM_CACHE_H__ */
+
+/** @} */
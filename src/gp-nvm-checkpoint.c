@@ -0,0 +1,353 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-checkpoint.c
+ * \brief	Implementation of the index checkpoints of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-checkpoint.h"
+
+// Uses following header(s)
+#include "nvm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Offset of an anchor slot.
+ *
+ */
+static inline uint32_t
+_gp_nvm_checkpoint_slot_offset(uint32_t slot)
+{
+	return sizeof(gp_nvm_superblock_t) + slot * sizeof(gp_nvm_checkpoint_anchor_t);
+}
+
+/**
+ * @brief      Append a value to a checkpoint buffer.
+ *
+ * @param[in]  buf    The buffer.
+ * @param[in]  value  The value.
+ */
+void
+gp_nvm_checkpoint_put(	gp_nvm_checkpoint_buf_t *buf,
+						uint32_t value)
+{
+	if( buf->error ){
+		return;
+	}
+	if( buf->len + sizeof(value) > buf->size ){
+		uint32_t size = buf->size ? buf->size * 2 : 256;
+		uint8_t *data = size > buf->size ? realloc(buf->data, size) : NULL;
+		if( data == NULL ){
+			buf->error = 1;
+			return;
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, &value, sizeof(value));
+	buf->len += sizeof(value);
+}
+
+/**
+ * @brief      Take the next value from a checkpoint buffer.
+ *
+ * @param[in]  buf  The buffer.
+ *
+ * @return     The value, 0 when the buffer has no values left.
+ */
+uint32_t
+gp_nvm_checkpoint_get(gp_nvm_checkpoint_buf_t *buf)
+{
+	uint32_t value = 0;
+	if( buf->error || buf->len - buf->pos < sizeof(value) ){
+		buf->error = 1;
+		return 0;
+	}
+	memcpy(&value, buf->data + buf->pos, sizeof(value));
+	buf->pos += sizeof(value);
+	return value;
+}
+
+/**
+ * @brief      Release the memory of a checkpoint buffer.
+ *
+ * @param[in]  buf  The buffer.
+ */
+void
+gp_nvm_checkpoint_buf_deinit(gp_nvm_checkpoint_buf_t *buf)
+{
+	free(buf->data);
+	memset(buf, 0, sizeof(gp_nvm_checkpoint_buf_t));
+}
+
+/**
+ * @brief      Append the engine, the sequence number and the index of a store to a checkpoint buffer.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  buf    The buffer.
+ */
+void
+gp_nvm_checkpoint_put_index(	const gp_nvm_store_t *store,
+								gp_nvm_checkpoint_buf_t *buf)
+{
+	const gp_nvm_index_t *index = &store->index;
+	gp_nvm_checkpoint_put(buf, store->engine);
+	gp_nvm_checkpoint_put(buf, store->seq);
+	gp_nvm_checkpoint_put(buf, index->num_entries);
+	for( uint32_t i = 0; i<index->num_slots; i++ ){
+		if( index->ctrl[i] != 0 ){
+			const gp_nvm_index_entry_t *entry = &index->entries[i];
+			gp_nvm_checkpoint_put(buf, index->ids[i]);
+			gp_nvm_checkpoint_put(buf, entry->offset);
+			gp_nvm_checkpoint_put(buf, entry->len);
+			gp_nvm_checkpoint_put(buf, entry->capacity);
+			gp_nvm_checkpoint_put(buf, entry->seq);
+			gp_nvm_checkpoint_put(buf, entry->crc);
+			gp_nvm_checkpoint_put(buf, entry->codec);
+		}
+	}
+}
+
+/**
+ * @brief      Load the sequence number and the index of a store from a checkpoint buffer.
+ *
+ * @param[in]  store  The attribute store, with an empty index.
+ * @param[in]  buf    The buffer.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the checkpoint is of another engine, is truncated or the index could not grow)
+ */
+int
+gp_nvm_checkpoint_get_index(	gp_nvm_store_t *store,
+								gp_nvm_checkpoint_buf_t *buf)
+{
+	if( gp_nvm_checkpoint_get(buf) != store->engine ){
+		return 1;
+	}
+	store->seq = gp_nvm_checkpoint_get(buf);
+	uint32_t num_entries = gp_nvm_checkpoint_get(buf);
+	for( uint32_t i = 0; i<num_entries && !buf->error; i++ ){
+		int added;
+		uint32_t attr_id = gp_nvm_checkpoint_get(buf);
+		gp_nvm_index_entry_t* attr = gp_nvm_index_insert(&store->index, attr_id, &added);
+		if( attr == NULL || !added ){
+			return 1;
+		}
+		attr->offset = gp_nvm_checkpoint_get(buf);
+		attr->len = gp_nvm_checkpoint_get(buf);
+		attr->capacity = gp_nvm_checkpoint_get(buf);
+		attr->seq = gp_nvm_checkpoint_get(buf);
+		attr->crc = gp_nvm_checkpoint_get(buf);
+		attr->codec = gp_nvm_checkpoint_get(buf);
+	}
+	return buf->error;
+}
+
+/**
+ * @brief      Read the records of the checkpoint of an anchor, from the last record back to the first.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (a record is missing or corrupt)
+ */
+static int
+_gp_nvm_checkpoint_read_chunks(	gp_nvm_store_t *store,
+								const gp_nvm_checkpoint_anchor_t *anchor,
+								gp_nvm_checkpoint_buf_t *buf)
+{
+	uint32_t remaining = anchor->size;
+	uint32_t offset = anchor->offset;
+	uint32_t *chunks = NULL;
+	uint32_t num_chunks = 0;
+
+	memset(buf, 0, sizeof(gp_nvm_checkpoint_buf_t));
+	buf->data = malloc(anchor->size);
+	if( anchor->size == 0 || buf->data == NULL ){
+		gp_nvm_checkpoint_buf_deinit(buf);
+		return 1;
+	}
+	buf->len = anchor->size;
+	buf->size = anchor->size;
+
+	// every record holds at least one byte, so this ends even when the records form a loop
+	while( offset != 0 ){
+		gp_nvm_record_hdr_t hdr;
+		uint32_t *grown = realloc(chunks, (num_chunks + 1) * sizeof(uint32_t));
+		if( grown == NULL ||
+			gp_nvm_store_read_hdr(store, offset, &hdr) != 0 ||
+			hdr.type != GP_NVM_RECORD_CHECKPOINT ||
+			hdr.len == 0 || hdr.len > remaining || hdr.len > hdr.capacity ||
+			gp_nvm_store_read(store, offset + sizeof(hdr), hdr.len, buf->data + remaining - hdr.len) != 0 ||
+			gp_nvm_crc32c(0, buf->data + remaining - hdr.len, hdr.len) != hdr.crc ){
+			free(grown ? grown : chunks);
+			gp_nvm_checkpoint_buf_deinit(buf);
+			return 1;
+		}
+		chunks = grown;
+		chunks[num_chunks++] = offset;
+		remaining -= hdr.len;
+		offset = hdr.attr_id;
+	}
+	if( remaining != 0 ){
+		free(chunks);
+		gp_nvm_checkpoint_buf_deinit(buf);
+		return 1;
+	}
+	free(store->ckpt.chunks);
+	store->ckpt.chunks = chunks;
+	store->ckpt.num_chunks = num_chunks;
+	return 0;
+}
+
+/**
+ * @brief      Read the newest valid checkpoint of a store.
+ *
+ * On success the records of the checkpoint become the chunks of the store.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] buf    The buffer the checkpoint is read in.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no valid checkpoint)
+ */
+int
+gp_nvm_checkpoint_read(	gp_nvm_store_t *store,
+						gp_nvm_checkpoint_buf_t *buf)
+{
+	gp_nvm_checkpoint_t *ckpt = &store->ckpt;
+	gp_nvm_checkpoint_anchor_t anchors[2];
+	int valid[2];
+
+	memset(buf, 0, sizeof(gp_nvm_checkpoint_buf_t));
+	for( uint32_t slot = 0; slot<2; slot++ ){
+		gp_nvm_checkpoint_anchor_t *anchor = &anchors[slot];
+		valid[slot] = gp_nvm_store_read(store, _gp_nvm_checkpoint_slot_offset(slot), sizeof(*anchor), anchor) == 0 &&
+			anchor->magic == GP_NVM_CHECKPOINT_MAGIC &&
+			anchor->crc == gp_nvm_crc32c(0, anchor, offsetof(gp_nvm_checkpoint_anchor_t, crc));
+		if( valid[slot] ){
+			if( !ckpt->anchored || anchor->generation > ckpt->generation ){
+				ckpt->generation = anchor->generation;
+				ckpt->slot = slot;
+			}
+			ckpt->anchored = 1;
+		}
+	}
+
+	// fall back to the older checkpoint when the records of the newest one are gone
+	for( uint32_t i = 0; i<2; i++ ){
+		uint32_t slot = i == 0 ? ckpt->slot : 1 - ckpt->slot;
+		if( valid[slot] && _gp_nvm_checkpoint_read_chunks(store, &anchors[slot], buf) == 0 ){
+			ckpt->slot = slot;
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief      Write the anchor of a checkpoint whose records are written.
+ *
+ * The records become the chunks of the store, the previous chunks are released.
+ *
+ * @param[in]  store       The attribute store.
+ * @param[in]  size        The number of bytes of the checkpoint.
+ * @param[in]  chunks      The offsets of the records of the checkpoint, allocated with malloc.
+ * @param[in]  num_chunks  The number of records.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (chunks is released)
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint_commit(	gp_nvm_store_t *store,
+							uint32_t size,
+							uint32_t *chunks,
+							uint32_t num_chunks)
+{
+	gp_nvm_checkpoint_t *ckpt = &store->ckpt;
+	// the other slot keeps the previous anchor until this one is written
+	uint32_t slot = 1 - ckpt->slot;
+	gp_nvm_checkpoint_anchor_t anchor = {
+		.magic = GP_NVM_CHECKPOINT_MAGIC,
+		.generation = ckpt->generation + 1,
+		.offset = chunks[num_chunks - 1],
+		.size = size,
+	};
+	anchor.crc = gp_nvm_crc32c(0, &anchor, offsetof(gp_nvm_checkpoint_anchor_t, crc));
+	if( nvm_dev_update(store->dev, _gp_nvm_checkpoint_slot_offset(slot), sizeof(anchor), &anchor) != 0 ){
+		free(chunks);
+		return GP_NVM_MEM_ERROR;
+	}
+	free(ckpt->chunks);
+	ckpt->chunks = chunks;
+	ckpt->num_chunks = num_chunks;
+	ckpt->generation = anchor.generation;
+	ckpt->slot = slot;
+	ckpt->valid = 1;
+	ckpt->anchored = 1;
+	ckpt->writes = 0;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Forget the chunks of a checkpoint that could not be used.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_checkpoint_reset(gp_nvm_store_t *store)
+{
+	free(store->ckpt.chunks);
+	store->ckpt.chunks = NULL;
+	store->ckpt.num_chunks = 0;
+	store->ckpt.valid = 0;
+}
+
+/**
+ * @brief      Mark that the store is about to change.
+ *
+ * With the in-place engine the anchors are erased first. A preloaded image isn't used anymore.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint_touch(gp_nvm_store_t *store)
+{
+	gp_nvm_checkpoint_t *ckpt = &store->ckpt;
+	ckpt->valid = 0;
+	ckpt->writes++;
+	// records may be overwritten, moved or added, which the image read at open doesn't show
+	__atomic_store_n(&store->image.valid, 0, __ATOMIC_RELAXED);
+	// values overwritten in place can't be found after the checkpoint
+	if( store->engine == GP_NVM_ENGINE_IN_PLACE && ckpt->anchored ){
+		gp_nvm_checkpoint_anchor_t anchors[2];
+		memset(anchors, 0, sizeof(anchors));
+		if( nvm_dev_update(store->dev, _gp_nvm_checkpoint_slot_offset(0), sizeof(anchors), anchors) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		ckpt->anchored = 0;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Release the checkpoint state of a store.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_checkpoint_deinit(gp_nvm_store_t *store)
+{
+	free(store->ckpt.chunks);
+	memset(&store->ckpt, 0, sizeof(gp_nvm_checkpoint_t));
+}
+
+/** @} */
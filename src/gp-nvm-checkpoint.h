@@ -0,0 +1,159 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-checkpoint.h
+ * \brief	Header file for the index checkpoints of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A checkpoint is a copy of the attribute index and the state of the storage engine, so the index can be
+ * loaded at boot-time instead of rebuilt by scanning all records.
+ * The checkpoint is written as one or more records of type GP_NVM_RECORD_CHECKPOINT, the attribute ID field
+ * of a checkpoint record holds the offset of the previous record of the checkpoint (0 for the first one).
+ * Once all records are written, an anchor pointing at the last record is written to one of the two anchor
+ * slots after the superblock. The slots are used in turn, so a torn anchor write leaves the previous anchor.
+ * At boot-time the valid anchor with the highest generation is used.
+ *
+ * The log engine replays the records written after its checkpoint. The in-place engine overwrites records
+ * in place, which can't be replayed, so its anchors are erased before the first change after a checkpoint.
+ * Without a valid checkpoint the engines fall back to scanning all records.
+ */
+
+#ifndef __GP_NVM_CHECKPOINT_H__
+#define __GP_NVM_CHECKPOINT_H__
+
+#include "gp-nvm-store.h"
+
+/**
+ * @brief      Buffer a checkpoint is serialized in.
+ *
+ * Values are put at the end of the buffer and taken from pos, error is set when the buffer
+ * could not grow or a value was taken beyond the end.
+ */
+typedef struct gp_nvm_checkpoint_buf {
+	uint8_t *data;
+	uint32_t len;
+	uint32_t size;
+	uint32_t pos;
+	int error;
+} gp_nvm_checkpoint_buf_t;
+
+/**
+ * @brief      Append a value to a checkpoint buffer.
+ *
+ * @param[in]  buf    The buffer.
+ * @param[in]  value  The value.
+ */
+void
+gp_nvm_checkpoint_put(	gp_nvm_checkpoint_buf_t *buf,
+						uint32_t value);
+
+/**
+ * @brief      Take the next value from a checkpoint buffer.
+ *
+ * @param[in]  buf  The buffer.
+ *
+ * @return     The value, 0 when the buffer has no values left.
+ */
+uint32_t
+gp_nvm_checkpoint_get(gp_nvm_checkpoint_buf_t *buf);
+
+/**
+ * @brief      Release the memory of a checkpoint buffer.
+ *
+ * @param[in]  buf  The buffer.
+ */
+void
+gp_nvm_checkpoint_buf_deinit(gp_nvm_checkpoint_buf_t *buf);
+
+/**
+ * @brief      Append the engine, the sequence number and the index of a store to a checkpoint buffer.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  buf    The buffer.
+ */
+void
+gp_nvm_checkpoint_put_index(	const gp_nvm_store_t *store,
+								gp_nvm_checkpoint_buf_t *buf);
+
+/**
+ * @brief      Load the sequence number and the index of a store from a checkpoint buffer.
+ *
+ * @param[in]  store  The attribute store, with an empty index.
+ * @param[in]  buf    The buffer.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the checkpoint is of another engine, is truncated or the index could not grow)
+ */
+int
+gp_nvm_checkpoint_get_index(	gp_nvm_store_t *store,
+								gp_nvm_checkpoint_buf_t *buf);
+
+/**
+ * @brief      Read the newest valid checkpoint of a store.
+ *
+ * On success the records of the checkpoint become the chunks of the store.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] buf    The buffer the checkpoint is read in.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no valid checkpoint)
+ */
+int
+gp_nvm_checkpoint_read(	gp_nvm_store_t *store,
+						gp_nvm_checkpoint_buf_t *buf);
+
+/**
+ * @brief      Write the anchor of a checkpoint whose records are written.
+ *
+ * The records become the chunks of the store, the previous chunks are released.
+ *
+ * @param[in]  store       The attribute store.
+ * @param[in]  size        The number of bytes of the checkpoint.
+ * @param[in]  chunks      The offsets of the records of the checkpoint, allocated with malloc.
+ * @param[in]  num_chunks  The number of records.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (chunks is released)
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint_commit(	gp_nvm_store_t *store,
+							uint32_t size,
+							uint32_t *chunks,
+							uint32_t num_chunks);
+
+/**
+ * @brief      Forget the chunks of a checkpoint that could not be used.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_checkpoint_reset(gp_nvm_store_t *store);
+
+/**
+ * @brief      Mark that the store is about to change.
+ *
+ * With the in-place engine the anchors are erased first. A preloaded image isn't used anymore.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint_touch(gp_nvm_store_t *store);
+
+/**
+ * @brief      Release the checkpoint state of a store.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_checkpoint_deinit(gp_nvm_store_t *store);
+
+#endif /* __GP_NVM_CHECKPOINT_H__ */
+
+/** @} */
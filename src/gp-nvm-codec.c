@@ -0,0 +1,330 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-codec.c
+ * \brief	Implementation of the value compression of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-codec.h"
+
+// Uses following header(s)
+#include <string.h>
+
+/**
+ * @brief      Number of bits of the hash of the match finder.
+ *
+ */
+#define GP_NVM_CODEC_HASH_BITS 10
+
+/**
+ * @brief      Longest distance of a match.
+ *
+ */
+#define GP_NVM_CODEC_MAX_DISTANCE 0xffff
+
+/**
+ * @brief      Read 4 bytes for the match finder.
+ *
+ */
+static inline uint32_t
+_gp_nvm_codec_read32(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/**
+ * @brief      Hash 4 bytes to a slot of the match finder.
+ *
+ */
+static inline uint32_t
+_gp_nvm_codec_hash(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - GP_NVM_CODEC_HASH_BITS);
+}
+
+/**
+ * @brief      Number of extra bytes a length of a token needs.
+ *
+ */
+static inline uint32_t
+_gp_nvm_codec_ext_len(uint32_t n)
+{
+	return n < 15 ? 0 : (n - 15) / 255 + 1;
+}
+
+/**
+ * @brief      Write the extra bytes of a length of a token.
+ *
+ */
+static uint32_t
+_gp_nvm_codec_put_ext(uint8_t *dst, uint32_t out, uint32_t n)
+{
+	if( n < 15 ){
+		return out;
+	}
+	for( n -= 15; n >= 255; n -= 255 ){
+		dst[out++] = 255;
+	}
+	dst[out++] = n;
+	return out;
+}
+
+/**
+ * @brief      Read the extra bytes of a length of a token, when its nibble is 15.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the length runs beyond the end)
+ */
+static int
+_gp_nvm_codec_get_ext(const uint8_t *src, uint32_t len, uint32_t *in, uint32_t *n)
+{
+	if( *n < 15 ){
+		return 0;
+	}
+	uint8_t b;
+	do {
+		if( *in >= len ){
+			return 1;
+		}
+		b = src[(*in)++];
+		*n += b;
+	} while( b == 255 );
+	return 0;
+}
+
+/**
+ * @brief      Write a sequence of literals, followed by a match when its length isn't 0.
+ *
+ * @return     The position after the sequence, 0 when it doesn't fit in size bytes.
+ */
+static uint32_t
+_gp_nvm_codec_put_sequence(	uint8_t *dst,
+							uint32_t out,
+							uint32_t size,
+							const uint8_t *literals,
+							uint32_t num_literals,
+							uint32_t distance,
+							uint32_t match)
+{
+	uint32_t match_code = match > 0 ? match - GP_NVM_CODEC_MIN_MATCH : 0;
+	uint64_t need = 1 + (uint64_t) _gp_nvm_codec_ext_len(num_literals) + num_literals;
+	if( match > 0 ){
+		need += 2 + _gp_nvm_codec_ext_len(match_code);
+	}
+	if( out + need > size ){
+		return 0;
+	}
+
+	dst[out++] = (num_literals < 15 ? num_literals : 15) << 4 | (match_code < 15 ? match_code : 15);
+	out = _gp_nvm_codec_put_ext(dst, out, num_literals);
+	memcpy(dst + out, literals, num_literals);
+	out += num_literals;
+	if( match > 0 ){
+		dst[out++] = distance & 0xff;
+		dst[out++] = distance >> 8;
+		out = _gp_nvm_codec_put_ext(dst, out, match_code);
+	}
+	return out;
+}
+
+/**
+ * @brief      Compress a value with the LZ codec.
+ *
+ * Matches are found with a hash table of the last position of every 4-byte prefix.
+ *
+ * @param[in]  src   The value.
+ * @param[in]  len   The length of the value.
+ * @param[out] dst   Buffer were the compressed value can be stored.
+ * @param[in]  size  The size of the buffer.
+ *
+ * @return     The length of the compressed value, 0 when it doesn't fit in size bytes.
+ */
+uint32_t
+gp_nvm_codec_compress(	const uint8_t *src,
+						uint32_t len,
+						uint8_t *dst,
+						uint32_t size)
+{
+	// positions are kept plus one, so 0 is an empty slot
+	uint32_t table[1 << GP_NVM_CODEC_HASH_BITS];
+	uint32_t out = 0;
+	uint32_t anchor = 0;
+	uint32_t pos = 0;
+
+	uint32_t v = len;
+	do {
+		if( out >= size ){
+			return 0;
+		}
+		dst[out++] = (v & 0x7f) | (v >= 0x80 ? 0x80 : 0);
+		v >>= 7;
+	} while( v > 0 );
+
+	memset(table, 0, sizeof(table));
+	while( len >= GP_NVM_CODEC_MIN_MATCH && pos <= len - GP_NVM_CODEC_MIN_MATCH ){
+		uint32_t prefix = _gp_nvm_codec_read32(src + pos);
+		uint32_t *slot = &table[_gp_nvm_codec_hash(prefix)];
+		uint32_t candidate = *slot;
+		*slot = pos + 1;
+		if( candidate == 0 || pos - (candidate - 1) > GP_NVM_CODEC_MAX_DISTANCE ||
+			_gp_nvm_codec_read32(src + candidate - 1) != prefix ){
+			pos++;
+			continue;
+		}
+		candidate--;
+
+		// the match may overlap the bytes it produces
+		uint32_t match = GP_NVM_CODEC_MIN_MATCH;
+		while( pos + match < len && src[candidate + match] == src[pos + match] ){
+			match++;
+		}
+		out = _gp_nvm_codec_put_sequence(dst, out, size, src + anchor, pos - anchor, pos - candidate, match);
+		if( out == 0 ){
+			return 0;
+		}
+		pos += match;
+		anchor = pos;
+	}
+
+	if( anchor < len ){
+		out = _gp_nvm_codec_put_sequence(dst, out, size, src + anchor, len - anchor, 0, 0);
+	}
+	return out;
+}
+
+/**
+ * @brief      Read the length of the value at the start of a compressed value.
+ *
+ * @return     The number of bytes of the length, 0 when it is corrupt.
+ */
+static uint32_t
+_gp_nvm_codec_get_len(const uint8_t *src, uint32_t len, uint32_t *p_length)
+{
+	uint32_t value = 0;
+	for( uint32_t in = 0; in<len && in<GP_NVM_CODEC_MAX_HEADER; in++ ){
+		value |= (uint32_t) (src[in] & 0x7f) << (7 * in);
+		if( (src[in] & 0x80) == 0 ){
+			*p_length = value;
+			return in + 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Get the length of a compressed value once it is decompressed.
+ *
+ * Only the start of the compressed value is needed, at most GP_NVM_CODEC_MAX_HEADER bytes.
+ *
+ * @param[in]  codec     The codec of the value.
+ * @param[in]  src       The start of the compressed value.
+ * @param[in]  len       The number of bytes at src.
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (unknown codec or corrupt value)
+ */
+int
+gp_nvm_codec_length(	uint32_t codec,
+						const uint8_t *src,
+						uint32_t len,
+						uint32_t *p_length)
+{
+	if( codec == GP_NVM_CODEC_NONE ){
+		*p_length = len;
+		return 0;
+	}
+	return codec != GP_NVM_CODEC_LZ || _gp_nvm_codec_get_len(src, len, p_length) == 0;
+}
+
+/**
+ * @brief      Decompress a value.
+ *
+ * Every length and distance is checked, so a corrupt value never reads or writes beyond the buffers.
+ *
+ * @param[in]  codec     The codec of the value.
+ * @param[in]  src       The compressed value.
+ * @param[in]  len       The length of the compressed value.
+ * @param[out] dst       Buffer were the value can be stored.
+ * @param[in]  size      The size of the buffer.
+ * @param[out] p_length  Pointer were the length of the value can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (unknown codec, corrupt value or the value doesn't fit in size bytes)
+ */
+int
+gp_nvm_codec_decompress(	uint32_t codec,
+							const uint8_t *src,
+							uint32_t len,
+							uint8_t *dst,
+							uint32_t size,
+							uint32_t *p_length)
+{
+	uint32_t in = 0;
+	uint32_t out = 0;
+	uint32_t raw_len = 0;
+
+	if( codec == GP_NVM_CODEC_NONE ){
+		if( len > size ){
+			return 1;
+		}
+		memcpy(dst, src, len);
+		*p_length = len;
+		return 0;
+	}
+	if( codec != GP_NVM_CODEC_LZ ){
+		return 1;
+	}
+
+	in = _gp_nvm_codec_get_len(src, len, &raw_len);
+	if( in == 0 || raw_len > size ){
+		return 1;
+	}
+
+	while( in < len ){
+		uint8_t token = src[in++];
+		uint32_t num_literals = token >> 4;
+		if( _gp_nvm_codec_get_ext(src, len, &in, &num_literals) != 0 ||
+			num_literals > len - in || num_literals > raw_len - out ){
+			return 1;
+		}
+		memcpy(dst + out, src + in, num_literals);
+		in += num_literals;
+		out += num_literals;
+		if( in == len ){
+			break;
+		}
+
+		if( len - in < 2 ){
+			return 1;
+		}
+		uint32_t distance = src[in] | (uint32_t) src[in + 1] << 8;
+		uint32_t match = token & 0x0f;
+		in += 2;
+		if( _gp_nvm_codec_get_ext(src, len, &in, &match) != 0 ){
+			return 1;
+		}
+		match += GP_NVM_CODEC_MIN_MATCH;
+		if( distance == 0 || distance > out || match > raw_len - out ){
+			return 1;
+		}
+		// byte by byte, the match may overlap the bytes it produces
+		for( uint32_t i = 0; i<match; i++, out++ ){
+			dst[out] = dst[out - distance];
+		}
+	}
+	if( out != raw_len ){
+		return 1;
+	}
+	*p_length = raw_len;
+	return 0;
+}
+
+/** @} */
@@ -0,0 +1,105 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-codec.h
+ * \brief	Header file for the value compression of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * Values can be stored compressed with a byte-oriented LZ codec. A compressed value starts with its
+ * uncompressed length as a base-128 varint, followed by sequences of a token, literals and a match.
+ * The upper four bits of the token are the number of literals, the lower four bits the match length
+ * minus GP_NVM_CODEC_MIN_MATCH. A nibble of 15 is followed by bytes that are added to it, up to and
+ * including the first byte that isn't 255. The literals are followed by the 16-bit little-endian
+ * distance of the match, the last sequence ends after its literals. A match can overlap the bytes it
+ * produces, so a run of one byte is a literal followed by one match with distance 1.
+ */
+
+#ifndef __GP_NVM_CODEC_H__
+#define __GP_NVM_CODEC_H__
+
+#include <stdint.h>
+
+/**
+ * @brief      Enumeration of value codecs, the codec is kept in 4 bits.
+ *
+ */
+enum GP_NVM_CODEC
+{
+	GP_NVM_CODEC_NONE,
+	GP_NVM_CODEC_LZ,
+};
+
+/**
+ * @brief      Shortest match the LZ codec encodes.
+ *
+ */
+#define GP_NVM_CODEC_MIN_MATCH 4
+
+/**
+ * @brief      Maximum number of bytes before the first sequence of a compressed value.
+ *
+ */
+#define GP_NVM_CODEC_MAX_HEADER 5
+
+/**
+ * @brief      Compress a value with the LZ codec.
+ *
+ * @param[in]  src   The value.
+ * @param[in]  len   The length of the value.
+ * @param[out] dst   Buffer were the compressed value can be stored.
+ * @param[in]  size  The size of the buffer.
+ *
+ * @return     The length of the compressed value, 0 when it doesn't fit in size bytes.
+ */
+uint32_t
+gp_nvm_codec_compress(	const uint8_t *src,
+						uint32_t len,
+						uint8_t *dst,
+						uint32_t size);
+
+/**
+ * @brief      Get the length of a compressed value once it is decompressed.
+ *
+ * Only the start of the compressed value is needed, at most GP_NVM_CODEC_MAX_HEADER bytes.
+ *
+ * @param[in]  codec     The codec of the value.
+ * @param[in]  src       The start of the compressed value.
+ * @param[in]  len       The number of bytes at src.
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (unknown codec or corrupt value)
+ */
+int
+gp_nvm_codec_length(	uint32_t codec,
+						const uint8_t *src,
+						uint32_t len,
+						uint32_t *p_length);
+
+/**
+ * @brief      Decompress a value.
+ *
+ * @param[in]  codec     The codec of the value.
+ * @param[in]  src       The compressed value.
+ * @param[in]  len       The length of the compressed value.
+ * @param[out] dst       Buffer were the value can be stored.
+ * @param[in]  size      The size of the buffer.
+ * @param[out] p_length  Pointer were the length of the value can be stored.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (unknown codec, corrupt value or the value doesn't fit in size bytes)
+ */
+int
+gp_nvm_codec_decompress(	uint32_t codec,
+							const uint8_t *src,
+							uint32_t len,
+							uint8_t *dst,
+							uint32_t size,
+							uint32_t *p_length);
+
+#endif /* __GP_NVM_CODEC_H__ */
+
+/** @} */
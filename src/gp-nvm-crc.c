@@ -0,0 +1,259 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-crc.c
+ * \brief	Implementation of the CRC32C (Castagnoli) checksum of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-crc.h"
+
+// Uses following header(s)
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define GP_NVM_CRC_HAVE_SSE42 1
+#endif
+
+/**
+ * @brief      CRC32C polynomial (reversed).
+ *
+ */
+#define GP_NVM_CRC_POLY 0x82f63b78
+
+/**
+ * @brief      Slice-by-8 tables, table[0] is the classic byte-wise table.
+ *
+ */
+static uint32_t gp_nvm_crc_table[8][256];
+
+/**
+ * @brief      Implementation used by gp_nvm_crc32c, selected once at the first call.
+ *
+ */
+static uint32_t (*gp_nvm_crc_impl)(uint32_t crc, const uint8_t *p, size_t len);
+
+/**
+ * @brief      Makes sure the implementation is selected and the tables are filled only once.
+ *
+ */
+static pthread_once_t gp_nvm_crc_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief      Compute the slice-by-8 tables.
+ *
+ */
+static void
+_gp_nvm_crc_init_tables(void)
+{
+	for( uint32_t n = 0; n<256; n++ ){
+		uint32_t crc = n;
+		for( int k = 0; k<8; k++ ){
+			crc = (crc >> 1) ^ (GP_NVM_CRC_POLY & (0 - (crc & 1)));
+		}
+		gp_nvm_crc_table[0][n] = crc;
+	}
+	for( uint32_t n = 0; n<256; n++ ){
+		uint32_t crc = gp_nvm_crc_table[0][n];
+		for( int k = 1; k<8; k++ ){
+			crc = gp_nvm_crc_table[0][crc & 0xff] ^ (crc >> 8);
+			gp_nvm_crc_table[k][n] = crc;
+		}
+	}
+}
+
+/**
+ * @brief      Table implementation, processes 8 bytes per step.
+ *
+ */
+static uint32_t
+_gp_nvm_crc_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while( len >= 8 ){
+		uint32_t lo, hi;
+		memcpy(&lo, p, sizeof(lo));
+		memcpy(&hi, p + 4, sizeof(hi));
+		// the tables assume little-endian loads
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		lo = __builtin_bswap32(lo);
+		hi = __builtin_bswap32(hi);
+#endif
+		lo ^= crc;
+		crc = gp_nvm_crc_table[7][lo & 0xff] ^
+				gp_nvm_crc_table[6][(lo >> 8) & 0xff] ^
+				gp_nvm_crc_table[5][(lo >> 16) & 0xff] ^
+				gp_nvm_crc_table[4][lo >> 24] ^
+				gp_nvm_crc_table[3][hi & 0xff] ^
+				gp_nvm_crc_table[2][(hi >> 8) & 0xff] ^
+				gp_nvm_crc_table[1][(hi >> 16) & 0xff] ^
+				gp_nvm_crc_table[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+	while( len-- > 0 ){
+		crc = gp_nvm_crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+#ifdef GP_NVM_CRC_HAVE_SSE42
+/**
+ * @brief      SSE4.2 implementation, only called when the CPU supports it.
+ *
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+_gp_nvm_crc_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	while( len >= 8 ){
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		crc64 = _mm_crc32_u64(crc64, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = (uint32_t) crc64;
+#endif
+	while( len >= 4 ){
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		crc = _mm_crc32_u32(crc, v);
+		p += 4;
+		len -= 4;
+	}
+	while( len-- > 0 ){
+		crc = _mm_crc32_u8(crc, *p++);
+	}
+	return crc;
+}
+#endif
+
+/**
+ * @brief      Select the implementation, the tables are filled before it can be used.
+ *
+ * Runs through pthread_once, so readers on several threads that compute their first CRC at the same time
+ * all see the implementation and the tables it uses.
+ */
+static void
+_gp_nvm_crc_select(void)
+{
+#ifdef GP_NVM_CRC_HAVE_SSE42
+	if( __builtin_cpu_supports("sse4.2") ){
+		gp_nvm_crc_impl = _gp_nvm_crc_hw;
+		return;
+	}
+#endif
+	_gp_nvm_crc_init_tables();
+	gp_nvm_crc_impl = _gp_nvm_crc_sw;
+}
+
+/**
+ * @brief      Update a CRC32C with len bytes.
+ *
+ * The CRC of data that is split in parts is computed by passing the result of one part to the next.
+ *
+ * @param[in]  crc   The CRC so far, 0 for the first part.
+ * @param[in]  data  The data.
+ * @param[in]  len   The number of bytes.
+ *
+ * @return     The updated CRC.
+ */
+uint32_t
+gp_nvm_crc32c(	uint32_t crc,
+				const void *data,
+				size_t len)
+{
+	pthread_once(&gp_nvm_crc_once, _gp_nvm_crc_select);
+	return ~gp_nvm_crc_impl(~crc, data, len);
+}
+
+/**
+ * @brief      Multiply two polynomials modulo the CRC32C polynomial, both in the reversed bit order.
+ *
+ */
+static uint32_t
+_gp_nvm_crc_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = (uint32_t) 1 << 31;
+	uint32_t p = 0;
+	for( ;; ){
+		if( a & m ){
+			p ^= b;
+			if( (a & (m - 1)) == 0 ){
+				break;
+			}
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ GP_NVM_CRC_POLY : b >> 1;
+	}
+	return p;
+}
+
+/**
+ * @brief      Feed len zero bytes to a CRC register that started at 0, in O(log(len)) steps.
+ *
+ * This multiplies the register with x^(8*len), built from the powers x^(2^k) that are squared on the fly.
+ */
+static uint32_t
+_gp_nvm_crc_zeros(uint32_t crc, size_t len)
+{
+	// x^8, the power of one zero byte
+	uint32_t power = (uint32_t) 1 << 23;
+	while( len > 0 ){
+		if( len & 1 ){
+			crc = _gp_nvm_crc_multmodp(power, crc);
+		}
+		power = _gp_nvm_crc_multmodp(power, power);
+		len >>= 1;
+	}
+	return crc;
+}
+
+/**
+ * @brief      Update the CRC32C of data of which a range changed, without the bytes outside the range.
+ *
+ * The CRC is linear: the CRC of the changed data is the old CRC xor the CRC, without the initial and final
+ * inversion, of the difference between the old and the new bytes followed by the tail bytes as zeros.
+ *
+ * @param[in]  crc       The CRC32C of the data before the change.
+ * @param[in]  old_data  The bytes of the range before the change.
+ * @param[in]  new_data  The bytes of the range after the change.
+ * @param[in]  len       The length of the range.
+ * @param[in]  tail      The number of bytes of the data after the range.
+ *
+ * @return     The CRC32C of the data after the change.
+ */
+uint32_t
+gp_nvm_crc32c_patch(	uint32_t crc,
+						const void *old_data,
+						const void *new_data,
+						size_t len,
+						size_t tail)
+{
+	const uint8_t *p_old = old_data;
+	const uint8_t *p_new = new_data;
+	uint8_t delta[64];
+	uint32_t diff = 0;
+
+	pthread_once(&gp_nvm_crc_once, _gp_nvm_crc_select);
+	while( len > 0 ){
+		size_t n = len < sizeof(delta) ? len : sizeof(delta);
+		for( size_t i = 0; i<n; i++ ){
+			delta[i] = p_old[i] ^ p_new[i];
+		}
+		diff = gp_nvm_crc_impl(diff, delta, n);
+		p_old += n;
+		p_new += n;
+		len -= n;
+	}
+	return crc ^ _gp_nvm_crc_zeros(diff, tail);
+}
+
+/** @} */
@@ -0,0 +1,60 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-crc.h
+ * \brief	Header file for the CRC32C (Castagnoli) checksum of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The CRC is computed with the SSE4.2 crc32 instruction when the CPU supports it,
+ * this is detected at runtime. Otherwise a slice-by-8 table implementation is used.
+ * Both give the same result.
+ */
+
+#ifndef __GP_NVM_CRC_H__
+#define __GP_NVM_CRC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief      Update a CRC32C with len bytes.
+ *
+ * The CRC of data that is split in parts is computed by passing the result of one part to the next.
+ *
+ * @param[in]  crc   The CRC so far, 0 for the first part.
+ * @param[in]  data  The data.
+ * @param[in]  len   The number of bytes.
+ *
+ * @return     The updated CRC.
+ */
+uint32_t
+gp_nvm_crc32c(	uint32_t crc,
+				const void *data,
+				size_t len);
+
+/**
+ * @brief      Update the CRC32C of data of which a range changed, without reading the bytes outside the range.
+ *
+ * The bytes before the range don't matter, only the number of bytes after it.
+ *
+ * @param[in]  crc       The CRC32C of the data before the change.
+ * @param[in]  old_data  The bytes of the range before the change.
+ * @param[in]  new_data  The bytes of the range after the change.
+ * @param[in]  len       The length of the range.
+ * @param[in]  tail      The number of bytes of the data after the range.
+ *
+ * @return     The CRC32C of the data after the change.
+ */
+uint32_t
+gp_nvm_crc32c_patch(	uint32_t crc,
+						const void *old_data,
+						const void *new_data,
+						size_t len,
+						size_t tail);
+
+#endif /* __GP_NVM_CRC_H__ */
+
+/** @} */
@@ -0,0 +1,434 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-export.c
+ * \brief	Implementation of the export and import of all attributes of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-export.h"
+
+// Uses following header(s)
+#include "nvm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Attribute of a store that is exported.
+ *
+ */
+typedef struct gp_nvm_export_record {
+	uint32_t attr_id;
+	gp_nvm_index_entry_t entry;
+} gp_nvm_export_record_t;
+
+/**
+ * @brief      Store a 32-bit number little-endian.
+ *
+ */
+static inline void
+_gp_nvm_export_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/**
+ * @brief      Load a 32-bit little-endian number.
+ *
+ */
+static inline uint32_t
+_gp_nvm_export_get32(const uint8_t *p)
+{
+	return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/**
+ * @brief      Compare two exported attributes on the offset of their record (for qsort).
+ *
+ */
+static int
+_gp_nvm_export_cmp_offset(const void *a, const void *b)
+{
+	const gp_nvm_export_record_t *ra = a;
+	const gp_nvm_export_record_t *rb = b;
+	return (ra->entry.offset > rb->entry.offset) - (ra->entry.offset < rb->entry.offset);
+}
+
+/**
+ * @brief      Write bytes of an export and add them to its CRC.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+static gp_nvm_result_t
+_gp_nvm_export_write(gp_nvm_export_t *exp, const uint8_t *data, uint32_t len)
+{
+	if( len > 0 && exp->write(data, len, exp->arg) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	exp->crc = gp_nvm_crc32c(exp->crc, data, len);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Get the bytes of a value on the NVM from the chunk, the next chunk is read when they aren't in it.
+ *
+ * A chunk starts at the value and ends at the end of the last value of the store, so values are only read
+ * once when they are fetched in the order of their offset.
+ *
+ * @param[in]  exp      The export.
+ * @param[in]  store    The store.
+ * @param[in]  offset   The offset of the value on the NVM.
+ * @param[in]  len      The length of the value.
+ * @param[in]  end      The end of the last value of the store.
+ * @param[out] p_value  Pointer were a pointer to the value in the chunk can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_export_fetch(	gp_nvm_export_t *exp,
+						const gp_nvm_store_t *store,
+						uint32_t offset,
+						uint32_t len,
+						uint32_t end,
+						const uint8_t **p_value)
+{
+	if( offset < exp->chunk_offset || offset - exp->chunk_offset + (uint64_t) len > exp->chunk_len ){
+		uint32_t size = end - offset;
+		if( size > GP_NVM_CONF_EXPORT_CHUNK_SIZE ){
+			size = len > GP_NVM_CONF_EXPORT_CHUNK_SIZE ? len : GP_NVM_CONF_EXPORT_CHUNK_SIZE;
+		}
+		if( size > exp->chunk_size ){
+			uint8_t *chunk = realloc(exp->chunk, size);
+			if( chunk == NULL ){
+				return GP_NVM_MEM_FULL;
+			}
+			exp->chunk = chunk;
+			exp->chunk_size = size;
+		}
+		if( nvm_dev_read(store->dev, offset, size, exp->chunk) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		exp->chunk_offset = offset;
+		exp->chunk_len = size;
+	}
+	*p_value = exp->chunk + (offset - exp->chunk_offset);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Start an export.
+ *
+ * @param[out] exp    The export.
+ * @param[in]  write  The callback that writes the bytes of the export.
+ * @param[in]  arg    The last argument of the callback.
+ */
+void
+gp_nvm_export_init(	gp_nvm_export_t *exp,
+					gp_nvm_export_cb_t write,
+					void *arg)
+{
+	memset(exp, 0, sizeof(gp_nvm_export_t));
+	exp->write = write;
+	exp->arg = arg;
+}
+
+/**
+ * @brief      Release the memory of an export.
+ *
+ * @param[in]  exp  The export.
+ */
+void
+gp_nvm_export_deinit(gp_nvm_export_t *exp)
+{
+	free(exp->chunk);
+	exp->chunk = NULL;
+	exp->chunk_size = 0;
+	exp->chunk_len = 0;
+}
+
+/**
+ * @brief      Write the header of an export.
+ *
+ * @param[in]  exp        The export.
+ * @param[in]  num_attrs  The number of attributes that will be exported.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_header(	gp_nvm_export_t *exp,
+						uint32_t num_attrs)
+{
+	uint8_t head[GP_NVM_EXPORT_HEADER_SIZE];
+	_gp_nvm_export_put32(head, GP_NVM_EXPORT_MAGIC);
+	_gp_nvm_export_put32(head + 4, GP_NVM_EXPORT_VERSION);
+	_gp_nvm_export_put32(head + 8, num_attrs);
+	return _gp_nvm_export_write(exp, head, sizeof(head));
+}
+
+/**
+ * @brief      Export one attribute.
+ *
+ * @param[in]  exp      The export.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  codec    The codec of the value.
+ * @param[in]  len      The length of the value as it is stored.
+ * @param[in]  value    The value as it is stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_value(	gp_nvm_export_t *exp,
+						uint32_t attr_id,
+						uint32_t codec,
+						uint32_t len,
+						const uint8_t *value)
+{
+	uint8_t head[GP_NVM_EXPORT_ENTRY_SIZE];
+	_gp_nvm_export_put32(head, attr_id);
+	_gp_nvm_export_put32(head + 4, len);
+	head[8] = codec;
+	gp_nvm_result_t result = _gp_nvm_export_write(exp, head, sizeof(head));
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_export_write(exp, value, len);
+	}
+	exp->bytes += len;
+	return result;
+}
+
+/**
+ * @brief      Export all attributes of a store in the order of their records on the NVM.
+ *
+ * The caller holds the writer mutex of the store. The CRC of every value is checked.
+ *
+ * @param[in]  exp    The export.
+ * @param[in]  store  The store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the NVM couldn't be read or the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_export_store(	gp_nvm_export_t *exp,
+						const gp_nvm_store_t *store)
+{
+	const gp_nvm_index_t *index = &store->index;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint32_t n = 0;
+	uint32_t end = 0;
+
+	if( index->num_entries == 0 ){
+		return GP_NVM_SUCCESS;
+	}
+	gp_nvm_export_record_t *records = malloc(index->num_entries * sizeof(gp_nvm_export_record_t));
+	if( records == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	for( uint32_t i = 0; i<index->num_slots && n<index->num_entries; i++ ){
+		if( index->ctrl[i] != 0 ){
+			records[n].attr_id = index->ids[i];
+			records[n].entry = index->entries[i];
+			uint32_t value_end = records[n].entry.offset + sizeof(gp_nvm_record_hdr_t) + records[n].entry.len;
+			if( value_end > end ){
+				end = value_end;
+			}
+			n++;
+		}
+	}
+	qsort(records, n, sizeof(gp_nvm_export_record_t), _gp_nvm_export_cmp_offset);
+
+	// the chunk may hold the bytes of the previous store
+	exp->chunk_len = 0;
+	for( uint32_t i = 0; i<n && result == GP_NVM_SUCCESS; i++ ){
+		const gp_nvm_index_entry_t *entry = &records[i].entry;
+		const uint8_t *value = NULL;
+
+		if( entry->len > 0 ){
+			result = _gp_nvm_export_fetch(exp, store, entry->offset + sizeof(gp_nvm_record_hdr_t), entry->len, end, &value);
+			if( result != GP_NVM_SUCCESS ){
+				break;
+			}
+		}
+		if( gp_nvm_crc32c(0, value, entry->len) != entry->crc ){
+			fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", records[i].attr_id);
+			result = GP_NVM_CRC_ERROR;
+			break;
+		}
+		result = gp_nvm_export_value(exp, records[i].attr_id, entry->codec, entry->len, value);
+	}
+	free(records);
+	return result;
+}
+
+/**
+ * @brief      Write the CRC at the end of an export.
+ *
+ * @param[in]  exp  The export.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_trailer(gp_nvm_export_t *exp)
+{
+	uint8_t tail[4];
+	_gp_nvm_export_put32(tail, exp->crc);
+	return _gp_nvm_export_write(exp, tail, sizeof(tail));
+}
+
+/**
+ * @brief      Read bytes of an import and add them to its CRC.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+static gp_nvm_result_t
+_gp_nvm_import_read(gp_nvm_import_t *imp, uint8_t *data, uint32_t len)
+{
+	if( len > 0 && imp->read(data, len, imp->arg) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	imp->crc = gp_nvm_crc32c(imp->crc, data, len);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Start an import and read the header.
+ *
+ * @param[out] imp   The import.
+ * @param[in]  read  The callback that reads the bytes of the import.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (not an export or an unknown version)
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_import_init(	gp_nvm_import_t *imp,
+					gp_nvm_import_cb_t read,
+					void *arg)
+{
+	uint8_t head[GP_NVM_EXPORT_HEADER_SIZE];
+
+	memset(imp, 0, sizeof(gp_nvm_import_t));
+	imp->read = read;
+	imp->arg = arg;
+	gp_nvm_result_t result = _gp_nvm_import_read(imp, head, sizeof(head));
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	if( _gp_nvm_export_get32(head) != GP_NVM_EXPORT_MAGIC || _gp_nvm_export_get32(head + 4) != GP_NVM_EXPORT_VERSION ){
+		fprintf(stderr, "GP-NVM: unknown export format\n");
+		return GP_NVM_FAIL;
+	}
+	imp->remaining = _gp_nvm_export_get32(head + 8);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Release the memory of an import.
+ *
+ * @param[in]  imp  The import.
+ */
+void
+gp_nvm_import_deinit(gp_nvm_import_t *imp)
+{
+	free(imp->value);
+	imp->value = NULL;
+	imp->value_size = 0;
+}
+
+/**
+ * @brief      Read the next attribute of an import.
+ *
+ * @param[in]  imp        The import.
+ * @param[out] p_attr_id  Pointer were the attribute identifier can be stored.
+ * @param[out] p_codec    Pointer were the codec of the value can be stored.
+ * @param[out] p_length   Pointer were the length of the stored value can be stored.
+ * @param[out] p_value    Pointer were a pointer to the stored value can be stored, valid until the next read.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no attributes left or an unknown codec)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_import_next(	gp_nvm_import_t *imp,
+					uint32_t *p_attr_id,
+					uint32_t *p_codec,
+					uint32_t *p_length,
+					const uint8_t **p_value)
+{
+	uint8_t head[GP_NVM_EXPORT_ENTRY_SIZE];
+
+	if( imp->remaining == 0 ){
+		return GP_NVM_FAIL;
+	}
+	gp_nvm_result_t result = _gp_nvm_import_read(imp, head, sizeof(head));
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	uint32_t len = _gp_nvm_export_get32(head + 4);
+	if( head[8] != GP_NVM_CODEC_NONE && head[8] != GP_NVM_CODEC_LZ ){
+		fprintf(stderr, "GP-NVM: unknown codec %u in export\n", head[8]);
+		return GP_NVM_FAIL;
+	}
+	if( len > imp->value_size ){
+		uint8_t *value = realloc(imp->value, len);
+		if( value == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+		imp->value = value;
+		imp->value_size = len;
+	}
+	result = _gp_nvm_import_read(imp, imp->value, len);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	imp->remaining--;
+	*p_attr_id = _gp_nvm_export_get32(head);
+	*p_codec = head[8];
+	*p_length = len;
+	*p_value = imp->value;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Read and check the CRC at the end of an import.
+ *
+ * @param[in]  imp  The import.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_import_trailer(gp_nvm_import_t *imp)
+{
+	uint8_t tail[4];
+	uint32_t crc = imp->crc;
+	gp_nvm_result_t result = _gp_nvm_import_read(imp, tail, sizeof(tail));
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	if( _gp_nvm_export_get32(tail) != crc ){
+		fprintf(stderr, "GP-NVM: CRC error in export\n");
+		return GP_NVM_CRC_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/** @} */
@@ -0,0 +1,228 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-export.h
+ * \brief	Header file for the export and import of all attributes of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * An export is a stream of bytes that holds every attribute of a context with its value as it is stored.
+ * It starts with a header of 12 bytes: the magic number, the version and the number of attributes.
+ * Every attribute follows as its ID, the length of the stored value, the codec of the value (one byte)
+ * and the stored value, so a compressed value is exported without decompressing it.
+ * The stream ends with the CRC32C of all bytes before it. All numbers are 32-bit little-endian.
+ * The attributes of a store are exported in the order of their records on the NVM, so the data of
+ * the store is read in one sequential pass, with reads of GP_NVM_CONF_EXPORT_CHUNK_SIZE bytes.
+ */
+
+#ifndef __GP_NVM_EXPORT_H__
+#define __GP_NVM_EXPORT_H__
+
+#include "gp-nvm-store.h"
+
+/**
+ * @brief      Magic number at the start of an export ("GPNX").
+ *
+ */
+#define GP_NVM_EXPORT_MAGIC 0x584e5047
+
+/**
+ * @brief      Version of the export format.
+ *
+ */
+#define GP_NVM_EXPORT_VERSION 1
+
+/**
+ * @brief      Size of the header of an export.
+ *
+ */
+#define GP_NVM_EXPORT_HEADER_SIZE 12
+
+/**
+ * @brief      Size of the fields before the value of an exported attribute.
+ *
+ */
+#define GP_NVM_EXPORT_ENTRY_SIZE 9
+
+/**
+ * @brief      Size of the reads of the NVM while a store is exported.
+ *
+ */
+#ifndef GP_NVM_CONF_EXPORT_CHUNK_SIZE
+#define GP_NVM_CONF_EXPORT_CHUNK_SIZE 65536
+#endif
+
+/**
+ * @brief      State of an export.
+ *
+ * The CRC covers all bytes written so far. The chunk holds the bytes of the NVM from chunk_offset,
+ * it grows for a value that is larger than a chunk. The bytes are the value bytes that were exported.
+ */
+typedef struct gp_nvm_export {
+	gp_nvm_export_cb_t write;
+	void *arg;
+	uint32_t crc;
+	uint8_t *chunk;
+	uint32_t chunk_size;
+	uint32_t chunk_offset;
+	uint32_t chunk_len;
+	uint64_t bytes;
+} gp_nvm_export_t;
+
+/**
+ * @brief      State of an import.
+ *
+ * The CRC covers all bytes read so far, remaining is the number of attributes that weren't read yet.
+ * The value of the last attribute that was read is kept in the value buffer.
+ */
+typedef struct gp_nvm_import {
+	gp_nvm_import_cb_t read;
+	void *arg;
+	uint32_t crc;
+	uint32_t remaining;
+	uint8_t *value;
+	uint32_t value_size;
+} gp_nvm_import_t;
+
+/**
+ * @brief      Start an export.
+ *
+ * @param[out] exp    The export.
+ * @param[in]  write  The callback that writes the bytes of the export.
+ * @param[in]  arg    The last argument of the callback.
+ */
+void
+gp_nvm_export_init(	gp_nvm_export_t *exp,
+					gp_nvm_export_cb_t write,
+					void *arg);
+
+/**
+ * @brief      Release the memory of an export.
+ *
+ * @param[in]  exp  The export.
+ */
+void
+gp_nvm_export_deinit(gp_nvm_export_t *exp);
+
+/**
+ * @brief      Write the header of an export.
+ *
+ * @param[in]  exp        The export.
+ * @param[in]  num_attrs  The number of attributes that will be exported.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_header(	gp_nvm_export_t *exp,
+						uint32_t num_attrs);
+
+/**
+ * @brief      Export one attribute.
+ *
+ * @param[in]  exp      The export.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  codec    The codec of the value.
+ * @param[in]  len      The length of the value as it is stored.
+ * @param[in]  value    The value as it is stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_value(	gp_nvm_export_t *exp,
+						uint32_t attr_id,
+						uint32_t codec,
+						uint32_t len,
+						const uint8_t *value);
+
+/**
+ * @brief      Export all attributes of a store in the order of their records on the NVM.
+ *
+ * The caller holds the writer mutex of the store. The CRC of every value is checked.
+ *
+ * @param[in]  exp    The export.
+ * @param[in]  store  The store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the NVM couldn't be read or the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_export_store(	gp_nvm_export_t *exp,
+						const gp_nvm_store_t *store);
+
+/**
+ * @brief      Write the CRC at the end of an export.
+ *
+ * @param[in]  exp  The export.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_export_trailer(gp_nvm_export_t *exp);
+
+/**
+ * @brief      Start an import and read the header.
+ *
+ * @param[out] imp   The import.
+ * @param[in]  read  The callback that reads the bytes of the import.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (not an export or an unknown version)
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_import_init(	gp_nvm_import_t *imp,
+					gp_nvm_import_cb_t read,
+					void *arg);
+
+/**
+ * @brief      Release the memory of an import.
+ *
+ * @param[in]  imp  The import.
+ */
+void
+gp_nvm_import_deinit(gp_nvm_import_t *imp);
+
+/**
+ * @brief      Read the next attribute of an import.
+ *
+ * @param[in]  imp        The import.
+ * @param[out] p_attr_id  Pointer were the attribute identifier can be stored.
+ * @param[out] p_codec    Pointer were the codec of the value can be stored.
+ * @param[out] p_length   Pointer were the length of the stored value can be stored.
+ * @param[out] p_value    Pointer were a pointer to the stored value can be stored, valid until the next read.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no attributes left or an unknown codec)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ */
+gp_nvm_result_t
+gp_nvm_import_next(	gp_nvm_import_t *imp,
+					uint32_t *p_attr_id,
+					uint32_t *p_codec,
+					uint32_t *p_length,
+					const uint8_t **p_value);
+
+/**
+ * @brief      Read and check the CRC at the end of an import.
+ *
+ * @param[in]  imp  The import.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR (the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_import_trailer(gp_nvm_import_t *imp);
+
+#endif /* __GP_NVM_EXPORT_H__ */
+
+/** @} */
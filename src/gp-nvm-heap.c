@@ -0,0 +1,943 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-heap.c
+ * \brief	Implementation of the in-place storage engine of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-heap.h"
+
+// Uses following header(s)
+#include "gp-nvm-checkpoint.h"
+#include "gp-nvm-stats.h"
+#include "nvm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Minimum capacity of the free record that remains when an extent is split.
+ *
+ */
+#define GP_NVM_HEAP_MIN_SPLIT GP_NVM_HEAP_ALIGN
+
+/**
+ * @brief      Mark the record at offset as free and return its extent to the allocator.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_free(gp_nvm_store_t *store, uint32_t offset, uint32_t capacity)
+{
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_FREE,
+		.capacity = capacity,
+	};
+	if( gp_nvm_store_write_record(store, offset, &hdr, NULL) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	if( gp_nvm_alloc_free(&store->alloc, offset, GP_NVM_RECORD_SIZE(capacity)) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Take a free extent for a record that can hold length bytes, the data region doesn't grow.
+ *
+ * The part of the extent that isn't needed is split off as a new free record.
+ *
+ * @param[in]  store     The attribute store.
+ * @param[in]  length    The length of the value.
+ * @param[out] offset    Pointer were the offset of the record can be stored.
+ * @param[out] capacity  Pointer were the capacity of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no free extent fits the record)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_take(gp_nvm_store_t *store, uint32_t length, uint32_t *offset, uint32_t *capacity)
+{
+	uint32_t cap = (length + GP_NVM_HEAP_ALIGN - 1) & ~(GP_NVM_HEAP_ALIGN - 1);
+	uint32_t size = GP_NVM_RECORD_SIZE(cap);
+	uint32_t extent_size;
+
+	if( cap < length || size < cap ){
+		return GP_NVM_MEM_FULL;
+	}
+
+	if( gp_nvm_alloc_take(&store->alloc, size, offset, &extent_size) == 0 ){
+		if( extent_size - size >= GP_NVM_RECORD_SIZE(GP_NVM_HEAP_MIN_SPLIT) ){
+			gp_nvm_result_t result = _gp_nvm_heap_free(store, *offset + size, extent_size - size - sizeof(gp_nvm_record_hdr_t));
+			if( result != GP_NVM_SUCCESS ){
+				gp_nvm_alloc_free(&store->alloc, *offset, extent_size);
+				return result;
+			}
+			store->alloc.splits++;
+		} else {
+			// the remainder is too small for a free record, the record keeps it as extra capacity
+			cap = extent_size - sizeof(gp_nvm_record_hdr_t);
+		}
+		*capacity = cap;
+		return GP_NVM_SUCCESS;
+	}
+	return GP_NVM_FAIL;
+}
+
+/**
+ * @brief      Allocate an extent for a record that can hold length bytes.
+ *
+ * A free extent is reused when possible, the part that isn't needed is split off as a new free record.
+ * Otherwise the extent is taken from the end of the data region.
+ *
+ * @param[in]  store     The attribute store.
+ * @param[in]  length    The length of the value.
+ * @param[out] offset    Pointer were the offset of the record can be stored.
+ * @param[out] capacity  Pointer were the capacity of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_alloc(gp_nvm_store_t *store, uint32_t length, uint32_t *offset, uint32_t *capacity)
+{
+	uint32_t cap = (length + GP_NVM_HEAP_ALIGN - 1) & ~(GP_NVM_HEAP_ALIGN - 1);
+	uint32_t size = GP_NVM_RECORD_SIZE(cap);
+
+	gp_nvm_result_t result = _gp_nvm_heap_take(store, length, offset, capacity);
+	if( result != GP_NVM_FAIL ){
+		return result;
+	}
+
+	// check if the data region can still grow
+	if( store->end > UINT32_MAX - size ){
+		return GP_NVM_MEM_FULL;
+	}
+	*offset = store->end;
+	*capacity = cap;
+	store->end += size;
+	store->alloc.end_allocs++;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Free the records of the newest checkpoint and forget it.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_free_checkpoint(gp_nvm_store_t *store)
+{
+	gp_nvm_checkpoint_t *ckpt = &store->ckpt;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	for( uint32_t i = 0; i<ckpt->num_chunks && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_record_hdr_t hdr;
+		if( gp_nvm_store_read_hdr(store, ckpt->chunks[i], &hdr) == 0 && hdr.type == GP_NVM_RECORD_CHECKPOINT ){
+			result = _gp_nvm_heap_free(store, ckpt->chunks[i], hdr.capacity);
+		}
+	}
+	gp_nvm_checkpoint_reset(store);
+	return result;
+}
+
+/**
+ * @brief      Point the index at the record at offset if it is newer than the record of the attribute in the index.
+ *
+ * The older of both records becomes free.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_apply(gp_nvm_store_t *store, uint32_t offset, const gp_nvm_record_hdr_t *hdr)
+{
+	int added;
+	gp_nvm_index_entry_t* attr = gp_nvm_index_insert(&store->index, hdr->attr_id, &added);
+	if( attr == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	if( !added && hdr->seq < attr->seq ){
+		return _gp_nvm_heap_free(store, offset, hdr->capacity);
+	}
+	// an interrupted move left the previous record of the attribute behind
+	if( !added ){
+		gp_nvm_result_t result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+	}
+	attr->offset = offset;
+	attr->len = hdr->len;
+	attr->capacity = hdr->capacity;
+	attr->seq = hdr->seq;
+	attr->crc = hdr->crc;
+	attr->codec = GP_NVM_RECORD_CODEC(hdr->flags);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Load the index, the end of the data region and the free extents from the newest checkpoint.
+ *
+ * The checkpoint is only valid when the store didn't change after it, otherwise its anchors are erased.
+ * When the checkpoint can't be used, the index and the allocator are emptied again.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no valid checkpoint)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_heap_restore(gp_nvm_store_t *store)
+{
+	gp_nvm_checkpoint_buf_t buf;
+	if( gp_nvm_checkpoint_read(store, &buf) != 0 ){
+		return GP_NVM_FAIL;
+	}
+
+	int error = gp_nvm_checkpoint_get_index(store, &buf);
+	uint32_t end = gp_nvm_checkpoint_get(&buf);
+	uint32_t num_extents = gp_nvm_checkpoint_get(&buf);
+	for( uint32_t i = 0; i<num_extents && !error && !buf.error; i++ ){
+		uint32_t offset = gp_nvm_checkpoint_get(&buf);
+		uint32_t size = gp_nvm_checkpoint_get(&buf);
+		error = offset < store->data_start || offset > end || size > end - offset ||
+			gp_nvm_alloc_free(&store->alloc, offset, size) != 0;
+	}
+	error |= buf.error || buf.pos != buf.len;
+	gp_nvm_checkpoint_buf_deinit(&buf);
+
+	// every record has to lie in the data region
+	const gp_nvm_index_t *index = &store->index;
+	for( uint32_t i = 0; i<index->num_slots && !error; i++ ){
+		const gp_nvm_index_entry_t *entry = &index->entries[i];
+		error = index->ctrl[i] != 0 &&
+			(entry->offset < store->data_start || entry->offset > end ||
+			GP_NVM_RECORD_SIZE(entry->capacity) > end - entry->offset || entry->len > entry->capacity);
+	}
+	if( !error ){
+		store->end = end;
+		store->ckpt.valid = 1;
+		return GP_NVM_SUCCESS;
+	}
+
+	fprintf(stderr, "GP-NVM: invalid checkpoint, scanning all records\n");
+	gp_nvm_checkpoint_reset(store);
+	gp_nvm_index_deinit(&store->index);
+	gp_nvm_alloc_deinit(&store->alloc);
+	store->seq = 0;
+	if( gp_nvm_index_init_shared(&store->index) != 0 || gp_nvm_alloc_init(&store->alloc) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	return GP_NVM_FAIL;
+}
+
+/**
+ * @brief      Open the in-place engine and load the index from the newest checkpoint or rebuild it by scanning all records.
+ *
+ * The scan stops at the first offset that doesn't contain a valid record header,
+ * this offset becomes the end of the data region. Free records are added to the allocator,
+ * adjacent free records are merged. The records of old checkpoints are free as well.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (the scan stopped at a corrupt record header)
+ */
+gp_nvm_result_t
+gp_nvm_heap_open(gp_nvm_store_t *store)
+{
+	uint32_t offset = store->data_start;
+	uint32_t free_offset = 0;
+	uint32_t free_size = 0;
+	gp_nvm_record_hdr_t hdr;
+	gp_nvm_batch_recovery_t recovery = { 0 };
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	int status = 0;
+
+	if( gp_nvm_alloc_init(&store->alloc) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	result = _gp_nvm_heap_restore(store);
+	if( result != GP_NVM_FAIL ){
+		return result;
+	}
+	result = GP_NVM_SUCCESS;
+
+	while( result == GP_NVM_SUCCESS && (status = gp_nvm_store_read_hdr(store, offset, &hdr)) == 0 ){
+		uint32_t size = GP_NVM_RECORD_SIZE(hdr.capacity);
+		if( size < hdr.capacity || hdr.len > hdr.capacity ){
+			break;
+		}
+
+		if( hdr.type == GP_NVM_RECORD_FREE || hdr.type == GP_NVM_RECORD_CHECKPOINT ){
+			// merge with the free record right before it
+			if( free_size > 0 && free_offset + free_size == offset ){
+				free_size += size;
+			} else {
+				if( free_size > 0 && gp_nvm_alloc_free(&store->alloc, free_offset, free_size) != 0 ){
+					result = GP_NVM_MEM_FULL;
+				}
+				free_offset = offset;
+				free_size = size;
+			}
+		} else if( hdr.type == GP_NVM_RECORD_COMMIT || (hdr.flags & GP_NVM_RECORD_FLAG_BATCH) ){
+			// batch records are applied once all commit records are known
+			if( gp_nvm_batch_recovery_add(&recovery, offset, &hdr) != 0 ){
+				result = GP_NVM_MEM_FULL;
+			}
+		} else if( hdr.type == GP_NVM_RECORD_ATTR ){
+			result = _gp_nvm_heap_apply(store, offset, &hdr);
+		}
+
+		if( hdr.seq > store->seq ){
+			store->seq = hdr.seq;
+		}
+		offset += size;
+	}
+	if( free_size > 0 && gp_nvm_alloc_free(&store->alloc, free_offset, free_size) != 0 ){
+		result = GP_NVM_MEM_FULL;
+	}
+	store->end = offset;
+
+	// finish committed batches by clearing the batch flag, roll back the others
+	for( uint32_t i = 0; i<recovery.num_pending && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_batch_record_t *record = &recovery.pending[i];
+		if( gp_nvm_batch_recovery_committed(&recovery, record->hdr.seq) ){
+			record->hdr.flags &= ~GP_NVM_RECORD_FLAG_BATCH;
+			if( gp_nvm_store_write_hdr(store, record->offset, &record->hdr) != 0 ){
+				result = GP_NVM_MEM_ERROR;
+				break;
+			}
+			result = _gp_nvm_heap_apply(store, record->offset, &record->hdr);
+		} else {
+			result = _gp_nvm_heap_free(store, record->offset, record->hdr.capacity);
+		}
+	}
+	for( uint32_t i = 0; i<recovery.num_commits && result == GP_NVM_SUCCESS; i++ ){
+		result = _gp_nvm_heap_free(store, recovery.commits[i].offset, recovery.commits[i].hdr.capacity);
+	}
+	gp_nvm_batch_recovery_deinit(&recovery);
+
+	if( result == GP_NVM_SUCCESS && status == 2 ){
+		// the records after a corrupt header can't be found, they will be overwritten
+		return GP_NVM_CRC_ERROR;
+	}
+	return result;
+}
+
+/**
+ * @brief      Release the memory of the in-place engine.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_heap_close(gp_nvm_store_t *store)
+{
+	gp_nvm_alloc_deinit(&store->alloc);
+}
+
+/**
+ * @brief      Set an attribute, overwriting it in place when the value fits its record.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value as it is stored.
+ * @param[in]  p_value  Pointer to the value in RAM, compressed with codec.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_set(	gp_nvm_store_t *store,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value,
+					uint32_t codec)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, attr_id);
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_ATTR,
+		.flags = codec << GP_NVM_RECORD_CODEC_SHIFT,
+		.attr_id = attr_id,
+		.len = length,
+		.crc = gp_nvm_crc32c(0, p_value, length),
+	};
+
+	// overwrite the value in place when it fits the record, the header is rewritten for the new CRC
+	// and gets a new sequence number, so a stream opened before knows the attribute was set
+	if( attr != NULL && length <= attr->capacity ){
+		hdr.capacity = attr->capacity;
+		hdr.seq = store->seq + 1;
+		if( gp_nvm_store_write_record(store, attr->offset, &hdr, p_value) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		store->seq++;
+		attr->seq = hdr.seq;
+		attr->len = length;
+		attr->crc = hdr.crc;
+		attr->codec = codec;
+		return GP_NVM_SUCCESS;
+	}
+
+	// write the value to a new record
+	uint32_t offset;
+	gp_nvm_result_t result = _gp_nvm_heap_alloc(store, length, &offset, &hdr.capacity);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	hdr.seq = store->seq + 1;
+	if( gp_nvm_store_write_record(store, offset, &hdr, p_value) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	store->seq++;
+
+	// the old record of a moved attribute becomes free
+	if( attr != NULL ){
+		GP_NVM_STATS_ADD(record_moves, 1);
+		result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+	} else {
+		int added;
+		attr = gp_nvm_index_insert(&store->index, attr_id, &added);
+		if( attr == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+	}
+	attr->offset = offset;
+	attr->len = length;
+	attr->capacity = hdr.capacity;
+	attr->seq = hdr.seq;
+	attr->crc = hdr.crc;
+	attr->codec = codec;
+	return result;
+}
+
+/**
+ * @brief      Overwrite a range of the value of an attribute in place.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_update_range(	gp_nvm_store_t *store,
+							uint32_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							const uint8_t* p_value)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, attr_id);
+	uint8_t old[64];
+
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	if( attr->codec != GP_NVM_CODEC_NONE ){
+		return GP_NVM_FAIL;
+	}
+	if( offset > attr->len || length > attr->len - offset ){
+		return GP_NVM_ATTR_LEN_DIFF;
+	}
+
+	// the CRC is patched with the old bytes of the range, the rest of the value isn't read
+	uint32_t value_offset = attr->offset + sizeof(gp_nvm_record_hdr_t) + offset;
+	uint32_t crc = attr->crc;
+	for( uint32_t pos = 0; pos<length; pos += sizeof(old) ){
+		uint32_t n = length - pos < sizeof(old) ? length - pos : sizeof(old);
+		if( nvm_dev_read(store->dev, value_offset + pos, n, old) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		crc = gp_nvm_crc32c_patch(crc, old, p_value + pos, n, attr->len - offset - pos - n);
+	}
+
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_ATTR,
+		.attr_id = attr_id,
+		.len = attr->len,
+		.capacity = attr->capacity,
+		.seq = store->seq + 1,
+		.crc = crc,
+	};
+	if( length > 0 && nvm_dev_update(store->dev, value_offset, length, p_value) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	if( gp_nvm_store_write_hdr(store, attr->offset, &hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	store->seq++;
+	attr->seq = hdr.seq;
+	attr->crc = crc;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Reserve a new record for a stream, the record is marked free until the stream is committed.
+ *
+ * @param[in]     store   The attribute store.
+ * @param[inout]  hdr     The header of the record with the attribute ID and the length of the value, the
+ *                        capacity and the sequence number are set here.
+ * @param[out]    offset  Pointer were the offset of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_open(	gp_nvm_store_t *store,
+							gp_nvm_record_hdr_t *hdr,
+							uint32_t *offset)
+{
+	gp_nvm_result_t result = _gp_nvm_heap_alloc(store, hdr->len, offset, &hdr->capacity);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	gp_nvm_record_hdr_t placeholder = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_FREE,
+		.capacity = hdr->capacity,
+		.seq = store->seq + 1,
+	};
+	if( gp_nvm_store_write_hdr(store, *offset, &placeholder) != 0 ){
+		gp_nvm_alloc_free(&store->alloc, *offset, GP_NVM_RECORD_SIZE(hdr->capacity));
+		return GP_NVM_MEM_ERROR;
+	}
+	hdr->seq = ++store->seq;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Commit a stream: write the attribute header of its record and point the index at it.
+ *
+ * The previous record of the attribute becomes free. The commit fails when the attribute got a newer
+ * record while the stream was open, the stream then has to be aborted.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record, with the CRC of the value.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute has a newer record)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_commit(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, hdr->attr_id);
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	if( attr != NULL && attr->seq > hdr->seq ){
+		return GP_NVM_FAIL;
+	}
+	if( gp_nvm_store_write_hdr(store, offset, hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	if( attr != NULL ){
+		result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+	} else {
+		int added;
+		attr = gp_nvm_index_insert(&store->index, hdr->attr_id, &added);
+		if( attr == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+	}
+	attr->offset = offset;
+	attr->len = hdr->len;
+	attr->capacity = hdr->capacity;
+	attr->seq = hdr->seq;
+	attr->crc = hdr->crc;
+	attr->codec = GP_NVM_CODEC_NONE;
+	return result;
+}
+
+/**
+ * @brief      Abort a stream, its record is returned to the allocator.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_abort(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset)
+{
+	return _gp_nvm_heap_free(store, offset, hdr->capacity);
+}
+
+/**
+ * @brief      Commit a batch: write its records to new extents, followed by the commit record.
+ *
+ * Records that are adjacent, like records at the end of the data region, are written with one update.
+ * Once the batch is committed, the previous records of the attributes become free, the batch flag of
+ * the records is cleared and the commit record becomes free.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  batch  The batch.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_commit(	gp_nvm_store_t *store,
+					gp_nvm_batch_t *batch)
+{
+	uint32_t n = batch->num_entries;
+	gp_nvm_batch_record_t *records = batch->records;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint32_t allocated;
+
+	if( n == 0 ){
+		return GP_NVM_SUCCESS;
+	}
+
+	// records[n] is the commit record
+	for( allocated = 0; allocated<=n; allocated++ ){
+		gp_nvm_batch_record_t *record = &records[allocated];
+		memset(record, 0, sizeof(gp_nvm_batch_record_t));
+		record->hdr.magic = GP_NVM_RECORD_MAGIC;
+		record->hdr.seq = store->seq + 1 + allocated;
+		if( allocated < n ){
+			gp_nvm_batch_entry_t *entry = &batch->entries[allocated];
+			record->value = batch->data + entry->data;
+			record->hdr.type = GP_NVM_RECORD_ATTR;
+			record->hdr.flags = GP_NVM_RECORD_FLAG_BATCH | entry->codec << GP_NVM_RECORD_CODEC_SHIFT;
+			record->hdr.attr_id = entry->attr_id;
+			record->hdr.len = entry->len;
+			record->hdr.crc = gp_nvm_crc32c(0, record->value, entry->len);
+		} else {
+			record->hdr.type = GP_NVM_RECORD_COMMIT;
+			record->hdr.attr_id = n;
+		}
+		result = _gp_nvm_heap_alloc(store, record->hdr.len, &record->offset, &record->hdr.capacity);
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+	}
+
+	if( result == GP_NVM_SUCCESS &&
+		(gp_nvm_batch_write(store->dev, records, n) != 0 || gp_nvm_store_write_record(store, records[n].offset, &records[n].hdr, NULL) != 0) ){
+		result = GP_NVM_MEM_ERROR;
+	}
+	if( result != GP_NVM_SUCCESS ){
+		// without commit record the batch isn't valid, the extents can be reused
+		for( uint32_t i = 0; i<allocated; i++ ){
+			_gp_nvm_heap_free(store, records[i].offset, records[i].hdr.capacity);
+		}
+		return result;
+	}
+	store->seq += n + 1;
+
+	// the batch is committed, point the index at the new records
+	for( uint32_t i = 0; i<n && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, records[i].hdr.attr_id);
+		if( attr != NULL ){
+			GP_NVM_STATS_ADD(record_moves, 1);
+			result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+		} else {
+			int added;
+			attr = gp_nvm_index_insert(&store->index, records[i].hdr.attr_id, &added);
+			if( attr == NULL ){
+				return GP_NVM_MEM_FULL;
+			}
+		}
+		attr->offset = records[i].offset;
+		attr->len = records[i].hdr.len;
+		attr->capacity = records[i].hdr.capacity;
+		attr->seq = records[i].hdr.seq;
+		attr->crc = records[i].hdr.crc;
+		attr->codec = GP_NVM_RECORD_CODEC(records[i].hdr.flags);
+	}
+
+	// the records don't depend on the commit record anymore once their batch flag is cleared
+	for( uint32_t i = 0; i<n && result == GP_NVM_SUCCESS; i++ ){
+		records[i].hdr.flags &= ~GP_NVM_RECORD_FLAG_BATCH;
+		if( gp_nvm_store_write_hdr(store, records[i].offset, &records[i].hdr) != 0 ){
+			result = GP_NVM_MEM_ERROR;
+		}
+	}
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_heap_free(store, records[n].offset, records[n].hdr.capacity);
+	}
+	return result;
+}
+
+/**
+ * @brief      Delete an attribute: its record becomes free and the index entry is removed.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_delete(	gp_nvm_store_t *store,
+					uint32_t attr_id)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, attr_id);
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	gp_nvm_result_t result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+	// the record is free on the NVM once its header is written, even when the allocator can't keep the extent
+	if( result != GP_NVM_MEM_ERROR ){
+		gp_nvm_index_remove(&store->index, attr_id);
+	}
+	return result;
+}
+
+/**
+ * @brief      Run one compaction step: shrink the data region by moving the records at its end into free extents.
+ *
+ * The free extent at the end of the data region is cut off, a zeroed record header ends the scan there.
+ * Then the record that ends at the end of the data region is moved to the free extent that fits it best,
+ * until no free extent fits it or max_bytes were moved. The record is found by searching the index.
+ * A move writes the record with a new sequence number before the old one becomes free, so an interrupted
+ * move keeps the newest record. The records of an outdated checkpoint at the end are freed as well.
+ * Nothing is compacted while a stream is open, the anchors of the checkpoint are erased before the first change.
+ *
+ * @param[in]  store      The attribute store.
+ * @param[in]  max_bytes  Maximum number of bytes to move, 0 moves until no free extent fits.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_compact(	gp_nvm_store_t *store,
+						uint32_t max_bytes)
+{
+	gp_nvm_index_t *index = &store->index;
+	uint8_t small[UINT8_MAX];
+	uint32_t moved = 0;
+	gp_nvm_result_t result;
+
+	if( store->streams > 0 ){
+		return GP_NVM_SUCCESS;
+	}
+	for( ;; ){
+		uint32_t offset;
+		uint32_t size;
+		if( gp_nvm_alloc_take_end(&store->alloc, store->end, &offset, &size) == 0 ){
+			gp_nvm_record_hdr_t end_hdr;
+			memset(&end_hdr, 0, sizeof(end_hdr));
+			if( gp_nvm_checkpoint_touch(store) != GP_NVM_SUCCESS ||
+				nvm_dev_update(store->dev, offset, sizeof(end_hdr), &end_hdr) != 0 ){
+				gp_nvm_alloc_free(&store->alloc, offset, size);
+				return GP_NVM_MEM_ERROR;
+			}
+			store->end = offset;
+			store->alloc.reclaimed_bytes += size;
+			continue;
+		}
+		if( max_bytes > 0 && moved >= max_bytes ){
+			break;
+		}
+
+		gp_nvm_index_entry_t *attr = NULL;
+		uint32_t attr_id = 0;
+		for( uint32_t i = 0; i<index->num_slots && attr == NULL; i++ ){
+			if( index->ctrl[i] != 0 && index->entries[i].offset + GP_NVM_RECORD_SIZE(index->entries[i].capacity) == store->end ){
+				attr = &index->entries[i];
+				attr_id = index->ids[i];
+			}
+		}
+		if( attr == NULL ){
+			// otherwise only a record of the checkpoint can end there
+			int at_end = 0;
+			for( uint32_t i = 0; i<store->ckpt.num_chunks; i++ ){
+				gp_nvm_record_hdr_t hdr;
+				at_end |= gp_nvm_store_read_hdr(store, store->ckpt.chunks[i], &hdr) == 0 && hdr.type == GP_NVM_RECORD_CHECKPOINT &&
+					store->ckpt.chunks[i] + GP_NVM_RECORD_SIZE(hdr.capacity) == store->end;
+			}
+			if( !at_end ){
+				break;
+			}
+			result = gp_nvm_checkpoint_touch(store);
+			if( result == GP_NVM_SUCCESS ){
+				result = _gp_nvm_heap_free_checkpoint(store);
+			}
+			if( result != GP_NVM_SUCCESS ){
+				return result;
+			}
+			continue;
+		}
+
+		// a large value gets a buffer of its own
+		uint8_t *value = attr->len <= sizeof(small) ? small : malloc(attr->len);
+		if( value == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+		gp_nvm_record_hdr_t hdr = {
+			.magic = GP_NVM_RECORD_MAGIC,
+			.type = GP_NVM_RECORD_ATTR,
+			.flags = attr->codec << GP_NVM_RECORD_CODEC_SHIFT,
+			.attr_id = attr_id,
+			.len = attr->len,
+			.seq = store->seq + 1,
+			.crc = attr->crc,
+		};
+		result = GP_NVM_MEM_ERROR;
+		if( nvm_dev_read(store->dev, attr->offset + sizeof(hdr), attr->len, value) == 0 &&
+			(result = gp_nvm_checkpoint_touch(store)) == GP_NVM_SUCCESS ){
+			result = _gp_nvm_heap_take(store, attr->len, &offset, &hdr.capacity);
+			if( result == GP_NVM_SUCCESS && gp_nvm_store_write_record(store, offset, &hdr, value) != 0 ){
+				result = GP_NVM_MEM_ERROR;
+			}
+		}
+		if( value != small ){
+			free(value);
+		}
+		if( result == GP_NVM_FAIL ){
+			// no free extent fits the record
+			break;
+		}
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+		store->seq++;
+		result = _gp_nvm_heap_free(store, attr->offset, attr->capacity);
+		attr->offset = offset;
+		attr->capacity = hdr.capacity;
+		attr->seq = hdr.seq;
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+		size = GP_NVM_RECORD_SIZE(hdr.capacity);
+		store->alloc.compact_bytes += size;
+		moved += size;
+		GP_NVM_STATS_ADD(record_moves, 1);
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * The live bytes are the bytes of the records in the data region, the stale bytes the free bytes between them.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_heap_get_stats(	const gp_nvm_store_t *store,
+						gp_nvm_compact_stats_t *stats)
+{
+	memset(stats, 0, sizeof(gp_nvm_compact_stats_t));
+	stats->live_bytes = store->end - store->data_start - store->alloc.free_bytes;
+	stats->stale_bytes = store->alloc.free_bytes;
+	stats->compact_bytes = store->alloc.compact_bytes;
+	stats->reclaimed_bytes = store->alloc.reclaimed_bytes;
+}
+
+/**
+ * @brief      Write a checkpoint of the index, the end of the data region and the free extents.
+ *
+ * The checkpoint is written as one record, the record of the previous checkpoint becomes free.
+ * Nothing is written when the newest checkpoint is still valid.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_checkpoint(gp_nvm_store_t *store)
+{
+	gp_nvm_checkpoint_t *ckpt = &store->ckpt;
+	gp_nvm_checkpoint_buf_t buf = { 0 };
+	gp_nvm_result_t result;
+
+	if( ckpt->valid ){
+		return GP_NVM_SUCCESS;
+	}
+	result = gp_nvm_checkpoint_touch(store);
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_heap_free_checkpoint(store);
+	}
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+
+	// taking the extent of the record doesn't add free extents, except for the part that is split off
+	uint64_t size = (5 + 7 * (uint64_t) store->index.num_entries + 2 * ((uint64_t) store->alloc.free_extents + 1)) * sizeof(uint32_t);
+	uint32_t *chunks = malloc(sizeof(uint32_t));
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_CHECKPOINT,
+		.seq = store->seq,
+	};
+	if( chunks == NULL || size > UINT32_MAX ){
+		free(chunks);
+		return GP_NVM_MEM_FULL;
+	}
+	result = _gp_nvm_heap_alloc(store, size, &chunks[0], &hdr.capacity);
+	if( result != GP_NVM_SUCCESS ){
+		free(chunks);
+		return result;
+	}
+
+	gp_nvm_checkpoint_put_index(store, &buf);
+	gp_nvm_checkpoint_put(&buf, store->end);
+	gp_nvm_checkpoint_put(&buf, store->alloc.free_extents);
+	const gp_nvm_index_t *by_start = &store->alloc.by_start;
+	for( uint32_t i = 0; i<by_start->num_slots; i++ ){
+		if( by_start->ctrl[i] != 0 ){
+			gp_nvm_checkpoint_put(&buf, by_start->ids[i]);
+			gp_nvm_checkpoint_put(&buf, store->alloc.pool[by_start->entries[i].offset].size);
+		}
+	}
+	hdr.len = buf.len;
+	hdr.crc = gp_nvm_crc32c(0, buf.data, buf.len);
+	if( buf.error ){
+		result = GP_NVM_MEM_FULL;
+	} else if( gp_nvm_store_write_record(store, chunks[0], &hdr, buf.data) != 0 ){
+		result = GP_NVM_MEM_ERROR;
+	}
+	gp_nvm_checkpoint_buf_deinit(&buf);
+	if( result != GP_NVM_SUCCESS ){
+		_gp_nvm_heap_free(store, chunks[0], hdr.capacity);
+		free(chunks);
+		return result;
+	}
+	return gp_nvm_checkpoint_commit(store, hdr.len, chunks, 1);
+}
+
+/** @} */
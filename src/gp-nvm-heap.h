@@ -0,0 +1,238 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-heap.h
+ * \brief	Header file for the in-place storage engine of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The in-place engine stores records back to back after the superblock and the static attributes.
+ * A value that fits the capacity of its record is overwritten in place. A value that doesn't fit is written to a new
+ * record in a free extent (or at the end of the data region) and the old record becomes a free record.
+ * Free extents are managed by the allocator in gp-nvm-alloc.h, a free extent that is larger than
+ * needed is split so the remainder stays available.
+ * The records of a batch are always written to new extents, so the previous values stay intact until
+ * the batch is committed.
+ */
+
+#ifndef __GP_NVM_HEAP_H__
+#define __GP_NVM_HEAP_H__
+
+#include "gp-nvm-store.h"
+#include "gp-nvm-batch.h"
+
+/**
+ * @brief      Alignment of the capacity of a record, values can grow up to it without moving.
+ *
+ */
+#define GP_NVM_HEAP_ALIGN 8
+
+/**
+ * @brief      Open the in-place engine and load the index from the newest checkpoint or rebuild it by scanning all records.
+ *
+ * The scan stops at the first offset that doesn't contain a valid record header,
+ * this offset becomes the end of the data region. Free records are added to the allocator,
+ * adjacent free records are merged. The records of old checkpoints are free as well.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (the scan stopped at a corrupt record header)
+ */
+gp_nvm_result_t
+gp_nvm_heap_open(gp_nvm_store_t *store);
+
+/**
+ * @brief      Release the memory of the in-place engine.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_heap_close(gp_nvm_store_t *store);
+
+/**
+ * @brief      Set an attribute, overwriting it in place when the value fits its record.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value as it is stored.
+ * @param[in]  p_value  Pointer to the value in RAM, compressed with codec.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_set(	gp_nvm_store_t *store,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value,
+					uint32_t codec);
+
+/**
+ * @brief      Overwrite a range of the value of an attribute in place.
+ *
+ * Only the bytes of the range are read and written, the CRC of the value is updated from the old and the
+ * new bytes of the range. The header is rewritten for the new CRC. A compressed value can't be patched.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_update_range(	gp_nvm_store_t *store,
+							uint32_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							const uint8_t* p_value);
+
+/**
+ * @brief      Reserve a new record for a stream, the record is marked free until the stream is committed.
+ *
+ * The sequence number of the record is taken here, so it is older than the records written while the
+ * stream is open.
+ *
+ * @param[in]     store   The attribute store.
+ * @param[inout]  hdr     The header of the record with the attribute ID and the length of the value, the
+ *                        capacity and the sequence number are set here.
+ * @param[out]    offset  Pointer were the offset of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_open(	gp_nvm_store_t *store,
+							gp_nvm_record_hdr_t *hdr,
+							uint32_t *offset);
+
+/**
+ * @brief      Commit a stream: write the attribute header of its record and point the index at it.
+ *
+ * The previous record of the attribute becomes free. The commit fails when the attribute got a newer
+ * record while the stream was open, the stream then has to be aborted.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record, with the CRC of the value.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute has a newer record)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_commit(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset);
+
+/**
+ * @brief      Abort a stream, its record is returned to the allocator.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_stream_abort(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset);
+
+/**
+ * @brief      Commit a batch: write its records to new extents, followed by the commit record.
+ *
+ * Records that are adjacent, like records at the end of the data region, are written with one update.
+ * Once the batch is committed, the previous records of the attributes become free, the batch flag of
+ * the records is cleared and the commit record becomes free.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  batch  The batch.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_commit(	gp_nvm_store_t *store,
+					gp_nvm_batch_t *batch);
+
+/**
+ * @brief      Delete an attribute: its record becomes free and the index entry is removed.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_delete(	gp_nvm_store_t *store,
+					uint32_t attr_id);
+
+/**
+ * @brief      Run one compaction step: shrink the data region by moving the records at its end into free extents.
+ *
+ * The free extent at the end of the data region is cut off, then the record that ends there is moved to the
+ * free extent that fits it best, until no free extent fits it or max_bytes were moved.
+ * Nothing is compacted while a stream is open.
+ *
+ * @param[in]  store      The attribute store.
+ * @param[in]  max_bytes  Maximum number of bytes to move, 0 moves until no free extent fits.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_compact(	gp_nvm_store_t *store,
+						uint32_t max_bytes);
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * The live bytes are the bytes of the records in the data region, the stale bytes the free bytes between them.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_heap_get_stats(	const gp_nvm_store_t *store,
+						gp_nvm_compact_stats_t *stats);
+
+/**
+ * @brief      Write a checkpoint of the index, the end of the data region and the free extents.
+ *
+ * The checkpoint is written as one record, the record of the previous checkpoint becomes free.
+ * Nothing is written when the newest checkpoint is still valid.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_heap_checkpoint(gp_nvm_store_t *store);
+
+#endif /* __GP_NVM_HEAP_H__ */
+
+/** @} */
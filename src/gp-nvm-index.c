@@ -0,0 +1,320 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-index.c
+ * \brief	Implementation of the in-RAM attribute index of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-index.h"
+
+// Uses following header(s)
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Control byte of an empty slot, used slots have the high bit set.
+ *
+ */
+#define GP_NVM_INDEX_CTRL_EMPTY 0x00
+
+/**
+ * @brief      Slots of a shared index that were replaced when the index grew.
+ *
+ */
+struct gp_nvm_index_retired {
+	struct gp_nvm_index_retired *next;
+	uint8_t *ctrl;
+	uint32_t *ids;
+	gp_nvm_index_entry_t *entries;
+};
+
+/**
+ * @brief      Hash an attribute ID (murmur3 finalizer).
+ *
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     The hash value.
+ */
+static inline uint32_t
+_gp_nvm_index_hash(uint32_t attr_id)
+{
+	uint32_t h = attr_id;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * @brief      Control byte for a hash: the high bit marks the slot as used, the low bits are a tag.
+ *
+ */
+static inline uint8_t
+_gp_nvm_index_ctrl(uint32_t hash)
+{
+	return 0x80 | (hash >> 25);
+}
+
+/**
+ * @brief      Search the slot of an attribute or the empty slot where it should be added.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  hash     The hash of the attribute identifier.
+ *
+ * @return     The slot number.
+ */
+static uint32_t
+_gp_nvm_index_probe(const gp_nvm_index_t *index, uint32_t attr_id, uint32_t hash)
+{
+	uint32_t mask = index->num_slots - 1;
+	uint8_t ctrl = _gp_nvm_index_ctrl(hash);
+	uint32_t slot = hash & mask;
+	// the index is never full, so the probe always ends at an empty slot,
+	// the bound only matters for a reader that races with a writer
+	for( uint32_t n = 0; n<index->num_slots && index->ctrl[slot] != GP_NVM_INDEX_CTRL_EMPTY; n++ ){
+		if( index->ctrl[slot] == ctrl && index->ids[slot] == attr_id ){
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/**
+ * @brief      Allocate the arrays of an index with num_slots slots.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+static int
+_gp_nvm_index_alloc(gp_nvm_index_t *index, uint32_t num_slots)
+{
+	index->ctrl = calloc(num_slots, sizeof(uint8_t));
+	index->ids = malloc(num_slots * sizeof(uint32_t));
+	index->entries = malloc(num_slots * sizeof(gp_nvm_index_entry_t));
+	if( index->ctrl == NULL || index->ids == NULL || index->entries == NULL ){
+		gp_nvm_index_deinit(index);
+		return 1;
+	}
+	index->num_slots = num_slots;
+	index->num_entries = 0;
+	return 0;
+}
+
+/**
+ * @brief      Double the number of slots and re-insert all entries.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory), the index is unchanged
+ */
+static int
+_gp_nvm_index_grow(gp_nvm_index_t *index)
+{
+	gp_nvm_index_t grown = { 0 };
+	gp_nvm_index_retired_t *retired = NULL;
+	if( index->shared && (retired = malloc(sizeof(gp_nvm_index_retired_t))) == NULL ){
+		return 1;
+	}
+	if( index->num_slots > UINT32_MAX / 2 || _gp_nvm_index_alloc(&grown, index->num_slots * 2) != 0 ){
+		free(retired);
+		return 1;
+	}
+	for( uint32_t i = 0; i<index->num_slots; i++ ){
+		if( index->ctrl[i] == GP_NVM_INDEX_CTRL_EMPTY ){
+			continue;
+		}
+		uint32_t hash = _gp_nvm_index_hash(index->ids[i]);
+		uint32_t slot = _gp_nvm_index_probe(&grown, index->ids[i], hash);
+		grown.ctrl[slot] = _gp_nvm_index_ctrl(hash);
+		grown.ids[slot] = index->ids[i];
+		grown.entries[slot] = index->entries[i];
+		grown.num_entries++;
+	}
+
+	// readers may still probe the old slots, keep them until the index is released
+	grown.shared = index->shared;
+	grown.retired = index->retired;
+	if( retired != NULL ){
+		retired->next = grown.retired;
+		retired->ctrl = index->ctrl;
+		retired->ids = index->ids;
+		retired->entries = index->entries;
+		grown.retired = retired;
+	} else {
+		free(index->ctrl);
+		free(index->ids);
+		free(index->entries);
+	}
+	*index = grown;
+	return 0;
+}
+
+/**
+ * @brief      Initialize an empty index.
+ *
+ * @param[out] index  The index.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_index_init(gp_nvm_index_t *index)
+{
+	memset(index, 0, sizeof(gp_nvm_index_t));
+	return _gp_nvm_index_alloc(index, GP_NVM_INDEX_MIN_SLOTS);
+}
+
+/**
+ * @brief      Initialize an empty index that can be searched by lock-free readers.
+ *
+ * @param[out] index  The index.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_index_init_shared(gp_nvm_index_t *index)
+{
+	if( gp_nvm_index_init(index) != 0 ){
+		return 1;
+	}
+	index->shared = 1;
+	return 0;
+}
+
+/**
+ * @brief      Release the memory of the index.
+ *
+ * @param[in]  index  The index.
+ */
+void
+gp_nvm_index_deinit(gp_nvm_index_t *index)
+{
+	while( index->retired != NULL ){
+		gp_nvm_index_retired_t *retired = index->retired;
+		index->retired = retired->next;
+		free(retired->ctrl);
+		free(retired->ids);
+		free(retired->entries);
+		free(retired);
+	}
+	free(index->ctrl);
+	free(index->ids);
+	free(index->entries);
+	memset(index, 0, sizeof(gp_nvm_index_t));
+}
+
+/**
+ * @brief      Search for an entry in the index based on the attribute ID.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     NULL: No entry was found.
+ * @return     gp_nvm_index_entry_t*: Pointer to the entry, valid until the next insert.
+ */
+gp_nvm_index_entry_t*
+gp_nvm_index_find(	const gp_nvm_index_t *index,
+					uint32_t attr_id)
+{
+	if( index->num_slots == 0 ){
+		return NULL;
+	}
+	uint32_t slot = _gp_nvm_index_probe(index, attr_id, _gp_nvm_index_hash(attr_id));
+	if( index->ctrl[slot] == GP_NVM_INDEX_CTRL_EMPTY || index->ids[slot] != attr_id ){
+		return NULL;
+	}
+	return &index->entries[slot];
+}
+
+/**
+ * @brief      Search for an entry in the index, adding a zeroed entry if none exists.
+ *
+ * The index grows when it becomes too full, which invalidates pointers to entries.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[out] added    Set to 1 if the entry was added, 0 if it existed.
+ *
+ * @return     NULL: The index could not grow (out of memory).
+ * @return     gp_nvm_index_entry_t*: Pointer to the entry, valid until the next insert.
+ */
+gp_nvm_index_entry_t*
+gp_nvm_index_insert(	gp_nvm_index_t *index,
+						uint32_t attr_id,
+						int *added)
+{
+	uint32_t hash = _gp_nvm_index_hash(attr_id);
+	uint32_t slot = _gp_nvm_index_probe(index, attr_id, hash);
+	*added = 0;
+	if( index->ctrl[slot] != GP_NVM_INDEX_CTRL_EMPTY ){
+		return &index->entries[slot];
+	}
+
+	// keep the load factor below 3/4 so probe sequences stay short
+	if( (index->num_entries + 1) * 4 > index->num_slots * 3 ){
+		if( _gp_nvm_index_grow(index) != 0 ){
+			return NULL;
+		}
+		slot = _gp_nvm_index_probe(index, attr_id, hash);
+	}
+
+	index->ctrl[slot] = _gp_nvm_index_ctrl(hash);
+	index->ids[slot] = attr_id;
+	memset(&index->entries[slot], 0, sizeof(gp_nvm_index_entry_t));
+	index->num_entries++;
+	*added = 1;
+	return &index->entries[slot];
+}
+
+/**
+ * @brief      Remove the entry of an attribute from the index.
+ *
+ * Entries that follow in the probe sequence are shifted back, so no tombstones are needed.
+ * This invalidates pointers to entries.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no entry was found)
+ */
+int
+gp_nvm_index_remove(	gp_nvm_index_t *index,
+						uint32_t attr_id)
+{
+	if( index->num_slots == 0 ){
+		return 1;
+	}
+	uint32_t mask = index->num_slots - 1;
+	uint32_t hole = _gp_nvm_index_probe(index, attr_id, _gp_nvm_index_hash(attr_id));
+	if( index->ctrl[hole] == GP_NVM_INDEX_CTRL_EMPTY ){
+		return 1;
+	}
+
+	// move entries back into the hole when the hole lies between their home slot and their slot
+	uint32_t slot = (hole + 1) & mask;
+	while( index->ctrl[slot] != GP_NVM_INDEX_CTRL_EMPTY ){
+		uint32_t home = _gp_nvm_index_hash(index->ids[slot]) & mask;
+		if( ((slot - home) & mask) >= ((slot - hole) & mask) ){
+			index->ctrl[hole] = index->ctrl[slot];
+			index->ids[hole] = index->ids[slot];
+			index->entries[hole] = index->entries[slot];
+			hole = slot;
+		}
+		slot = (slot + 1) & mask;
+	}
+	index->ctrl[hole] = GP_NVM_INDEX_CTRL_EMPTY;
+	index->num_entries--;
+	return 0;
+}
+
+/** @} */
@@ -0,0 +1,148 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-index.h
+ * \brief	Header file for the in-RAM attribute index of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The index is an open-addressing hash table with linear probing.
+ * It is laid out as a struct-of-arrays: a probe only touches the control bytes
+ * (a 7-bit hash tag per slot) and the attribute IDs, the entry metadata is only
+ * read once the slot of the attribute is found.
+ *
+ * A shared index can be searched by lock-free readers while a writer changes it. When a shared index
+ * grows, the old slots are kept until the index is released, so a reader that still uses them never
+ * touches freed memory. Such a reader has to detect the concurrent change itself, see gp-nvm-sync.h.
+ */
+
+#ifndef __GP_NVM_INDEX_H__
+#define __GP_NVM_INDEX_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief      Minimum number of slots in the index, must be a power of two.
+ *
+ */
+#define GP_NVM_INDEX_MIN_SLOTS 16
+
+/**
+ * @brief      Index entry.
+ *
+ * This structure contains the offset of the attribute record in NVM, the length of the value,
+ * the capacity of the record, the sequence number of the record, the CRC of the value and its codec.
+ * The length and the CRC are those of the value as it is stored, so of the compressed value when
+ * the codec isn't GP_NVM_CODEC_NONE.
+ */
+typedef struct gp_nvm_index_entry {
+	uint32_t offset;
+	uint32_t len;
+	uint32_t capacity;
+	uint32_t seq;
+	uint32_t crc;
+	uint32_t codec;
+} gp_nvm_index_entry_t;
+
+/**
+ * @brief      Slots of a shared index that were replaced when the index grew.
+ *
+ */
+typedef struct gp_nvm_index_retired gp_nvm_index_retired_t;
+
+/**
+ * @brief      Attribute index.
+ *
+ */
+typedef struct gp_nvm_index {
+	uint32_t num_slots;
+	uint32_t num_entries;
+	uint8_t *ctrl;
+	uint32_t *ids;
+	gp_nvm_index_entry_t *entries;
+	int shared;
+	gp_nvm_index_retired_t *retired;
+} gp_nvm_index_t;
+
+/**
+ * @brief      Initialize an empty index.
+ *
+ * @param[out] index  The index.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_index_init(gp_nvm_index_t *index);
+
+/**
+ * @brief      Initialize an empty index that can be searched by lock-free readers.
+ *
+ * @param[out] index  The index.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+int
+gp_nvm_index_init_shared(gp_nvm_index_t *index);
+
+/**
+ * @brief      Release the memory of the index.
+ *
+ * @param[in]  index  The index.
+ */
+void
+gp_nvm_index_deinit(gp_nvm_index_t *index);
+
+/**
+ * @brief      Search for an entry in the index based on the attribute ID.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     NULL: No entry was found.
+ * @return     gp_nvm_index_entry_t*: Pointer to the entry, valid until the next insert.
+ */
+gp_nvm_index_entry_t*
+gp_nvm_index_find(	const gp_nvm_index_t *index,
+					uint32_t attr_id);
+
+/**
+ * @brief      Search for an entry in the index, adding a zeroed entry if none exists.
+ *
+ * The index grows when it becomes too full, which invalidates pointers to entries.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[out] added    Set to 1 if the entry was added, 0 if it existed.
+ *
+ * @return     NULL: The index could not grow (out of memory).
+ * @return     gp_nvm_index_entry_t*: Pointer to the entry, valid until the next insert.
+ */
+gp_nvm_index_entry_t*
+gp_nvm_index_insert(	gp_nvm_index_t *index,
+						uint32_t attr_id,
+						int *added);
+
+/**
+ * @brief      Remove the entry of an attribute from the index.
+ *
+ * Entries that follow in the probe sequence are shifted back, so no tombstones are needed.
+ * This invalidates pointers to entries.
+ *
+ * @param[in]  index    The index.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (no entry was found)
+ */
+int
+gp_nvm_index_remove(	gp_nvm_index_t *index,
+						uint32_t attr_id);
+
+#endif /* __GP_NVM_INDEX_H__ */
+
+/** @} */
@@ -0,0 +1,1338 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-log.c
+ * \brief	Implementation of the log-structured storage engine of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-log.h"
+
+// Uses following header(s)
+#include "gp-nvm-checkpoint.h"
+#include "gp-nvm-stats.h"
+#include "nvm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Magic number at the start of a used segment ("SEGM").
+ *
+ */
+#define GP_NVM_LOG_SEGMENT_MAGIC 0x4d474553
+
+/**
+ * @brief      Marks that no segment is being compacted.
+ *
+ */
+#define GP_NVM_LOG_NO_SEGMENT UINT32_MAX
+
+/**
+ * @brief      Segment header.
+ *
+ * The sequence number is the sequence number of the store when the segment was opened.
+ * The CRC covers the magic number and the sequence number.
+ */
+typedef struct gp_nvm_log_segment_hdr {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t crc;
+} gp_nvm_log_segment_hdr_t;
+
+/**
+ * @brief      Offset of the start of a segment.
+ *
+ */
+static inline uint32_t
+_gp_nvm_log_segment_base(const gp_nvm_log_t *log, uint32_t seg)
+{
+	return (seg + 1) * log->segment_size;
+}
+
+/**
+ * @brief      Segment that contains offset.
+ *
+ */
+static inline uint32_t
+_gp_nvm_log_segment_of(const gp_nvm_log_t *log, uint32_t offset)
+{
+	return offset / log->segment_size - 1;
+}
+
+/**
+ * @brief      Make sure the segment arrays can hold num_segments segments, new segments are free.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+static int
+_gp_nvm_log_reserve(gp_nvm_log_t *log, uint32_t num_segments)
+{
+	if( num_segments <= log->num_segments ){
+		return 0;
+	}
+	uint32_t *seg_live = realloc(log->seg_live, num_segments * sizeof(uint32_t));
+	if( seg_live == NULL ){
+		return 1;
+	}
+	log->seg_live = seg_live;
+	uint32_t *seg_fill = realloc(log->seg_fill, num_segments * sizeof(uint32_t));
+	if( seg_fill == NULL ){
+		return 1;
+	}
+	log->seg_fill = seg_fill;
+	uint32_t *seg_seq = realloc(log->seg_seq, num_segments * sizeof(uint32_t));
+	if( seg_seq == NULL ){
+		return 1;
+	}
+	log->seg_seq = seg_seq;
+	uint8_t *seg_used = realloc(log->seg_used, num_segments * sizeof(uint8_t));
+	if( seg_used == NULL ){
+		return 1;
+	}
+	log->seg_used = seg_used;
+	memset(&log->seg_live[log->num_segments], 0, (num_segments - log->num_segments) * sizeof(uint32_t));
+	memset(&log->seg_fill[log->num_segments], 0, (num_segments - log->num_segments) * sizeof(uint32_t));
+	memset(&log->seg_seq[log->num_segments], 0, (num_segments - log->num_segments) * sizeof(uint32_t));
+	memset(&log->seg_used[log->num_segments], 0, (num_segments - log->num_segments) * sizeof(uint8_t));
+	log->free_segments += num_segments - log->num_segments;
+	log->num_segments = num_segments;
+	return 0;
+}
+
+/**
+ * @brief      Account for a record of size bytes at offset that fills its segment.
+ *
+ */
+static inline void
+_gp_nvm_log_fill(gp_nvm_log_t *log, uint32_t offset, uint32_t size)
+{
+	log->seg_fill[_gp_nvm_log_segment_of(log, offset)] += size;
+	log->fill_bytes += size;
+}
+
+/**
+ * @brief      Make the record at offset of size bytes stale.
+ *
+ */
+static inline void
+_gp_nvm_log_unlive(gp_nvm_log_t *log, uint32_t offset, uint32_t size)
+{
+	log->seg_live[_gp_nvm_log_segment_of(log, offset)] -= size;
+	log->live_bytes -= size;
+}
+
+/**
+ * @brief      Drop the tombstone of an attribute, its delete record becomes stale.
+ *
+ */
+static void
+_gp_nvm_log_drop_tombstone(gp_nvm_log_t *log, uint32_t attr_id, const gp_nvm_index_entry_t *tombstone)
+{
+	_gp_nvm_log_unlive(log, tombstone->offset, GP_NVM_RECORD_SIZE(tombstone->capacity));
+	gp_nvm_index_remove(&log->tombstones, attr_id);
+}
+
+/**
+ * @brief      Point the index at the record at offset, the previous record of the attribute becomes stale.
+ *
+ * A record that is older than the tombstone of its attribute is stale right away, a newer record makes the
+ * tombstone stale.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record.
+ * @param[in]  offset  The offset of the record in NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_log_apply(gp_nvm_store_t *store, const gp_nvm_record_hdr_t *hdr, uint32_t offset)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t size = GP_NVM_RECORD_SIZE(hdr->capacity);
+	int added;
+
+	_gp_nvm_log_fill(log, offset, size);
+	gp_nvm_index_entry_t* tombstone = gp_nvm_index_find(&log->tombstones, hdr->attr_id);
+	if( tombstone != NULL ){
+		if( tombstone->seq > hdr->seq ){
+			return GP_NVM_SUCCESS;
+		}
+		_gp_nvm_log_drop_tombstone(log, hdr->attr_id, tombstone);
+	}
+	gp_nvm_index_entry_t* attr = gp_nvm_index_insert(&store->index, hdr->attr_id, &added);
+	if( attr == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	if( !added ){
+		// a newer record was already found during the scan
+		if( attr->seq > hdr->seq ){
+			return GP_NVM_SUCCESS;
+		}
+		_gp_nvm_log_unlive(log, attr->offset, GP_NVM_RECORD_SIZE(attr->capacity));
+	}
+	attr->offset = offset;
+	attr->len = hdr->len;
+	attr->capacity = hdr->capacity;
+	attr->seq = hdr->seq;
+	attr->crc = hdr->crc;
+	attr->codec = GP_NVM_RECORD_CODEC(hdr->flags);
+	log->seg_live[_gp_nvm_log_segment_of(log, offset)] += size;
+	log->live_bytes += size;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Delete the attribute of the delete record at offset, the record becomes its tombstone.
+ *
+ * The delete record is stale right away when the attribute has a newer record or a newer tombstone.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the delete record.
+ * @param[in]  offset  The offset of the delete record in NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_log_apply_delete(gp_nvm_store_t *store, const gp_nvm_record_hdr_t *hdr, uint32_t offset)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t size = GP_NVM_RECORD_SIZE(hdr->capacity);
+	int added;
+
+	_gp_nvm_log_fill(log, offset, size);
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, hdr->attr_id);
+	if( attr != NULL ){
+		if( attr->seq > hdr->seq ){
+			return GP_NVM_SUCCESS;
+		}
+		_gp_nvm_log_unlive(log, attr->offset, GP_NVM_RECORD_SIZE(attr->capacity));
+		gp_nvm_index_remove(&store->index, hdr->attr_id);
+	}
+	gp_nvm_index_entry_t* tombstone = gp_nvm_index_insert(&log->tombstones, hdr->attr_id, &added);
+	if( tombstone == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	if( !added ){
+		if( tombstone->seq > hdr->seq ){
+			return GP_NVM_SUCCESS;
+		}
+		_gp_nvm_log_unlive(log, tombstone->offset, GP_NVM_RECORD_SIZE(tombstone->capacity));
+	}
+	tombstone->offset = offset;
+	tombstone->capacity = hdr->capacity;
+	tombstone->seq = hdr->seq;
+	log->seg_live[_gp_nvm_log_segment_of(log, offset)] += size;
+	log->live_bytes += size;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Open a free segment (or a new one at the end of the NVM) as the tail of the log.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_open_segment(gp_nvm_store_t *store)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t seg = 0;
+	while( seg < log->num_segments && log->seg_used[seg] ){
+		seg++;
+	}
+	if( seg == log->num_segments ){
+		if( _gp_nvm_log_segment_base(log, seg + 1) < _gp_nvm_log_segment_base(log, seg) ||
+			_gp_nvm_log_reserve(log, seg + 1) != 0 ){
+			return GP_NVM_MEM_FULL;
+		}
+	}
+
+	gp_nvm_log_segment_hdr_t seg_hdr = { GP_NVM_LOG_SEGMENT_MAGIC, store->seq, 0 };
+	seg_hdr.crc = gp_nvm_crc32c(0, &seg_hdr, offsetof(gp_nvm_log_segment_hdr_t, crc));
+	if( nvm_dev_update(store->dev, _gp_nvm_log_segment_base(log, seg), sizeof(seg_hdr), &seg_hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	log->device_bytes += sizeof(seg_hdr);
+	log->seg_used[seg] = 1;
+	log->seg_live[seg] = 0;
+	log->seg_fill[seg] = 0;
+	log->seg_seq[seg] = store->seq;
+	log->free_segments--;
+	log->tail = seg;
+	log->tail_offset = _gp_nvm_log_segment_base(log, seg) + sizeof(seg_hdr);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Make sure there are size bytes left in the tail segment, opening a new tail if needed.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_reserve_tail(gp_nvm_store_t *store, uint64_t size)
+{
+	gp_nvm_log_t *log = &store->log;
+	if( size > log->segment_size - sizeof(gp_nvm_log_segment_hdr_t) ){
+		return GP_NVM_MEM_FULL;
+	}
+	if( log->tail == GP_NVM_LOG_NO_SEGMENT ||
+		log->tail_offset + size > _gp_nvm_log_segment_base(log, log->tail) + log->segment_size ){
+		return _gp_nvm_log_open_segment(store);
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Append a record to the tail of the log and point the index at it.
+ *
+ * The CRC and the codec of the value are passed in, so a relocated record keeps the CRC it was written with.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_append(gp_nvm_store_t *store, uint32_t attr_id, uint32_t length, const uint8_t* p_value, uint32_t crc, uint32_t codec)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t size = GP_NVM_RECORD_SIZE(length);
+	gp_nvm_result_t result = _gp_nvm_log_reserve_tail(store, size);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_ATTR,
+		.flags = codec << GP_NVM_RECORD_CODEC_SHIFT,
+		.attr_id = attr_id,
+		.len = length,
+		.capacity = length,
+		.seq = store->seq + 1,
+		.crc = crc,
+	};
+	if( gp_nvm_store_write_record(store, log->tail_offset, &hdr, p_value) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	store->seq++;
+	log->device_bytes += size;
+
+	result = _gp_nvm_log_apply(store, &hdr, log->tail_offset);
+	log->tail_offset += size;
+	return result;
+}
+
+/**
+ * @brief      Append a delete record for an attribute to the tail of the log and make it the tombstone of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_append_delete(gp_nvm_store_t *store, uint32_t attr_id)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t size = GP_NVM_RECORD_SIZE(0);
+	gp_nvm_result_t result = _gp_nvm_log_reserve_tail(store, size);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_DELETE,
+		.attr_id = attr_id,
+		.seq = store->seq + 1,
+	};
+	if( gp_nvm_store_write_record(store, log->tail_offset, &hdr, NULL) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	store->seq++;
+	log->device_bytes += size;
+
+	result = _gp_nvm_log_apply_delete(store, &hdr, log->tail_offset);
+	log->tail_offset += size;
+	return result;
+}
+
+/**
+ * @brief      Check if a tombstone is still needed, because a segment other than its own may hold an older record of its attribute.
+ *
+ * Only a segment that was opened before the delete record was written can hold older records. A tombstone
+ * that is newer than the newest checkpoint is needed until the next checkpoint, the index of the checkpoint
+ * may still hold the attribute and a reopen would bring it back.
+ *
+ */
+static int
+_gp_nvm_log_tombstone_needed(const gp_nvm_store_t *store, uint32_t seg, uint32_t seq)
+{
+	const gp_nvm_log_t *log = &store->log;
+	if( store->ckpt.num_chunks > 0 && seq > log->ckpt_seq ){
+		return 1;
+	}
+	for( uint32_t i = 0; i<log->num_segments; i++ ){
+		if( i != seg && log->seg_used[i] && log->seg_seq[i] < seq ){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Check if a segment holds a record of the newest checkpoint.
+ *
+ */
+static int
+_gp_nvm_log_holds_checkpoint(const gp_nvm_store_t *store, uint32_t seg)
+{
+	for( uint32_t i = 0; i<store->ckpt.num_chunks; i++ ){
+		if( _gp_nvm_log_segment_of(&store->log, store->ckpt.chunks[i]) == seg ){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Select the segment with the least live bytes among the segments that have stale bytes.
+ *
+ * Segments that hold the newest checkpoint are kept until the next checkpoint.
+ *
+ * @return     The segment number or GP_NVM_LOG_NO_SEGMENT when there is nothing to compact.
+ */
+static uint32_t
+_gp_nvm_log_select_victim(const gp_nvm_store_t *store)
+{
+	const gp_nvm_log_t *log = &store->log;
+	uint32_t victim = GP_NVM_LOG_NO_SEGMENT;
+	uint32_t min_live = UINT32_MAX;
+	for( uint32_t seg = 0; seg<log->num_segments; seg++ ){
+		if( log->seg_used[seg] && seg != log->tail && log->seg_live[seg] < log->seg_fill[seg] && log->seg_live[seg] < min_live &&
+			!_gp_nvm_log_holds_checkpoint(store, seg) ){
+			victim = seg;
+			min_live = log->seg_live[seg];
+		}
+	}
+	return victim;
+}
+
+/**
+ * @brief      Erase the header of a segment that holds no live records anymore, so it can be reused.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_erase_segment(gp_nvm_store_t *store, uint32_t seg)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_log_segment_hdr_t seg_hdr = { 0, 0, 0 };
+	if( nvm_dev_update(store->dev, _gp_nvm_log_segment_base(log, seg), sizeof(seg_hdr), &seg_hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	log->device_bytes += sizeof(seg_hdr);
+	log->compact_bytes += sizeof(seg_hdr);
+	log->reclaimed_bytes += log->seg_fill[seg];
+	log->fill_bytes -= log->seg_fill[seg];
+	log->seg_used[seg] = 0;
+	log->seg_live[seg] = 0;
+	log->seg_fill[seg] = 0;
+	log->free_segments++;
+	log->segments_reclaimed++;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Initialize the state of the log engine without segments.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory)
+ */
+static int
+_gp_nvm_log_init(gp_nvm_log_t *log, uint32_t segment_size, uint32_t compact_threshold)
+{
+	memset(log, 0, sizeof(gp_nvm_log_t));
+	log->segment_size = segment_size;
+	log->compact_threshold = compact_threshold ? compact_threshold : GP_NVM_LOG_DEFAULT_COMPACT_THRESHOLD;
+	log->tail = GP_NVM_LOG_NO_SEGMENT;
+	log->compact_seg = GP_NVM_LOG_NO_SEGMENT;
+	return gp_nvm_index_init(&log->tombstones);
+}
+
+/**
+ * @brief      Scan the records of a segment from offset, as long as their sequence numbers keep increasing.
+ *
+ * @param[in]     store     The attribute store.
+ * @param[in]     seg       The segment.
+ * @param[inout]  offset    The offset to start at, set to the offset after the last valid record.
+ * @param[inout]  last_seq  The sequence number the records have to exceed, set to the one of the last valid record.
+ * @param[in]     recovery  The batch records and commit records are added to it.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_log_scan(	gp_nvm_store_t *store,
+					uint32_t seg,
+					uint32_t *offset,
+					uint32_t *last_seq,
+					gp_nvm_batch_recovery_t *recovery)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t seg_end = _gp_nvm_log_segment_base(log, seg) + log->segment_size;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	gp_nvm_record_hdr_t hdr;
+
+	while( *offset + sizeof(hdr) <= seg_end &&
+			gp_nvm_store_read_hdr(store, *offset, &hdr) == 0 &&
+			hdr.seq > *last_seq &&
+			hdr.len <= hdr.capacity &&
+			*offset + GP_NVM_RECORD_SIZE(hdr.capacity) <= seg_end ){
+		if( hdr.type == GP_NVM_RECORD_COMMIT || (hdr.flags & GP_NVM_RECORD_FLAG_BATCH) ){
+			// batch records are applied once all commit records are known
+			if( gp_nvm_batch_recovery_add(recovery, *offset, &hdr) != 0 ){
+				result = GP_NVM_MEM_FULL;
+			}
+		} else if( hdr.type == GP_NVM_RECORD_ATTR ){
+			result = _gp_nvm_log_apply(store, &hdr, *offset);
+		} else if( hdr.type == GP_NVM_RECORD_DELETE ){
+			result = _gp_nvm_log_apply_delete(store, &hdr, *offset);
+		} else if( hdr.type == GP_NVM_RECORD_CHECKPOINT || hdr.type == GP_NVM_RECORD_FREE ){
+			// a free record is the reserved record of a stream that wasn't committed
+			_gp_nvm_log_fill(log, *offset, GP_NVM_RECORD_SIZE(hdr.capacity));
+		}
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+		*last_seq = hdr.seq;
+		*offset += GP_NVM_RECORD_SIZE(hdr.capacity);
+	}
+	if( *last_seq > store->seq ){
+		store->seq = *last_seq;
+	}
+	return result;
+}
+
+/**
+ * @brief      Apply the records of committed batches, the other batch records and the commit records are stale.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_log_recover(gp_nvm_store_t *store, gp_nvm_batch_recovery_t *recovery)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	for( uint32_t i = 0; i<recovery->num_pending && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_batch_record_t *record = &recovery->pending[i];
+		if( gp_nvm_batch_recovery_committed(recovery, record->hdr.seq) ){
+			result = _gp_nvm_log_apply(store, &record->hdr, record->offset);
+		} else {
+			_gp_nvm_log_fill(log, record->offset, GP_NVM_RECORD_SIZE(record->hdr.capacity));
+		}
+	}
+	for( uint32_t i = 0; i<recovery->num_commits; i++ ){
+		_gp_nvm_log_fill(log, recovery->commits[i].offset, GP_NVM_RECORD_SIZE(recovery->commits[i].hdr.capacity));
+	}
+	return result;
+}
+
+/**
+ * @brief      Read a segment header.
+ *
+ * @return     0: SUCCESS (a used segment)
+ * @return     1: ERROR (a free segment)
+ * @return     2: ERROR (beyond the end of the NVM)
+ */
+static int
+_gp_nvm_log_read_segment(const gp_nvm_store_t *store, uint32_t seg, gp_nvm_log_segment_hdr_t *seg_hdr)
+{
+	const gp_nvm_log_t *log = &store->log;
+	uint32_t base = _gp_nvm_log_segment_base(log, seg);
+	uint32_t size = nvm_dev_size(store->dev);
+	// the segments end where the NVM ends, compare before reading so that isn't reported as a device error
+	if( base < log->segment_size || size < sizeof(*seg_hdr) || base > size - sizeof(*seg_hdr) ||
+		gp_nvm_store_read(store, base, sizeof(*seg_hdr), seg_hdr) != 0 ){
+		return 2;
+	}
+	if( seg_hdr->magic != GP_NVM_LOG_SEGMENT_MAGIC ){
+		return 1;
+	}
+	if( seg_hdr->crc != gp_nvm_crc32c(0, seg_hdr, offsetof(gp_nvm_log_segment_hdr_t, crc)) ){
+		// the sequence number can't be trusted, so neither can the records
+		fprintf(stderr, "GP-NVM: CRC error in header of segment %u, treating it as free\n", seg);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Remove the entries of an index whose record is in a segment.
+ *
+ * A removal shifts the entries that follow back, so the slot is checked again.
+ *
+ */
+static void
+_gp_nvm_log_forget_segment(const gp_nvm_log_t *log, gp_nvm_index_t *index, uint32_t seg)
+{
+	for( uint32_t i = 0; i<index->num_slots; ){
+		if( index->ctrl[i] != 0 && _gp_nvm_log_segment_of(log, index->entries[i].offset) == seg ){
+			gp_nvm_index_remove(index, index->ids[i]);
+		} else {
+			i++;
+		}
+	}
+}
+
+/**
+ * @brief      Load the index and the segment state from the newest checkpoint and replay the records written after it.
+ *
+ * Records are replayed from the end of the tail at the time of the checkpoint and from the start of every
+ * segment that was opened after it. Segments that were erased after the checkpoint become free, the index
+ * entries and tombstones of the checkpoint in them are dropped before the segment is replayed.
+ * The live bytes are counted again from the index afterwards.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no valid checkpoint)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_log_restore(gp_nvm_store_t *store)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_checkpoint_buf_t buf;
+	gp_nvm_batch_recovery_t recovery = { 0 };
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	if( gp_nvm_checkpoint_read(store, &buf) != 0 ){
+		return GP_NVM_FAIL;
+	}
+	int error = gp_nvm_checkpoint_get_index(store, &buf);
+	uint32_t ckpt_seq = store->seq;
+	uint32_t num_segments = gp_nvm_checkpoint_get(&buf);
+	uint32_t ckpt_tail = gp_nvm_checkpoint_get(&buf);
+	uint32_t ckpt_tail_offset = gp_nvm_checkpoint_get(&buf);
+	error |= buf.error || (uint64_t) num_segments * 3 * sizeof(uint32_t) > buf.len - buf.pos ||
+		_gp_nvm_log_reserve(log, num_segments) != 0;
+	for( uint32_t seg = 0; seg<num_segments && !error; seg++ ){
+		log->seg_used[seg] = gp_nvm_checkpoint_get(&buf) != 0;
+		log->seg_seq[seg] = gp_nvm_checkpoint_get(&buf);
+		log->seg_fill[seg] = gp_nvm_checkpoint_get(&buf);
+		log->free_segments -= log->seg_used[seg];
+	}
+	uint32_t num_tombstones = gp_nvm_checkpoint_get(&buf);
+	error |= buf.error || (uint64_t) num_tombstones * 3 * sizeof(uint32_t) != buf.len - buf.pos;
+	for( uint32_t i = 0; i<num_tombstones && !error; i++ ){
+		int added;
+		uint32_t attr_id = gp_nvm_checkpoint_get(&buf);
+		gp_nvm_index_entry_t *tombstone = gp_nvm_index_insert(&log->tombstones, attr_id, &added);
+		error = tombstone == NULL || !added;
+		if( !error ){
+			tombstone->offset = gp_nvm_checkpoint_get(&buf);
+			tombstone->capacity = 0;
+			tombstone->seq = gp_nvm_checkpoint_get(&buf);
+			error = tombstone->offset < log->segment_size || _gp_nvm_log_segment_of(log, tombstone->offset) >= num_segments ||
+				!log->seg_used[_gp_nvm_log_segment_of(log, tombstone->offset)];
+		}
+	}
+	error |= buf.error || buf.pos != buf.len;
+	gp_nvm_checkpoint_buf_deinit(&buf);
+
+	// the index may only point into segments that were used
+	const gp_nvm_index_t *index = &store->index;
+	for( uint32_t i = 0; i<index->num_slots && !error; i++ ){
+		uint32_t offset = index->entries[i].offset;
+		error = index->ctrl[i] != 0 &&
+			(offset < log->segment_size || _gp_nvm_log_segment_of(log, offset) >= num_segments ||
+			!log->seg_used[_gp_nvm_log_segment_of(log, offset)]);
+	}
+	if( ckpt_tail != GP_NVM_LOG_NO_SEGMENT ){
+		error |= ckpt_tail >= num_segments || !log->seg_used[ckpt_tail] ||
+			ckpt_tail_offset < _gp_nvm_log_segment_base(log, ckpt_tail) ||
+			ckpt_tail_offset > _gp_nvm_log_segment_base(log, ckpt_tail) + log->segment_size;
+	}
+
+	uint32_t tail_seq = 0;
+	uint32_t seg = 0;
+	for( ; !error && result == GP_NVM_SUCCESS; seg++ ){
+		gp_nvm_log_segment_hdr_t seg_hdr;
+		int status = _gp_nvm_log_read_segment(store, seg, &seg_hdr);
+		if( status == 2 ){
+			break;
+		}
+		if( _gp_nvm_log_reserve(log, seg + 1) != 0 ){
+			result = GP_NVM_MEM_FULL;
+			break;
+		}
+		uint32_t offset = _gp_nvm_log_segment_base(log, seg) + sizeof(seg_hdr);
+		uint32_t last_seq = seg_hdr.seq;
+		if( seg < num_segments && log->seg_used[seg] ){
+			if( status == 0 && seg_hdr.seq == log->seg_seq[seg] ){
+				// only the tail was written after the checkpoint
+				if( seg != ckpt_tail ){
+					continue;
+				}
+				offset = ckpt_tail_offset;
+				last_seq = ckpt_seq;
+			} else {
+				// erased after the checkpoint, and maybe opened again: its records in the checkpoint are gone,
+				// those that were relocated are replayed from the segment they were moved to
+				_gp_nvm_log_forget_segment(log, &store->index, seg);
+				_gp_nvm_log_forget_segment(log, &log->tombstones, seg);
+				log->seg_used[seg] = 0;
+				log->seg_fill[seg] = 0;
+				log->free_segments++;
+			}
+		}
+		if( !log->seg_used[seg] ){
+			if( status != 0 ){
+				continue;
+			}
+			log->seg_used[seg] = 1;
+			log->seg_seq[seg] = seg_hdr.seq;
+			log->free_segments--;
+		}
+		result = _gp_nvm_log_scan(store, seg, &offset, &last_seq, &recovery);
+
+		// the most recently opened segment is the tail
+		if( log->tail == GP_NVM_LOG_NO_SEGMENT || seg_hdr.seq >= tail_seq ){
+			log->tail = seg;
+			log->tail_offset = offset;
+			tail_seq = seg_hdr.seq;
+		}
+	}
+	// the segments that were used can't be beyond the end of the NVM
+	for( ; seg<num_segments && !error; seg++ ){
+		error = log->seg_used[seg];
+	}
+	if( !error && result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_log_recover(store, &recovery);
+	}
+	gp_nvm_batch_recovery_deinit(&recovery);
+
+	// count the live bytes of the index, every record has to be in a used segment
+	memset(log->seg_live, 0, log->num_segments * sizeof(uint32_t));
+	log->live_bytes = 0;
+	for( uint32_t i = 0; i<index->num_slots && !error; i++ ){
+		if( index->ctrl[i] != 0 ){
+			const gp_nvm_index_entry_t *entry = &index->entries[i];
+			uint32_t entry_seg = _gp_nvm_log_segment_of(log, entry->offset);
+			error = entry_seg >= log->num_segments || !log->seg_used[entry_seg];
+			if( !error ){
+				log->seg_live[entry_seg] += GP_NVM_RECORD_SIZE(entry->capacity);
+				log->live_bytes += GP_NVM_RECORD_SIZE(entry->capacity);
+			}
+		}
+	}
+	for( uint32_t i = 0; i<log->tombstones.num_slots && !error; i++ ){
+		if( log->tombstones.ctrl[i] != 0 ){
+			uint32_t entry_seg = _gp_nvm_log_segment_of(log, log->tombstones.entries[i].offset);
+			error = entry_seg >= log->num_segments || !log->seg_used[entry_seg];
+			if( !error ){
+				log->seg_live[entry_seg] += GP_NVM_RECORD_SIZE(0);
+				log->live_bytes += GP_NVM_RECORD_SIZE(0);
+			}
+		}
+	}
+	log->fill_bytes = 0;
+	for( uint32_t i = 0; i<log->num_segments; i++ ){
+		log->fill_bytes += log->seg_used[i] ? log->seg_fill[i] : 0;
+	}
+	if( !error && result == GP_NVM_SUCCESS ){
+		// the checkpoint is still valid when only its own records were written after it
+		store->ckpt.valid = store->seq == ckpt_seq + store->ckpt.num_chunks;
+		log->ckpt_seq = ckpt_seq;
+		return GP_NVM_SUCCESS;
+	}
+
+	fprintf(stderr, "GP-NVM: invalid checkpoint, scanning all segments\n");
+	gp_nvm_checkpoint_reset(store);
+	gp_nvm_index_deinit(&store->index);
+	gp_nvm_log_close(store);
+	store->seq = 0;
+	if( gp_nvm_index_init_shared(&store->index) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	return result == GP_NVM_MEM_FULL ? GP_NVM_MEM_FULL : GP_NVM_FAIL;
+}
+
+/**
+ * @brief      Open the log engine and load the index from the newest checkpoint or rebuild it by scanning all segments.
+ *
+ * @param[in]  store              The attribute store.
+ * @param[in]  segment_size       The segment size from the superblock.
+ * @param[in]  compact_threshold  The compaction threshold, 0 selects the default.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_log_open(	gp_nvm_store_t *store,
+					uint32_t segment_size,
+					uint32_t compact_threshold)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_batch_recovery_t recovery = { 0 };
+	gp_nvm_result_t result;
+	uint32_t tail_seq = 0;
+
+	if( _gp_nvm_log_init(log, segment_size, compact_threshold) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	result = _gp_nvm_log_restore(store);
+	if( result != GP_NVM_FAIL ){
+		return result;
+	}
+	// the restore released the segment state, but not when there was no checkpoint
+	gp_nvm_index_deinit(&log->tombstones);
+	if( _gp_nvm_log_init(log, segment_size, compact_threshold) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+	result = GP_NVM_SUCCESS;
+
+	for( uint32_t seg = 0; ; seg++ ){
+		gp_nvm_log_segment_hdr_t seg_hdr;
+		int status = _gp_nvm_log_read_segment(store, seg, &seg_hdr);
+		if( status == 2 ){
+			break;
+		}
+		if( _gp_nvm_log_reserve(log, seg + 1) != 0 ){
+			result = GP_NVM_MEM_FULL;
+			break;
+		}
+		if( status != 0 ){
+			continue;
+		}
+		log->seg_used[seg] = 1;
+		log->seg_seq[seg] = seg_hdr.seq;
+		log->free_segments--;
+
+		// records are valid as long as their sequence numbers keep increasing
+		uint32_t last_seq = seg_hdr.seq;
+		uint32_t offset = _gp_nvm_log_segment_base(log, seg) + sizeof(seg_hdr);
+		result = _gp_nvm_log_scan(store, seg, &offset, &last_seq, &recovery);
+
+		// the most recently opened segment is the tail
+		if( log->tail == GP_NVM_LOG_NO_SEGMENT || seg_hdr.seq >= tail_seq ){
+			log->tail = seg;
+			log->tail_offset = offset;
+			tail_seq = seg_hdr.seq;
+		}
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+	}
+
+	// records of a batch without commit record are stale, just like the commit records themselves
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_log_recover(store, &recovery);
+	}
+	gp_nvm_batch_recovery_deinit(&recovery);
+	return result;
+}
+
+/**
+ * @brief      Release the memory of the log engine.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_log_close(gp_nvm_store_t *store)
+{
+	free(store->log.seg_live);
+	free(store->log.seg_fill);
+	free(store->log.seg_seq);
+	free(store->log.seg_used);
+	gp_nvm_index_deinit(&store->log.tombstones);
+	memset(&store->log, 0, sizeof(gp_nvm_log_t));
+}
+
+/**
+ * @brief      Run a compaction step when there are no free segments and too many stale bytes.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_log_auto_compact(gp_nvm_store_t *store)
+{
+	gp_nvm_log_t *log = &store->log;
+	// reclaim stale records in the background of the write path, one segment at a time
+	if( log->free_segments == 0 && (log->fill_bytes - log->live_bytes) * 100 > log->live_bytes * log->compact_threshold ){
+		return gp_nvm_log_compact(store, log->segment_size);
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Append a new record for an attribute and point the index at it.
+ *
+ * When there are no free segments and too many stale bytes, a compaction step is run afterwards.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value as it is stored.
+ * @param[in]  p_value  Pointer to the value in RAM, compressed with codec.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_set(	gp_nvm_store_t *store,
+				uint32_t attr_id,
+				uint32_t length,
+				const uint8_t* p_value,
+				uint32_t codec)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_result_t result = _gp_nvm_log_append(store, attr_id, length, p_value, gp_nvm_crc32c(0, p_value, length), codec);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	log->user_bytes += length;
+	return _gp_nvm_log_auto_compact(store);
+}
+
+/**
+ * @brief      Commit a batch: append its records and the commit record to the tail segment.
+ *
+ * All records of a batch are written to the same segment, so the commit record is erased together with them.
+ * The records are adjacent and written with one update, followed by the commit record.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  batch  The batch.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL (also when the batch doesn't fit in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_commit(	gp_nvm_store_t *store,
+					gp_nvm_batch_t *batch)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t n = batch->num_entries;
+	uint64_t size = GP_NVM_RECORD_SIZE(0);
+	uint64_t user_bytes = 0;
+	gp_nvm_result_t result;
+
+	if( n == 0 ){
+		return GP_NVM_SUCCESS;
+	}
+	for( uint32_t i = 0; i<n; i++ ){
+		size += GP_NVM_RECORD_SIZE(batch->entries[i].len);
+		user_bytes += batch->entries[i].len;
+	}
+	result = _gp_nvm_log_reserve_tail(store, size);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+
+	uint32_t offset = log->tail_offset;
+	for( uint32_t i = 0; i<n; i++ ){
+		gp_nvm_batch_entry_t *entry = &batch->entries[i];
+		gp_nvm_batch_record_t *record = &batch->records[i];
+		memset(record, 0, sizeof(gp_nvm_batch_record_t));
+		record->offset = offset;
+		record->value = batch->data + entry->data;
+		record->hdr.magic = GP_NVM_RECORD_MAGIC;
+		record->hdr.type = GP_NVM_RECORD_ATTR;
+		record->hdr.flags = GP_NVM_RECORD_FLAG_BATCH | entry->codec << GP_NVM_RECORD_CODEC_SHIFT;
+		record->hdr.attr_id = entry->attr_id;
+		record->hdr.len = entry->len;
+		record->hdr.capacity = entry->len;
+		record->hdr.seq = store->seq + 1 + i;
+		record->hdr.crc = gp_nvm_crc32c(0, record->value, entry->len);
+		offset += GP_NVM_RECORD_SIZE(entry->len);
+	}
+	gp_nvm_record_hdr_t commit = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_COMMIT,
+		.attr_id = n,
+		.seq = store->seq + n + 1,
+	};
+	if( gp_nvm_batch_write(store->dev, batch->records, n) != 0 || gp_nvm_store_write_record(store, offset, &commit, NULL) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	store->seq += n + 1;
+	log->device_bytes += size;
+	log->user_bytes += user_bytes;
+
+	for( uint32_t i = 0; i<n; i++ ){
+		result = _gp_nvm_log_apply(store, &batch->records[i].hdr, batch->records[i].offset);
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+	}
+	_gp_nvm_log_fill(log, offset, GP_NVM_RECORD_SIZE(0));
+	log->tail_offset = offset + GP_NVM_RECORD_SIZE(0);
+	return _gp_nvm_log_auto_compact(store);
+}
+
+/**
+ * @brief      Reserve a record for a stream at the tail, the record is marked free until the stream is committed.
+ *
+ * The tail moves beyond the record right away, so the records written while the stream is open follow it.
+ * The record counts as stale until the stream is committed.
+ *
+ * @param[in]     store   The attribute store.
+ * @param[inout]  hdr     The header of the record with the attribute ID and the length of the value, the
+ *                        capacity and the sequence number are set here.
+ * @param[out]    offset  Pointer were the offset of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL (also when the record doesn't fit in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_stream_open(	gp_nvm_store_t *store,
+						gp_nvm_record_hdr_t *hdr,
+						uint32_t *offset)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint64_t size = (uint64_t) sizeof(gp_nvm_record_hdr_t) + hdr->len;
+	gp_nvm_result_t result = _gp_nvm_log_reserve_tail(store, size);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	gp_nvm_record_hdr_t placeholder = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_FREE,
+		.capacity = hdr->len,
+		.seq = store->seq + 1,
+	};
+	if( gp_nvm_store_write_hdr(store, log->tail_offset, &placeholder) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	hdr->capacity = hdr->len;
+	hdr->seq = ++store->seq;
+	log->device_bytes += sizeof(placeholder);
+	_gp_nvm_log_fill(log, log->tail_offset, size);
+	*offset = log->tail_offset;
+	log->tail_offset += size;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Commit a stream: write the attribute header of its record and point the index at it.
+ *
+ * The commit fails when the attribute got a newer record or was deleted while the stream was open, the record
+ * then stays stale.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record, with the CRC of the value.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute has a newer record)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_stream_commit(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint32_t size = GP_NVM_RECORD_SIZE(hdr->capacity);
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, hdr->attr_id);
+	gp_nvm_index_entry_t* tombstone = gp_nvm_index_find(&log->tombstones, hdr->attr_id);
+
+	if( (attr != NULL && attr->seq > hdr->seq) || (tombstone != NULL && tombstone->seq > hdr->seq) ){
+		return GP_NVM_FAIL;
+	}
+	if( gp_nvm_store_write_hdr(store, offset, hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	log->device_bytes += size;
+	log->user_bytes += hdr->len;
+	// the record was filled when it was reserved, applying it fills it again
+	log->seg_fill[_gp_nvm_log_segment_of(log, offset)] -= size;
+	log->fill_bytes -= size;
+	gp_nvm_result_t result = _gp_nvm_log_apply(store, hdr, offset);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	return _gp_nvm_log_auto_compact(store);
+}
+
+/**
+ * @brief      Delete an attribute: append a delete record that hides its older records and point no index entry at it.
+ *
+ * The record of the attribute becomes stale and is reclaimed by compaction. The delete record is kept as the
+ * tombstone of the attribute until the segments that can hold older records are erased and, when the attribute
+ * was in the newest checkpoint, until the next checkpoint is written.
+ * When there are no free segments and too many stale bytes, a compaction step is run afterwards.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_delete(	gp_nvm_store_t *store,
+					uint32_t attr_id)
+{
+	if( gp_nvm_index_find(&store->index, attr_id) == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	gp_nvm_result_t result = _gp_nvm_log_append_delete(store, attr_id);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	return _gp_nvm_log_auto_compact(store);
+}
+
+/**
+ * @brief      Run one incremental compaction step.
+ *
+ * Nothing is compacted while a stream is open, the segment of its record may not be erased.
+ *
+ * @param[in]  store      The attribute store.
+ * @param[in]  max_bytes  Maximum number of bytes to relocate, 0 relocates a complete segment.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_compact(	gp_nvm_store_t *store,
+					uint32_t max_bytes)
+{
+	gp_nvm_log_t *log = &store->log;
+	uint8_t small[UINT8_MAX];
+	uint32_t moved = 0;
+
+	if( store->streams > 0 ){
+		return GP_NVM_SUCCESS;
+	}
+	if( max_bytes == 0 ){
+		max_bytes = log->segment_size;
+	}
+
+	if( log->compact_seg == GP_NVM_LOG_NO_SEGMENT ){
+		uint32_t victim = _gp_nvm_log_select_victim(store);
+		if( victim == GP_NVM_LOG_NO_SEGMENT ){
+			return GP_NVM_SUCCESS;
+		}
+		gp_nvm_log_segment_hdr_t seg_hdr;
+		if( nvm_dev_read(store->dev, _gp_nvm_log_segment_base(log, victim), sizeof(seg_hdr), &seg_hdr) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		log->compact_seg = victim;
+		log->compact_offset = _gp_nvm_log_segment_base(log, victim) + sizeof(seg_hdr);
+		log->compact_last_seq = seg_hdr.seq;
+	}
+
+	uint32_t seg = log->compact_seg;
+	uint32_t seg_end = _gp_nvm_log_segment_base(log, seg) + log->segment_size;
+	while( moved < max_bytes && log->seg_live[seg] > 0 ){
+		gp_nvm_record_hdr_t hdr;
+		if( log->compact_offset + sizeof(hdr) > seg_end ||
+			gp_nvm_store_read_hdr(store, log->compact_offset, &hdr) != 0 ||
+			hdr.seq <= log->compact_last_seq ){
+			// live bytes are accounted for but their records can't be found
+			fprintf(stderr, "GP-NVM: lost track of live records in segment %u\n", seg);
+			return GP_NVM_MEM_ERROR;
+		}
+		uint32_t size = GP_NVM_RECORD_SIZE(hdr.capacity);
+		gp_nvm_index_entry_t* attr = gp_nvm_index_find(&store->index, hdr.attr_id);
+
+		// relocate the record to the tail if it is still the latest record of the attribute
+		if( hdr.type == GP_NVM_RECORD_ATTR && attr != NULL && attr->offset == log->compact_offset ){
+			// a large value gets a buffer of its own
+			uint8_t *value = hdr.len <= sizeof(small) ? small : malloc(hdr.len);
+			if( value == NULL ){
+				return GP_NVM_MEM_FULL;
+			}
+			gp_nvm_result_t result = GP_NVM_MEM_ERROR;
+			if( nvm_dev_read(store->dev, log->compact_offset + sizeof(hdr), hdr.len, value) == 0 ){
+				result = _gp_nvm_log_append(store, hdr.attr_id, hdr.len, value, hdr.crc, GP_NVM_RECORD_CODEC(hdr.flags));
+			}
+			if( value != small ){
+				free(value);
+			}
+			if( result != GP_NVM_SUCCESS ){
+				return result;
+			}
+			log->compact_bytes += size;
+			moved += size;
+			GP_NVM_STATS_ADD(record_moves, 1);
+		}
+
+		// a tombstone is dropped once no segment can hold an older record of its attribute, else it is relocated
+		gp_nvm_index_entry_t* tombstone = gp_nvm_index_find(&log->tombstones, hdr.attr_id);
+		if( hdr.type == GP_NVM_RECORD_DELETE && tombstone != NULL && tombstone->offset == log->compact_offset ){
+			if( !_gp_nvm_log_tombstone_needed(store, seg, tombstone->seq) ){
+				_gp_nvm_log_drop_tombstone(log, hdr.attr_id, tombstone);
+			} else {
+				gp_nvm_result_t result = _gp_nvm_log_append_delete(store, hdr.attr_id);
+				if( result != GP_NVM_SUCCESS ){
+					return result;
+				}
+				log->compact_bytes += size;
+				moved += size;
+				GP_NVM_STATS_ADD(record_moves, 1);
+			}
+		}
+		log->compact_last_seq = hdr.seq;
+		log->compact_offset += size;
+	}
+
+	if( log->seg_live[seg] == 0 ){
+		log->compact_seg = GP_NVM_LOG_NO_SEGMENT;
+		return _gp_nvm_log_erase_segment(store, seg);
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Write a checkpoint of the index and the segment state.
+ *
+ * The checkpoint is appended to the log as records that fill the tail, the segments that hold them
+ * aren't compacted until the next checkpoint. The tombstones of deleted attributes follow the segment state. The state is taken before the records are appended,
+ * so they are replayed like any record written after the checkpoint.
+ * Nothing is written when the newest checkpoint is still valid.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_checkpoint(gp_nvm_store_t *store)
+{
+	gp_nvm_log_t *log = &store->log;
+	gp_nvm_checkpoint_buf_t buf = { 0 };
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint32_t max_len = log->segment_size - sizeof(gp_nvm_log_segment_hdr_t) - sizeof(gp_nvm_record_hdr_t);
+	uint32_t *chunks = NULL;
+	uint32_t num_chunks = 0;
+	uint32_t prev = 0;
+	uint32_t ckpt_seq = store->seq;
+
+	if( store->ckpt.valid ){
+		return GP_NVM_SUCCESS;
+	}
+	gp_nvm_checkpoint_put_index(store, &buf);
+	gp_nvm_checkpoint_put(&buf, log->num_segments);
+	gp_nvm_checkpoint_put(&buf, log->tail);
+	gp_nvm_checkpoint_put(&buf, log->tail_offset);
+	for( uint32_t seg = 0; seg<log->num_segments; seg++ ){
+		gp_nvm_checkpoint_put(&buf, log->seg_used[seg]);
+		gp_nvm_checkpoint_put(&buf, log->seg_seq[seg]);
+		gp_nvm_checkpoint_put(&buf, log->seg_fill[seg]);
+	}
+	gp_nvm_checkpoint_put(&buf, log->tombstones.num_entries);
+	for( uint32_t i = 0; i<log->tombstones.num_slots; i++ ){
+		if( log->tombstones.ctrl[i] != 0 ){
+			gp_nvm_checkpoint_put(&buf, log->tombstones.ids[i]);
+			gp_nvm_checkpoint_put(&buf, log->tombstones.entries[i].offset);
+			gp_nvm_checkpoint_put(&buf, log->tombstones.entries[i].seq);
+		}
+	}
+	if( buf.error ){
+		result = GP_NVM_MEM_FULL;
+	}
+
+	for( uint32_t pos = 0; pos<buf.len && result == GP_NVM_SUCCESS; ){
+		uint32_t len = buf.len - pos < max_len ? buf.len - pos : max_len;
+		// fill what is left of the tail before a new segment is opened
+		if( log->tail != GP_NVM_LOG_NO_SEGMENT ){
+			uint32_t room = _gp_nvm_log_segment_base(log, log->tail) + log->segment_size - log->tail_offset;
+			if( room > sizeof(gp_nvm_record_hdr_t) && room - sizeof(gp_nvm_record_hdr_t) < len ){
+				len = room - sizeof(gp_nvm_record_hdr_t);
+			}
+		}
+		uint32_t size = GP_NVM_RECORD_SIZE(len);
+		uint32_t *grown = realloc(chunks, (num_chunks + 1) * sizeof(uint32_t));
+		if( grown == NULL ){
+			result = GP_NVM_MEM_FULL;
+			break;
+		}
+		chunks = grown;
+		result = _gp_nvm_log_reserve_tail(store, size);
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+
+		gp_nvm_record_hdr_t hdr = {
+			.magic = GP_NVM_RECORD_MAGIC,
+			.type = GP_NVM_RECORD_CHECKPOINT,
+			.attr_id = prev,
+			.len = len,
+			.capacity = len,
+			.seq = store->seq + 1,
+			.crc = gp_nvm_crc32c(0, buf.data + pos, len),
+		};
+		if( gp_nvm_store_write_record(store, log->tail_offset, &hdr, buf.data + pos) != 0 ){
+			result = GP_NVM_MEM_ERROR;
+			break;
+		}
+		store->seq++;
+		log->device_bytes += size;
+		_gp_nvm_log_fill(log, log->tail_offset, size);
+		chunks[num_chunks++] = prev = log->tail_offset;
+		log->tail_offset += size;
+		pos += len;
+	}
+
+	uint32_t len = buf.len;
+	gp_nvm_checkpoint_buf_deinit(&buf);
+	if( result != GP_NVM_SUCCESS ){
+		free(chunks);
+		return result;
+	}
+	result = gp_nvm_checkpoint_commit(store, len, chunks, num_chunks);
+	if( result == GP_NVM_SUCCESS ){
+		log->ckpt_seq = ckpt_seq;
+	}
+	return result;
+}
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_log_get_stats(	const gp_nvm_store_t *store,
+						gp_nvm_compact_stats_t *stats)
+{
+	const gp_nvm_log_t *log = &store->log;
+	memset(stats, 0, sizeof(gp_nvm_compact_stats_t));
+	stats->live_bytes = log->live_bytes;
+	stats->stale_bytes = log->fill_bytes - log->live_bytes;
+	stats->user_bytes = log->user_bytes;
+	stats->device_bytes = log->device_bytes;
+	stats->compact_bytes = log->compact_bytes;
+	stats->reclaimed_bytes = log->reclaimed_bytes;
+	stats->segments_reclaimed = log->segments_reclaimed;
+	stats->num_segments = log->num_segments;
+	stats->free_segments = log->free_segments;
+	if( log->user_bytes > 0 ){
+		stats->write_amplification = (double) log->device_bytes / log->user_bytes;
+	}
+}
+
+/** @} */
@@ -0,0 +1,209 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-log.h
+ * \brief	Header file for the log-structured storage engine of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The log engine never overwrites a record. Every set appends a new record with a higher sequence
+ * number to the tail segment and the index is updated to point at it. The previous record of the
+ * attribute becomes stale. Segments are reclaimed by relocating their live records to the tail,
+ * after which the segment header is erased and the segment can be reused.
+ *
+ * A segment header stores the sequence number at the time the segment was opened.
+ * Records in a segment must have increasing sequence numbers above it, so stale records that
+ * remain in a reused segment are never mistaken for valid ones.
+ *
+ * A batch is appended to a single segment, together with its commit record.
+ */
+
+#ifndef __GP_NVM_LOG_H__
+#define __GP_NVM_LOG_H__
+
+#include "gp-nvm-store.h"
+#include "gp-nvm-batch.h"
+
+/**
+ * @brief      Default size of a log segment in bytes.
+ *
+ */
+#define GP_NVM_LOG_DEFAULT_SEGMENT_SIZE 4096
+
+/**
+ * @brief      Default compaction threshold: compact when there are more stale than live bytes.
+ *
+ */
+#define GP_NVM_LOG_DEFAULT_COMPACT_THRESHOLD 100
+
+/**
+ * @brief      Open the log engine and load the index from the newest checkpoint or rebuild it by scanning all segments.
+ *
+ * With a checkpoint only the records written after it are scanned.
+ *
+ * @param[in]  store              The attribute store.
+ * @param[in]  segment_size       The segment size from the superblock.
+ * @param[in]  compact_threshold  The compaction threshold, 0 selects the default.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_log_open(	gp_nvm_store_t *store,
+					uint32_t segment_size,
+					uint32_t compact_threshold);
+
+/**
+ * @brief      Release the memory of the log engine.
+ *
+ * @param[in]  store  The attribute store.
+ */
+void
+gp_nvm_log_close(gp_nvm_store_t *store);
+
+/**
+ * @brief      Append a new record for an attribute and point the index at it.
+ *
+ * When there are no free segments and too many stale bytes, a compaction step is run afterwards.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ * @param[in]  length   The length of the value as it is stored.
+ * @param[in]  p_value  Pointer to the value in RAM, compressed with codec.
+ * @param[in]  codec    The codec of the value.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_set(	gp_nvm_store_t *store,
+				uint32_t attr_id,
+				uint32_t length,
+				const uint8_t* p_value,
+				uint32_t codec);
+
+/**
+ * @brief      Commit a batch: append its records and the commit record to the tail segment.
+ *
+ * All records of a batch are written to the same segment, so the commit record is erased together with them.
+ * The records are adjacent and written with one update, followed by the commit record.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[in]  batch  The batch.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL (also when the batch doesn't fit in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_commit(	gp_nvm_store_t *store,
+					gp_nvm_batch_t *batch);
+
+/**
+ * @brief      Reserve a record for a stream at the tail, the record is marked free until the stream is committed.
+ *
+ * The record has to fit in one segment. The tail moves beyond the record right away, so the records written
+ * while the stream is open follow it. The sequence number of the record is taken here, so it is older than
+ * those records. A stream is aborted by leaving its record stale.
+ *
+ * @param[in]     store   The attribute store.
+ * @param[inout]  hdr     The header of the record with the attribute ID and the length of the value, the
+ *                        capacity and the sequence number are set here.
+ * @param[out]    offset  Pointer were the offset of the record can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL (also when the record doesn't fit in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_stream_open(	gp_nvm_store_t *store,
+						gp_nvm_record_hdr_t *hdr,
+						uint32_t *offset);
+
+/**
+ * @brief      Commit a stream: write the attribute header of its record and point the index at it.
+ *
+ * The commit fails when the attribute got a newer record while the stream was open, the record then stays stale.
+ *
+ * @param[in]  store   The attribute store.
+ * @param[in]  hdr     The header of the record, with the CRC of the value.
+ * @param[in]  offset  The offset of the record.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute has a newer record)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_stream_commit(	gp_nvm_store_t *store,
+							const gp_nvm_record_hdr_t *hdr,
+							uint32_t offset);
+
+/**
+ * @brief      Delete an attribute: append a delete record that hides its older records and point no index entry at it.
+ *
+ * The record of the attribute becomes stale and is reclaimed by compaction. The delete record is kept as the
+ * tombstone of the attribute until the segments that can hold older records are erased and, when the attribute
+ * was in the newest checkpoint, until the next checkpoint is written.
+ * When there are no free segments and too many stale bytes, a compaction step is run afterwards.
+ *
+ * @param[in]  store    The attribute store.
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_delete(	gp_nvm_store_t *store,
+					uint32_t attr_id);
+
+/**
+ * @brief      Run one incremental compaction step.
+ *
+ * Nothing is compacted while a stream is open.
+ *
+ * @param[in]  store      The attribute store.
+ * @param[in]  max_bytes  Maximum number of bytes to relocate, 0 relocates a complete segment.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_compact(	gp_nvm_store_t *store,
+					uint32_t max_bytes);
+
+/**
+ * @brief      Write a checkpoint of the index and the segment state.
+ *
+ * The checkpoint is appended to the log as records that fill the tail, the segments that hold them
+ * aren't compacted until the next checkpoint. The tombstones of deleted attributes follow the segment state.
+ * Nothing is written when the newest checkpoint is still valid.
+ *
+ * @param[in]  store  The attribute store.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_log_checkpoint(gp_nvm_store_t *store);
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * @param[in]  store  The attribute store.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_log_get_stats(	const gp_nvm_store_t *store,
+						gp_nvm_compact_stats_t *stats);
+
+#endif /* __GP_NVM_LOG_H__ */
+
+/** @} */
@@ -0,0 +1,367 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-schema.c
+ * \brief	Implementation of the static attributes of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-schema.h"
+
+// Uses following header(s)
+#include "nvm.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Largest record that is read with one read of the NVM, beyond it the header and the range are read apart.
+ *
+ */
+#ifndef GP_NVM_CONF_SCHEMA_READ_SIZE
+#define GP_NVM_CONF_SCHEMA_READ_SIZE 256
+#endif
+
+/**
+ * @brief      Static attribute: its ID, the length of its value and the offset of its slot in the region.
+ *
+ */
+typedef struct gp_nvm_schema_slot {
+	uint32_t attr_id;
+	uint32_t len;
+	uint32_t offset;
+} gp_nvm_schema_slot_t;
+
+#ifdef GP_NVM_CONF_SCHEMA
+/**
+ * @brief      Layout of the region of the static attributes, one record per slot.
+ *
+ * The members are byte arrays, so the layout has no padding and offsetof gives the offset of every slot.
+ */
+typedef struct gp_nvm_schema_layout {
+#define GP_NVM_SCHEMA_ATTR(name, id, type) uint8_t name[sizeof(gp_nvm_record_hdr_t) + sizeof(type)];
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+} gp_nvm_schema_layout_t;
+
+// the ID of every static attribute has to fit the attribute identifier
+#define GP_NVM_SCHEMA_ATTR(name, id, type) \
+	_Static_assert((uint64_t) (id) <= (gp_nvm_attr_id_t) -1, "ID of static attribute " #name " doesn't fit gp_nvm_attr_id_t");
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+#endif
+
+/**
+ * @brief      The static attributes, the last entry keeps the table valid without a schema.
+ *
+ */
+static const gp_nvm_schema_slot_t slots[GP_NVM_NUM_SLOTS + 1] = {
+#ifdef GP_NVM_CONF_SCHEMA
+#define GP_NVM_SCHEMA_ATTR(name, id, type) { (id), sizeof(type), offsetof(gp_nvm_schema_layout_t, name) },
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+#endif
+	{ 0, 0, 0 }
+};
+
+/**
+ * @brief      Number of static attributes, as a variable so comparing a slot with it doesn't warn without a schema.
+ *
+ */
+static const uint32_t num_slots = GP_NVM_NUM_SLOTS;
+
+/**
+ * @brief      Offset of the record of a slot on the NVM.
+ *
+ */
+static inline uint32_t
+_gp_nvm_schema_offset(uint32_t slot)
+{
+	return GP_NVM_DATA_START + slots[slot].offset;
+}
+
+/**
+ * @brief      Check the record header of a slot.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the slot is still zeroed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_schema_check_hdr(uint32_t slot, const gp_nvm_record_hdr_t *hdr)
+{
+	if( hdr->magic != GP_NVM_RECORD_MAGIC ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	if( hdr->hdr_crc != gp_nvm_crc32c(0, hdr, offsetof(gp_nvm_record_hdr_t, hdr_crc)) ||
+		hdr->type != GP_NVM_RECORD_ATTR || hdr->attr_id != slots[slot].attr_id || hdr->len != slots[slot].len ){
+		return GP_NVM_CRC_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Get the size of the region of the static attributes.
+ *
+ * @return     The size in bytes, 0 without a schema.
+ */
+uint32_t
+gp_nvm_schema_size(void)
+{
+#ifdef GP_NVM_CONF_SCHEMA
+	return sizeof(gp_nvm_schema_layout_t);
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief      Get the CRC of the schema, over the ID and the size of every static attribute.
+ *
+ * @return     The CRC, 0 without a schema.
+ */
+uint32_t
+gp_nvm_schema_crc(void)
+{
+	uint32_t crc = 0;
+	for( uint32_t slot = 0; slot<num_slots; slot++ ){
+		crc = gp_nvm_crc32c(crc, &slots[slot].attr_id, sizeof(uint32_t));
+		crc = gp_nvm_crc32c(crc, &slots[slot].len, sizeof(uint32_t));
+	}
+	return crc;
+}
+
+/**
+ * @brief      Get the attribute identifier of a slot.
+ *
+ * @param[in]  slot  The slot.
+ *
+ * @return     The attribute identifier.
+ */
+uint32_t
+gp_nvm_schema_attr_id(uint32_t slot)
+{
+	return slots[slot].attr_id;
+}
+
+/**
+ * @brief      Get the length of the value of a slot.
+ *
+ * @param[in]  slot  The slot.
+ *
+ * @return     The length, 0 when the slot doesn't exist.
+ */
+uint32_t
+gp_nvm_schema_len(uint32_t slot)
+{
+	return slot < num_slots ? slots[slot].len : 0;
+}
+
+/**
+ * @brief      Read a range of the value of a static attribute from its slot.
+ *
+ * Only the record header and the range are read, with one read when they fit GP_NVM_CONF_SCHEMA_READ_SIZE bytes.
+ * The CRC of the value is checked when the range is the complete value, a range of 0 bytes only checks that
+ * the attribute was set.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_read(	const gp_nvm_store_t *store,
+					uint32_t slot,
+					uint32_t offset,
+					uint32_t length,
+					uint8_t *p_value)
+{
+	uint32_t len = slots[slot].len;
+	gp_nvm_record_hdr_t hdr;
+
+	if( offset > len || length > len - offset ){
+		return GP_NVM_ATTR_LEN_DIFF;
+	}
+	// a small record is read at once, a large one as its header and the range
+	uint8_t buf[GP_NVM_CONF_SCHEMA_READ_SIZE];
+	uint32_t size = sizeof(hdr) + offset + length;
+	if( size <= sizeof(buf) ){
+		if( nvm_dev_read(store->dev, _gp_nvm_schema_offset(slot), size, buf) != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+		memcpy(&hdr, buf, sizeof(hdr));
+	}
+	else if( nvm_dev_read(store->dev, _gp_nvm_schema_offset(slot), sizeof(hdr), &hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	gp_nvm_result_t result = _gp_nvm_schema_check_hdr(slot, &hdr);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	if( size <= sizeof(buf) ){
+		memcpy(p_value, buf + sizeof(hdr) + offset, length);
+	}
+	else if( nvm_dev_read(store->dev, _gp_nvm_schema_offset(slot) + sizeof(gp_nvm_record_hdr_t) + offset, length, p_value) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	if( length == len && gp_nvm_crc32c(0, p_value, len) != hdr.crc ){
+		return GP_NVM_CRC_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Point a view at the value of a static attribute in the memory of the NVM device.
+ *
+ * @param[in]  store   The store of the first shard.
+ * @param[in]  slot    The slot.
+ * @param[out] p_view  Pointer were the value and its length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_view(	const gp_nvm_store_t *store,
+					uint32_t slot,
+					gp_nvm_view_t *p_view)
+{
+	uint32_t len = slots[slot].len;
+	gp_nvm_record_hdr_t hdr;
+
+	const uint8_t *p_record = nvm_dev_view(store->dev, _gp_nvm_schema_offset(slot), GP_NVM_RECORD_SIZE(len));
+	if( p_record == NULL ){
+		return GP_NVM_FAIL;
+	}
+	memcpy(&hdr, p_record, sizeof(hdr));
+	gp_nvm_result_t result = _gp_nvm_schema_check_hdr(slot, &hdr);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	if( gp_nvm_crc32c(0, p_record + sizeof(hdr), len) != hdr.crc ){
+		return GP_NVM_CRC_ERROR;
+	}
+	p_view->p_value = p_record + sizeof(hdr);
+	p_view->length = len;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Write the value of a static attribute to its slot.
+ *
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  p_value  The value, gp_nvm_schema_len bytes.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_write(	const gp_nvm_store_t *store,
+						uint32_t slot,
+						const uint8_t *p_value)
+{
+	// the record never moves, so it needs no sequence number
+	gp_nvm_record_hdr_t hdr = {
+		.magic = GP_NVM_RECORD_MAGIC,
+		.type = GP_NVM_RECORD_ATTR,
+		.attr_id = slots[slot].attr_id,
+		.len = slots[slot].len,
+		.capacity = slots[slot].len,
+		.crc = gp_nvm_crc32c(0, p_value, slots[slot].len),
+	};
+	if( gp_nvm_store_write_record(store, _gp_nvm_schema_offset(slot), &hdr, p_value) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Overwrite a range of the value of a static attribute.
+ *
+ * The value is read, the range is patched in and the value is written again for its new CRC.
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  The new bytes of the range.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_update(	const gp_nvm_store_t *store,
+						uint32_t slot,
+						uint32_t offset,
+						uint32_t length,
+						const uint8_t *p_value)
+{
+	uint32_t len = slots[slot].len;
+
+	if( offset > len || length > len - offset ){
+		return GP_NVM_ATTR_LEN_DIFF;
+	}
+	uint8_t *value = malloc(len);
+	if( value == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	gp_nvm_result_t result = gp_nvm_schema_read(store, slot, 0, len, value);
+	if( result == GP_NVM_SUCCESS ){
+		memcpy(value + offset, p_value, length);
+		result = gp_nvm_schema_write(store, slot, value);
+	}
+	free(value);
+	return result;
+}
+
+/**
+ * @brief      Clear the slot of a static attribute, so it reads as never set.
+ *
+ * Only the record header is zeroed, the slot keeps its place in the region.
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store  The store of the first shard.
+ * @param[in]  slot   The slot.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_clear(	const gp_nvm_store_t *store,
+						uint32_t slot)
+{
+	gp_nvm_record_hdr_t hdr;
+	if( nvm_dev_read(store->dev, _gp_nvm_schema_offset(slot), sizeof(hdr), &hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	if( hdr.magic != GP_NVM_RECORD_MAGIC ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	if( nvm_dev_update(store->dev, _gp_nvm_schema_offset(slot), sizeof(hdr), &hdr) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/** @} */
@@ -0,0 +1,192 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-schema.h
+ * \brief	Header file for the static attributes of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The static attributes of the schema in GP_NVM_CONF_SCHEMA are stored in a region of slots at
+ * GP_NVM_DATA_START in the NVM of the first shard. Every slot holds the record of one static attribute:
+ * a record header followed by the sizeof(type) bytes of the value. The slots are laid out in the order
+ * of the schema, so the offset of every slot is known at compile time and its record is never moved,
+ * both engines overwrite it in place. A slot that was never set is still zeroed from the format.
+ * The records of the in-place engine start after the region, the log engine keeps the region before its
+ * first segment. The superblock holds the size and the CRC of the schema, so an NVM can't be opened with
+ * another schema.
+ */
+
+#ifndef __GP_NVM_SCHEMA_H__
+#define __GP_NVM_SCHEMA_H__
+
+#include "gp-nvm-store.h"
+
+/**
+ * @brief      Get the slot of a static attribute.
+ *
+ * The switch is generated from the schema, so an ID that is used twice doesn't compile.
+ *
+ * @param[in]  attr_id  The attribute identifier.
+ *
+ * @return     The slot, GP_NVM_NUM_SLOTS when the attribute isn't static.
+ */
+static inline uint32_t
+gp_nvm_schema_slot_of(uint32_t attr_id)
+{
+#ifdef GP_NVM_CONF_SCHEMA
+	switch( attr_id ){
+#define GP_NVM_SCHEMA_ATTR(name, id, type) case (id): return GP_NVM_SLOT_##name;
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+		default:
+			break;
+	}
+#endif
+	(void) attr_id;
+	return GP_NVM_NUM_SLOTS;
+}
+
+/**
+ * @brief      Get the size of the region of the static attributes.
+ *
+ * @return     The size in bytes, 0 without a schema.
+ */
+uint32_t
+gp_nvm_schema_size(void);
+
+/**
+ * @brief      Get the CRC of the schema, over the ID and the size of every static attribute.
+ *
+ * @return     The CRC, 0 without a schema.
+ */
+uint32_t
+gp_nvm_schema_crc(void);
+
+/**
+ * @brief      Get the attribute identifier of a slot.
+ *
+ * @param[in]  slot  The slot.
+ *
+ * @return     The attribute identifier.
+ */
+uint32_t
+gp_nvm_schema_attr_id(uint32_t slot);
+
+/**
+ * @brief      Get the length of the value of a slot.
+ *
+ * @param[in]  slot  The slot.
+ *
+ * @return     The length, 0 when the slot doesn't exist.
+ */
+uint32_t
+gp_nvm_schema_len(uint32_t slot);
+
+/**
+ * @brief      Read a range of the value of a static attribute from its slot.
+ *
+ * Only the record header and the range are read, with one read when they fit GP_NVM_CONF_SCHEMA_READ_SIZE bytes.
+ * The CRC of the value is checked when the range is the complete value, a range of 0 bytes only checks that
+ * the attribute was set.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_read(	const gp_nvm_store_t *store,
+					uint32_t slot,
+					uint32_t offset,
+					uint32_t length,
+					uint8_t *p_value);
+
+/**
+ * @brief      Point a view at the value of a static attribute in the memory of the NVM device.
+ *
+ * @param[in]  store   The store of the first shard.
+ * @param[in]  slot    The slot.
+ * @param[out] p_view  Pointer were the value and its length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_view(	const gp_nvm_store_t *store,
+					uint32_t slot,
+					gp_nvm_view_t *p_view);
+
+/**
+ * @brief      Write the value of a static attribute to its slot.
+ *
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  p_value  The value, gp_nvm_schema_len bytes.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_write(	const gp_nvm_store_t *store,
+						uint32_t slot,
+						const uint8_t *p_value);
+
+/**
+ * @brief      Overwrite a range of the value of a static attribute.
+ *
+ * The value is read, the range is patched in and the value is written again for its new CRC.
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store    The store of the first shard.
+ * @param[in]  slot     The slot.
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  The new bytes of the range.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_update(	const gp_nvm_store_t *store,
+						uint32_t slot,
+						uint32_t offset,
+						uint32_t length,
+						const uint8_t *p_value);
+
+/**
+ * @brief      Clear the slot of a static attribute, so it reads as never set.
+ *
+ * Only the record header is zeroed, the slot keeps its place in the region.
+ * The caller holds the writer mutex of the first shard.
+ *
+ * @param[in]  store  The store of the first shard.
+ * @param[in]  slot   The slot.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_schema_clear(	const gp_nvm_store_t *store,
+						uint32_t slot);
+
+#endif /* __GP_NVM_SCHEMA_H__ */
+
+/** @} */
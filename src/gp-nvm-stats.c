@@ -0,0 +1,98 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-stats.c
+ * \brief	Implementation of the runtime statistics of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-stats.h"
+
+// Uses following header(s)
+#include "gp-nvm-sync.h"
+
+/**
+ * @brief      Counters of the library, every thread counts in its own block.
+ *
+ */
+static gp_nvm_stats_t gp_nvm_shared_stats;
+static nvm_stats_t gp_nvm_stats = NVM_STATS_INITIALIZER(&gp_nvm_shared_stats);
+#if GP_NVM_CONF_THREADS
+static __thread gp_nvm_stats_t *gp_nvm_thread_stats;
+#else
+static gp_nvm_stats_t *gp_nvm_thread_stats;
+#endif
+
+/**
+ * @brief      Return the counters of the calling thread.
+ *
+ */
+gp_nvm_stats_t*
+gp_nvm_stats_local(void)
+{
+	if( gp_nvm_thread_stats == NULL ){
+		gp_nvm_thread_stats = (gp_nvm_stats_t*) nvm_stats_thread_counters(&gp_nvm_stats);
+	}
+	return gp_nvm_thread_stats;
+}
+
+/**
+ * @brief      Start timing an operation.
+ *
+ * @return     The start time, 0 when the statistics are disabled.
+ */
+uint64_t
+gp_nvm_stats_begin(void)
+{
+#if GP_NVM_CONF_STATS
+	return nvm_stats_now_ns();
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief      Count an operation that started at start.
+ *
+ * @param[in]  op      The counters of the operation in the counters of the calling thread.
+ * @param[in]  start   The start time returned by gp_nvm_stats_begin.
+ * @param[in]  bytes   The value bytes of the operation.
+ * @param[in]  result  The result of the operation.
+ *
+ * @return     The result of the operation.
+ */
+gp_nvm_result_t
+gp_nvm_stats_end(	gp_nvm_op_stats_t *op,
+					uint64_t start,
+					uint32_t bytes,
+					gp_nvm_result_t result)
+{
+#if GP_NVM_CONF_STATS
+	NVM_STATS_ADD(op->count, 1);
+	NVM_STATS_ADD(op->errors, result != GP_NVM_SUCCESS);
+	NVM_STATS_ADD(op->time_ns, nvm_stats_now_ns() - start);
+	NVM_STATS_ADD(op->bytes, bytes);
+#else
+	(void) op;
+	(void) start;
+	(void) bytes;
+#endif
+	return result;
+}
+
+/**
+ * @brief      Sum the counters of all threads.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_stats_sum(gp_nvm_stats_t *stats)
+{
+	nvm_stats_sum(&gp_nvm_stats, (uint64_t*) stats);
+}
+
+/** @} */
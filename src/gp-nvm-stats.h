@@ -0,0 +1,80 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-stats.h
+ * \brief	Header file for the runtime statistics of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The counters of gp_nvm_stats_t are kept per thread with the counter sets of nvm-stats.h,
+ * so counting doesn't add contention between threads.
+ */
+
+#ifndef __GP_NVM_STATS_H__
+#define __GP_NVM_STATS_H__
+
+#include "gp-nvm.h"
+#include "nvm-stats.h"
+
+/**
+ * @brief      Set to 0 to build without runtime statistics, gp_nvm_get_stats then returns zeros.
+ *
+ */
+#ifndef GP_NVM_CONF_STATS
+#define GP_NVM_CONF_STATS 1
+#endif
+
+/**
+ * @brief      Add to a counter of gp_nvm_stats_t in the counters of the calling thread.
+ *
+ */
+#if GP_NVM_CONF_STATS
+#define GP_NVM_STATS_ADD(field, n) NVM_STATS_ADD(gp_nvm_stats_local()->field, n)
+#else
+#define GP_NVM_STATS_ADD(field, n) ((void) (n))
+#endif
+
+/**
+ * @brief      Return the counters of the calling thread.
+ *
+ */
+gp_nvm_stats_t*
+gp_nvm_stats_local(void);
+
+/**
+ * @brief      Start timing an operation.
+ *
+ * @return     The start time, 0 when the statistics are disabled.
+ */
+uint64_t
+gp_nvm_stats_begin(void);
+
+/**
+ * @brief      Count an operation that started at start.
+ *
+ * @param[in]  op      The counters of the operation in the counters of the calling thread.
+ * @param[in]  start   The start time returned by gp_nvm_stats_begin.
+ * @param[in]  bytes   The value bytes of the operation.
+ * @param[in]  result  The result of the operation.
+ *
+ * @return     The result of the operation.
+ */
+gp_nvm_result_t
+gp_nvm_stats_end(	gp_nvm_op_stats_t *op,
+					uint64_t start,
+					uint32_t bytes,
+					gp_nvm_result_t result);
+
+/**
+ * @brief      Sum the counters of all threads.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_stats_sum(gp_nvm_stats_t *stats);
+
+#endif /* __GP_NVM_STATS_H__ */
+
+/** @} */
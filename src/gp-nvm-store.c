@@ -0,0 +1,209 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-store.c
+ * \brief	Implementation of the record helpers shared by the storage engines.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-store.h"
+
+// Uses following header(s)
+#include "nvm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      Copy bytes that are written to the NVM into the part of the image that holds them.
+ *
+ * This keeps the image up to date with the records that are rewritten while the store is opened.
+ */
+static void
+_gp_nvm_store_image_write(const gp_nvm_store_t *store, uint32_t offset, uint32_t len, const void *ptr)
+{
+	const gp_nvm_image_t *image = &store->image;
+	if( !image->valid || offset >= image->offset + image->len || offset + len <= image->offset ){
+		return;
+	}
+	uint32_t start = offset > image->offset ? offset : image->offset;
+	uint32_t end = offset + len < image->offset + image->len ? offset + len : image->offset + image->len;
+	memcpy(image->data + (start - image->offset), (const uint8_t*) ptr + (start - offset), end - start);
+}
+
+/**
+ * @brief      Read the record header at offset.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[out] hdr     Pointer were the header can be stored.
+ *
+ * @return     0: SUCCESS (a record header with a valid magic number and CRC)
+ * @return     1: ERROR (no record header)
+ * @return     2: ERROR (a record header with a CRC error)
+ */
+int
+gp_nvm_store_read_hdr(	const gp_nvm_store_t *store,
+						uint32_t offset,
+						gp_nvm_record_hdr_t *hdr)
+{
+	uint32_t size = nvm_dev_size(store->dev);
+	// a scan ends at the end of the NVM, which isn't an error of the device
+	if( size < sizeof(gp_nvm_record_hdr_t) || offset > size - sizeof(gp_nvm_record_hdr_t) ){
+		return 1;
+	}
+	if( gp_nvm_store_read(store, offset, sizeof(gp_nvm_record_hdr_t), hdr) != 0 || hdr->magic != GP_NVM_RECORD_MAGIC ){
+		return 1;
+	}
+	if( hdr->hdr_crc != gp_nvm_crc32c(0, hdr, offsetof(gp_nvm_record_hdr_t, hdr_crc)) ){
+		fprintf(stderr, "GP-NVM: CRC error in record header at offset %u\n", offset);
+		return 2;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Compute the header CRC of a record header.
+ *
+ * @param[in]  hdr  The record header.
+ */
+void
+gp_nvm_store_seal_hdr(gp_nvm_record_hdr_t *hdr)
+{
+	hdr->hdr_crc = gp_nvm_crc32c(0, hdr, offsetof(gp_nvm_record_hdr_t, hdr_crc));
+}
+
+/**
+ * @brief      Write a record header at offset, the header CRC is computed here.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[in]  hdr     The record header.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_write_hdr(	const gp_nvm_store_t *store,
+						uint32_t offset,
+						const gp_nvm_record_hdr_t *hdr)
+{
+	gp_nvm_record_hdr_t sealed = *hdr;
+	gp_nvm_store_seal_hdr(&sealed);
+	if( nvm_dev_update(store->dev, offset, sizeof(gp_nvm_record_hdr_t), &sealed) != 0 ){
+		return 1;
+	}
+	_gp_nvm_store_image_write(store, offset, sizeof(gp_nvm_record_hdr_t), &sealed);
+	return 0;
+}
+
+/**
+ * @brief      Write a record at offset.
+ *
+ * The value is written first, the record only becomes valid once its header is written.
+ * The header CRC is computed here, the value CRC has to be set by the caller.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[in]  hdr     The record header.
+ * @param[in]  value   The value of the record.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_write_record(	const gp_nvm_store_t *store,
+							uint32_t offset,
+							const gp_nvm_record_hdr_t *hdr,
+							const void *value)
+{
+	if( hdr->len > 0 ){
+		if( nvm_dev_update(store->dev, offset + sizeof(gp_nvm_record_hdr_t), hdr->len, value) != 0 ){
+			return 1;
+		}
+		_gp_nvm_store_image_write(store, offset + sizeof(gp_nvm_record_hdr_t), hdr->len, value);
+	}
+	return gp_nvm_store_write_hdr(store, offset, hdr);
+}
+
+/**
+ * @brief      Read the complete NVM of a store into an image with one read, before the store is opened.
+ *
+ * The open reads the superblock, the checkpoint and the record headers from the image, and gets copy the
+ * values from it until the store changes. Nothing is read when the NVM is empty.
+ *
+ * @param[in]  store  The store.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory or the NVM couldn't be read)
+ */
+int
+gp_nvm_store_preload(gp_nvm_store_t *store)
+{
+	gp_nvm_image_t *image = &store->image;
+	uint32_t size = nvm_dev_size(store->dev);
+
+	gp_nvm_store_release_image(store);
+	// a device without a size would have to be read until a read fails
+	if( size == 0 || size == UINT32_MAX ){
+		return size == 0 ? 0 : 1;
+	}
+	image->data = malloc(size);
+	if( image->data == NULL ){
+		return 1;
+	}
+	if( nvm_dev_read(store->dev, 0, size, image->data) != 0 ){
+		gp_nvm_store_release_image(store);
+		return 1;
+	}
+	image->offset = 0;
+	image->len = size;
+	image->valid = 1;
+	return 0;
+}
+
+/**
+ * @brief      Release the image of a store.
+ *
+ * @param[in]  store  The store.
+ */
+void
+gp_nvm_store_release_image(gp_nvm_store_t *store)
+{
+	free(store->image.data);
+	memset(&store->image, 0, sizeof(gp_nvm_image_t));
+}
+
+/**
+ * @brief      Read len bytes of the NVM at offset, from the image while it is valid and holds them.
+ *
+ * This also runs without the writer mutex, a get that overlaps with the first change is retried by its caller.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset in the NVM.
+ * @param[in]  len     The number of bytes.
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_read(	const gp_nvm_store_t *store,
+					uint32_t offset,
+					uint32_t len,
+					void *ptr)
+{
+	const gp_nvm_image_t *image = &store->image;
+	if( __atomic_load_n(&image->valid, __ATOMIC_RELAXED) &&
+		offset >= image->offset && len <= image->len && offset - image->offset <= image->len - len ){
+		memcpy(ptr, image->data + (offset - image->offset), len);
+		return 0;
+	}
+	return nvm_dev_read(store->dev, offset, len, ptr) != 0;
+}
+
+/** @} */
@@ -0,0 +1,356 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-store.h
+ * \brief	Header file for the on-NVM format and the attribute store shared by the storage engines.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The NVM starts with a superblock that is written once when the NVM is formatted, followed by the two
+ * anchor slots of the index checkpoints, see gp-nvm-checkpoint.h.
+ * Attributes are stored as records: a record header directly followed by the value.
+ * The in-place engine stores records back to back after the anchor slots and overwrites values in place.
+ * The log engine appends a new record for every set, see gp-nvm-log.h.
+ * The superblock and every record header are protected by a CRC32C, the value of a record has
+ * its own CRC32C that is checked when the attribute is read.
+ */
+
+#ifndef __GP_NVM_STORE_H__
+#define __GP_NVM_STORE_H__
+
+#include "gp-nvm.h"
+#include "gp-nvm-index.h"
+#include "gp-nvm-alloc.h"
+#include "gp-nvm-crc.h"
+#include "gp-nvm-codec.h"
+#include "nvm.h"
+
+/**
+ * @brief      Magic number identifying a formatted NVM ("GPNV").
+ *
+ */
+#define GP_NVM_MAGIC 0x564e5047
+
+/**
+ * @brief      Version of the on-NVM format.
+ *
+ */
+#define GP_NVM_VERSION 9
+
+/**
+ * @brief      Magic number at the start of every record.
+ *
+ */
+#define GP_NVM_RECORD_MAGIC 0xa77e
+
+/**
+ * @brief      Enumeration of record types.
+ *
+ */
+enum GP_NVM_RECORD_TYPE
+{
+	GP_NVM_RECORD_ATTR = 1,
+	GP_NVM_RECORD_FREE,
+	GP_NVM_RECORD_COMMIT,
+	GP_NVM_RECORD_CHECKPOINT,
+	GP_NVM_RECORD_DELETE,
+};
+
+/**
+ * @brief      Record flag: the record is part of a batch and only valid when the batch was committed.
+ *
+ */
+#define GP_NVM_RECORD_FLAG_BATCH 0x01
+
+/**
+ * @brief      Position of the codec of the value in the record flags, see gp-nvm-codec.h.
+ *
+ */
+#define GP_NVM_RECORD_CODEC_SHIFT 4
+
+/**
+ * @brief      Get the codec of the value from the record flags.
+ *
+ */
+#define GP_NVM_RECORD_CODEC(flags) ((uint32_t) (flags) >> GP_NVM_RECORD_CODEC_SHIFT)
+
+/**
+ * @brief      Superblock.
+ *
+ * The segment size is only used by the log engine.
+ * The number of shards is 0 when the NVM isn't a shard of a sharded context.
+ * The schema size and CRC describe the static attributes at GP_NVM_DATA_START, see gp-nvm-schema.h,
+ * both are 0 when the NVM holds no static attributes. The CRC covers all fields before it.
+ */
+typedef struct gp_nvm_superblock {
+	uint32_t magic;
+	uint16_t version;
+	uint8_t engine;
+	uint8_t num_shards;
+	uint32_t segment_size;
+	uint32_t schema_size;
+	uint32_t schema_crc;
+	uint32_t crc;
+} gp_nvm_superblock_t;
+
+/**
+ * @brief      Magic number of a valid checkpoint anchor ("CKPT").
+ *
+ */
+#define GP_NVM_CHECKPOINT_MAGIC 0x54504b43
+
+/**
+ * @brief      Checkpoint anchor.
+ *
+ * The anchor points at the last record of a checkpoint, the generation increases with every checkpoint.
+ * The size is the number of bytes of the checkpoint. The CRC covers all fields before it.
+ */
+typedef struct gp_nvm_checkpoint_anchor {
+	uint32_t magic;
+	uint32_t generation;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t crc;
+} gp_nvm_checkpoint_anchor_t;
+
+/**
+ * @brief      Offset of the data after the superblock and the anchor slots.
+ *
+ * The static attributes are stored here, followed by the first record of the in-place engine.
+ *
+ */
+#define GP_NVM_DATA_START ((uint32_t) (sizeof(gp_nvm_superblock_t) + 2 * sizeof(gp_nvm_checkpoint_anchor_t)))
+
+/**
+ * @brief      Record header.
+ *
+ * The sequence number increases with every record that is written,
+ * when several records exist for the same attribute the one with the highest sequence number is valid.
+ * The capacity is the space reserved for the value, the next record starts after it.
+ * A free record marks an extent that can be reused, its capacity covers the complete extent.
+ * A stream reserves its record with a free record header that is replaced by the attribute header once the
+ * stream is committed, so the record of a stream that was never committed is free after a crash.
+ * The value CRC covers the len bytes of the value, the header CRC covers all header fields before it.
+ * A compressed value is stored as is, len is the length of the compressed value.
+ * A delete record of the log engine has no value, it deletes the records of its attribute with a lower
+ * sequence number.
+ */
+typedef struct gp_nvm_record_hdr {
+	uint16_t magic;
+	uint8_t type;
+	uint8_t flags;
+	uint32_t attr_id;
+	uint32_t len;
+	uint32_t capacity;
+	uint32_t seq;
+	uint32_t crc;
+	uint32_t hdr_crc;
+} gp_nvm_record_hdr_t;
+
+/**
+ * @brief      State of the log engine.
+ *
+ * The log is divided in segments of segment_size bytes, segment i starts at offset (i+1)*segment_size.
+ * For every segment the number of live bytes and the number of bytes filled with records are tracked,
+ * the difference are stale bytes. A segment without a valid segment header is free.
+ * The sequence number of the segment header is kept to recognize a segment that was reused after a checkpoint.
+ * The segment that is being compacted and the position of the compactor in it are kept between steps.
+ * The tombstones are the delete records of deleted attributes, they are live records as long as a segment
+ * may hold an older record of their attribute. The offset, capacity and sequence number of the entries are
+ * those of the delete record. A tombstone that is newer than the newest checkpoint, taken at sequence number
+ * ckpt_seq, is also kept until the next checkpoint, the index of the checkpoint may still hold its attribute.
+ * Reclaimed bytes are the bytes of the segments that were erased.
+ */
+typedef struct gp_nvm_log {
+	uint32_t segment_size;
+	uint32_t num_segments;
+	uint32_t free_segments;
+	uint32_t *seg_live;
+	uint32_t *seg_fill;
+	uint32_t *seg_seq;
+	uint8_t *seg_used;
+	uint32_t tail;
+	uint32_t tail_offset;
+	uint32_t compact_threshold;
+	uint32_t compact_seg;
+	uint32_t compact_offset;
+	uint32_t compact_last_seq;
+	gp_nvm_index_t tombstones;
+	uint32_t ckpt_seq;
+	uint64_t live_bytes;
+	uint64_t fill_bytes;
+	uint64_t user_bytes;
+	uint64_t device_bytes;
+	uint64_t compact_bytes;
+	uint64_t segments_reclaimed;
+	uint64_t reclaimed_bytes;
+} gp_nvm_log_t;
+
+/**
+ * @brief      Checkpoint state of a store.
+ *
+ * The chunks are the offsets of the records of the newest checkpoint. Valid is set while that checkpoint
+ * describes the current state of the store, anchored while an anchor on the NVM may still be valid.
+ * Writes counts the changes since the newest checkpoint.
+ */
+typedef struct gp_nvm_checkpoint {
+	uint32_t interval;
+	uint32_t writes;
+	uint32_t generation;
+	uint32_t slot;
+	int valid;
+	int anchored;
+	uint32_t *chunks;
+	uint32_t num_chunks;
+} gp_nvm_checkpoint_t;
+
+/**
+ * @brief      Image of the NVM of a store that was read before it was opened, see the preload field of gp_nvm_config_t.
+ *
+ * The image holds len bytes of the NVM from offset. Records that are rewritten while the store is opened are
+ * written to the image as well. Valid is cleared before the store changes for the first time, after that every
+ * read goes to the NVM again.
+ * The data is only released when the store is closed, because a get without the writer mutex may still copy from it.
+ */
+typedef struct gp_nvm_image {
+	uint8_t *data;
+	uint32_t offset;
+	uint32_t len;
+	int valid;
+} gp_nvm_image_t;
+
+/**
+ * @brief      Attribute store.
+ *
+ * The store keeps the index of all attributes in RAM for fast look-up, every change is synced on its NVM device.
+ * Values of at least compress_min_len bytes are compressed when that saves space, 0 disables compression.
+ * Streams counts the streams that reserved a record which isn't committed yet, see gp_nvm_stream_open.
+ * Data start is the offset of the first record of the in-place engine, after the static attributes.
+ * Values are read from the image instead of the NVM while it is valid.
+ */
+typedef struct gp_nvm_store {
+	nvm_dev_t *dev;
+	gp_nvm_index_t index;
+	gp_nvm_engine_t engine;
+	uint32_t seq;
+	uint32_t end;
+	gp_nvm_alloc_t alloc;
+	gp_nvm_log_t log;
+	gp_nvm_checkpoint_t ckpt;
+	uint32_t compress_min_len;
+	uint32_t streams;
+	uint32_t data_start;
+	gp_nvm_image_t image;
+} gp_nvm_store_t;
+
+/**
+ * @brief      Size of a record on the NVM with a given capacity.
+ *
+ */
+#define GP_NVM_RECORD_SIZE(capacity) ((uint32_t) sizeof(gp_nvm_record_hdr_t) + (capacity))
+
+/**
+ * @brief      Read the record header at offset.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[out] hdr     Pointer were the header can be stored.
+ *
+ * @return     0: SUCCESS (a record header with a valid magic number and CRC)
+ * @return     1: ERROR (no record header)
+ * @return     2: ERROR (a record header with a CRC error)
+ */
+int
+gp_nvm_store_read_hdr(	const gp_nvm_store_t *store,
+						uint32_t offset,
+						gp_nvm_record_hdr_t *hdr);
+
+/**
+ * @brief      Compute the header CRC of a record header.
+ *
+ * @param[in]  hdr  The record header.
+ */
+void
+gp_nvm_store_seal_hdr(gp_nvm_record_hdr_t *hdr);
+
+/**
+ * @brief      Write a record header at offset, the header CRC is computed here.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[in]  hdr     The record header.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_write_hdr(	const gp_nvm_store_t *store,
+						uint32_t offset,
+						const gp_nvm_record_hdr_t *hdr);
+
+/**
+ * @brief      Write a record at offset.
+ *
+ * The value is written first, the record only becomes valid once its header is written.
+ * The header CRC is computed here, the value CRC has to be set by the caller.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset of the record in NVM.
+ * @param[in]  hdr     The record header.
+ * @param[in]  value   The value of the record.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_write_record(	const gp_nvm_store_t *store,
+							uint32_t offset,
+							const gp_nvm_record_hdr_t *hdr,
+							const void *value);
+
+/**
+ * @brief      Read the complete NVM of a store into an image with one read, before the store is opened.
+ *
+ * The open reads the superblock, the checkpoint and the record headers from the image, and gets copy the
+ * values from it until the store changes. Nothing is read when the NVM is empty.
+ *
+ * @param[in]  store  The store.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (out of memory or the NVM couldn't be read)
+ */
+int
+gp_nvm_store_preload(gp_nvm_store_t *store);
+
+/**
+ * @brief      Release the image of a store.
+ *
+ * @param[in]  store  The store.
+ */
+void
+gp_nvm_store_release_image(gp_nvm_store_t *store);
+
+/**
+ * @brief      Read len bytes of the NVM at offset, from the image while it is valid and holds them.
+ *
+ * This also runs without the writer mutex, a get that overlaps with the first change is retried by its caller.
+ *
+ * @param[in]  store   The store.
+ * @param[in]  offset  The offset in the NVM.
+ * @param[in]  len     The number of bytes.
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+gp_nvm_store_read(	const gp_nvm_store_t *store,
+					uint32_t offset,
+					uint32_t len,
+					void *ptr);
+
+#endif /* __GP_NVM_STORE_H__ */
+
+/** @} */
@@ -0,0 +1,151 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-sync.c
+ * \brief	Implementation of the synchronization of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "gp-nvm-sync.h"
+
+// Uses following header(s)
+#if GP_NVM_CONF_THREADS
+#include <sched.h>
+#endif
+
+/**
+ * @brief      Initialize a synchronization state that isn't statically initialized.
+ *
+ * @param[out] sync  The synchronization state.
+ */
+void
+gp_nvm_sync_init(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_init(&sync->lock, NULL);
+#endif
+	sync->seq = 0;
+}
+
+/**
+ * @brief      Release a synchronization state initialized with gp_nvm_sync_init.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_deinit(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_destroy(&sync->lock);
+#endif
+}
+
+/**
+ * @brief      Take the writer mutex without changing the sequence counter, for calls that only read.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_lock(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_lock(&sync->lock);
+#endif
+}
+
+/**
+ * @brief      Release the writer mutex.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_unlock(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_unlock(&sync->lock);
+#endif
+}
+
+/**
+ * @brief      Take the writer mutex and make the sequence counter odd.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_write_begin(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_lock(&sync->lock);
+	__atomic_store_n(&sync->seq, sync->seq + 1, __ATOMIC_RELAXED);
+	// the odd counter has to be visible before any of the changes
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+	sync->seq++;
+#endif
+}
+
+/**
+ * @brief      Make the sequence counter even and release the writer mutex.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_write_end(gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	__atomic_store_n(&sync->seq, sync->seq + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&sync->lock);
+#else
+	sync->seq++;
+#endif
+}
+
+/**
+ * @brief      Start a lock-free read, waits while a writer is busy.
+ *
+ * @param[in]  sync  The synchronization state.
+ *
+ * @return     The sequence counter, to be passed to gp_nvm_sync_read_retry.
+ */
+uint32_t
+gp_nvm_sync_read_begin(const gp_nvm_sync_t *sync)
+{
+#if GP_NVM_CONF_THREADS
+	uint32_t seq;
+	while( (seq = __atomic_load_n(&sync->seq, __ATOMIC_ACQUIRE)) & 1 ){
+		// writes include NVM I/O, so give the writer the CPU instead of spinning
+		sched_yield();
+	}
+	return seq;
+#else
+	return sync->seq;
+#endif
+}
+
+/**
+ * @brief      Check if a writer changed the state since gp_nvm_sync_read_begin.
+ *
+ * @param[in]  sync  The synchronization state.
+ * @param[in]  seq   The sequence counter returned by gp_nvm_sync_read_begin.
+ *
+ * @return     1: The read has to be retried.
+ * @return     0: Everything that was read is consistent.
+ */
+int
+gp_nvm_sync_read_retry(	const gp_nvm_sync_t *sync,
+						uint32_t seq)
+{
+#if GP_NVM_CONF_THREADS
+	// the reads of the caller have to complete before the counter is checked again
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&sync->seq, __ATOMIC_RELAXED) != seq;
+#else
+	return sync->seq != seq;
+#endif
+}
+
+/** @} */
@@ -0,0 +1,131 @@
+/**
+ * \addtogroup gp-nvm-lib
+ * @{
+ */
+
+/**
+ * \file 	gp-nvm-sync.h
+ * \brief	Header file for the synchronization of the general purpose NVM library.
+ * \author	Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * Writers serialize on a mutex and make the sequence counter odd while they change the index or the NVM.
+ * Readers don't take the mutex: they remember the sequence counter before the read and retry the read
+ * when the counter changed afterwards (a seqlock). A reader can therefore see a half-updated index, so
+ * memory that readers may still use (e.g. the slots of the index before it grew) is only released when
+ * the library is initialized again.
+ * The sequence counter also tells callers that hold a view of a value if the store changed since.
+ * Without GP_NVM_CONF_THREADS the functions only maintain the sequence counter.
+ */
+
+#ifndef __GP_NVM_SYNC_H__
+#define __GP_NVM_SYNC_H__
+
+#include <stdint.h>
+
+/**
+ * @brief      Set to 0 to build the library for a single thread without pthreads.
+ *
+ */
+#ifndef GP_NVM_CONF_THREADS
+#define GP_NVM_CONF_THREADS 1
+#endif
+
+#if GP_NVM_CONF_THREADS
+#include <pthread.h>
+#endif
+
+/**
+ * @brief      Writer mutex and sequence counter.
+ *
+ */
+typedef struct gp_nvm_sync {
+#if GP_NVM_CONF_THREADS
+	pthread_mutex_t lock;
+#endif
+	uint32_t seq;
+} gp_nvm_sync_t;
+
+/**
+ * @brief      Static initializer of gp_nvm_sync_t.
+ *
+ */
+#if GP_NVM_CONF_THREADS
+#define GP_NVM_SYNC_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, 0 }
+#else
+#define GP_NVM_SYNC_INITIALIZER { 0 }
+#endif
+
+/**
+ * @brief      Initialize a synchronization state that isn't statically initialized.
+ *
+ * @param[out] sync  The synchronization state.
+ */
+void
+gp_nvm_sync_init(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Release a synchronization state initialized with gp_nvm_sync_init.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_deinit(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Take the writer mutex without changing the sequence counter, for calls that only read.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_lock(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Release the writer mutex.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_unlock(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Take the writer mutex and make the sequence counter odd.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_write_begin(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Make the sequence counter even and release the writer mutex.
+ *
+ * @param[in]  sync  The synchronization state.
+ */
+void
+gp_nvm_sync_write_end(gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Start a lock-free read, waits while a writer is busy.
+ *
+ * @param[in]  sync  The synchronization state.
+ *
+ * @return     The sequence counter, to be passed to gp_nvm_sync_read_retry.
+ */
+uint32_t
+gp_nvm_sync_read_begin(const gp_nvm_sync_t *sync);
+
+/**
+ * @brief      Check if a writer changed the state since gp_nvm_sync_read_begin.
+ *
+ * @param[in]  sync  The synchronization state.
+ * @param[in]  seq   The sequence counter returned by gp_nvm_sync_read_begin.
+ *
+ * @return     1: The read has to be retried.
+ * @return     0: Everything that was read is consistent.
+ */
+int
+gp_nvm_sync_read_retry(	const gp_nvm_sync_t *sync,
+						uint32_t seq);
+
+#endif /* __GP_NVM_SYNC_H__ */
+
+/** @} */
@@ -14,195 +14,3104 @@
 
 // Uses following header(s)
 #include "nvm.h"
+#include "gp-nvm-store.h"
+#include "gp-nvm-heap.h"
+#include "gp-nvm-log.h"
+#include "gp-nvm-checkpoint.h"
+#include "gp-nvm-batch.h"
+#include "gp-nvm-export.h"
+#include "gp-nvm-schema.h"
+#include "gp-nvm-cache.h"
+#include "gp-nvm-sync.h"
+#include "gp-nvm-async.h"
+#include "gp-nvm-stats.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /**
- * @brief      Maximum number of attributes in the NVM.
- * 
+ * @brief      Shard of a context: a store on its own NVM device with its own writer mutex and cache.
+ *
+ * The cache is disabled when it has no entries.
  */
-#define MAX_ATTRS 10
+typedef struct gp_nvm_shard {
+	gp_nvm_sync_t sync;
+	gp_nvm_store_t store;
+	gp_nvm_cache_t cache;
+	uint32_t cache_flush_interval;
+	uint64_t cache_last_flush;
+} gp_nvm_shard_t;
 
 /**
- * @brief      Attribute list entry.
- * 
- * This structure consists of the attribute identifier, length and offset in NVM.
+ * @brief      Context of an independent attribute store.
+ *
+ * Attributes are spread over the shards by a hash of their ID. The mutex of the context only protects
+ * the batch that is being staged. The asynchronous sets of a shard are staged in the async batch, which
+ * is only used by the I/O worker.
+ */
+struct gp_nvm_ctx {
+	gp_nvm_sync_t sync;
+	gp_nvm_shard_t *shards;
+	uint32_t num_shards;
+	int owns_devs;
+	gp_nvm_batch_t batch;
+	gp_nvm_async_t async;
+	gp_nvm_batch_t async_batch;
+};
+
+/**
+ * @brief      Shard of the default context.
+ *
+ */
+static gp_nvm_shard_t default_shard = { .sync = GP_NVM_SYNC_INITIALIZER };
+
+/**
+ * @brief      Default context, used by the functions without a context and backed by the default NVM device.
+ *
+ */
+static gp_nvm_ctx_t default_ctx = { .sync = GP_NVM_SYNC_INITIALIZER, .shards = &default_shard, .num_shards = 1 };
+
+/**
+ * @brief      Stream that writes the value of an attribute straight into its reserved record.
+ *
+ * The header is the header the record gets when the stream is committed, its CRC is updated with every chunk.
+ * Pos is the number of bytes of the value that were written.
  */
-typedef struct attr_list_entry {
-	gp_nvm_attr_id_t attr_id;
-	uint8_t len;
+struct gp_nvm_stream {
+	gp_nvm_shard_t *shard;
 	uint32_t offset;
-} attr_list_entry_t;
+	uint32_t pos;
+	gp_nvm_record_hdr_t hdr;
+};
 
 /**
- * @brief      Attribute list.
- * 
- * This structure contains the number of entries, the total size and an array of entries.
+ * @brief      Monotonic time in milliseconds.
+ *
  */
-typedef struct attr_list {
-	uint8_t num_entries;
-	uint32_t total_size;
-	attr_list_entry_t entries[MAX_ATTRS];
-} attr_list_t;
+static uint64_t
+_gp_nvm_now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
 /**
- * @brief      Attribute list declaration.
- * 
- * The attribute list is also maintained in RAM memory for fast look-up.
- * Every change is synced on the NVM.
- * 
+ * @brief      Shard that stores an attribute.
+ *
+ * The shard is picked with a multiplicative hash, independent of the hash of the index in the shard.
+ * The static attributes are stored in the first shard.
  */
-attr_list_t attrs;
+static gp_nvm_shard_t*
+_gp_nvm_shard_of(const gp_nvm_ctx_t *ctx, uint32_t attr_id)
+{
+	if( ctx->num_shards == 1 || gp_nvm_schema_slot_of(attr_id) != GP_NVM_NUM_SLOTS ){
+		return &ctx->shards[0];
+	}
+	return &ctx->shards[((uint64_t) (attr_id * 0x9e3779b1u) * ctx->num_shards) >> 32];
+}
 
 /**
- * @brief      This function initializes the general purpose non-volatile memory library.
+ * @brief      Write a checkpoint of the index of a store with its storage engine.
+ *
+ * Nothing is written while a stream is open, the checkpoint wouldn't know the record of the stream.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
  */
-void
-gp_nvm_init()
+static gp_nvm_result_t
+_gp_nvm_store_checkpoint(gp_nvm_store_t *store)
 {
-	// clear whatever data is currently in attrs
-	memset(&attrs, 0, sizeof(attr_list_t));
-	// read correct attr_list from nvm
-	if( nvm_read(0, sizeof(attr_list_t), &attrs) != 0 ){
-		// attr list does not exist yet
-		nvm_append(0, sizeof(attr_list_t), &attrs);
+	if( store->streams > 0 ){
+		return GP_NVM_SUCCESS;
 	}
-	printf("GP-NVM: printing attr list at boot-time.\n");
-	printf("\t num_entries = %u, total size = %u\n", attrs.num_entries, attrs.total_size);
-	for( int i = 0; i<attrs.num_entries; i++ ){
-		printf("\t [%d] = { attr_id: %u, offset: %u, len: %u\n", i, attrs.entries[i].attr_id, attrs.entries[i].offset, attrs.entries[i].len);
+	if( store->engine == GP_NVM_ENGINE_LOG ){
+		return gp_nvm_log_checkpoint(store);
 	}
+	return gp_nvm_heap_checkpoint(store);
 }
 
 /**
- * @brief      Allows to search for an entry in the attribute list based on the attribute ID.
+ * @brief      Write a checkpoint after a successful change, once the store changed interval times since the last one.
  *
- * @param[in]  attr_id  The att.ribute identifier
+ * The result of the change is returned when no checkpoint is written.
  *
- * @return     NULL: No entry was found.
- * @return     attr_list_entry_t*: Pointer to the entry in the attribute list.
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
  */
-attr_list_entry_t*
-_gp_nvm_get_attr_list_entry(gp_nvm_attr_id_t attr_id)
+static gp_nvm_result_t
+_gp_nvm_store_tick(gp_nvm_store_t *store, gp_nvm_result_t result)
 {
-	attr_list_entry_t* attr = NULL;
-	int i = 0;
-	while( i<attrs.num_entries && attr == NULL ){
-		if( attrs.entries[i].attr_id == attr_id ){
-			attr = &attrs.entries[i];
-		}
-		i++;
+	if( result != GP_NVM_SUCCESS || store->ckpt.interval == 0 || store->ckpt.writes < store->ckpt.interval ){
+		return result;
 	}
-	return attr;
+	return _gp_nvm_store_checkpoint(store);
 }
 
 /**
- * @brief      Get an attribute based on attribute ID.
- * 
- * This function searches for the attribute in NVM.
- * If found, it copies both the length and value into the respective pointers provides as parameters.
+ * @brief      Compress a value for a store when compression is enabled and it saves space.
  *
- * @param[in]  attr_id   The attribute identifier
- * @param[out] p_length  Pointer were the length can be stored.
- * @param[out] p_value   Pointer were the value can be stored.
+ * @param[in]  store         The attribute store.
+ * @param[in]  length        The length of the value.
+ * @param[in]  p_value       Pointer to the value in RAM.
+ * @param[out] p_stored_len  Pointer were the length of the compressed value can be stored.
+ *
+ * @return     The value compressed with GP_NVM_CODEC_LZ and allocated with malloc, NULL when the value is stored as is.
+ */
+static uint8_t*
+_gp_nvm_compress(	const gp_nvm_store_t *store,
+					uint32_t length,
+					const uint8_t* p_value,
+					uint32_t *p_stored_len)
+{
+	if( store->compress_min_len == 0 || length < store->compress_min_len || length < 2 ){
+		return NULL;
+	}
+	// only a value that is at least one byte shorter is worth decompressing
+	uint8_t *p_stored = malloc(length - 1);
+	uint32_t len = p_stored != NULL ? gp_nvm_codec_compress(p_value, length, p_stored, length - 1) : 0;
+	if( len == 0 ){
+		free(p_stored);
+		return NULL;
+	}
+	GP_NVM_STATS_ADD(compressed_values, 1);
+	GP_NVM_STATS_ADD(compressed_saved_bytes, length - len);
+	*p_stored_len = len;
+	return p_stored;
+}
+
+/**
+ * @brief      Store an attribute with the storage engine of a shard, this bypasses the cache.
+ *
+ * This is also the write-back callback of the cache of the shard. The value is compressed here.
  *
  * @return     0: GP_NVM_SUCCESS
- * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
  * @return     5: GP_NVM_MEM_ERROR
  */
-gp_nvm_result_t
-gp_nvm_get_attribute(	gp_nvm_attr_id_t attr_id,
-						uint8_t* p_length,
-						uint8_t* p_value)
+static gp_nvm_result_t
+_gp_nvm_store_set(void *arg, uint32_t attr_id, uint32_t length, const uint8_t* p_value)
 {
-	// lookup attr_id in attrs list
-	attr_list_entry_t* attr = _gp_nvm_get_attr_list_entry(attr_id);
-	if( attr == NULL ){
-		return GP_NVM_ATTR_NOT_FOUND;
+	gp_nvm_store_t *store = &((gp_nvm_shard_t*) arg)->store;
+	uint32_t codec = GP_NVM_CODEC_NONE;
+	uint32_t stored_len;
+	gp_nvm_result_t result = gp_nvm_checkpoint_touch(store);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	uint8_t *stored = _gp_nvm_compress(store, length, p_value, &stored_len);
+	if( stored != NULL ){
+		codec = GP_NVM_CODEC_LZ;
+		length = stored_len;
+		p_value = stored;
 	}
+	// the log engine appends a new record for every set
+	if( store->engine == GP_NVM_ENGINE_LOG ){
+		result = gp_nvm_log_set(store, attr_id, length, p_value, codec);
+	} else {
+		result = gp_nvm_heap_set(store, attr_id, length, p_value, codec);
+	}
+	free(stored);
+	return _gp_nvm_store_tick(store, result);
+}
 
-	// read attr data from nvm and copy in value pointer
-	if( nvm_read(attr->offset, attr->len, p_value) ){
-		return GP_NVM_MEM_ERROR;
+/**
+ * @brief      Commit a batch with the storage engine of a store.
+ *
+ * The staged values are compressed in place first, a compressed value is shorter so it fits where it was staged.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_store_commit(gp_nvm_store_t *store, gp_nvm_batch_t *batch)
+{
+	uint32_t stored_len;
+	gp_nvm_result_t result = gp_nvm_checkpoint_touch(store);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
 	}
-	// copy len into len pointer
-	*p_length = attr->len;
+	for( uint32_t i = 0; i<batch->num_entries; i++ ){
+		gp_nvm_batch_entry_t *entry = &batch->entries[i];
+		uint8_t *stored = entry->codec == GP_NVM_CODEC_NONE ? _gp_nvm_compress(store, entry->len, batch->data + entry->data, &stored_len) : NULL;
+		if( stored != NULL ){
+			memcpy(batch->data + entry->data, stored, stored_len);
+			entry->len = stored_len;
+			entry->codec = GP_NVM_CODEC_LZ;
+			free(stored);
+		}
+	}
+	if( store->engine == GP_NVM_ENGINE_LOG ){
+		result = gp_nvm_log_commit(store, batch);
+	} else {
+		result = gp_nvm_heap_commit(store, batch);
+	}
+	return _gp_nvm_store_tick(store, result);
+}
 
-	return GP_NVM_SUCCESS;
+/**
+ * @brief      Write back the cache of a shard when the flush interval passed.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_cache_tick(gp_nvm_shard_t *shard)
+{
+	if( shard->cache_flush_interval == 0 || shard->cache.dirty == 0 ){
+		return GP_NVM_SUCCESS;
+	}
+	uint64_t now = _gp_nvm_now_ms();
+	if( now - shard->cache_last_flush < shard->cache_flush_interval ){
+		return GP_NVM_SUCCESS;
+	}
+	shard->cache_last_flush = now;
+	return gp_nvm_cache_flush(&shard->cache);
 }
 
 /**
- * @brief      Set an attribute based on the attribute ID.
- * 
- * This function tries to update an attribute on the NVM.
- * If found, it checks if the lenght is correct and copies the value retrieved from the p_value pointer.
- * If not found, it will append the attribute to the list and update the attribute list structure.
+ * @brief      Print the attribute index of a store.
  *
- * @param[in]  attr_id  The attribute identifier
- * @param[in]  length   The length of the attribute
- * @param[in]  p_value  Pointer to the value in RAM.
+ */
+static void
+_gp_nvm_print_index(const gp_nvm_store_t *store)
+{
+	uint32_t n = 0;
+	printf("GP-NVM: printing attr list at boot-time.\n");
+	printf("\t num_entries = %u, engine = %u\n", store->index.num_entries, store->engine);
+	for( uint32_t i = 0; i<store->index.num_slots; i++ ){
+		if( store->index.ctrl[i] != 0 ){
+			printf("\t [%u] = { attr_id: %u, offset: %u, len: %u\n", n++, store->index.ids[i], store->index.entries[i].offset, store->index.entries[i].len);
+		}
+	}
+}
+
+/**
+ * @brief      Release the cache and the store of a shard, dirty values are written back first.
+ *
+ * With checkpoint set, a checkpoint is written afterwards when automatic checkpoints are enabled.
  *
  * @return     0: GP_NVM_SUCCESS
- * @return     3: GP_NVM_ATTR_LEN_DIFF
  * @return     4: GP_NVM_MEM_FULL
  * @return     5: GP_NVM_MEM_ERROR
  */
-gp_nvm_result_t
-gp_nvm_set_attribute(	gp_nvm_attr_id_t attr_id,
-						uint8_t length,
-						uint8_t* p_value)
+static gp_nvm_result_t
+_gp_nvm_shard_close(gp_nvm_shard_t *shard, int checkpoint)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	if( shard->cache.entries != NULL && (result = gp_nvm_cache_flush(&shard->cache)) != GP_NVM_SUCCESS ){
+		fprintf(stderr, "GP-NVM: dropping dirty values of the cache\n");
+	}
+	// the interval is only set once the store is open
+	if( result == GP_NVM_SUCCESS && checkpoint && shard->store.ckpt.interval > 0 ){
+		result = _gp_nvm_store_checkpoint(&shard->store);
+	}
+	gp_nvm_cache_deinit(&shard->cache);
+	gp_nvm_index_deinit(&shard->store.index);
+	gp_nvm_heap_close(&shard->store);
+	gp_nvm_log_close(&shard->store);
+	gp_nvm_checkpoint_deinit(&shard->store);
+	gp_nvm_store_release_image(&shard->store);
+	shard->store.seq = 0;
+	shard->store.end = 0;
+	return result;
+}
+
+/**
+ * @brief      Open the store of a shard on an NVM device, an empty NVM is formatted.
+ *
+ * A store that was open before is closed first. The caller holds the writer mutex of the shard.
+ *
+ * @param[in]  shard       The shard.
+ * @param[in]  dev         The NVM device of the shard.
+ * @param[in]  config      The configuration.
+ * @param[in]  num_shards  The number of shards of the context, 0 if the context isn't sharded.
+ * @param[in]  schema      1 when the shard holds the static attributes, see gp-nvm-schema.h.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_open(	gp_nvm_shard_t *shard,
+					nvm_dev_t *dev,
+					const gp_nvm_config_t *config,
+					uint32_t num_shards,
+					int schema)
 {
-	// lookup attr_id in attrs list
-	attr_list_entry_t* attr = _gp_nvm_get_attr_list_entry(attr_id);
+	gp_nvm_store_t *store = &shard->store;
+	uint32_t schema_size = schema ? gp_nvm_schema_size() : 0;
+	uint32_t schema_crc = schema ? gp_nvm_schema_crc() : 0;
+	gp_nvm_superblock_t sb;
+	gp_nvm_result_t result;
+
+	// clear whatever data is currently in the store, the device may have been replaced meanwhile
+	_gp_nvm_shard_close(shard, 0);
+	store->dev = dev;
+	if( gp_nvm_index_init_shared(&store->index) != 0 ){
+		return GP_NVM_MEM_FULL;
+	}
+
+	// the superblock, the checkpoint and the records are read from the image while the store is opened,
+	// gets still work without the image, they just read the NVM
+	if( config->preload && gp_nvm_store_preload(store) != 0 ){
+		fprintf(stderr, "GP-NVM: preload failed, the NVM is read record by record\n");
+	}
 
-	//add attribute if it doesn't exist yet
-	if(attr == NULL){
-		// check if attr list can still grow
-		if( attrs.num_entries == MAX_ATTRS ) {
+	// read superblock from nvm
+	if( nvm_dev_size(dev) < sizeof(sb) || gp_nvm_store_read(store, 0, sizeof(sb), &sb) != 0 ){
+		// nvm is not formatted yet
+		memset(&sb, 0, sizeof(sb));
+		sb.magic = GP_NVM_MAGIC;
+		sb.version = GP_NVM_VERSION;
+		sb.engine = config->engine;
+		sb.num_shards = num_shards;
+		sb.schema_size = schema_size;
+		sb.schema_crc = schema_crc;
+		if( config->engine == GP_NVM_ENGINE_LOG ){
+			sb.segment_size = config->log_segment_size ? config->log_segment_size : GP_NVM_LOG_DEFAULT_SEGMENT_SIZE;
+			// the static attributes are kept before the first segment
+			if( GP_NVM_DATA_START + schema_size > sb.segment_size ){
+				fprintf(stderr, "GP-NVM: the static attributes don't fit before the first log segment\n");
+				return GP_NVM_MEM_ERROR;
+			}
+		}
+		sb.crc = gp_nvm_crc32c(0, &sb, offsetof(gp_nvm_superblock_t, crc));
+		// the anchor slots are empty until the first checkpoint, the slots of the static attributes until they are set
+		uint8_t *head = calloc(1, GP_NVM_DATA_START + schema_size);
+		if( head == NULL ){
 			return GP_NVM_MEM_FULL;
 		}
+		memcpy(head, &sb, sizeof(sb));
+		int error = nvm_dev_append(dev, 0, GP_NVM_DATA_START + schema_size, head);
+		free(head);
+		if( error != 0 ){
+			return GP_NVM_MEM_ERROR;
+		}
+	}
+	if( sb.magic != GP_NVM_MAGIC || sb.version != GP_NVM_VERSION ){
+		fprintf(stderr, "GP-NVM: unknown NVM format, recreate the NVM\n");
+		return GP_NVM_MEM_ERROR;
+	}
+	if( sb.crc != gp_nvm_crc32c(0, &sb, offsetof(gp_nvm_superblock_t, crc)) ){
+		fprintf(stderr, "GP-NVM: CRC error in superblock\n");
+		return GP_NVM_CRC_ERROR;
+	}
+	// attributes would be looked up in the wrong shard
+	if( sb.num_shards != num_shards ){
+		fprintf(stderr, "GP-NVM: NVM was formatted for %u shards, not %u\n", sb.num_shards, num_shards);
+		return GP_NVM_MEM_ERROR;
+	}
+	// the static attributes would be read from the wrong slots
+	if( sb.schema_size != schema_size || sb.schema_crc != schema_crc ){
+		fprintf(stderr, "GP-NVM: NVM was formatted for another attribute schema\n");
+		return GP_NVM_MEM_ERROR;
+	}
+	store->data_start = GP_NVM_DATA_START + sb.schema_size;
 
-		// write attr to mem
-		if( nvm_append(sizeof(attr_list_t) + attrs.total_size, length, p_value) != 0 ){
+	store->engine = sb.engine;
+	switch( store->engine ){
+		case GP_NVM_ENGINE_IN_PLACE:
+			result = gp_nvm_heap_open(store);
+			break;
+		case GP_NVM_ENGINE_LOG:
+			if( sb.segment_size <= GP_NVM_DATA_START || sb.segment_size < store->data_start ){
+				return GP_NVM_MEM_ERROR;
+			}
+			result = gp_nvm_log_open(store, sb.segment_size, config->log_compact_threshold);
+			break;
+		default:
+			fprintf(stderr, "GP-NVM: unknown engine %u\n", sb.engine);
 			return GP_NVM_MEM_ERROR;
+	}
+
+	if( result == GP_NVM_SUCCESS ){
+		store->ckpt.interval = config->checkpoint_interval;
+		store->compress_min_len = config->compress_min_len;
+	}
+	if( result == GP_NVM_SUCCESS && config->cache_size > 0 ){
+		if( gp_nvm_cache_init(&shard->cache, config->cache_size, _gp_nvm_store_set, shard) != 0 ){
+			return GP_NVM_MEM_FULL;
 		}
+		shard->cache_flush_interval = config->cache_flush_interval;
+		shard->cache_last_flush = _gp_nvm_now_ms();
+	}
+	return result;
+}
 
-		// add new attr in list
-		attrs.entries[attrs.num_entries].attr_id = attr_id;
-		attrs.entries[attrs.num_entries].offset = sizeof(attr_list_t) + attrs.total_size;
-		attrs.entries[attrs.num_entries].len = length;
-		attrs.total_size += length;
-		attrs.num_entries++;
+/**
+ * @brief      Make the writes of a shard durable after a successful change, see nvm_arch_dev_sync.
+ *
+ * The caller doesn't hold the writer mutex, so a group commit can cover the changes of other threads.
+ * The result of the change is returned when the sync succeeds.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_sync(gp_nvm_shard_t *shard, gp_nvm_result_t result)
+{
+	if( result == GP_NVM_SUCCESS && nvm_dev_sync(shard->store.dev) != 0 ){
+		return GP_NVM_MEM_ERROR;
+	}
+	return result;
+}
 
-		//update attr list in mem
-		if( nvm_update(0, sizeof(attr_list_t), &attrs) != 0 ){
-			// remove attr from list
-			attrs.total_size -= length;
-			attrs.num_entries--;
-			return GP_NVM_MEM_ERROR;
+/**
+ * @brief      Set an attribute in a shard, through the cache when the shard has one.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_set(	gp_nvm_shard_t *shard,
+					uint32_t attr_id,
+					uint32_t length,
+					const uint8_t* p_value)
+{
+	// GP_NVM_FAIL means the value wasn't cached
+	gp_nvm_result_t result = GP_NVM_FAIL;
+
+	gp_nvm_sync_write_begin(&shard->sync);
+	// the value is written back later, unless it is too large for the cache
+	if( shard->cache.entries != NULL ){
+		result = gp_nvm_cache_put(&shard->cache, attr_id, length, p_value, 1);
+		if( result == GP_NVM_SUCCESS ){
+			result = _gp_nvm_cache_tick(shard);
 		}
-		return GP_NVM_SUCCESS;
 	}
+	if( result == GP_NVM_FAIL ){
+		result = _gp_nvm_store_set(shard, attr_id, length, p_value);
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+	return result;
+}
+
+/**
+ * @brief      Delete an attribute in a shard, its cache entry is dropped.
+ *
+ * An attribute that is only in the cache was never written back, dropping its entry deletes it.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_delete(	gp_nvm_shard_t *shard,
+						uint32_t attr_id)
+{
+	gp_nvm_store_t *store = &shard->store;
+	gp_nvm_result_t result = GP_NVM_ATTR_NOT_FOUND;
+
+	gp_nvm_sync_write_begin(&shard->sync);
+	if( shard->cache.entries != NULL && gp_nvm_cache_invalidate(&shard->cache, attr_id) ){
+		result = GP_NVM_SUCCESS;
+	}
+	if( gp_nvm_index_find(&store->index, attr_id) != NULL && (result = gp_nvm_checkpoint_touch(store)) == GP_NVM_SUCCESS ){
+		if( store->engine == GP_NVM_ENGINE_LOG ){
+			result = gp_nvm_log_delete(store, attr_id);
+		} else {
+			result = gp_nvm_heap_delete(store, attr_id);
+		}
+		result = _gp_nvm_store_tick(store, result);
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+	return result;
+}
+
+/**
+ * @brief      Store a group of asynchronous sets of different attributes, this runs in the I/O worker.
+ *
+ * The sets of every shard are committed like a batch, so records that are adjacent on the NVM are written
+ * with one vectored write. A shard with a cache absorbs the sets in the cache instead. When the group
+ * doesn't fit (e.g. in one log segment) the sets are stored one by one.
+ */
+static void
+_gp_nvm_async_store(void *arg, gp_nvm_async_entry_t **entries, uint32_t num_entries)
+{
+	gp_nvm_ctx_t *ctx = arg;
+	gp_nvm_batch_t *batch = &ctx->async_batch;
+
+	for( uint32_t s = 0; s<ctx->num_shards; s++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[s];
+		gp_nvm_result_t result = GP_NVM_MEM_FULL;
+		int staged = 1;
+
+		gp_nvm_batch_init(batch);
+		for( uint32_t i = 0; i<num_entries && staged; i++ ){
+			if( _gp_nvm_shard_of(ctx, entries[i]->attr_id) == shard &&
+				gp_nvm_batch_stage(batch, entries[i]->attr_id, entries[i]->len, entries[i]->value) != 0 ){
+				staged = 0;
+			}
+		}
+		if( batch->num_entries == 0 ){
+			continue;
+		}
+
+		if( staged && batch->num_entries > 1 && shard->cache.entries == NULL ){
+			gp_nvm_sync_write_begin(&shard->sync);
+			result = _gp_nvm_store_commit(&shard->store, batch);
+			gp_nvm_sync_write_end(&shard->sync);
+		}
+		for( uint32_t i = 0; i<num_entries; i++ ){
+			gp_nvm_async_entry_t *entry = entries[i];
+			if( _gp_nvm_shard_of(ctx, entry->attr_id) != shard ){
+				continue;
+			}
+			if( result == GP_NVM_MEM_FULL ){
+				entry->result = _gp_nvm_shard_set(shard, entry->attr_id, entry->len, entry->value);
+			} else {
+				entry->result = result;
+			}
+		}
+		// one sync covers all sets of the shard, they only complete once they are durable
+		if( nvm_dev_sync(shard->store.dev) != 0 ){
+			for( uint32_t i = 0; i<num_entries; i++ ){
+				if( _gp_nvm_shard_of(ctx, entries[i]->attr_id) == shard && entries[i]->result == GP_NVM_SUCCESS ){
+					entries[i]->result = GP_NVM_MEM_ERROR;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief      Read the value of an attribute from the NVM, a compressed value is decompressed in p_value.
+ *
+ * This also runs without the writer mutex, so every field of the index entry is read once.
+ * A compressed value that can't be decompressed is reported as a CRC error.
+ *
+ * @param[in]  store     The store.
+ * @param[in]  index     The index of the store, or a copy of it.
+ * @param[in]  attr_id   The attribute identifier.
+ * @param[in]  size      The size of the buffer at p_value, nothing beyond it is written.
+ * @param[out] p_length  Pointer were the length can be stored, also the length the value needs when it doesn't fit.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_read(	const gp_nvm_store_t *store,
+				const gp_nvm_index_t *index,
+				uint32_t attr_id,
+				uint32_t size,
+				uint32_t* p_length,
+				uint8_t* p_value)
+{
+	// lookup attr_id in the index
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(index, attr_id);
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	uint32_t offset = attr->offset;
+	uint32_t len = attr->len;
+	uint32_t crc = attr->crc;
+	uint32_t codec = attr->codec;
+	uint8_t *p_stored = p_value;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
 
-	// check if the lengths match (var length arrays are not possible)
-	/**
-	* \todo Enable variable length arrays.
-	*/
-	if( attr->len != length ){
+	if( codec == GP_NVM_CODEC_NONE && len > size ){
+		*p_length = len;
 		return GP_NVM_ATTR_LEN_DIFF;
 	}
+	if( codec != GP_NVM_CODEC_NONE && (p_stored = malloc(len)) == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	// read attr data from nvm and copy in value pointer
+	if( gp_nvm_store_read(store, offset + sizeof(gp_nvm_record_hdr_t), len, p_stored) ){
+		result = GP_NVM_MEM_ERROR;
+	} else if( gp_nvm_crc32c(0, p_stored, len) != crc ){
+		result = GP_NVM_CRC_ERROR;
+	} else if( codec != GP_NVM_CODEC_NONE ){
+		// the length of the decompressed value is known before anything is written to the buffer
+		uint32_t raw_len;
+		if( gp_nvm_codec_length(codec, p_stored, len, &raw_len) != 0 ){
+			result = GP_NVM_CRC_ERROR;
+		} else if( raw_len > size ){
+			*p_length = raw_len;
+			result = GP_NVM_ATTR_LEN_DIFF;
+		} else if( gp_nvm_codec_decompress(codec, p_stored, len, p_value, size, &len) != 0 ){
+			result = GP_NVM_CRC_ERROR;
+		}
+	}
+	if( p_stored != p_value ){
+		free(p_stored);
+	}
+	if( result == GP_NVM_SUCCESS ){
+		*p_length = len;
+	}
+	return result;
+}
+
+/**
+ * @brief      Get the length of the value of an attribute, for a compressed value only its start is read.
+ *
+ * Like _gp_nvm_read this runs without the writer mutex.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_length(	const gp_nvm_store_t *store,
+				const gp_nvm_index_t *index,
+				uint32_t attr_id,
+				uint32_t* p_length)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(index, attr_id);
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	uint32_t offset = attr->offset;
+	uint32_t len = attr->len;
+	uint32_t codec = attr->codec;
+	uint8_t head[GP_NVM_CODEC_MAX_HEADER];
 
-	// update attr data in nvm
-	if( nvm_update(attr->offset, attr->len, p_value) != 0 ){
+	if( codec == GP_NVM_CODEC_NONE ){
+		*p_length = len;
+		return GP_NVM_SUCCESS;
+	}
+	if( len > sizeof(head) ){
+		len = sizeof(head);
+	}
+	if( gp_nvm_store_read(store, offset + sizeof(gp_nvm_record_hdr_t), len, head) ){
 		return GP_NVM_MEM_ERROR;
 	}
+	if( gp_nvm_codec_length(codec, head, len, p_length) != 0 ){
+		return GP_NVM_CRC_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
 
+/**
+ * @brief      Read the complete value of an attribute into a buffer allocated with malloc.
+ *
+ * Like _gp_nvm_read this runs without the writer mutex. The caller frees the buffer.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_load(	const gp_nvm_store_t *store,
+				const gp_nvm_index_t *index,
+				uint32_t attr_id,
+				uint32_t* p_length,
+				uint8_t** p_value)
+{
+	uint32_t len;
+	gp_nvm_result_t result = _gp_nvm_length(store, index, attr_id, &len);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	// a value of 0 bytes still gets a buffer
+	uint8_t *value = malloc(len > 0 ? len : 1);
+	if( value == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	result = _gp_nvm_read(store, index, attr_id, len, p_length, value);
+	if( result != GP_NVM_SUCCESS ){
+		free(value);
+		return result;
+	}
+	*p_value = value;
 	return GP_NVM_SUCCESS;
 }
 
-// howto add var length arrays:
-// option a) include max_length when setting attribute so enough mem can be allocated
-// option b) move attr with higher offset backward/forward in NVM when length differs
-// 			also update offsets in attr_list with int offset_diff = new_len - old_len 
+/**
+ * @brief      Read a range of the value of an attribute from the NVM.
+ *
+ * Like _gp_nvm_read this runs without the writer mutex. Only the range is read, so the CRC of the value
+ * can't be checked. A compressed value is read and decompressed completely.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL (only for a compressed value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+static gp_nvm_result_t
+_gp_nvm_read_range(	const gp_nvm_store_t *store,
+					const gp_nvm_index_t *index,
+					uint32_t attr_id,
+					uint32_t offset,
+					uint32_t length,
+					uint8_t* p_value)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(index, attr_id);
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	uint32_t record = attr->offset;
+	uint32_t len = attr->len;
+
+	if( attr->codec != GP_NVM_CODEC_NONE ){
+		uint8_t *value;
+		gp_nvm_result_t result = _gp_nvm_load(store, index, attr_id, &len, &value);
+		if( result != GP_NVM_SUCCESS ){
+			return result;
+		}
+		if( offset > len || length > len - offset ){
+			result = GP_NVM_ATTR_LEN_DIFF;
+		} else {
+			memcpy(p_value, value + offset, length);
+		}
+		free(value);
+		return result;
+	}
+	if( offset > len || length > len - offset ){
+		return GP_NVM_ATTR_LEN_DIFF;
+	}
+	if( length > 0 && gp_nvm_store_read(store, record + sizeof(gp_nvm_record_hdr_t) + offset, length, p_value) ){
+		return GP_NVM_MEM_ERROR;
+	}
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Point a view at the value of an attribute in the memory of the NVM device.
+ *
+ * Like _gp_nvm_read this runs without the writer mutex.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed or the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_view(	nvm_dev_t *dev,
+				const gp_nvm_index_t *index,
+				uint32_t attr_id,
+				gp_nvm_view_t *p_view)
+{
+	gp_nvm_index_entry_t* attr = gp_nvm_index_find(index, attr_id);
+	if( attr == NULL ){
+		return GP_NVM_ATTR_NOT_FOUND;
+	}
+	uint32_t offset = attr->offset;
+	uint32_t len = attr->len;
+	uint32_t crc = attr->crc;
+
+	if( attr->codec != GP_NVM_CODEC_NONE ){
+		return GP_NVM_FAIL;
+	}
+	const uint8_t *p_value = nvm_dev_view(dev, offset + sizeof(gp_nvm_record_hdr_t), len);
+	if( p_value == NULL ){
+		return GP_NVM_FAIL;
+	}
+	if( gp_nvm_crc32c(0, p_value, len) != crc ){
+		return GP_NVM_CRC_ERROR;
+	}
+	p_view->p_value = p_value;
+	p_view->length = len;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Read a range of the value of a static attribute from its slot, the shard is the first shard of the context.
+ *
+ * Static attributes never go through the cache, so this runs without the writer mutex like a get without
+ * the cache and retries when a writer changed the shard meanwhile.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_slot_read(	gp_nvm_shard_t *shard,
+					uint32_t slot,
+					uint32_t offset,
+					uint32_t length,
+					uint8_t* p_value)
+{
+	for( ;; ){
+		uint32_t seq = gp_nvm_sync_read_begin(&shard->sync);
+		gp_nvm_result_t result = gp_nvm_schema_read(&shard->store, slot, offset, length, p_value);
+		if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			return result;
+		}
+	}
+}
+
+/**
+ * @brief      Overwrite a range of the value of a static attribute in its slot, the shard is the first shard of the context.
+ *
+ * A range that covers the complete value is written without reading the old value.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_slot_write(	gp_nvm_shard_t *shard,
+					uint32_t slot,
+					uint32_t offset,
+					uint32_t length,
+					const uint8_t* p_value)
+{
+	gp_nvm_result_t result;
+
+	gp_nvm_sync_write_begin(&shard->sync);
+	if( offset == 0 && length == gp_nvm_schema_len(slot) ){
+		result = gp_nvm_schema_write(&shard->store, slot, p_value);
+	} else {
+		result = gp_nvm_schema_update(&shard->store, slot, offset, length, p_value);
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+	return _gp_nvm_shard_sync(shard, result);
+}
+
+/**
+ * @brief      Get an attribute through the cache of a shard, the caller holds the writer mutex.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes, p_length is set to its length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_get_cached(	gp_nvm_shard_t *shard,
+					uint32_t attr_id,
+					uint32_t size,
+					uint32_t* p_length,
+					uint8_t* p_value)
+{
+	uint32_t length;
+
+	// serve the value from the cache
+	if( gp_nvm_cache_get(&shard->cache, attr_id, size, p_length, p_value) ){
+		return *p_length > size ? GP_NVM_ATTR_LEN_DIFF : _gp_nvm_cache_tick(shard);
+	}
+
+	gp_nvm_result_t result = _gp_nvm_read(&shard->store, &shard->store.index, attr_id, size, &length, p_value);
+	if( result == GP_NVM_ATTR_LEN_DIFF ){
+		*p_length = length;
+	}
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	*p_length = length;
+
+	// a failure to cache the value doesn't affect the get
+	gp_nvm_cache_put(&shard->cache, attr_id, length, p_value, 0);
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Overwrite a range of the value of an attribute with the storage engine of a shard, this bypasses the cache.
+ *
+ * The log engine never overwrites a record and a compressed value can't be patched, so then the complete
+ * value is set again with the range patched in.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_store_update_range(	gp_nvm_shard_t *shard,
+							uint32_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							const uint8_t* p_value)
+{
+	gp_nvm_store_t *store = &shard->store;
+	uint8_t *value;
+	uint32_t len;
+	gp_nvm_result_t result;
+
+	if( store->engine != GP_NVM_ENGINE_LOG ){
+		result = gp_nvm_checkpoint_touch(store);
+		if( result == GP_NVM_SUCCESS ){
+			result = gp_nvm_heap_update_range(store, attr_id, offset, length, p_value);
+		}
+		if( result != GP_NVM_FAIL ){
+			return _gp_nvm_store_tick(store, result);
+		}
+	}
+
+	result = _gp_nvm_load(store, &store->index, attr_id, &len, &value);
+	if( result != GP_NVM_SUCCESS ){
+		return result;
+	}
+	if( offset > len || length > len - offset ){
+		result = GP_NVM_ATTR_LEN_DIFF;
+	} else {
+		memcpy(value + offset, p_value, length);
+		result = _gp_nvm_store_set(shard, attr_id, len, value);
+	}
+	free(value);
+	return result;
+}
+
+/**
+ * @brief      Overwrite a range of the value of an attribute in a shard, through the cache when the shard has one.
+ *
+ * The cache may hold a value that is newer than the NVM, so a cached value is patched in the cache.
+ * A value that isn't cached is patched on the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_update_range(	gp_nvm_shard_t *shard,
+							uint32_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							const uint8_t* p_value)
+{
+	gp_nvm_result_t result;
+	uint8_t value[GP_NVM_CONF_CACHE_VALUE_SIZE];
+	uint32_t len;
+
+	gp_nvm_sync_write_begin(&shard->sync);
+	if( shard->cache.entries == NULL || !gp_nvm_cache_get(&shard->cache, attr_id, sizeof(value), &len, value) ){
+		result = _gp_nvm_store_update_range(shard, attr_id, offset, length, p_value);
+	} else if( offset > len || length > len - offset ){
+		result = GP_NVM_ATTR_LEN_DIFF;
+	} else {
+		memcpy(value + offset, p_value, length);
+		result = gp_nvm_cache_put(&shard->cache, attr_id, len, value, 1);
+		if( result == GP_NVM_SUCCESS ){
+			result = _gp_nvm_cache_tick(shard);
+		}
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+	return result;
+}
+
+/**
+ * @brief      Compare two attribute IDs (for qsort).
+ *
+ */
+static int
+_gp_nvm_cmp_id(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*) a;
+	uint32_t y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief      Write back the dirty values of the cache of a shard, so the NVM holds every attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_flush(gp_nvm_shard_t *shard)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	if( shard->cache.entries == NULL ){
+		return GP_NVM_SUCCESS;
+	}
+	gp_nvm_sync_write_begin(&shard->sync);
+	shard->cache_last_flush = _gp_nvm_now_ms();
+	result = gp_nvm_cache_flush(&shard->cache);
+	gp_nvm_sync_write_end(&shard->sync);
+	return _gp_nvm_shard_sync(shard, result);
+}
+
+/**
+ * @brief      Read the complete value of an attribute of a shard into a buffer allocated with malloc.
+ *
+ * A cached value is taken from the cache, otherwise the value is read like a get without the cache.
+ * A static attribute is read from its slot. The caller frees the buffer.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_shard_load(	gp_nvm_shard_t *shard,
+					uint32_t attr_id,
+					uint32_t* p_length,
+					uint8_t** p_value)
+{
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	gp_nvm_result_t result;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		*p_length = gp_nvm_schema_len(slot);
+		if( (*p_value = malloc(*p_length)) == NULL ){
+			return GP_NVM_MEM_FULL;
+		}
+		result = _gp_nvm_slot_read(shard, slot, 0, *p_length, *p_value);
+		if( result != GP_NVM_SUCCESS ){
+			free(*p_value);
+		}
+		return result;
+	}
+	if( shard->cache.entries != NULL ){
+		uint8_t value[GP_NVM_CONF_CACHE_VALUE_SIZE];
+		gp_nvm_sync_write_begin(&shard->sync);
+		if( !gp_nvm_cache_get(&shard->cache, attr_id, sizeof(value), p_length, value) ){
+			result = _gp_nvm_load(&shard->store, &shard->store.index, attr_id, p_length, p_value);
+		} else if( (*p_value = malloc(*p_length > 0 ? *p_length : 1)) == NULL ){
+			result = GP_NVM_MEM_FULL;
+		} else {
+			memcpy(*p_value, value, *p_length);
+			result = GP_NVM_SUCCESS;
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		return result;
+	}
+	for( ;; ){
+		uint32_t seq = gp_nvm_sync_read_begin(&shard->sync);
+		// the copy of the index is only consistent when no writer changed it meanwhile
+		gp_nvm_index_t index = shard->store.index;
+		if( gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			continue;
+		}
+		result = _gp_nvm_load(&shard->store, &index, attr_id, p_length, p_value);
+		if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			return result;
+		}
+		if( result == GP_NVM_SUCCESS ){
+			free(*p_value);
+		}
+	}
+}
+
+/**
+ * @brief      Commit the imported attributes of a store.
+ *
+ * With the log engine a batch has to fit in one segment, so the attributes are committed in parts of at most
+ * half a segment. A value that doesn't fit in a segment can't be stored by the log engine anyway.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_store_import(gp_nvm_store_t *store, gp_nvm_batch_t *batch)
+{
+	gp_nvm_batch_t part = { 0 };
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	if( store->engine != GP_NVM_ENGINE_LOG ){
+		return _gp_nvm_store_commit(store, batch);
+	}
+	gp_nvm_batch_init(&part);
+	for( uint32_t i = 0; i<batch->num_entries && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_batch_entry_t *entry = &batch->entries[i];
+		if( part.num_entries > 0 && part.data_len + (uint64_t) entry->len > store->log.segment_size / 2 ){
+			result = _gp_nvm_store_commit(store, &part);
+			gp_nvm_batch_init(&part);
+		}
+		if( result == GP_NVM_SUCCESS &&
+			gp_nvm_batch_append(&part, entry->attr_id, entry->len, batch->data + entry->data, entry->codec) != 0 ){
+			result = GP_NVM_MEM_FULL;
+		}
+	}
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_store_commit(store, &part);
+	}
+	gp_nvm_batch_deinit(&part);
+	return result;
+}
+
+/**
+ * @brief      Export the static attributes that were set, or only count them when exp is NULL.
+ *
+ * The caller holds the writer mutex of the first shard. Static attributes are never compressed.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+static gp_nvm_result_t
+_gp_nvm_export_slots(gp_nvm_export_t *exp, const gp_nvm_store_t *store, uint32_t *p_count)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint8_t *value = NULL;
+
+	*p_count = 0;
+	// the region is larger than every value in it
+	if( exp != NULL && GP_NVM_NUM_SLOTS != 0 && (value = malloc(gp_nvm_schema_size())) == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	for( uint32_t slot = 0; slot != GP_NVM_NUM_SLOTS && result == GP_NVM_SUCCESS; slot++ ){
+		uint32_t len = exp != NULL ? gp_nvm_schema_len(slot) : 0;
+		result = gp_nvm_schema_read(store, slot, 0, len, value);
+		if( result == GP_NVM_ATTR_NOT_FOUND ){
+			result = GP_NVM_SUCCESS;
+			continue;
+		}
+		if( result == GP_NVM_CRC_ERROR ){
+			fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", gp_nvm_schema_attr_id(slot));
+		}
+		if( result == GP_NVM_SUCCESS && exp != NULL ){
+			result = gp_nvm_export_value(exp, gp_nvm_schema_attr_id(slot), GP_NVM_CODEC_NONE, len, value);
+		}
+		(*p_count)++;
+	}
+	free(value);
+	return result;
+}
+
+/**
+ * @brief      Stage an imported value of a static attribute, a compressed value is decompressed first.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't have the length of the type of the attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+static gp_nvm_result_t
+_gp_nvm_import_slot(	gp_nvm_batch_t *statics,
+						uint32_t slot,
+						uint32_t codec,
+						uint32_t len,
+						const uint8_t *value)
+{
+	uint32_t attr_id = gp_nvm_schema_attr_id(slot);
+	uint32_t slot_len = gp_nvm_schema_len(slot);
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	uint8_t *raw = malloc(slot_len);
+	if( raw == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	if( gp_nvm_codec_decompress(codec, value, len, raw, slot_len, &len) != 0 || len != slot_len ){
+		fprintf(stderr, "GP-NVM: static attribute %u is imported with another length\n", attr_id);
+		result = GP_NVM_ATTR_LEN_DIFF;
+	} else if( gp_nvm_batch_append(statics, attr_id, len, raw, GP_NVM_CODEC_NONE) != 0 ){
+		result = GP_NVM_MEM_FULL;
+	}
+	free(raw);
+	return result;
+}
+
+/**
+ * @brief      Open an independent attribute store.
+ *
+ * Without sharding the store is kept in the file at path. With num_shards > 1 in the configuration,
+ * the attributes are spread over num_shards files named path.0, path.1, ... that each have their own
+ * index and writer mutex, so sets of attributes in different shards don't wait for each other.
+ * The files have to exist, empty files are formatted. A sharded store has to be opened with the same
+ * number of shards every time.
+ *
+ * @param[out] p_ctx    Pointer were the context can be stored.
+ * @param[in]  path     The path of the NVM file, or the prefix of the shard files.
+ * @param[in]  config   The configuration, NULL selects the defaults.
+ * @param[in]  backend  The configuration of the NVM devices, NULL selects the defaults. Its path is ignored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (invalid number of shards)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_open(	gp_nvm_ctx_t **p_ctx,
+				const char *path,
+				const gp_nvm_config_t *config,
+				const nvm_arch_config_t *backend)
+{
+	gp_nvm_config_t defaults = { 0 };
+	nvm_arch_config_t dev_config = { 0 };
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	if( config == NULL ){
+		config = &defaults;
+	}
+	if( backend != NULL ){
+		dev_config = *backend;
+	}
+	uint32_t num_shards = config->num_shards > 1 ? config->num_shards : 1;
+	if( num_shards > GP_NVM_MAX_SHARDS ){
+		return GP_NVM_FAIL;
+	}
+
+	gp_nvm_ctx_t *ctx = calloc(1, sizeof(gp_nvm_ctx_t));
+	if( ctx == NULL || (ctx->shards = calloc(num_shards, sizeof(gp_nvm_shard_t))) == NULL ){
+		free(ctx);
+		return GP_NVM_MEM_FULL;
+	}
+	gp_nvm_sync_init(&ctx->sync);
+	ctx->owns_devs = 1;
+
+	char shard_path[strlen(path) + 16];
+	for( uint32_t i = 0; i<num_shards; i++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[i];
+		gp_nvm_sync_init(&shard->sync);
+		ctx->num_shards++;
+
+		dev_config.path = path;
+		if( num_shards > 1 ){
+			snprintf(shard_path, sizeof(shard_path), "%s.%u", path, i);
+			dev_config.path = shard_path;
+		}
+		nvm_dev_t *dev = nvm_arch_open(&dev_config);
+		if( dev == NULL ){
+			result = GP_NVM_MEM_ERROR;
+			break;
+		}
+		result = _gp_nvm_shard_open(shard, dev, config, num_shards > 1 ? num_shards : 0, i == 0);
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+	}
+
+	if( result != GP_NVM_SUCCESS ){
+		gp_nvm_close(ctx);
+		return result;
+	}
+	gp_nvm_async_init(&ctx->async, config->async_queue_size, _gp_nvm_async_store, ctx);
+	*p_ctx = ctx;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Close a store opened with gp_nvm_open, dirty values of the cache are written back first.
+ *
+ * No other call may use the context concurrently or afterwards.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_close(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	if( ctx == NULL || ctx == &default_ctx ){
+		return GP_NVM_SUCCESS;
+	}
+	// the queued sets are stored before the shards are closed
+	gp_nvm_async_deinit(&ctx->async);
+	gp_nvm_batch_deinit(&ctx->async_batch);
+	for( uint32_t i = 0; i<ctx->num_shards; i++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[i];
+		gp_nvm_result_t shard_result = _gp_nvm_shard_close(shard, 1);
+		if( result == GP_NVM_SUCCESS ){
+			result = shard_result;
+		}
+		if( ctx->owns_devs && nvm_arch_close(shard->store.dev) != 0 && result == GP_NVM_SUCCESS ){
+			result = GP_NVM_MEM_ERROR;
+		}
+		gp_nvm_sync_deinit(&shard->sync);
+	}
+	gp_nvm_batch_deinit(&ctx->batch);
+	gp_nvm_sync_deinit(&ctx->sync);
+	free(ctx->shards);
+	free(ctx);
+	return result;
+}
+
+/**
+ * @brief      Return the default context, used by the functions without a context.
+ *
+ * @return     gp_nvm_ctx_t*: The default context.
+ */
+gp_nvm_ctx_t*
+gp_nvm_default_ctx(void)
+{
+	return &default_ctx;
+}
+
+/**
+ * @brief      Get an attribute of a context based on attribute ID.
+ *
+ * Without the cache, gets don't take a lock: the get is retried when a writer changed the shard meanwhile.
+ * Nothing is written beyond size bytes of the buffer, also not by a get that races with a writer.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  size      The size of the buffer at p_value.
+ * @param[out] p_length  Pointer were the length can be stored.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes, p_length is set to its length)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute(	gp_nvm_ctx_t *ctx,
+							gp_nvm_attr_id_t attr_id,
+							uint32_t size,
+							uint32_t* p_length,
+							uint8_t* p_value)
+{
+	gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result;
+	uint32_t length = 0;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		length = gp_nvm_schema_len(slot);
+		result = length > size ? GP_NVM_ATTR_LEN_DIFF : _gp_nvm_slot_read(shard, slot, 0, length, p_value);
+		if( result == GP_NVM_SUCCESS || result == GP_NVM_ATTR_LEN_DIFF ){
+			*p_length = length;
+		}
+	} else if( shard->cache.entries != NULL ){
+		// a get changes the state of the cache, so it is serialized with the writers
+		gp_nvm_sync_write_begin(&shard->sync);
+		result = _gp_nvm_get_cached(shard, attr_id, size, p_length, p_value);
+		gp_nvm_sync_write_end(&shard->sync);
+	} else {
+		for( ;; ){
+			uint32_t seq = gp_nvm_sync_read_begin(&shard->sync);
+			// the copy of the index is only consistent when no writer changed it meanwhile
+			gp_nvm_index_t index = shard->store.index;
+			if( gp_nvm_sync_read_retry(&shard->sync, seq) ){
+				continue;
+			}
+			result = _gp_nvm_read(&shard->store, &index, attr_id, size, &length, p_value);
+			if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+				break;
+			}
+		}
+		if( result == GP_NVM_SUCCESS || result == GP_NVM_ATTR_LEN_DIFF ){
+			// copy len into len pointer
+			*p_length = length;
+		}
+	}
+
+	if( result == GP_NVM_CRC_ERROR ){
+		fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", attr_id);
+		GP_NVM_STATS_ADD(crc_errors, 1);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->get, start, result == GP_NVM_SUCCESS ? *p_length : 0, result);
+}
+
+/**
+ * @brief      Get a range of the value of an attribute of a context, see gp_nvm_get_attribute_range.
+ *
+ * Without the cache the range is read like a get, without a lock. With the cache a cached value is used,
+ * otherwise the range is read from the NVM without caching the value.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_range(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								uint32_t offset,
+								uint32_t length,
+								uint8_t* p_value)
+{
+	gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result;
+	uint8_t value[GP_NVM_CONF_CACHE_VALUE_SIZE];
+	uint32_t len;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		result = _gp_nvm_slot_read(shard, slot, offset, length, p_value);
+	} else if( shard->cache.entries != NULL ){
+		gp_nvm_sync_write_begin(&shard->sync);
+		if( !gp_nvm_cache_get(&shard->cache, attr_id, sizeof(value), &len, value) ){
+			result = _gp_nvm_read_range(&shard->store, &shard->store.index, attr_id, offset, length, p_value);
+		} else if( offset > len || length > len - offset ){
+			result = GP_NVM_ATTR_LEN_DIFF;
+		} else {
+			memcpy(p_value, value + offset, length);
+			result = _gp_nvm_cache_tick(shard);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+	} else {
+		for( ;; ){
+			uint32_t seq = gp_nvm_sync_read_begin(&shard->sync);
+			// the copy of the index is only consistent when no writer changed it meanwhile
+			gp_nvm_index_t index = shard->store.index;
+			if( gp_nvm_sync_read_retry(&shard->sync, seq) ){
+				continue;
+			}
+			result = _gp_nvm_read_range(&shard->store, &index, attr_id, offset, length, p_value);
+			if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+				break;
+			}
+		}
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->get_range, start, result == GP_NVM_SUCCESS ? length : 0, result);
+}
+
+/**
+ * @brief      Get a read-only view of an attribute of a context, without copying the value.
+ *
+ * Views never take the lock, they are retried like gets without the cache. With the cache, a dirty value of
+ * the attribute is written back first so the view shows it. The view doesn't go through the cache.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[out] p_view   Pointer were the view can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed or the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_view(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								gp_nvm_view_t *p_view)
+{
+	gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint32_t seq;
+
+	if( shard->cache.entries != NULL ){
+		gp_nvm_sync_write_begin(&shard->sync);
+		result = gp_nvm_cache_clean(&shard->cache, attr_id);
+		gp_nvm_sync_write_end(&shard->sync);
+	}
+	while( result == GP_NVM_SUCCESS ){
+		seq = gp_nvm_sync_read_begin(&shard->sync);
+		// the copy of the index is only consistent when no writer changed it meanwhile
+		gp_nvm_index_t index = shard->store.index;
+		if( gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			continue;
+		}
+		if( slot != GP_NVM_NUM_SLOTS ){
+			result = gp_nvm_schema_view(&shard->store, slot, p_view);
+		} else {
+			result = _gp_nvm_view(shard->store.dev, &index, attr_id, p_view);
+		}
+		if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			break;
+		}
+		result = GP_NVM_SUCCESS;
+	}
+	if( result == GP_NVM_SUCCESS ){
+		p_view->attr_id = attr_id;
+		p_view->generation = seq;
+	}
+
+	if( result == GP_NVM_CRC_ERROR ){
+		fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", attr_id);
+		GP_NVM_STATS_ADD(crc_errors, 1);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->view, start, result == GP_NVM_SUCCESS ? p_view->length : 0, result);
+}
+
+/**
+ * @brief      Check if the value of a view of a context may have been changed since it was taken.
+ *
+ * Every change of the shard of the attribute counts, also changes of other attributes.
+ *
+ * @param[in]  ctx     The context.
+ * @param[in]  p_view  The view returned by gp_nvm_ctx_get_attribute_view.
+ *
+ * @return     1: The store changed, the value of the view can't be trusted.
+ * @return     0: The value of the view is still the value of the attribute.
+ */
+int
+gp_nvm_ctx_view_changed(	gp_nvm_ctx_t *ctx,
+							const gp_nvm_view_t *p_view)
+{
+	return gp_nvm_sync_read_retry(&_gp_nvm_shard_of(ctx, p_view->attr_id)->sync, p_view->generation);
+}
+
+/**
+ * @brief      Set an attribute of a context based on the attribute ID.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_attribute(	gp_nvm_ctx_t *ctx,
+							gp_nvm_attr_id_t attr_id,
+							uint32_t length,
+							uint8_t* p_value)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	gp_nvm_result_t result;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		// the length of a static attribute is fixed by its type
+		result = length == gp_nvm_schema_len(slot) ? _gp_nvm_slot_write(&ctx->shards[0], slot, 0, length, p_value) : GP_NVM_ATTR_LEN_DIFF;
+	} else {
+		gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+		result = _gp_nvm_shard_sync(shard, _gp_nvm_shard_set(shard, attr_id, length, p_value));
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->set, start, length, result);
+}
+
+/**
+ * @brief      Delete an attribute of a context, see gp_nvm_delete_attribute.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_delete_attribute(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	gp_nvm_shard_t *shard = slot != GP_NVM_NUM_SLOTS ? &ctx->shards[0] : _gp_nvm_shard_of(ctx, attr_id);
+	gp_nvm_result_t result;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		gp_nvm_sync_write_begin(&shard->sync);
+		result = gp_nvm_schema_clear(&shard->store, slot);
+		gp_nvm_sync_write_end(&shard->sync);
+	} else {
+		result = _gp_nvm_shard_delete(shard, attr_id);
+	}
+	result = _gp_nvm_shard_sync(shard, result);
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->deletes, start, 0, result);
+}
+
+/**
+ * @brief      Overwrite a range of the value of an attribute of a context, see gp_nvm_update_attribute_range.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_update_attribute_range(	gp_nvm_ctx_t *ctx,
+									gp_nvm_attr_id_t attr_id,
+									uint32_t offset,
+									uint32_t length,
+									uint8_t* p_value)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	gp_nvm_result_t result;
+
+	if( slot != GP_NVM_NUM_SLOTS ){
+		result = _gp_nvm_slot_write(&ctx->shards[0], slot, offset, length, p_value);
+	} else {
+		gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+		result = _gp_nvm_shard_sync(shard, _gp_nvm_shard_update_range(shard, attr_id, offset, length, p_value));
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->update_range, start, length, result);
+}
+
+/**
+ * @brief      Get the length of the value of an attribute of a context, see gp_nvm_get_attribute_length.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_length(	gp_nvm_ctx_t *ctx,
+									gp_nvm_attr_id_t attr_id,
+									uint32_t* p_length)
+{
+	gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+	uint32_t slot = gp_nvm_schema_slot_of(attr_id);
+	gp_nvm_result_t result;
+	uint8_t value[GP_NVM_CONF_CACHE_VALUE_SIZE];
+
+	// a range of 0 bytes checks that the static attribute was set
+	if( slot != GP_NVM_NUM_SLOTS ){
+		result = _gp_nvm_slot_read(shard, slot, 0, 0, NULL);
+		if( result == GP_NVM_SUCCESS ){
+			*p_length = gp_nvm_schema_len(slot);
+		}
+		return result;
+	}
+	// a dirty value in the cache may have another length than the value on the NVM
+	if( shard->cache.entries != NULL ){
+		gp_nvm_sync_write_begin(&shard->sync);
+		if( gp_nvm_cache_get(&shard->cache, attr_id, sizeof(value), p_length, value) ){
+			result = GP_NVM_SUCCESS;
+		} else {
+			result = _gp_nvm_length(&shard->store, &shard->store.index, attr_id, p_length);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		return result;
+	}
+	for( ;; ){
+		uint32_t seq = gp_nvm_sync_read_begin(&shard->sync);
+		// the copy of the index is only consistent when no writer changed it meanwhile
+		gp_nvm_index_t index = shard->store.index;
+		if( gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			continue;
+		}
+		result = _gp_nvm_length(&shard->store, &index, attr_id, p_length);
+		if( !gp_nvm_sync_read_retry(&shard->sync, seq) ){
+			return result;
+		}
+	}
+}
+
+/**
+ * @brief      Open a stream that sets the value of an attribute of a context, see gp_nvm_stream_open.
+ *
+ * The record of the value is reserved here with the storage engine of the shard of the attribute.
+ * A dirty value of the attribute in the cache is written back first.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  length    The length of the value.
+ * @param[out] p_stream  Pointer were the stream can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_stream_open(	gp_nvm_ctx_t *ctx,
+						gp_nvm_attr_id_t attr_id,
+						uint32_t length,
+						gp_nvm_stream_t **p_stream)
+{
+	gp_nvm_shard_t *shard = _gp_nvm_shard_of(ctx, attr_id);
+	gp_nvm_store_t *store = &shard->store;
+	gp_nvm_stream_t *stream;
+	gp_nvm_result_t result;
+
+	// the slot of a static attribute is overwritten in place, there is no record to reserve
+	if( gp_nvm_schema_slot_of(attr_id) != GP_NVM_NUM_SLOTS ){
+		return GP_NVM_FAIL;
+	}
+	if( (stream = calloc(1, sizeof(gp_nvm_stream_t))) == NULL ){
+		return GP_NVM_MEM_FULL;
+	}
+	stream->shard = shard;
+	stream->hdr.magic = GP_NVM_RECORD_MAGIC;
+	stream->hdr.type = GP_NVM_RECORD_ATTR;
+	stream->hdr.attr_id = attr_id;
+	stream->hdr.len = length;
+
+	gp_nvm_sync_write_begin(&shard->sync);
+	// a dirty value written back while the stream is open would make the commit fail
+	result = shard->cache.entries != NULL ? gp_nvm_cache_clean(&shard->cache, attr_id) : GP_NVM_SUCCESS;
+	if( result == GP_NVM_SUCCESS ){
+		result = gp_nvm_checkpoint_touch(store);
+	}
+	if( result == GP_NVM_SUCCESS && store->engine == GP_NVM_ENGINE_LOG ){
+		result = gp_nvm_log_stream_open(store, &stream->hdr, &stream->offset);
+	} else if( result == GP_NVM_SUCCESS ){
+		result = gp_nvm_heap_stream_open(store, &stream->hdr, &stream->offset);
+	}
+	if( result == GP_NVM_SUCCESS ){
+		store->streams++;
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+
+	if( result != GP_NVM_SUCCESS ){
+		free(stream);
+		return result;
+	}
+	*p_stream = stream;
+	return GP_NVM_SUCCESS;
+}
+
+/**
+ * @brief      Write the next chunk of the value of a stream.
+ *
+ * The chunk is written straight into the reserved record, the store doesn't change so readers aren't retried.
+ *
+ * @param[in]  stream   The stream.
+ * @param[in]  length   The length of the chunk.
+ * @param[in]  p_value  Pointer to the chunk in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the chunk ends beyond the length of the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_write(	gp_nvm_stream_t *stream,
+						uint32_t length,
+						const uint8_t* p_value)
+{
+	gp_nvm_shard_t *shard = stream->shard;
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+
+	if( length > stream->hdr.len - stream->pos ){
+		result = GP_NVM_ATTR_LEN_DIFF;
+	} else if( length > 0 ){
+		gp_nvm_sync_lock(&shard->sync);
+		if( nvm_dev_update(shard->store.dev, stream->offset + sizeof(gp_nvm_record_hdr_t) + stream->pos, length, p_value) != 0 ){
+			result = GP_NVM_MEM_ERROR;
+		}
+		gp_nvm_sync_unlock(&shard->sync);
+	}
+	if( result == GP_NVM_SUCCESS ){
+		stream->hdr.crc = gp_nvm_crc32c(stream->hdr.crc, p_value, length);
+		stream->pos += length;
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->stream_write, start, length, result);
+}
+
+/**
+ * @brief      Commit a stream, the value becomes the value of the attribute.
+ *
+ * The stream is released, except when not all bytes of the value were written yet.
+ *
+ * @param[in]  stream  The stream.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute was set while the stream was open)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (not all bytes of the value were written, the stream stays open)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_commit(gp_nvm_stream_t *stream)
+{
+	gp_nvm_shard_t *shard = stream->shard;
+	gp_nvm_store_t *store = &shard->store;
+	uint64_t start = gp_nvm_stats_begin();
+	uint32_t length = stream->hdr.len;
+	gp_nvm_result_t result;
+
+	if( stream->pos != length ){
+		return gp_nvm_stats_end(&gp_nvm_stats_local()->stream_commit, start, 0, GP_NVM_ATTR_LEN_DIFF);
+	}
+	gp_nvm_sync_write_begin(&shard->sync);
+	store->streams--;
+	if( shard->cache.entries != NULL && gp_nvm_cache_is_dirty(&shard->cache, stream->hdr.attr_id) ){
+		// the entry was cleaned when the stream was opened, so the attribute was set after that
+		result = GP_NVM_FAIL;
+	} else if( store->engine == GP_NVM_ENGINE_LOG ){
+		result = gp_nvm_log_stream_commit(store, &stream->hdr, stream->offset);
+	} else {
+		result = gp_nvm_heap_stream_commit(store, &stream->hdr, stream->offset);
+	}
+	// the reserved record of the log engine just stays stale
+	if( result == GP_NVM_FAIL && store->engine != GP_NVM_ENGINE_LOG ){
+		gp_nvm_heap_stream_abort(store, &stream->hdr, stream->offset);
+	}
+	// a clean cached value of the attribute is older than the value of the stream
+	if( result == GP_NVM_SUCCESS && shard->cache.entries != NULL ){
+		gp_nvm_cache_invalidate(&shard->cache, stream->hdr.attr_id);
+	}
+	result = _gp_nvm_store_tick(store, result);
+	gp_nvm_sync_write_end(&shard->sync);
+	free(stream);
+	result = _gp_nvm_shard_sync(shard, result);
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->stream_commit, start, length, result);
+}
+
+/**
+ * @brief      Abort a stream, the attribute keeps its previous value and the stream is released.
+ *
+ * @param[in]  stream  The stream.
+ */
+void
+gp_nvm_stream_abort(gp_nvm_stream_t *stream)
+{
+	gp_nvm_shard_t *shard = stream->shard;
+	gp_nvm_sync_write_begin(&shard->sync);
+	shard->store.streams--;
+	// the reserved record of the log engine just stays stale
+	if( shard->store.engine != GP_NVM_ENGINE_LOG ){
+		gp_nvm_heap_stream_abort(&shard->store, &stream->hdr, stream->offset);
+	}
+	gp_nvm_sync_write_end(&shard->sync);
+	free(stream);
+}
+
+/**
+ * @brief      Queue the set of an attribute of a context, see gp_nvm_set_attribute_async.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL to poll with gp_nvm_ctx_poll_async.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS (the set was queued)
+ * @return     1: GP_NVM_FAIL (the context wasn't initialized or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full or the value is too long)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_attribute_async(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								uint32_t length,
+								uint8_t* p_value,
+								gp_nvm_async_cb_t cb,
+								void *arg)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result = GP_NVM_FAIL;
+	// the I/O worker commits its sets like a batch
+	if( gp_nvm_schema_slot_of(attr_id) == GP_NVM_NUM_SLOTS ){
+		result = gp_nvm_async_submit(&ctx->async, attr_id, length, p_value, cb, arg);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->async_set, start, length, result);
+}
+
+/**
+ * @brief      Return the number of asynchronous sets of a context that aren't completed yet.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     The number of queued sets, 0 when all sets are completed.
+ */
+uint32_t
+gp_nvm_ctx_poll_async(gp_nvm_ctx_t *ctx)
+{
+	return gp_nvm_async_pending(&ctx->async);
+}
+
+/**
+ * @brief      Wait until all asynchronous sets of a context are completed.
+ *
+ * @param[in]  ctx   The context.
+ */
+void
+gp_nvm_ctx_wait_async(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_async_wait(&ctx->async);
+}
+
+/**
+ * @brief      Start a batch of attribute sets in a context.
+ *
+ * There is one batch per context for all threads.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a batch was already started)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_begin(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_result_t result = GP_NVM_FAIL;
+	gp_nvm_sync_lock(&ctx->sync);
+	if( !ctx->batch.active ){
+		gp_nvm_batch_init(&ctx->batch);
+		result = GP_NVM_SUCCESS;
+	}
+	gp_nvm_sync_unlock(&ctx->sync);
+	return result;
+}
+
+/**
+ * @brief      Stage the set of an attribute in the batch of a context.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_set(	gp_nvm_ctx_t *ctx,
+						gp_nvm_attr_id_t attr_id,
+						uint32_t length,
+						uint8_t* p_value)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	gp_nvm_sync_lock(&ctx->sync);
+	// the slot of a static attribute is overwritten in place, which can't be rolled back
+	if( !ctx->batch.active || gp_nvm_schema_slot_of(attr_id) != GP_NVM_NUM_SLOTS ){
+		result = GP_NVM_FAIL;
+	} else if( gp_nvm_batch_stage(&ctx->batch, attr_id, length, p_value) != 0 ){
+		result = GP_NVM_MEM_FULL;
+	}
+	gp_nvm_sync_unlock(&ctx->sync);
+	return result;
+}
+
+/**
+ * @brief      Commit the batch of a context, either all staged sets are stored or none of them.
+ *
+ * The commit record of a batch is written in one shard, so all attributes of a batch have to be in the
+ * same shard. The batch is ended, also when the commit fails.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or the batch spans several shards)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_commit(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_batch_t *batch = &ctx->batch;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint64_t start = gp_nvm_stats_begin();
+
+	gp_nvm_sync_lock(&ctx->sync);
+	if( !batch->active ){
+		gp_nvm_sync_unlock(&ctx->sync);
+		return gp_nvm_stats_end(&gp_nvm_stats_local()->batch_commit, start, 0, GP_NVM_FAIL);
+	}
+	uint32_t bytes = batch->data_len;
+	gp_nvm_shard_t *shard = &ctx->shards[0];
+	if( batch->num_entries > 0 ){
+		shard = _gp_nvm_shard_of(ctx, batch->entries[0].attr_id);
+	}
+	for( uint32_t i = 1; i<batch->num_entries; i++ ){
+		if( _gp_nvm_shard_of(ctx, batch->entries[i].attr_id) != shard ){
+			fprintf(stderr, "GP-NVM: batch spans several shards\n");
+			result = GP_NVM_FAIL;
+			break;
+		}
+	}
+
+	if( result == GP_NVM_SUCCESS ){
+		gp_nvm_sync_write_begin(&shard->sync);
+		result = _gp_nvm_store_commit(&shard->store, batch);
+		// cached values of the attributes are older than the committed values
+		for( uint32_t i = 0; i<batch->num_entries && result == GP_NVM_SUCCESS && shard->cache.entries != NULL; i++ ){
+			gp_nvm_cache_invalidate(&shard->cache, batch->entries[i].attr_id);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+	}
+	gp_nvm_batch_deinit(batch);
+	gp_nvm_sync_unlock(&ctx->sync);
+	result = _gp_nvm_shard_sync(shard, result);
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->batch_commit, start, bytes, result);
+}
+
+/**
+ * @brief      Drop the batch of a context without storing any of the staged sets.
+ *
+ * @param[in]  ctx   The context.
+ */
+void
+gp_nvm_ctx_batch_abort(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_sync_lock(&ctx->sync);
+	gp_nvm_batch_deinit(&ctx->batch);
+	gp_nvm_sync_unlock(&ctx->sync);
+}
+
+/**
+ * @brief      Write back all dirty values of the caches of a context to the NVM.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_flush(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	for( uint32_t i = 0; i<ctx->num_shards && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[i];
+		gp_nvm_sync_write_begin(&shard->sync);
+		if( shard->cache.entries != NULL ){
+			shard->cache_last_flush = _gp_nvm_now_ms();
+			result = gp_nvm_cache_flush(&shard->cache);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		result = _gp_nvm_shard_sync(shard, result);
+	}
+	return result;
+}
+
+/**
+ * @brief      Run one incremental compaction step in every shard of a context, see gp_nvm_compact.
+ *
+ * The bytes of the compactions are the bytes they reclaimed.
+ *
+ * @param[in]  ctx        The context.
+ * @param[in]  max_bytes  Maximum number of bytes to relocate per shard, 0 relocates as much as one step can.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_compact(	gp_nvm_ctx_t *ctx,
+					uint32_t max_bytes)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	uint64_t reclaimed = 0;
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	for( uint32_t i = 0; i<ctx->num_shards && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[i];
+		gp_nvm_store_t *store = &shard->store;
+		gp_nvm_sync_write_begin(&shard->sync);
+		uint64_t *p_reclaimed = store->engine == GP_NVM_ENGINE_LOG ? &store->log.reclaimed_bytes : &store->alloc.reclaimed_bytes;
+		uint64_t before = *p_reclaimed;
+		// the in-place engine only erases the anchors when it changes something
+		if( store->engine != GP_NVM_ENGINE_LOG ){
+			result = gp_nvm_heap_compact(store, max_bytes);
+		} else if( (result = gp_nvm_checkpoint_touch(store)) == GP_NVM_SUCCESS ){
+			result = gp_nvm_log_compact(store, max_bytes);
+		}
+		reclaimed += *p_reclaimed - before;
+		gp_nvm_sync_write_end(&shard->sync);
+		result = _gp_nvm_shard_sync(shard, result);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->compactions, start, reclaimed, result);
+}
+
+/**
+ * @brief      Write a checkpoint of the index of every shard of a context.
+ *
+ * Dirty values of the caches are written back first, so the checkpoint covers them.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_checkpoint(gp_nvm_ctx_t *ctx)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	for( uint32_t i = 0; i<ctx->num_shards && result == GP_NVM_SUCCESS; i++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[i];
+		gp_nvm_sync_write_begin(&shard->sync);
+		if( shard->cache.entries != NULL ){
+			shard->cache_last_flush = _gp_nvm_now_ms();
+			result = gp_nvm_cache_flush(&shard->cache);
+		}
+		if( result == GP_NVM_SUCCESS ){
+			result = _gp_nvm_store_checkpoint(&shard->store);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		result = _gp_nvm_shard_sync(shard, result);
+	}
+	return result;
+}
+
+/**
+ * @brief      Call a callback for every attribute of a context in an ID range, in ID order.
+ *
+ * The IDs of every shard are collected under its writer mutex after the cache was written back, then the
+ * values are read one by one without holding a lock, so the callback can call the library.
+ * An attribute that disappeared meanwhile is skipped.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  first_id  The first attribute identifier of the range.
+ * @param[in]  last_id   The last attribute identifier of the range.
+ * @param[in]  cb        The callback.
+ * @param[in]  arg       The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_foreach(	gp_nvm_ctx_t *ctx,
+					gp_nvm_attr_id_t first_id,
+					gp_nvm_attr_id_t last_id,
+					gp_nvm_foreach_cb_t cb,
+					void *arg)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint32_t *ids = NULL;
+	uint32_t num_ids = 0;
+	uint32_t max_ids = 0;
+
+	for( uint32_t s = 0; s<ctx->num_shards && result == GP_NVM_SUCCESS; s++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[s];
+		const gp_nvm_index_t *index = &shard->store.index;
+		result = _gp_nvm_shard_flush(shard);
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+		gp_nvm_sync_lock(&shard->sync);
+		if( num_ids + index->num_entries > max_ids ){
+			uint32_t *grown = realloc(ids, (num_ids + index->num_entries) * sizeof(uint32_t));
+			if( grown == NULL ){
+				result = GP_NVM_MEM_FULL;
+			} else {
+				ids = grown;
+				max_ids = num_ids + index->num_entries;
+			}
+		}
+		for( uint32_t i = 0; i<index->num_slots && result == GP_NVM_SUCCESS; i++ ){
+			if( index->ctrl[i] != 0 && index->ids[i] >= first_id && index->ids[i] <= last_id ){
+				ids[num_ids++] = index->ids[i];
+			}
+		}
+		gp_nvm_sync_unlock(&shard->sync);
+	}
+	// the static attributes that were never set are skipped like attributes that disappeared
+	if( result == GP_NVM_SUCCESS && GP_NVM_NUM_SLOTS != 0 ){
+		uint32_t *grown = realloc(ids, (num_ids + GP_NVM_NUM_SLOTS) * sizeof(uint32_t));
+		if( grown == NULL ){
+			result = GP_NVM_MEM_FULL;
+		} else {
+			ids = grown;
+		}
+	}
+	for( uint32_t slot = 0; slot != GP_NVM_NUM_SLOTS && result == GP_NVM_SUCCESS; slot++ ){
+		uint32_t attr_id = gp_nvm_schema_attr_id(slot);
+		if( attr_id >= first_id && attr_id <= last_id ){
+			ids[num_ids++] = attr_id;
+		}
+	}
+	if( num_ids > 1 ){
+		qsort(ids, num_ids, sizeof(uint32_t), _gp_nvm_cmp_id);
+	}
+
+	for( uint32_t i = 0; i<num_ids && result == GP_NVM_SUCCESS; i++ ){
+		uint8_t *value;
+		uint32_t length;
+		result = _gp_nvm_shard_load(_gp_nvm_shard_of(ctx, ids[i]), ids[i], &length, &value);
+		if( result == GP_NVM_ATTR_NOT_FOUND ){
+			result = GP_NVM_SUCCESS;
+			continue;
+		}
+		if( result == GP_NVM_CRC_ERROR ){
+			fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", ids[i]);
+			GP_NVM_STATS_ADD(crc_errors, 1);
+		}
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+		int stop = cb(ids[i], length, value, arg);
+		free(value);
+		if( stop ){
+			break;
+		}
+	}
+	free(ids);
+	return result;
+}
+
+/**
+ * @brief      Export all attributes of a context.
+ *
+ * The caches are written back first, then the writer mutexes of all shards are held until the export is
+ * done, so the export is a consistent copy of every shard. Gets without the cache don't take the mutex.
+ * The static attributes are exported first.
+ *
+ * @param[in]  ctx    The context.
+ * @param[in]  write  The callback that writes the bytes.
+ * @param[in]  arg    The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_export(	gp_nvm_ctx_t *ctx,
+					gp_nvm_export_cb_t write,
+					void *arg)
+{
+	gp_nvm_result_t result = GP_NVM_SUCCESS;
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_export_t exp;
+	uint32_t num_attrs = 0;
+	uint32_t num_statics = 0;
+
+	for( uint32_t s = 0; s<ctx->num_shards && result == GP_NVM_SUCCESS; s++ ){
+		result = _gp_nvm_shard_flush(&ctx->shards[s]);
+	}
+	if( result != GP_NVM_SUCCESS ){
+		return gp_nvm_stats_end(&gp_nvm_stats_local()->exports, start, 0, result);
+	}
+
+	gp_nvm_export_init(&exp, write, arg);
+	for( uint32_t s = 0; s<ctx->num_shards; s++ ){
+		gp_nvm_sync_lock(&ctx->shards[s].sync);
+		num_attrs += ctx->shards[s].store.index.num_entries;
+	}
+	result = _gp_nvm_export_slots(NULL, &ctx->shards[0].store, &num_statics);
+	if( result == GP_NVM_SUCCESS ){
+		result = gp_nvm_export_header(&exp, num_attrs + num_statics);
+	}
+	if( result == GP_NVM_SUCCESS ){
+		result = _gp_nvm_export_slots(&exp, &ctx->shards[0].store, &num_statics);
+	}
+	for( uint32_t s = 0; s<ctx->num_shards && result == GP_NVM_SUCCESS; s++ ){
+		result = gp_nvm_export_store(&exp, &ctx->shards[s].store);
+	}
+	if( result == GP_NVM_SUCCESS ){
+		result = gp_nvm_export_trailer(&exp);
+	}
+	for( uint32_t s = 0; s<ctx->num_shards; s++ ){
+		gp_nvm_sync_unlock(&ctx->shards[s].sync);
+	}
+	gp_nvm_export_deinit(&exp);
+
+	if( result == GP_NVM_CRC_ERROR ){
+		GP_NVM_STATS_ADD(crc_errors, 1);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->exports, start, exp.bytes > UINT32_MAX ? UINT32_MAX : exp.bytes, result);
+}
+
+/**
+ * @brief      Import the attributes of an export in a context.
+ *
+ * The attributes are staged in a batch per shard while the stream is read, nothing is written before the CRC
+ * of the stream is checked. Cached values of the imported attributes are dropped.
+ *
+ * @param[in]  ctx   The context.
+ * @param[in]  read  The callback that reads the bytes.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_import(	gp_nvm_ctx_t *ctx,
+					gp_nvm_import_cb_t read,
+					void *arg)
+{
+	uint64_t start = gp_nvm_stats_begin();
+	uint64_t bytes = 0;
+	gp_nvm_import_t imp;
+	gp_nvm_index_t seen;
+	gp_nvm_batch_t statics = { 0 };
+
+	gp_nvm_batch_t *batches = calloc(ctx->num_shards, sizeof(gp_nvm_batch_t));
+	if( batches == NULL || gp_nvm_index_init(&seen) != 0 ){
+		free(batches);
+		return gp_nvm_stats_end(&gp_nvm_stats_local()->imports, start, 0, GP_NVM_MEM_FULL);
+	}
+	gp_nvm_batch_init(&statics);
+	gp_nvm_result_t result = gp_nvm_import_init(&imp, read, arg);
+	while( result == GP_NVM_SUCCESS && imp.remaining > 0 ){
+		uint32_t attr_id, codec, len, slot;
+		const uint8_t *value;
+		int added;
+		result = gp_nvm_import_next(&imp, &attr_id, &codec, &len, &value);
+		if( result != GP_NVM_SUCCESS ){
+			break;
+		}
+		// the batches don't look for an earlier set of the attribute, so a repeated attribute is rejected here
+		if( gp_nvm_index_insert(&seen, attr_id, &added) == NULL ){
+			result = GP_NVM_MEM_FULL;
+		} else if( !added ){
+			fprintf(stderr, "GP-NVM: attribute %u is imported twice\n", attr_id);
+			result = GP_NVM_FAIL;
+		} else if( (slot = gp_nvm_schema_slot_of(attr_id)) != GP_NVM_NUM_SLOTS ){
+			result = _gp_nvm_import_slot(&statics, slot, codec, len, value);
+		} else if( gp_nvm_batch_append(&batches[_gp_nvm_shard_of(ctx, attr_id) - ctx->shards], attr_id, len, value, codec) != 0 ){
+			result = GP_NVM_MEM_FULL;
+		}
+		bytes += len;
+	}
+	if( result == GP_NVM_SUCCESS ){
+		result = gp_nvm_import_trailer(&imp);
+	}
+	gp_nvm_import_deinit(&imp);
+	gp_nvm_index_deinit(&seen);
+
+	// the static attributes are overwritten in their slots
+	if( result == GP_NVM_SUCCESS && statics.num_entries > 0 ){
+		gp_nvm_shard_t *shard = &ctx->shards[0];
+		gp_nvm_sync_write_begin(&shard->sync);
+		for( uint32_t i = 0; i<statics.num_entries && result == GP_NVM_SUCCESS; i++ ){
+			gp_nvm_batch_entry_t *entry = &statics.entries[i];
+			result = gp_nvm_schema_write(&shard->store, gp_nvm_schema_slot_of(entry->attr_id), statics.data + entry->data);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		result = _gp_nvm_shard_sync(shard, result);
+	}
+	gp_nvm_batch_deinit(&statics);
+
+	for( uint32_t s = 0; s<ctx->num_shards && result == GP_NVM_SUCCESS; s++ ){
+		gp_nvm_shard_t *shard = &ctx->shards[s];
+		gp_nvm_batch_t *batch = &batches[s];
+		if( batch->num_entries == 0 ){
+			continue;
+		}
+		gp_nvm_sync_write_begin(&shard->sync);
+		result = _gp_nvm_store_import(&shard->store, batch);
+		// cached values of the attributes are older than the imported values
+		for( uint32_t i = 0; i<batch->num_entries && result == GP_NVM_SUCCESS && shard->cache.entries != NULL; i++ ){
+			gp_nvm_cache_invalidate(&shard->cache, batch->entries[i].attr_id);
+		}
+		gp_nvm_sync_write_end(&shard->sync);
+		result = _gp_nvm_shard_sync(shard, result);
+	}
+	for( uint32_t s = 0; s<ctx->num_shards; s++ ){
+		gp_nvm_batch_deinit(&batches[s]);
+	}
+	free(batches);
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->imports, start, bytes > UINT32_MAX ? UINT32_MAX : bytes, result);
+}
+
+/**
+ * @brief      Get a static attribute of a context from its slot, see gp_nvm_get_slot.
+ *
+ * Gets and sets of static attributes are counted with the other gets and sets.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  slot     The slot of the attribute.
+ * @param[out] p_value  Pointer were the value can be stored, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_slot(	gp_nvm_ctx_t *ctx,
+						uint32_t slot,
+						void* p_value)
+{
+	uint32_t len = gp_nvm_schema_len(slot);
+	if( len == 0 ){
+		return GP_NVM_FAIL;
+	}
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result = _gp_nvm_slot_read(&ctx->shards[0], slot, 0, len, p_value);
+	if( result == GP_NVM_CRC_ERROR ){
+		fprintf(stderr, "GP-NVM: CRC error in value of attribute %u\n", gp_nvm_schema_attr_id(slot));
+		GP_NVM_STATS_ADD(crc_errors, 1);
+	}
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->get, start, result == GP_NVM_SUCCESS ? len : 0, result);
+}
+
+/**
+ * @brief      Set a static attribute of a context in its slot, see gp_nvm_set_slot.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  slot     The slot of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_slot(	gp_nvm_ctx_t *ctx,
+						uint32_t slot,
+						const void* p_value)
+{
+	uint32_t len = gp_nvm_schema_len(slot);
+	if( len == 0 ){
+		return GP_NVM_FAIL;
+	}
+	uint64_t start = gp_nvm_stats_begin();
+	gp_nvm_result_t result = _gp_nvm_slot_write(&ctx->shards[0], slot, 0, len, p_value);
+	return gp_nvm_stats_end(&gp_nvm_stats_local()->set, start, len, result);
+}
+
+/**
+ * @brief      Copy the statistics of the value caches of a context, summed over all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_cache_stats(	gp_nvm_ctx_t *ctx,
+							gp_nvm_cache_stats_t *stats)
+{
+	gp_nvm_cache_stats_t shard_stats;
+	memset(stats, 0, sizeof(gp_nvm_cache_stats_t));
+	for( uint32_t i = 0; i<ctx->num_shards; i++ ){
+		gp_nvm_sync_lock(&ctx->shards[i].sync);
+		gp_nvm_cache_get_stats(&ctx->shards[i].cache, &shard_stats);
+		gp_nvm_sync_unlock(&ctx->shards[i].sync);
+		stats->hits += shard_stats.hits;
+		stats->misses += shard_stats.misses;
+		stats->absorbed += shard_stats.absorbed;
+		stats->writebacks += shard_stats.writebacks;
+		stats->evictions += shard_stats.evictions;
+		stats->num_entries += shard_stats.num_entries;
+		stats->cached += shard_stats.cached;
+		stats->dirty += shard_stats.dirty;
+	}
+}
+
+/**
+ * @brief      Copy the compaction statistics of a context, summed over all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_compact_stats(	gp_nvm_ctx_t *ctx,
+								gp_nvm_compact_stats_t *stats)
+{
+	gp_nvm_compact_stats_t shard_stats;
+	memset(stats, 0, sizeof(gp_nvm_compact_stats_t));
+	for( uint32_t i = 0; i<ctx->num_shards; i++ ){
+		gp_nvm_sync_lock(&ctx->shards[i].sync);
+		if( ctx->shards[i].store.engine == GP_NVM_ENGINE_LOG ){
+			gp_nvm_log_get_stats(&ctx->shards[i].store, &shard_stats);
+		} else {
+			gp_nvm_heap_get_stats(&ctx->shards[i].store, &shard_stats);
+		}
+		gp_nvm_sync_unlock(&ctx->shards[i].sync);
+		stats->live_bytes += shard_stats.live_bytes;
+		stats->stale_bytes += shard_stats.stale_bytes;
+		stats->user_bytes += shard_stats.user_bytes;
+		stats->device_bytes += shard_stats.device_bytes;
+		stats->compact_bytes += shard_stats.compact_bytes;
+		stats->reclaimed_bytes += shard_stats.reclaimed_bytes;
+		stats->segments_reclaimed += shard_stats.segments_reclaimed;
+		stats->num_segments += shard_stats.num_segments;
+		stats->free_segments += shard_stats.free_segments;
+	}
+	if( stats->user_bytes > 0 ){
+		stats->write_amplification = (double) stats->device_bytes / stats->user_bytes;
+	}
+}
+
+/**
+ * @brief      Copy the free-space allocator statistics of the in-place engine of a context.
+ *
+ * The counters are summed over all shards, the largest free extent and the data end are the maximum
+ * of all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_alloc_stats(	gp_nvm_ctx_t *ctx,
+							gp_nvm_alloc_stats_t *stats)
+{
+	gp_nvm_alloc_stats_t shard_stats;
+	memset(stats, 0, sizeof(gp_nvm_alloc_stats_t));
+	for( uint32_t i = 0; i<ctx->num_shards; i++ ){
+		gp_nvm_sync_lock(&ctx->shards[i].sync);
+		gp_nvm_alloc_get_stats(&ctx->shards[i].store.alloc, &shard_stats);
+		shard_stats.data_end = ctx->shards[i].store.end;
+		gp_nvm_sync_unlock(&ctx->shards[i].sync);
+		stats->allocs += shard_stats.allocs;
+		stats->frees += shard_stats.frees;
+		stats->splits += shard_stats.splits;
+		stats->search_steps += shard_stats.search_steps;
+		stats->merges += shard_stats.merges;
+		stats->end_allocs += shard_stats.end_allocs;
+		stats->free_extents += shard_stats.free_extents;
+		stats->free_bytes += shard_stats.free_bytes;
+		if( shard_stats.largest_free > stats->largest_free ){
+			stats->largest_free = shard_stats.largest_free;
+		}
+		if( shard_stats.data_end > stats->data_end ){
+			stats->data_end = shard_stats.data_end;
+		}
+	}
+	if( stats->free_bytes > 0 ){
+		stats->fragmentation = 1.0 - (double) stats->largest_free / stats->free_bytes;
+	}
+}
+
+/**
+ * @brief      This function initializes the general purpose non-volatile memory library.
+ *
+ * An empty NVM is formatted, otherwise the attribute index is rebuilt from the records on the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_init()
+{
+	return gp_nvm_init_with_config(NULL);
+}
+
+/**
+ * @brief      This function initializes the general purpose non-volatile memory library with a configuration.
+ *
+ * The default context is opened on the default NVM device, it isn't sharded.
+ * No other call of the library may run concurrently with the initialization.
+ *
+ * @param[in]  config  The configuration, NULL selects the defaults.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_init_with_config(const gp_nvm_config_t *config)
+{
+	gp_nvm_config_t defaults = { 0 };
+	if( config == NULL ){
+		config = &defaults;
+	}
+
+	// the sets queued before are stored in the previous store
+	gp_nvm_async_deinit(&default_ctx.async);
+
+	gp_nvm_sync_write_begin(&default_shard.sync);
+	gp_nvm_result_t result = _gp_nvm_shard_open(&default_shard, nvm_arch_default_dev(), config, 0, 1);
+	if( result == GP_NVM_SUCCESS && config->verbose ){
+		_gp_nvm_print_index(&default_shard.store);
+	}
+	gp_nvm_sync_write_end(&default_shard.sync);
+
+	if( result == GP_NVM_SUCCESS ){
+		gp_nvm_async_init(&default_ctx.async, config->async_queue_size, _gp_nvm_async_store, &default_ctx);
+	}
+	return result;
+}
+
+/**
+ * @brief      Get an attribute based on attribute ID.
+ *
+ * This function searches for the attribute in NVM.
+ * If found, it copies both the length and value into the respective pointers provides as parameters.
+ * A value that doesn't fit in size bytes isn't copied, then p_length is set to the length it needs.
+ * The length can change with every set, so a buffer sized with gp_nvm_get_attribute_length may be too small.
+ *
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  size      The size of the buffer at p_value.
+ * @param[out] p_length  Pointer were the length can be stored.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute(	gp_nvm_attr_id_t attr_id,
+						uint32_t size,
+						uint32_t* p_length,
+						uint8_t* p_value)
+{
+	return gp_nvm_ctx_get_attribute(&default_ctx, attr_id, size, p_length, p_value);
+}
+
+/**
+ * @brief      Get a range of the value of an attribute based on attribute ID.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_range(	gp_nvm_attr_id_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							uint8_t* p_value)
+{
+	return gp_nvm_ctx_get_attribute_range(&default_ctx, attr_id, offset, length, p_value);
+}
+
+/**
+ * @brief      Get a read-only view of an attribute based on attribute ID, without copying the value.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[out] p_view   Pointer were the view can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed or the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_view(	gp_nvm_attr_id_t attr_id,
+							gp_nvm_view_t *p_view)
+{
+	return gp_nvm_ctx_get_attribute_view(&default_ctx, attr_id, p_view);
+}
+
+/**
+ * @brief      Check if the value of a view may have been changed since it was taken.
+ *
+ * @param[in]  p_view  The view returned by gp_nvm_get_attribute_view.
+ *
+ * @return     1: The store changed, the value of the view can't be trusted.
+ * @return     0: The value of the view is still the value of the attribute.
+ */
+int
+gp_nvm_view_changed(const gp_nvm_view_t *p_view)
+{
+	return gp_nvm_ctx_view_changed(&default_ctx, p_view);
+}
+
+/**
+ * @brief      Set an attribute based on the attribute ID.
+ *
+ * This function tries to update an attribute on the NVM.
+ * If found, the value is overwritten in place when it fits the record, otherwise the record is moved.
+ * If not found, it will add a new record for the attribute to the NVM and add it to the index.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_set_attribute(	gp_nvm_attr_id_t attr_id,
+						uint32_t length,
+						uint8_t* p_value)
+{
+	return gp_nvm_ctx_set_attribute(&default_ctx, attr_id, length, p_value);
+}
+
+/**
+ * @brief      Delete an attribute based on the attribute ID.
+ *
+ * The in-place engine frees the record of the attribute, the log engine appends a delete record that hides
+ * the older records of the attribute. The space is reclaimed by gp_nvm_compact. A cached value of the attribute
+ * is dropped, also when it was never written back. A static attribute reads as never set again.
+ * An asynchronous set of the attribute that is still queued sets it again once it is stored.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_delete_attribute(gp_nvm_attr_id_t attr_id)
+{
+	return gp_nvm_ctx_delete_attribute(&default_ctx, attr_id);
+}
+
+/**
+ * @brief      Overwrite a range of the value of an attribute based on the attribute ID.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_update_attribute_range(	gp_nvm_attr_id_t attr_id,
+								uint32_t offset,
+								uint32_t length,
+								uint8_t* p_value)
+{
+	return gp_nvm_ctx_update_attribute_range(&default_ctx, attr_id, offset, length, p_value);
+}
+
+/**
+ * @brief      Get the length of the value of an attribute based on attribute ID.
+ *
+ * @param[in]  attr_id   The attribute identifier
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_length(	gp_nvm_attr_id_t attr_id,
+								uint32_t* p_length)
+{
+	return gp_nvm_ctx_get_attribute_length(&default_ctx, attr_id, p_length);
+}
+
+/**
+ * @brief      Open a stream that sets the value of an attribute in chunks.
+ *
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  length    The length of the value.
+ * @param[out] p_stream  Pointer were the stream can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_open(	gp_nvm_attr_id_t attr_id,
+					uint32_t length,
+					gp_nvm_stream_t **p_stream)
+{
+	return gp_nvm_ctx_stream_open(&default_ctx, attr_id, length, p_stream);
+}
+
+/**
+ * @brief      Queue the set of an attribute, the value is stored on the NVM by the I/O worker thread.
+ *
+ * The value is copied, the call doesn't wait for the NVM.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL to poll with gp_nvm_poll_async.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS (the set was queued)
+ * @return     1: GP_NVM_FAIL (the library wasn't initialized or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full or the value is too long)
+ */
+gp_nvm_result_t
+gp_nvm_set_attribute_async(	gp_nvm_attr_id_t attr_id,
+							uint32_t length,
+							uint8_t* p_value,
+							gp_nvm_async_cb_t cb,
+							void *arg)
+{
+	return gp_nvm_ctx_set_attribute_async(&default_ctx, attr_id, length, p_value, cb, arg);
+}
+
+/**
+ * @brief      Return the number of asynchronous sets that aren't completed yet.
+ *
+ * @return     The number of queued sets, 0 when all sets are completed.
+ */
+uint32_t
+gp_nvm_poll_async(void)
+{
+	return gp_nvm_ctx_poll_async(&default_ctx);
+}
+
+/**
+ * @brief      Wait until all asynchronous sets are completed.
+ *
+ */
+void
+gp_nvm_wait_async(void)
+{
+	gp_nvm_ctx_wait_async(&default_ctx);
+}
+
+/**
+ * @brief      Start a batch of attribute sets.
+ *
+ * There is one batch for all threads.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a batch was already started)
+ */
+gp_nvm_result_t
+gp_nvm_batch_begin(void)
+{
+	return gp_nvm_ctx_batch_begin(&default_ctx);
+}
+
+/**
+ * @brief      Stage the set of an attribute in the batch.
+ *
+ * The value is copied, it isn't visible to gp_nvm_get_attribute until the batch is committed.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_batch_set(	gp_nvm_attr_id_t attr_id,
+					uint32_t length,
+					uint8_t* p_value)
+{
+	return gp_nvm_ctx_batch_set(&default_ctx, attr_id, length, p_value);
+}
+
+/**
+ * @brief      Commit the batch, either all staged sets are stored or none of them.
+ *
+ * The batch is ended, also when the commit fails.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_batch_commit(void)
+{
+	return gp_nvm_ctx_batch_commit(&default_ctx);
+}
+
+/**
+ * @brief      Drop the batch without storing any of the staged sets.
+ *
+ */
+void
+gp_nvm_batch_abort(void)
+{
+	gp_nvm_ctx_batch_abort(&default_ctx);
+}
+
+/**
+ * @brief      Write back all dirty values of the value cache to the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_flush(void)
+{
+	return gp_nvm_ctx_flush(&default_ctx);
+}
+
+/**
+ * @brief      Copy the statistics of the value cache.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_cache_stats(gp_nvm_cache_stats_t *stats)
+{
+	gp_nvm_ctx_get_cache_stats(&default_ctx, stats);
+}
+
+/**
+ * @brief      Run one incremental compaction step.
+ *
+ * @param[in]  max_bytes  Maximum number of bytes to relocate, 0 relocates a complete segment of the log engine
+ *                        and moves records until no free extent fits with the in-place engine.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_compact(uint32_t max_bytes)
+{
+	return gp_nvm_ctx_compact(&default_ctx, max_bytes);
+}
+
+/**
+ * @brief      Write a checkpoint of the attribute index.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint(void)
+{
+	return gp_nvm_ctx_checkpoint(&default_ctx);
+}
+
+/**
+ * @brief      Call a callback for every attribute with an ID from first_id up to and including last_id, in ID order.
+ *
+ * @param[in]  first_id  The first attribute identifier of the range.
+ * @param[in]  last_id   The last attribute identifier of the range.
+ * @param[in]  cb        The callback.
+ * @param[in]  arg       The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_foreach(	gp_nvm_attr_id_t first_id,
+				gp_nvm_attr_id_t last_id,
+				gp_nvm_foreach_cb_t cb,
+				void *arg)
+{
+	return gp_nvm_ctx_foreach(&default_ctx, first_id, last_id, cb, arg);
+}
+
+/**
+ * @brief      Export all attributes to a compact stream of bytes.
+ *
+ * @param[in]  write  The callback that writes the bytes.
+ * @param[in]  arg    The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_export(	gp_nvm_export_cb_t write,
+				void *arg)
+{
+	return gp_nvm_ctx_export(&default_ctx, write, arg);
+}
+
+/**
+ * @brief      Import all attributes of a stream written by gp_nvm_export.
+ *
+ * @param[in]  read  The callback that reads the bytes.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_import(	gp_nvm_import_cb_t read,
+				void *arg)
+{
+	return gp_nvm_ctx_import(&default_ctx, read, arg);
+}
+
+/**
+ * @brief      Get a static attribute from its slot, see GP_NVM_SLOT.
+ * 
+ * A static attribute has a record at a fixed offset of the NVM, so it is read without a look-up.
+ * Use the typed gp_nvm_get_slot_<name> functions, they pass a value of the type of the schema.
+ *
+ * @param[in]  slot     The slot of the attribute.
+ * @param[out] p_value  Pointer were the value can be stored, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_get_slot(	uint32_t slot,
+					void* p_value)
+{
+	return gp_nvm_ctx_get_slot(&default_ctx, slot, p_value);
+}
+
+/**
+ * @brief      Set a static attribute in its slot, see GP_NVM_SLOT.
+ * 
+ * The record of a static attribute is overwritten in place, also with the log engine.
+ * Use the typed gp_nvm_set_slot_<name> functions, they pass a value of the type of the schema.
+ *
+ * @param[in]  slot     The slot of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_set_slot(	uint32_t slot,
+					const void* p_value)
+{
+	return gp_nvm_ctx_set_slot(&default_ctx, slot, p_value);
+}
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_compact_stats(gp_nvm_compact_stats_t *stats)
+{
+	gp_nvm_ctx_get_compact_stats(&default_ctx, stats);
+}
+
+/**
+ * @brief      Copy the free-space allocator statistics of the in-place engine.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_alloc_stats(gp_nvm_alloc_stats_t *stats)
+{
+	gp_nvm_ctx_get_alloc_stats(&default_ctx, stats);
+}
+
+/**
+ * @brief      Copy the runtime statistics of the library.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_stats(gp_nvm_stats_t *stats)
+{
+	gp_nvm_stats_sum(stats);
+}
 
-/** @} */
\ No newline at end of file
+/** @} */
@@ -11,11 +11,110 @@
  *
  * The gp-nvm-lib can be used to persistenly store attributes on a non-volatile memory device. 
  * For this purpose a getter and a setter function are provided.
- * The gp-nvm-lib maintains a list of attributes in RAM, indexed by the attribute ID.
+ * The gp-nvm-lib maintains a hash index of the attributes in RAM, indexed by the attribute ID.
  * Each entry contains the offset in the NVM and length of the attribute.
  * 
- * \todo Extend the attribute list with a CRC value for each attribute and for the list itself.
- * \todo Allow attributes that can have a variable size.  
+ * On the NVM, every attribute is stored as a record: a small header with the attribute ID,
+ * length and capacity, followed by the value. Attributes can change length with every set. There is no separate attribute list that has to be rewritten,
+ * the index is rebuilt at boot-time by scanning the records.
+ * 
+ * To keep the boot-time flat as the store grows, a checkpoint of the index can be written to the NVM with
+ * gp_nvm_checkpoint, or automatically every checkpoint_interval changes and when a context is closed.
+ * The index is then loaded from the newest valid checkpoint: the log engine only scans the records written
+ * after it, the in-place engine only uses a checkpoint when nothing changed after it (e.g. a checkpoint
+ * written at close), because values overwritten in place can't be found by a partial scan.
+ * Without a valid checkpoint all records are scanned.
+ * 
+ * Two storage engines are available, the engine is chosen when the NVM is formatted:
+ *   * The in-place engine overwrites the value of an existing attribute in place.
+ *     When an attribute grows beyond the space of its record, the record is moved to a free extent
+ *     and the old extent is returned to a free-space allocator, see gp_nvm_get_alloc_stats.
+ *   * The log engine appends a new versioned record for every set, so all writes are sequential.
+ *     Stale records are reclaimed by an incremental compactor, see gp_nvm_compact.
+ * 
+ * gp_nvm_delete_attribute deletes an attribute. Its space is reclaimed online by gp_nvm_compact in steps of a
+ * bounded number of bytes: the log engine erases segments, the in-place engine shrinks its data region by
+ * moving the records at its end into the free space before it.
+ * 
+ * Several sets can be grouped in a batch with gp_nvm_batch_begin, gp_nvm_batch_set and gp_nvm_batch_commit.
+ * A batch is committed atomically: after a crash either all of its sets are stored or none of them.
+ * With the log engine a batch has to fit in one log segment.
+ * 
+ * An optional write-back cache keeps recently used values in RAM, see gp_nvm_config_t.
+ * With the cache, gets of cached attributes don't read the NVM and sets only update the cache.
+ * Dirty values are written to the NVM by gp_nvm_flush, when they are evicted or when the flush interval passed,
+ * so sets that were not written back yet are lost on a crash.
+ * 
+ * Sets, batch commits, flushes, compactions and checkpoints return once their writes are durable according to
+ * the durability level of the NVM device, see nvm_arch_durability_t. The device is synced after the writer
+ * mutex is released, so with group commit the sets of several threads share one flush.
+ * 
+ * The library can be used from several threads. Sets, batch commits, flushes and compaction serialize on
+ * one writer mutex. Gets don't take a lock when the cache is disabled: they read a snapshot of the index
+ * and retry when a writer changed the store meanwhile, so gets scale with the number of cores.
+ * With the cache, gets take the writer mutex because they update the cache.
+ * Initialization may not run concurrently with other calls. Build with GP_NVM_CONF_THREADS=0 and
+ * NVM_CONF_THREADS=0 for a platform without pthreads.
+ * 
+ * The functions without a context use the default context on the default NVM device.
+ * gp_nvm_open opens an independent context on a file of its own, every gp_nvm_ctx_ function takes the context
+ * as its first parameter. A context can be sharded: attribute IDs are hashed over several backing files that
+ * each have their own index and writer mutex, so sets of attributes in different shards don't contend.
+ * A batch has to stay within one shard.
+ * 
+ * gp_nvm_set_attribute_async queues a set and returns without waiting for the NVM, so it can be used from
+ * threads that may not block on storage. An I/O worker thread per context stores the queued sets: repeated
+ * sets of the same attribute are merged and the others are committed together like a batch, so records that
+ * are adjacent on the NVM are written with one vectored write. Completion is reported through a callback or
+ * by polling with gp_nvm_poll_async. Gets return the previous value until the set completed.
+ * 
+ * gp_nvm_get_stats returns counters and cumulative latencies of the operations of the library, nvm_arch_get_stats
+ * those of the NVM devices. Every thread counts in counters of its own that are only summed when they are read,
+ * so the statistics can stay enabled in production. Build with GP_NVM_CONF_STATS=0 and NVM_CONF_STATS=0
+ * to leave them out.
+ * 
+ * gp_nvm_get_attribute_view returns a read-only pointer to the value on the NVM instead of a copy, when the
+ * NVM device keeps the NVM in memory (a mapped file or the RAM backend). The view carries the generation of
+ * the store it was taken in: gp_nvm_view_changed tells if a set, batch or compaction may have changed the
+ * value since, in which case the view has to be taken again.
+ * 
+ * gp_nvm_update_attribute_range overwrites a range of the value of an attribute, e.g. one field of a struct,
+ * and gp_nvm_get_attribute_range reads one. The in-place engine only reads and writes the bytes of the range
+ * and the record header: the CRC of the value is updated from the old and the new bytes of the range.
+ * The log engine appends the complete value like a set. A range get can't check the CRC of the value.
+ * 
+ * With compress_min_len set in the configuration, values of at least that many bytes are compressed with
+ * a small LZ codec when that makes them shorter, which also covers runs of one byte. The codec is kept in the
+ * record header and the index entry, the stored length and CRC are those of the compressed value. Gets
+ * decompress the value, so compression is transparent except that a compressed value can't be viewed and
+ * its ranges are updated by setting the complete value again.
+ * 
+ * Lengths and offsets of values are 32 bits wide. gp_nvm_get_attribute_length tells how large the buffer of a
+ * get has to be. A large value, e.g. a calibration table or a firmware image, doesn't have to be held in RAM
+ * completely: gp_nvm_stream_open reserves the record of the value, gp_nvm_stream_write writes the value
+ * in sequential chunks straight into the record and gp_nvm_stream_commit makes it the value of the attribute.
+ * Until the commit gets return the previous value, after a crash the reserved record is free again.
+ * gp_nvm_get_attribute_range reads a large value back in chunks. Streamed values aren't compressed.
+ * With the log engine a value has to fit in one log segment, so large values need a large log_segment_size.
+ * 
+ * gp_nvm_foreach calls a callback for every attribute in a range of IDs, in ID order. gp_nvm_export writes all
+ * attributes to a compact stream through a callback, reading the records of every shard in one sequential pass,
+ * and gp_nvm_import sets them again from such a stream with one batch per shard, e.g. to restore a backup.
+ * 
+ * An attribute set that is fixed at build time can be declared as a static schema with GP_NVM_CONF_SCHEMA.
+ * Every static attribute gets a slot of a fixed size at a fixed offset of the NVM, laid out at compile time,
+ * so gp_nvm_get_slot and gp_nvm_set_slot index the slot directly and typed gp_nvm_get_slot_<name> functions
+ * check the type of the value at compile time. gp_nvm_get_attribute and gp_nvm_set_attribute use the slot of a
+ * static ID as well, other IDs stay dynamic. Static attributes can't be set in a batch, a stream or asynchronously.
+ * 
+ * With preload set in the configuration, every shard reads its NVM with one read when it is opened. The scan
+ * that rebuilds the index runs over that image, and gets, range gets and lengths copy from it instead of
+ * reading the NVM for every attribute.
+ * The first change of a shard stops the use of its image, it is released when the shard is closed.
+ * 
+ * The superblock and every record header carry a CRC32C, so a corrupt record header stops the scan at boot-time.
+ * The value of every record has its own CRC32C that is checked on every get, a corrupt value is reported
+ * as GP_NVM_CRC_ERROR. This detects corruption without the read-back verify of the NVM device.
  *
  */
 
@@ -30,12 +129,28 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "nvm-arch.h"
+
+/**
+ * @brief      Width of the attribute identifier in bits (8, 16 or 32).
+ * 
+ * Attribute identifiers are always stored with 32 bits on the NVM.
+ */
+#ifndef GP_NVM_CONF_ATTR_ID_BITS
+#define GP_NVM_CONF_ATTR_ID_BITS 32
+#endif
 
 /**
  * @brief      Attribute identifier.
  * 
  */
+#if GP_NVM_CONF_ATTR_ID_BITS == 8
 typedef uint8_t gp_nvm_attr_id_t;
+#elif GP_NVM_CONF_ATTR_ID_BITS == 16
+typedef uint16_t gp_nvm_attr_id_t;
+#else
+typedef uint32_t gp_nvm_attr_id_t;
+#endif
 /**
  * @brief      gp-nvm-lib operation result code.
  * 
@@ -54,51 +169,1242 @@ enum GP_NVM_RESULT_CODE
 	GP_NVM_ATTR_LEN_DIFF,
 	GP_NVM_MEM_FULL,
 	GP_NVM_MEM_ERROR,
+	GP_NVM_CRC_ERROR,
 };
 
 /**
- * @brief      Allows to search for an entry in the attribute list based on the attribute ID.
- *
- * @param[in]  attr_id  The att.ribute identifier
+ * @brief      Enumeration of storage engines.
+ * 
+ */
+typedef enum gp_nvm_engine {
+	GP_NVM_ENGINE_IN_PLACE,
+	GP_NVM_ENGINE_LOG,
+} gp_nvm_engine_t;
+
+/**
+ * @brief      Configuration of the gp-nvm-lib.
+ * 
+ * A zeroed configuration selects the in-place engine and default values for all other fields.
+ * The engine and segment size are only used when an empty NVM is formatted,
+ * an NVM that is already formatted keeps its engine.
+ */
+typedef struct gp_nvm_config {
+	gp_nvm_engine_t engine;
+	uint32_t log_segment_size;		/**< Size of a log segment in bytes, 0 selects the default. */
+	uint32_t log_compact_threshold;	/**< Compact when stale bytes exceed this percentage of live bytes, 0 selects the default. */
+	uint32_t cache_size;			/**< Size of the write-back value cache in bytes, 0 disables the cache. */
+	uint32_t cache_flush_interval;	/**< Write back dirty values when this many milliseconds passed since the last flush, 0 disables the timer. */
+	uint32_t num_shards;			/**< Number of shard files of a context opened with gp_nvm_open, 0 or 1 disables sharding. */
+	uint32_t async_queue_size;		/**< Number of asynchronous sets that can be queued, 0 selects the default. */
+	uint32_t checkpoint_interval;	/**< Write a checkpoint of the index after this many changes and when the context is closed, 0 disables automatic checkpoints. */
+	uint32_t compress_min_len;		/**< Compress values of at least this many bytes when that saves space, 0 disables compression. */
+	uint32_t preload;				/**< Read the NVM of every shard with one read at boot-time, rebuild the index and serve gets from it until the first change, 0 disables the preload. */
+	uint32_t verbose;				/**< Print the attribute index at boot-time when not 0. */
+} gp_nvm_config_t;
+
+/**
+ * @brief      Completion callback of an asynchronous set.
+ * 
+ * The callback is called from the I/O worker thread with the result of the set and the argument passed
+ * with the set.
+ */
+typedef void (*gp_nvm_async_cb_t)(gp_nvm_attr_id_t attr_id, gp_nvm_result_t result, void *arg);
+
+/**
+ * @brief      Callback of gp_nvm_foreach, called for every attribute with its value.
+ * 
+ * The value is only valid during the call. The callback may call the library, e.g. to set the attribute.
+ * Return 0 to continue with the next attribute, any other value stops the iteration.
+ */
+typedef int (*gp_nvm_foreach_cb_t)(gp_nvm_attr_id_t attr_id, uint32_t length, const uint8_t* p_value, void *arg);
+
+/**
+ * @brief      Callback that writes the next bytes of an export, see gp_nvm_export.
+ * 
+ * Return 0 when all bytes were written, any other value stops the export.
+ */
+typedef int (*gp_nvm_export_cb_t)(const uint8_t* p_data, uint32_t length, void *arg);
+
+/**
+ * @brief      Callback that reads the next bytes of an import, see gp_nvm_import.
+ * 
+ * Return 0 when exactly length bytes were read, any other value stops the import.
+ */
+typedef int (*gp_nvm_import_cb_t)(uint8_t* p_data, uint32_t length, void *arg);
+
+/**
+ * @brief      Maximum number of shards of a context.
+ * 
+ */
+#define GP_NVM_MAX_SHARDS 255
+
+/**
+ * @brief      Context of an independent attribute store, see gp_nvm_open.
+ * 
+ */
+typedef struct gp_nvm_ctx gp_nvm_ctx_t;
+
+/**
+ * @brief      Compaction statistics.
+ * 
+ * The write amplification is the number of bytes written to the NVM divided by the
+ * number of value bytes set by the user.
+ * The reclaimed bytes are the bytes of erased segments of the log engine and the bytes cut off the end
+ * of the data of the in-place engine. The in-place engine only fills in the live, stale, compact and
+ * reclaimed bytes, its stale bytes are the free space between its records.
+ */
+typedef struct gp_nvm_compact_stats {
+	uint64_t live_bytes;
+	uint64_t stale_bytes;
+	uint64_t user_bytes;
+	uint64_t device_bytes;
+	uint64_t compact_bytes;
+	uint64_t reclaimed_bytes;
+	uint64_t segments_reclaimed;
+	uint32_t num_segments;
+	uint32_t free_segments;
+	double write_amplification;
+} gp_nvm_compact_stats_t;
+
+/**
+ * @brief      Free-space allocator statistics of the in-place engine.
+ * 
+ * The search steps count the free extents inspected by all allocations.
+ * The fragmentation is 1 - largest_free / free_bytes, 0 when all free space is one extent.
+ */
+typedef struct gp_nvm_alloc_stats {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t splits;
+	uint64_t search_steps;
+	uint64_t merges;
+	uint64_t end_allocs;
+	uint32_t free_extents;
+	uint32_t largest_free;
+	uint64_t free_bytes;
+	uint32_t data_end;
+	double fragmentation;
+} gp_nvm_alloc_stats_t;
+
+/**
+ * @brief      Statistics of the write-back value cache.
+ * 
+ * Absorbed sets updated a value that was not written back yet, so they never reached the NVM.
+ */
+typedef struct gp_nvm_cache_stats {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t absorbed;
+	uint64_t writebacks;
+	uint64_t evictions;
+	uint32_t num_entries;
+	uint32_t cached;
+	uint32_t dirty;
+} gp_nvm_cache_stats_t;
+
+/**
+ * @brief      Counters of one kind of operation.
+ * 
+ * The time is the sum of the wall-clock time of all operations in nanoseconds.
+ * The bytes are the value bytes that were read or written, including those of failed operations.
+ */
+typedef struct gp_nvm_op_stats {
+	uint64_t count;
+	uint64_t errors;
+	uint64_t time_ns;
+	uint64_t bytes;
+} gp_nvm_op_stats_t;
+
+/**
+ * @brief      Runtime statistics of the library, over all contexts.
+ * 
+ * Batch commits count the value bytes of all sets of the batch.
+ * Asynchronous sets are counted when they are queued, an error means the queue was full.
+ * Views count the value bytes that were returned without copying them.
+ * Range updates and range gets count the bytes of the range.
+ * Stream writes count the bytes of the chunk, stream commits the bytes of the complete value.
+ * Exports and imports count the value bytes of all attributes as they are stored.
+ * Deletes count no bytes, compactions count the bytes they reclaimed.
+ * A record move writes an attribute to a new record: its value outgrew its record, a batch replaced it
+ * or compaction relocated it. Moves are the directory rewrites of this library, the log engine
+ * appends a record for every set and those aren't counted as moves.
+ * Compressed values counts the values that were stored compressed, with the bytes that saved.
+ * The statistics of the NVM devices are read with nvm_arch_get_stats.
+ */
+typedef struct gp_nvm_stats {
+	gp_nvm_op_stats_t get;
+	gp_nvm_op_stats_t set;
+	gp_nvm_op_stats_t batch_commit;
+	gp_nvm_op_stats_t async_set;
+	gp_nvm_op_stats_t view;
+	gp_nvm_op_stats_t update_range;
+	gp_nvm_op_stats_t get_range;
+	gp_nvm_op_stats_t stream_write;
+	gp_nvm_op_stats_t stream_commit;
+	gp_nvm_op_stats_t exports;
+	gp_nvm_op_stats_t imports;
+	gp_nvm_op_stats_t deletes;
+	gp_nvm_op_stats_t compactions;
+	uint64_t crc_errors;
+	uint64_t record_moves;
+	uint64_t compressed_values;
+	uint64_t compressed_saved_bytes;
+} gp_nvm_stats_t;
+
+/**
+ * @brief      Read-only view of the value of an attribute on the NVM.
+ * 
+ * The value points into the memory of the NVM device and stays readable until the store is closed, but
+ * its bytes are only guaranteed to be the value of the attribute as long as gp_nvm_view_changed returns 0.
+ * The generation is the state of the shard of the attribute when the view was taken.
+ */
+typedef struct gp_nvm_view {
+	const uint8_t *p_value;
+	uint32_t length;
+	gp_nvm_attr_id_t attr_id;
+	uint32_t generation;
+} gp_nvm_view_t;
+
+/**
+ * @brief      Stream that sets the value of an attribute in chunks, see gp_nvm_stream_open.
+ * 
+ */
+typedef struct gp_nvm_stream gp_nvm_stream_t;
+
+/**
+ * @brief      Enumeration of the slots of the static attributes, GP_NVM_SLOT_<name> for every static attribute.
+ * 
+ * An attribute set that is fixed at build time can be declared as a static schema: define GP_NVM_CONF_SCHEMA
+ * as the name of a header with a line GP_NVM_SCHEMA_ATTR(name, id, type) for every static attribute, e.g.
+ * GP_NVM_SCHEMA_ATTR(tx_power, 0x10, int8_t). The header is included several times, so declarations of
+ * its types have to be guarded against that. Without GP_NVM_CONF_SCHEMA all attributes are dynamic.
+ */
+#ifdef GP_NVM_CONF_SCHEMA
+// the first inclusion only declares the types of the schema
+#define GP_NVM_SCHEMA_ATTR(name, id, type)
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+#endif
+enum GP_NVM_SLOT
+{
+#ifdef GP_NVM_CONF_SCHEMA
+#define GP_NVM_SCHEMA_ATTR(name, id, type) GP_NVM_SLOT_##name,
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+#endif
+	GP_NVM_NUM_SLOTS
+};
+
+/**
+ * @brief      This function initializes the general purpose non-volatile memory library.
+ * 
+ * An empty NVM is formatted, otherwise the attribute index is rebuilt from the records on the NVM.
  *
- * @return     NULL: No entry was found.
- * @return     attr_list_entry_t*: Pointer to the entry in the attribute list.
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
  */
-void
+gp_nvm_result_t
 gp_nvm_init();
 
 /**
- * @brief      Allows to search for an entry in the attribute list based on the attribute ID.
+ * @brief      This function initializes the general purpose non-volatile memory library with a configuration.
  *
- * @param[in]  attr_id  The att.ribute identifier
+ * @param[in]  config  The configuration, NULL selects the defaults.
  *
- * @return     NULL: No entry was found.
- * @return     attr_list_entry_t*: Pointer to the entry in the attribute list.
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
  */
-gp_nvm_result_t 
-gp_nvm_get_attribute(	gp_nvm_attr_id_t attr_id,
-						uint8_t* p_length,
-						uint8_t* p_value);
+gp_nvm_result_t
+gp_nvm_init_with_config(const gp_nvm_config_t *config);
 
 /**
  * @brief      Get an attribute based on attribute ID.
  * 
  * This function searches for the attribute in NVM.
  * If found, it copies both the length and value into the respective pointers provides as parameters.
+ * A value that doesn't fit in size bytes isn't copied, then p_length is set to the length it needs.
+ * The length can change with every set, so a buffer sized with gp_nvm_get_attribute_length may be too small.
  *
  * @param[in]  attr_id   The attribute identifier
+ * @param[in]  size      The size of the buffer at p_value.
  * @param[out] p_length  Pointer were the length can be stored.
  * @param[out] p_value   Pointer were the value can be stored.
  *
  * @return     0: GP_NVM_SUCCESS
  * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t 
+gp_nvm_get_attribute(	gp_nvm_attr_id_t attr_id,
+						uint32_t size,
+						uint32_t* p_length,
+						uint8_t* p_value);
+
+/**
+ * @brief      Get a range of the value of an attribute based on attribute ID.
+ * 
+ * Only the bytes of the range are read, so unlike gp_nvm_get_attribute the CRC of the value isn't checked.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_range(	gp_nvm_attr_id_t attr_id,
+							uint32_t offset,
+							uint32_t length,
+							uint8_t* p_value);
+
+/**
+ * @brief      Get the length of the value of an attribute based on attribute ID, without reading the value.
+ * 
+ * Only the start of a compressed value is read for its length.
+ *
+ * @param[in]  attr_id   The attribute identifier
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_length(	gp_nvm_attr_id_t attr_id,
+								uint32_t* p_length);
+
+/**
+ * @brief      Get a read-only view of an attribute based on attribute ID, without copying the value.
+ * 
+ * The CRC of the value is checked like with gp_nvm_get_attribute. Use the value, then check with
+ * gp_nvm_view_changed that no writer changed it meanwhile, otherwise take the view again.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[out] p_view   Pointer were the view can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed, e.g. a file that isn't memory-mapped, or the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_get_attribute_view(	gp_nvm_attr_id_t attr_id,
+							gp_nvm_view_t *p_view);
+
+/**
+ * @brief      Check if the value of a view may have been changed since it was taken.
+ *
+ * @param[in]  p_view  The view returned by gp_nvm_get_attribute_view.
+ *
+ * @return     1: The store changed, the value of the view can't be trusted.
+ * @return     0: The value of the view is still the value of the attribute.
+ */
+int
+gp_nvm_view_changed(const gp_nvm_view_t *p_view);
+
+/**
+ * @brief      Set an attribute based on the attribute ID.
+ * 
+ * This function tries to update an attribute on the NVM.
+ * If found, the value is overwritten in place when it fits the record, otherwise the record is moved.
+ * If not found, it will add a new record for the attribute to the NVM and add it to the index.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
  * @return     5: GP_NVM_MEM_ERROR
  */
 gp_nvm_result_t
 gp_nvm_set_attribute(	gp_nvm_attr_id_t attr_id,
-						uint8_t length, 
+						uint32_t length, 
 						uint8_t* p_value);
 
+/**
+ * @brief      Delete an attribute based on the attribute ID.
+ * 
+ * The in-place engine frees the record of the attribute, the log engine appends a delete record that hides
+ * the older records of the attribute. The space is reclaimed by gp_nvm_compact. A cached value of the attribute
+ * is dropped, also when it was never written back. A static attribute reads as never set again.
+ * An asynchronous set of the attribute that is still queued sets it again once it is stored.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_delete_attribute(gp_nvm_attr_id_t attr_id);
+
+/**
+ * @brief      Overwrite a range of the value of an attribute based on the attribute ID.
+ * 
+ * The length of the value doesn't change, the range has to lie within the value.
+ * With the in-place engine only the bytes of the range and the record header are written and verified.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (the log engine read a corrupt value)
+ */
+gp_nvm_result_t
+gp_nvm_update_attribute_range(	gp_nvm_attr_id_t attr_id,
+								uint32_t offset,
+								uint32_t length,
+								uint8_t* p_value);
+
+/**
+ * @brief      Open a stream that sets the value of an attribute in chunks.
+ * 
+ * The record of the value is reserved on the NVM, the value is written into it with gp_nvm_stream_write and
+ * becomes the value of the attribute with gp_nvm_stream_commit. Every stream has to be committed or aborted
+ * before the store is closed. While a stream is open no checkpoints are written and nothing is
+ * compacted. The attribute may not be set while its stream is open, the commit then fails.
+ *
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  length    The length of the value.
+ * @param[out] p_stream  Pointer were the stream can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (also when the log engine can't fit the value in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_open(	gp_nvm_attr_id_t attr_id,
+					uint32_t length,
+					gp_nvm_stream_t **p_stream);
+
+/**
+ * @brief      Write the next chunk of the value of a stream.
+ * 
+ * The chunks are written in order, each one right after the previous one.
+ *
+ * @param[in]  stream   The stream.
+ * @param[in]  length   The length of the chunk.
+ * @param[in]  p_value  Pointer to the chunk in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the chunk ends beyond the length of the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_write(	gp_nvm_stream_t *stream,
+						uint32_t length,
+						const uint8_t* p_value);
+
+/**
+ * @brief      Commit a stream, the value becomes the value of the attribute.
+ * 
+ * The stream is released, except when not all bytes of the value were written yet.
+ *
+ * @param[in]  stream  The stream.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the attribute was set while the stream was open)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (not all bytes of the value were written, the stream stays open)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_stream_commit(gp_nvm_stream_t *stream);
+
+/**
+ * @brief      Abort a stream, the attribute keeps its previous value and the stream is released.
+ *
+ * @param[in]  stream  The stream.
+ */
+void
+gp_nvm_stream_abort(gp_nvm_stream_t *stream);
+
+/**
+ * @brief      Start a batch of attribute sets.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a batch was already started)
+ */
+gp_nvm_result_t
+gp_nvm_batch_begin(void);
+
+/**
+ * @brief      Stage the set of an attribute in the batch.
+ *
+ * The value is copied, it isn't visible to gp_nvm_get_attribute until the batch is committed.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_batch_set(	gp_nvm_attr_id_t attr_id,
+					uint32_t length,
+					uint8_t* p_value);
+
+/**
+ * @brief      Commit the batch, either all staged sets are stored or none of them.
+ *
+ * The batch is ended, also when the commit fails.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_batch_commit(void);
+
+/**
+ * @brief      Drop the batch without storing any of the staged sets.
+ *
+ */
+void
+gp_nvm_batch_abort(void);
+
+/**
+ * @brief      Queue the set of an attribute, the value is stored on the NVM by the I/O worker thread.
+ *
+ * The value is copied, the call doesn't wait for the NVM. The queued sets of one attribute are stored in
+ * the order they were queued, but not in order with synchronous sets of the same attribute.
+ * The value is copied into the queue, so it can't be longer than GP_NVM_CONF_ASYNC_VALUE_SIZE.
+ *
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL to poll with gp_nvm_poll_async.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS (the set was queued)
+ * @return     1: GP_NVM_FAIL (the library wasn't initialized or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full or the value is too long)
+ */
+gp_nvm_result_t
+gp_nvm_set_attribute_async(	gp_nvm_attr_id_t attr_id,
+							uint32_t length,
+							uint8_t* p_value,
+							gp_nvm_async_cb_t cb,
+							void *arg);
+
+/**
+ * @brief      Return the number of asynchronous sets that aren't completed yet.
+ *
+ * @return     The number of queued sets, 0 when all sets are completed.
+ */
+uint32_t
+gp_nvm_poll_async(void);
+
+/**
+ * @brief      Wait until all asynchronous sets are completed.
+ *
+ * This may not be called from a completion callback.
+ */
+void
+gp_nvm_wait_async(void);
+
+/**
+ * @brief      Write back all dirty values of the value cache to the NVM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_flush(void);
+
+/**
+ * @brief      Copy the statistics of the value cache.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_cache_stats(gp_nvm_cache_stats_t *stats);
+
+/**
+ * @brief      Run one incremental compaction step.
+ * 
+ * The log engine relocates at most max_bytes of live records out of the segment with the least live data,
+ * the segment is reclaimed once it holds no live records anymore.
+ * The in-place engine cuts the free space at the end of the data region off and moves at most max_bytes of
+ * the records at its end into free extents before it, so the data region shrinks.
+ * Nothing is compacted while a stream is open.
+ *
+ * @param[in]  max_bytes  Maximum number of bytes to relocate, 0 relocates a complete segment of the log engine
+ *                        and moves records until no free extent fits with the in-place engine.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_compact(uint32_t max_bytes);
+
+/**
+ * @brief      Write a checkpoint of the attribute index, so the next initialization doesn't have to scan all records.
+ * 
+ * Dirty values of the value cache are written back first. Nothing is written when the store didn't change
+ * since the last checkpoint.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_checkpoint(void);
+
+/**
+ * @brief      Call a callback for every attribute with an ID from first_id up to and including last_id, in ID order.
+ * 
+ * Dirty values of the value cache are written back first. The IDs are collected before the first call, so
+ * the callback can change attributes; an attribute that is set during the iteration may be seen with its old
+ * or new value, one that is added isn't seen.
+ *
+ * @param[in]  first_id  The first attribute identifier of the range.
+ * @param[in]  last_id   The last attribute identifier of the range.
+ * @param[in]  cb        The callback.
+ * @param[in]  arg       The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS (also when the callback stopped the iteration)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_foreach(	gp_nvm_attr_id_t first_id,
+				gp_nvm_attr_id_t last_id,
+				gp_nvm_foreach_cb_t cb,
+				void *arg);
+
+/**
+ * @brief      Export all attributes to a compact stream of bytes, e.g. for a backup.
+ * 
+ * Values are exported as they are stored, a compressed value stays compressed. The records of every shard are
+ * read in one sequential pass over the NVM, in the order they are stored, and the CRC of every value is checked.
+ * The stream ends with a CRC, see gp-nvm-export.h for the format. Dirty values of the value cache are written
+ * back first. Sets wait until the export is done, gets without the value cache don't.
+ *
+ * @param[in]  write  The callback that writes the bytes.
+ * @param[in]  arg    The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the NVM couldn't be read or the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_export(	gp_nvm_export_cb_t write,
+				void *arg);
+
+/**
+ * @brief      Import all attributes of a stream written by gp_nvm_export, attributes that aren't in it are kept.
+ * 
+ * The complete stream is read and its CRC checked before anything is set, so a truncated or corrupt stream
+ * changes nothing. The attributes of every shard are then committed as one batch, so they are written in one
+ * pass. With the log engine a batch has to fit in a log segment, so the attributes are committed in batches
+ * of at most half a segment instead.
+ *
+ * @param[in]  read  The callback that reads the bytes.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (not a stream of gp_nvm_export or an attribute is in it twice)
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR (the NVM couldn't be written or the callback failed)
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_import(	gp_nvm_import_cb_t read,
+				void *arg);
+
+/**
+ * @brief      Get a static attribute from its slot, see GP_NVM_SLOT.
+ * 
+ * A static attribute has a record at a fixed offset of the NVM, so it is read without a look-up.
+ * Use the typed gp_nvm_get_slot_<name> functions, they pass a value of the type of the schema.
+ *
+ * @param[in]  slot     The slot of the attribute.
+ * @param[out] p_value  Pointer were the value can be stored, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_get_slot(	uint32_t slot,
+					void* p_value);
+
+/**
+ * @brief      Set a static attribute in its slot, see GP_NVM_SLOT.
+ * 
+ * The record of a static attribute is overwritten in place, also with the log engine.
+ * Use the typed gp_nvm_set_slot_<name> functions, they pass a value of the type of the schema.
+ *
+ * @param[in]  slot     The slot of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_set_slot(	uint32_t slot,
+					const void* p_value);
+
+/**
+ * @brief      Copy the compaction statistics.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_compact_stats(gp_nvm_compact_stats_t *stats);
+
+/**
+ * @brief      Copy the free-space allocator statistics of the in-place engine.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_alloc_stats(gp_nvm_alloc_stats_t *stats);
+
+/**
+ * @brief      Copy the runtime statistics of the library.
+ *
+ * Every thread counts in its own counters, they are summed here. The counters are never reset, so they
+ * can be exported as monotonic counters.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_get_stats(gp_nvm_stats_t *stats);
+
+/**
+ * @brief      Open an independent attribute store.
+ *
+ * Without sharding the store is kept in the file at path. With num_shards > 1 in the configuration,
+ * the attributes are spread over num_shards files named path.0, path.1, ... The files have to exist,
+ * empty files are formatted. A sharded store has to be opened with the same number of shards every time.
+ *
+ * @param[out] p_ctx    Pointer were the context can be stored.
+ * @param[in]  path     The path of the NVM file, or the prefix of the shard files.
+ * @param[in]  config   The configuration, NULL selects the defaults.
+ * @param[in]  backend  The configuration of the NVM devices, NULL selects the defaults. Its path is ignored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (invalid number of shards)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_open(	gp_nvm_ctx_t **p_ctx,
+				const char *path,
+				const gp_nvm_config_t *config,
+				const nvm_arch_config_t *backend);
+
+/**
+ * @brief      Close a store opened with gp_nvm_open, dirty values of the cache are written back first.
+ *
+ * Queued asynchronous sets are completed before the store is closed.
+ * No other call may use the context concurrently or afterwards.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_close(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Return the default context, used by the functions without a context.
+ *
+ * @return     gp_nvm_ctx_t*: The default context.
+ */
+gp_nvm_ctx_t*
+gp_nvm_default_ctx(void);
+
+/**
+ * @brief      Get an attribute of a context, see gp_nvm_get_attribute.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  size      The size of the buffer at p_value.
+ * @param[out] p_length  Pointer were the length can be stored.
+ * @param[out] p_value   Pointer were the value can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the value doesn't fit in size bytes)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute(	gp_nvm_ctx_t *ctx,
+							gp_nvm_attr_id_t attr_id,
+							uint32_t size,
+							uint32_t* p_length,
+							uint8_t* p_value);
+
+/**
+ * @brief      Get a range of the value of an attribute of a context, see gp_nvm_get_attribute_range.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[out] p_value  Pointer were the bytes of the range can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL (no memory to decompress the value)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_range(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								uint32_t offset,
+								uint32_t length,
+								uint8_t* p_value);
+
+/**
+ * @brief      Get the length of the value of an attribute of a context, see gp_nvm_get_attribute_length.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[out] p_length  Pointer were the length can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR (only for a compressed value)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_length(	gp_nvm_ctx_t *ctx,
+									gp_nvm_attr_id_t attr_id,
+									uint32_t* p_length);
+
+/**
+ * @brief      Get a read-only view of an attribute of a context, see gp_nvm_get_attribute_view.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[out] p_view   Pointer were the view can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (the NVM device can't be viewed or the value is compressed)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_attribute_view(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								gp_nvm_view_t *p_view);
+
+/**
+ * @brief      Check if the value of a view of a context may have been changed, see gp_nvm_view_changed.
+ *
+ * @param[in]  ctx     The context.
+ * @param[in]  p_view  The view returned by gp_nvm_ctx_get_attribute_view.
+ *
+ * @return     1: The store changed, the value of the view can't be trusted.
+ * @return     0: The value of the view is still the value of the attribute.
+ */
+int
+gp_nvm_ctx_view_changed(	gp_nvm_ctx_t *ctx,
+							const gp_nvm_view_t *p_view);
+
+/**
+ * @brief      Set an attribute of a context, see gp_nvm_set_attribute.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_attribute(	gp_nvm_ctx_t *ctx,
+							gp_nvm_attr_id_t attr_id,
+							uint32_t length,
+							uint8_t* p_value);
+
+/**
+ * @brief      Delete an attribute of a context, see gp_nvm_delete_attribute.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_delete_attribute(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id);
+
+/**
+ * @brief      Overwrite a range of the value of an attribute of a context, see gp_nvm_update_attribute_range.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  offset   The offset of the range in the value.
+ * @param[in]  length   The length of the range.
+ * @param[in]  p_value  Pointer to the new bytes of the range in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     2: GP_NVM_ATTR_NOT_FOUND
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (the range ends beyond the value)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_update_attribute_range(	gp_nvm_ctx_t *ctx,
+									gp_nvm_attr_id_t attr_id,
+									uint32_t offset,
+									uint32_t length,
+									uint8_t* p_value);
+
+/**
+ * @brief      Open a stream that sets the value of an attribute of a context, see gp_nvm_stream_open.
+ *
+ * The stream is written and committed with gp_nvm_stream_write and gp_nvm_stream_commit.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  attr_id   The attribute identifier
+ * @param[in]  length    The length of the value.
+ * @param[out] p_stream  Pointer were the stream can be stored.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (also when the log engine can't fit the value in one segment)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_stream_open(	gp_nvm_ctx_t *ctx,
+						gp_nvm_attr_id_t attr_id,
+						uint32_t length,
+						gp_nvm_stream_t **p_stream);
+
+/**
+ * @brief      Queue the set of an attribute of a context, see gp_nvm_set_attribute_async.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ * @param[in]  cb       The completion callback, NULL to poll with gp_nvm_ctx_poll_async.
+ * @param[in]  arg      The last argument of the completion callback.
+ *
+ * @return     0: GP_NVM_SUCCESS (the set was queued)
+ * @return     1: GP_NVM_FAIL (the context wasn't initialized or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL (the queue is full or the value is too long)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_attribute_async(	gp_nvm_ctx_t *ctx,
+								gp_nvm_attr_id_t attr_id,
+								uint32_t length,
+								uint8_t* p_value,
+								gp_nvm_async_cb_t cb,
+								void *arg);
+
+/**
+ * @brief      Return the number of asynchronous sets of a context that aren't completed yet.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     The number of queued sets, 0 when all sets are completed.
+ */
+uint32_t
+gp_nvm_ctx_poll_async(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Wait until all asynchronous sets of a context are completed.
+ *
+ * This may not be called from a completion callback.
+ *
+ * @param[in]  ctx   The context.
+ */
+void
+gp_nvm_ctx_wait_async(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Start a batch of attribute sets in a context.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (a batch was already started)
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_begin(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Stage the set of an attribute in the batch of a context.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  attr_id  The attribute identifier
+ * @param[in]  length   The length of the attribute
+ * @param[in]  p_value  Pointer to the value in RAM.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or a static attribute)
+ * @return     4: GP_NVM_MEM_FULL
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_set(	gp_nvm_ctx_t *ctx,
+						gp_nvm_attr_id_t attr_id,
+						uint32_t length,
+						uint8_t* p_value);
+
+/**
+ * @brief      Commit the batch of a context, either all staged sets are stored or none of them.
+ *
+ * All attributes of a batch have to be in the same shard. The batch is ended, also when the commit fails.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no batch was started or the batch spans several shards)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_batch_commit(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Drop the batch of a context without storing any of the staged sets.
+ *
+ * @param[in]  ctx   The context.
+ */
+void
+gp_nvm_ctx_batch_abort(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Write back all dirty values of the caches of a context to the NVM.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_flush(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Run one incremental compaction step in every shard of a context, see gp_nvm_compact.
+ *
+ * @param[in]  ctx        The context.
+ * @param[in]  max_bytes  Maximum number of bytes to relocate per shard, 0 relocates as much as one step can.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_compact(	gp_nvm_ctx_t *ctx,
+					uint32_t max_bytes);
+
+/**
+ * @brief      Write a checkpoint of the index of every shard of a context.
+ *
+ * Dirty values of the caches are written back first, so the checkpoint covers them.
+ *
+ * @param[in]  ctx   The context.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_checkpoint(gp_nvm_ctx_t *ctx);
+
+/**
+ * @brief      Call a callback for every attribute of a context in an ID range, in ID order, see gp_nvm_foreach.
+ *
+ * @param[in]  ctx       The context.
+ * @param[in]  first_id  The first attribute identifier of the range.
+ * @param[in]  last_id   The last attribute identifier of the range.
+ * @param[in]  cb        The callback.
+ * @param[in]  arg       The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_foreach(	gp_nvm_ctx_t *ctx,
+					gp_nvm_attr_id_t first_id,
+					gp_nvm_attr_id_t last_id,
+					gp_nvm_foreach_cb_t cb,
+					void *arg);
+
+/**
+ * @brief      Export all attributes of a context, see gp_nvm_export.
+ *
+ * @param[in]  ctx    The context.
+ * @param[in]  write  The callback that writes the bytes.
+ * @param[in]  arg    The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_export(	gp_nvm_ctx_t *ctx,
+					gp_nvm_export_cb_t write,
+					void *arg);
+
+/**
+ * @brief      Import the attributes of an export in a context, see gp_nvm_import.
+ * 
+ * The stream can come from a context with another number of shards or another engine.
+ *
+ * @param[in]  ctx   The context.
+ * @param[in]  read  The callback that reads the bytes.
+ * @param[in]  arg   The last argument of the callback.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL
+ * @return     3: GP_NVM_ATTR_LEN_DIFF (a static attribute with another length)
+ * @return     4: GP_NVM_MEM_FULL
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_import(	gp_nvm_ctx_t *ctx,
+					gp_nvm_import_cb_t read,
+					void *arg);
+
+/**
+ * @brief      Get a static attribute of a context from its slot, see gp_nvm_get_slot.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  slot     The slot of the attribute.
+ * @param[out] p_value  Pointer were the value can be stored, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     2: GP_NVM_ATTR_NOT_FOUND (the attribute was never set)
+ * @return     5: GP_NVM_MEM_ERROR
+ * @return     6: GP_NVM_CRC_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_get_slot(	gp_nvm_ctx_t *ctx,
+						uint32_t slot,
+						void* p_value);
+
+/**
+ * @brief      Set a static attribute of a context in its slot, see gp_nvm_set_slot.
+ *
+ * @param[in]  ctx      The context.
+ * @param[in]  slot     The slot of the attribute.
+ * @param[in]  p_value  Pointer to the value in RAM, the size of the type of the attribute.
+ *
+ * @return     0: GP_NVM_SUCCESS
+ * @return     1: GP_NVM_FAIL (no such slot)
+ * @return     5: GP_NVM_MEM_ERROR
+ */
+gp_nvm_result_t
+gp_nvm_ctx_set_slot(	gp_nvm_ctx_t *ctx,
+						uint32_t slot,
+						const void* p_value);
+
+/**
+ * @brief      Copy the statistics of the value caches of a context, summed over all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_cache_stats(	gp_nvm_ctx_t *ctx,
+							gp_nvm_cache_stats_t *stats);
+
+/**
+ * @brief      Copy the compaction statistics of a context, summed over all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_compact_stats(	gp_nvm_ctx_t *ctx,
+								gp_nvm_compact_stats_t *stats);
+
+/**
+ * @brief      Copy the free-space allocator statistics of the in-place engine of a context.
+ *
+ * The counters are summed over all shards, the largest free extent and the data end are the maximum of all shards.
+ *
+ * @param[in]  ctx    The context.
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+gp_nvm_ctx_get_alloc_stats(	gp_nvm_ctx_t *ctx,
+							gp_nvm_alloc_stats_t *stats);
+
+#ifdef GP_NVM_CONF_SCHEMA
+/**
+ * @brief      Typed get and set of every static attribute: gp_nvm_get_slot_<name>, gp_nvm_set_slot_<name>
+ *             and their gp_nvm_ctx_ versions.
+ * 
+ * The value is passed as a pointer to the type of the schema, so the compiler checks it instead of a length at runtime.
+ */
+#define GP_NVM_SCHEMA_ATTR(name, id, type) \
+	static inline gp_nvm_result_t gp_nvm_get_slot_##name(type* p_value) { return gp_nvm_get_slot(GP_NVM_SLOT_##name, p_value); } \
+	static inline gp_nvm_result_t gp_nvm_set_slot_##name(const type* p_value) { return gp_nvm_set_slot(GP_NVM_SLOT_##name, p_value); } \
+	static inline gp_nvm_result_t gp_nvm_ctx_get_slot_##name(gp_nvm_ctx_t *ctx, type* p_value) { return gp_nvm_ctx_get_slot(ctx, GP_NVM_SLOT_##name, p_value); } \
+	static inline gp_nvm_result_t gp_nvm_ctx_set_slot_##name(gp_nvm_ctx_t *ctx, const type* p_value) { return gp_nvm_ctx_set_slot(ctx, GP_NVM_SLOT_##name, p_value); }
+#include GP_NVM_CONF_SCHEMA
+#undef GP_NVM_SCHEMA_ATTR
+#endif
+
 #endif /* __GP_NVM_H__ */
 
 /** @} */
@@ -0,0 +1,576 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-arch.c
+ * \brief Implementation of the architecture specific NVM device interface.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A device is a backend and the context the backend returned when the device was opened.
+ * Every operation is dispatched to the backend and counted in the statistics of the calling thread.
+ */
+
+// Implements following header(s)
+#include "nvm-arch.h"
+#include "nvm-backend.h"
+
+// Uses following header(s)
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief      NVM device.
+ *
+ */
+struct nvm_arch_dev {
+  const nvm_arch_backend_t *backend;
+  void *ctx;
+};
+
+/**
+ * @brief      Default NVM device declaration.
+ *
+ */
+static nvm_arch_dev_t nvm_dev;
+
+/**
+ * @brief      Statistics of all devices, every thread counts in its own block.
+ *
+ */
+static nvm_arch_stats_t nvm_arch_shared_stats;
+static nvm_stats_t nvm_arch_stats = NVM_STATS_INITIALIZER(&nvm_arch_shared_stats);
+#if NVM_CONF_THREADS
+static __thread nvm_arch_stats_t *nvm_arch_thread_stats;
+#else
+static nvm_arch_stats_t *nvm_arch_thread_stats;
+#endif
+
+/**
+ * @brief      Return the statistics counters of the calling thread.
+ *
+ */
+nvm_arch_stats_t*
+nvm_backend_stats(void)
+{
+  if( nvm_arch_thread_stats == NULL ){
+    nvm_arch_thread_stats = (nvm_arch_stats_t*) nvm_stats_thread_counters(&nvm_arch_stats);
+  }
+  return nvm_arch_thread_stats;
+}
+
+/**
+ * @brief      Start timing an operation.
+ *
+ * @return     The start time, 0 when the statistics are disabled.
+ */
+uint64_t
+nvm_backend_op_begin(void)
+{
+#if NVM_CONF_STATS
+  return nvm_stats_now_ns();
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief      Count an operation that started at start.
+ *
+ * @param[in]  op     The counters of the operation in the counters of the calling thread.
+ * @param[in]  start  The start time returned by nvm_backend_op_begin.
+ * @param[in]  ret    The result of the operation.
+ *
+ * @return     The result of the operation.
+ */
+int
+nvm_backend_op_end(nvm_arch_op_stats_t *op, uint64_t start, int ret)
+{
+#if NVM_CONF_STATS
+  NVM_STATS_ADD(op->count, 1);
+  NVM_STATS_ADD(op->errors, ret != 0);
+  NVM_STATS_ADD(op->time_ns, nvm_stats_now_ns() - start);
+#else
+  (void) op;
+  (void) start;
+#endif
+  return ret;
+}
+
+/**
+ * @brief      Open a device with the backend of the configuration.
+ *
+ * @param[out] dev     The NVM device.
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_arch_open(nvm_arch_dev_t *dev, const nvm_arch_config_t *config)
+{
+  uint64_t start = nvm_backend_op_begin();
+  const nvm_arch_backend_t *backend = &nvm_arch_file_backend;
+  if( config != NULL && config->backend != NULL ){
+    backend = config->backend;
+  }
+  dev->ctx = backend->open(config);
+  dev->backend = backend;
+  return nvm_backend_op_end(&nvm_backend_stats()->open, start, dev->ctx == NULL);
+}
+
+/**
+ * @brief      Close a device, the device can be opened again afterwards.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_arch_close(nvm_arch_dev_t *dev)
+{
+  if( dev->ctx == NULL ){
+    return 0;
+  }
+  uint64_t start = nvm_backend_op_begin();
+  int ret = dev->backend->close(dev->ctx);
+  dev->ctx = NULL;
+  return nvm_backend_op_end(&nvm_backend_stats()->close, start, ret);
+}
+
+/**
+ * @brief      Open the NVM device once so it can serve all subsequent operations.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_init(const nvm_arch_config_t *config)
+{
+  // re-initializing closes the device that is currently open
+  _nvm_arch_close(&nvm_dev);
+  return _nvm_arch_open(&nvm_dev, config);
+}
+
+/**
+ * @brief      Release the NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_deinit(void)
+{
+  return _nvm_arch_close(&nvm_dev);
+}
+
+/**
+ * @brief      Return the default NVM device, opening it with the default configuration when needed.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     nvm_arch_dev_t*: Pointer to the default device.
+ */
+nvm_arch_dev_t*
+nvm_arch_default_dev(void)
+{
+  if( nvm_dev.ctx == NULL && nvm_arch_init(NULL) != 0 ){
+    return NULL;
+  }
+  return &nvm_dev;
+}
+
+/**
+ * @brief      Open an NVM device that is independent of the default device.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     nvm_arch_dev_t*: Pointer to the device, release it with nvm_arch_close.
+ */
+nvm_arch_dev_t*
+nvm_arch_open(const nvm_arch_config_t *config)
+{
+  nvm_arch_dev_t *dev = calloc(1, sizeof(nvm_arch_dev_t));
+  if( dev == NULL ){
+    return NULL;
+  }
+  if( _nvm_arch_open(dev, config) != 0 ){
+    free(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+/**
+ * @brief      Release an NVM device opened with nvm_arch_open.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_close(nvm_arch_dev_t *dev)
+{
+  if( dev == NULL ){
+    return 0;
+  }
+  int ret = _nvm_arch_close(dev);
+  free(dev);
+  return ret;
+}
+
+/**
+ * @brief      Copy the write verification counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_verify_stats(nvm_arch_verify_stats_t *stats)
+{
+  nvm_arch_dev_get_verify_stats(&nvm_dev, stats);
+}
+
+/**
+ * @brief      Copy the write verification counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_verify_stats(const nvm_arch_dev_t *dev, nvm_arch_verify_stats_t *stats)
+{
+  memset(stats, 0, sizeof(nvm_arch_verify_stats_t));
+  if( dev->ctx != NULL && dev->backend->get_verify_stats != NULL ){
+    dev->backend->get_verify_stats(dev->ctx, stats);
+  }
+}
+
+/**
+ * @brief      Copy the I/O counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_io_stats(nvm_arch_io_stats_t *stats)
+{
+  nvm_arch_dev_get_io_stats(&nvm_dev, stats);
+}
+
+/**
+ * @brief      Copy the I/O counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_io_stats(const nvm_arch_dev_t *dev, nvm_arch_io_stats_t *stats)
+{
+  memset(stats, 0, sizeof(nvm_arch_io_stats_t));
+  if( dev->ctx != NULL && dev->backend->get_io_stats != NULL ){
+    dev->backend->get_io_stats(dev->ctx, stats);
+  }
+}
+
+/**
+ * @brief      Copy the flash emulation counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_flash_stats(nvm_arch_flash_stats_t *stats)
+{
+  nvm_arch_dev_get_flash_stats(&nvm_dev, stats);
+}
+
+/**
+ * @brief      Copy the flash emulation counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_flash_stats(const nvm_arch_dev_t *dev, nvm_arch_flash_stats_t *stats)
+{
+  memset(stats, 0, sizeof(nvm_arch_flash_stats_t));
+  if( dev->ctx != NULL && dev->backend->get_flash_stats != NULL ){
+    dev->backend->get_flash_stats(dev->ctx, stats);
+  }
+}
+
+/**
+ * @brief      Copy the erase count of every block of an NVM device that emulates flash.
+ *
+ * @param[in]  dev         The NVM device.
+ * @param[out] counts      Array were the erase counts can be stored.
+ * @param[in]  max_counts  The length of the array.
+ *
+ * @return     The number of blocks, this may be more than max_counts.
+ */
+uint32_t
+nvm_arch_dev_get_erase_counts(const nvm_arch_dev_t *dev, uint32_t *counts, uint32_t max_counts)
+{
+  if( dev->ctx == NULL || dev->backend->get_erase_counts == NULL ){
+    return 0;
+  }
+  return dev->backend->get_erase_counts(dev->ctx, counts, max_counts);
+}
+
+/**
+ * @brief      Copy the statistics of all NVM devices.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+nvm_arch_get_stats(nvm_arch_stats_t *stats)
+{
+  nvm_stats_sum(&nvm_arch_stats, (uint64_t*) stats);
+}
+
+/**
+ * @brief      Copy len bytes into pointer from an NVM device starting at offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_read(nvm_arch_dev_t *dev,
+                  long int offset,
+                  size_t len,
+                  void *ptr)
+{
+  uint64_t start = nvm_backend_op_begin();
+  nvm_arch_stats_t *stats = nvm_backend_stats();
+  if( dev == NULL || dev->ctx == NULL ){
+    return nvm_backend_op_end(&stats->read, start, 1);
+  }
+  int ret = dev->backend->read(dev->ctx, offset, len, ptr);
+  if( ret == 0 ){
+    NVM_STATS_ADD(stats->bytes_read, len);
+  }
+  return nvm_backend_op_end(&stats->read, start, ret);
+}
+
+/**
+ * @brief      Update an NVM device by copying len bytes read from pointer starting at offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_update(nvm_arch_dev_t *dev,
+                    long int offset,
+                    size_t len,
+                    const void *ptr)
+{
+  uint64_t start = nvm_backend_op_begin();
+  nvm_arch_stats_t *stats = nvm_backend_stats();
+  if( dev == NULL || dev->ctx == NULL ){
+    return nvm_backend_op_end(&stats->update, start, 1);
+  }
+  int ret = dev->backend->update(dev->ctx, offset, len, ptr);
+  if( ret == 0 ){
+    NVM_STATS_ADD(stats->bytes_written, len);
+  }
+  return nvm_backend_op_end(&stats->update, start, ret);
+}
+
+/**
+ * @brief      Update an NVM device by copying iovcnt buffers back to back starting at offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_updatev(nvm_arch_dev_t *dev,
+                     long int offset,
+                     const nvm_arch_iovec_t *iov,
+                     uint32_t iovcnt)
+{
+  uint64_t start = nvm_backend_op_begin();
+  nvm_arch_stats_t *stats = nvm_backend_stats();
+  int ret = 0;
+  if( dev == NULL || dev->ctx == NULL ){
+    return nvm_backend_op_end(&stats->update, start, 1);
+  }
+
+  if( dev->backend->updatev != NULL ){
+    ret = dev->backend->updatev(dev->ctx, offset, iov, iovcnt);
+  } else {
+    // without vectored updates the buffers are written one by one
+    long int pos = offset;
+    for( uint32_t i = 0; i<iovcnt && ret == 0; i++ ){
+      ret = dev->backend->update(dev->ctx, pos, iov[i].len, iov[i].base);
+      pos += iov[i].len;
+    }
+  }
+  for( uint32_t i = 0; i<iovcnt && ret == 0; i++ ){
+    NVM_STATS_ADD(stats->bytes_written, iov[i].len);
+  }
+  return nvm_backend_op_end(&stats->update, start, ret);
+}
+
+/**
+ * @brief      Append to an NVM device by copying len bytes read from pointer starting at offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the append operation should start.
+ * @param[in]  len     The length of the append operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_append(nvm_arch_dev_t *dev,
+                    long int offset,
+                    size_t len,
+                    const void *ptr)
+{
+  uint64_t start = nvm_backend_op_begin();
+  nvm_arch_stats_t *stats = nvm_backend_stats();
+  if( dev == NULL || dev->ctx == NULL ){
+    return nvm_backend_op_end(&stats->append, start, 1);
+  }
+  int ret = dev->backend->append(dev->ctx, offset, len, ptr);
+  if( ret == 0 ){
+    NVM_STATS_ADD(stats->bytes_written, len);
+  }
+  return nvm_backend_op_end(&stats->append, start, ret);
+}
+
+/**
+ * @brief      Return a read-only pointer to len bytes of an NVM device starting at offset, without copying them.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the view should start.
+ * @param[in]  len     The length of the view (number of bytes).
+ *
+ * @return     NULL: The backend has no view or the range is beyond the end of the NVM.
+ * @return     const void*: Pointer to the bytes.
+ */
+const void*
+nvm_arch_dev_view(nvm_arch_dev_t *dev,
+                  long int offset,
+                  size_t len)
+{
+  if( dev == NULL || dev->ctx == NULL || dev->backend->view == NULL || offset < 0 ){
+    return NULL;
+  }
+  return dev->backend->view(dev->ctx, offset, len);
+}
+
+/**
+ * @brief      Get the number of bytes in an NVM device, reads up to that size don't fail because of the size.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     The size in bytes, SIZE_MAX when the backend can't tell.
+ */
+size_t
+nvm_arch_dev_size(const nvm_arch_dev_t *dev)
+{
+  if( dev == NULL || dev->ctx == NULL ){
+    return 0;
+  }
+  if( dev->backend->size == NULL ){
+    return SIZE_MAX;
+  }
+  return dev->backend->size(dev->ctx);
+}
+
+/**
+ * @brief      Make the writes to an NVM device durable according to its durability level.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_sync(nvm_arch_dev_t *dev)
+{
+  if( dev == NULL || dev->ctx == NULL ){
+    return 1;
+  }
+  if( dev->backend->sync == NULL ){
+    return 0;
+  }
+  uint64_t start = nvm_backend_op_begin();
+  return nvm_backend_op_end(&nvm_backend_stats()->sync, start, dev->backend->sync(dev->ctx));
+}
+
+/**
+ * @brief      Copy len bytes into pointer from NVM starting at offset.
+ *
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_read(long int offset,
+              size_t len,
+              void *ptr)
+{
+  return nvm_arch_dev_read(nvm_arch_default_dev(), offset, len, ptr);
+}
+
+/**
+ * @brief      Update NVM by copying len bytes read from pointer to NVM starting at offset.
+ *
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_update(long int offset,
+                size_t len,
+                const void *ptr)
+{
+  return nvm_arch_dev_update(nvm_arch_default_dev(), offset, len, ptr);
+}
+
+/**
+ * @brief      Append to NVM by copying len bytes read from pointer to NVM starting at offset.
+ *
+ * @param[in]  offset  The offset in the NVM were the append operation should start.
+ * @param[in]  len     The length of the append operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_append(long int offset,
+                size_t len,
+                const void *ptr)
+{
+  return nvm_arch_dev_append(nvm_arch_default_dev(), offset, len, ptr);
+}
+
+/** @} */
@@ -8,6 +8,9 @@
  * @{
  *
  * The architecture specific NVM device interface implements the platform specific NVM device.
+ * Every device is served by a backend, a table of functions that is selected at runtime with the configuration
+ * of the device. The file backend keeps the NVM in a file, the RAM backend keeps it in memory without any
+ * system call and can snapshot it to a file.
  *
  */
 
@@ -23,6 +26,497 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * @brief      Default path of the file that backs the NVM device.
+ * 
+ */
+#ifndef NVM_ARCH_DEFAULT_PATH
+#define NVM_ARCH_DEFAULT_PATH "nvm.bin"
+#endif
+
+/**
+ * @brief      Default number of pending writes that ends the wait of a group commit.
+ * 
+ */
+#ifndef NVM_ARCH_DEFAULT_SYNC_BATCH
+#define NVM_ARCH_DEFAULT_SYNC_BATCH 32
+#endif
+
+/**
+ * @brief      Default maximum wait of a group commit in milliseconds.
+ * 
+ */
+#ifndef NVM_ARCH_DEFAULT_SYNC_INTERVAL_MS
+#define NVM_ARCH_DEFAULT_SYNC_INTERVAL_MS 2
+#endif
+
+/**
+ * @brief      Enumeration of the I/O modes used to access the NVM device.
+ * 
+ */
+typedef enum nvm_arch_io_mode {
+	NVM_ARCH_IO_FD,		/**< Persistent file descriptor, accessed with pread/pwrite. */
+	NVM_ARCH_IO_MMAP,	/**< Shared memory-mapped view that grows with the device. */
+} nvm_arch_io_mode_t;
+
+/**
+ * @brief      Enumeration of the policies used to verify data after it was written.
+ * 
+ */
+typedef enum nvm_arch_verify_mode {
+	NVM_ARCH_VERIFY_BULK,		/**< Read back every write and compare it with memcmp. */
+	NVM_ARCH_VERIFY_OFF,		/**< Don't verify writes. */
+	NVM_ARCH_VERIFY_SAMPLED,	/**< Bulk verify one out of every verify_interval writes. */
+} nvm_arch_verify_mode_t;
+
+/**
+ * @brief      Enumeration of the flash memories the NVM device can emulate.
+ * 
+ */
+typedef enum nvm_arch_flash_type {
+	NVM_ARCH_FLASH_NONE,	/**< Byte-addressable NVM, any byte can be overwritten in place. */
+	NVM_ARCH_FLASH_NOR,		/**< NOR flash, bits can be programmed from 1 to 0 at any time. */
+	NVM_ARCH_FLASH_NAND,	/**< NAND flash, a page can only be programmed once after its block was erased. */
+} nvm_arch_flash_type_t;
+
+/**
+ * @brief      Enumeration of the durability levels of the NVM device.
+ * 
+ * Writes are made durable when the user of the device calls nvm_arch_dev_sync, typically once per
+ * operation of the library. Without a sync the data is only in the page cache and may be lost on power failure.
+ */
+typedef enum nvm_arch_durability {
+	NVM_ARCH_DURABILITY_NONE,		/**< Don't sync, data reaches the NVM when the platform writes it back. */
+	NVM_ARCH_DURABILITY_FSYNC,		/**< Every sync flushes the data and the metadata of the file with fsync. */
+	NVM_ARCH_DURABILITY_GROUP,		/**< Group commit: one fdatasync covers the writes of all threads that sync meanwhile. */
+	NVM_ARCH_DURABILITY_FDATASYNC,	/**< Every sync flushes the data and the size of the file with fdatasync. */
+} nvm_arch_durability_t;
+
+/**
+ * @brief      Configuration of the flash emulation.
+ * 
+ * The block size has to be a multiple of the page size, 0 selects the defaults.
+ * Erased bytes read as 0xff, also the bytes the file doesn't contain yet. A write that can't be programmed
+ * on the erased or programmed state of the flash erases the blocks it touches and programs them again with
+ * their old contents and the new data. The erase and program times are simulated by sleeping.
+ */
+typedef struct nvm_arch_flash_config {
+	nvm_arch_flash_type_t type;
+	uint32_t page_size;
+	uint32_t block_size;
+	uint32_t erase_time_us;
+	uint32_t program_time_us;
+} nvm_arch_flash_config_t;
+
+/**
+ * @brief      Configuration of the NVM device.
+ * 
+ * A NULL backend selects the file backend. A NULL path selects NVM_ARCH_DEFAULT_PATH.
+ * The I/O mode, verification and flash emulation are options of the file backend, a zeroed configuration
+ * uses a persistent file descriptor, bulk verifies every write and doesn't emulate flash.
+ * The durability level is also an option of the file backend, 0 doesn't sync. With group commit a sync waits
+ * until sync_batch writes are pending or sync_interval_ms passed, whichever comes first, and then one fdatasync
+ * releases all waiting threads together. 0 selects NVM_ARCH_DEFAULT_SYNC_BATCH and NVM_ARCH_DEFAULT_SYNC_INTERVAL_MS.
+ * The RAM backend only uses the path when snapshot is set: the device is loaded from the file when it is
+ * opened, if the file exists, and saved to it when it is closed.
+ */
+typedef struct nvm_arch_config {
+	const char *path;
+	nvm_arch_io_mode_t io_mode;
+	nvm_arch_verify_mode_t verify_mode;
+	uint32_t verify_interval;
+	nvm_arch_flash_config_t flash;
+	const struct nvm_arch_backend *backend;
+	int snapshot;
+	nvm_arch_durability_t durability;
+	uint32_t sync_interval_ms;
+	uint32_t sync_batch;
+} nvm_arch_config_t;
+
+/**
+ * @brief      Write verification counters.
+ * 
+ */
+typedef struct nvm_arch_verify_stats {
+	uint64_t writes;
+	uint64_t verified;
+	uint64_t skipped;
+	uint64_t failures;
+	uint64_t bytes_verified;
+} nvm_arch_verify_stats_t;
+
+/**
+ * @brief      I/O counters of an NVM device.
+ * 
+ * The system calls are the ones that access the file (pread, pwrite, pwritev, ftruncate, mmap, msync, fsync
+ * and fdatasync), the bytes include the reads and writes of a mapped view and the reads of the write verification.
+ * The syncs are the fsync and fdatasync calls, the synced writes are the writes they made durable.
+ */
+typedef struct nvm_arch_io_stats {
+	uint64_t syscalls;
+	uint64_t syncs;
+	uint64_t synced_writes;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+} nvm_arch_io_stats_t;
+
+/**
+ * @brief      Flash emulation counters.
+ * 
+ * The requested bytes are written by the user of the device, the programmed bytes are the bytes of all
+ * programmed pages (NAND) or of all programmed bytes (NOR) including the old contents of erased blocks.
+ * Rewrites are writes that needed an erase. The busy time is the simulated time of all erases and programs.
+ * The erase counts are kept in RAM, they count the erases since the device was opened up to the last block
+ * that was written.
+ */
+typedef struct nvm_arch_flash_stats {
+	uint64_t bytes_requested;
+	uint64_t bytes_programmed;
+	uint64_t page_programs;
+	uint64_t erases;
+	uint64_t rewrites;
+	uint64_t busy_us;
+	uint32_t num_blocks;
+	uint32_t min_erase_count;
+	uint32_t max_erase_count;
+	double write_amplification;
+} nvm_arch_flash_stats_t;
+
+/**
+ * @brief      Counters of one kind of operation.
+ * 
+ * The time is the sum of the wall-clock time of all operations in nanoseconds.
+ */
+typedef struct nvm_arch_op_stats {
+	uint64_t count;
+	uint64_t errors;
+	uint64_t time_ns;
+} nvm_arch_op_stats_t;
+
+/**
+ * @brief      Statistics of all NVM devices.
+ * 
+ * Updates include vectored updates. Extends are the operations that grow the file and its mapped view.
+ * Syncs include the time a sync waited for a group commit.
+ * The bytes only count the data of reads, updates and appends, not the reads of the write verification.
+ */
+typedef struct nvm_arch_stats {
+	nvm_arch_op_stats_t read;
+	nvm_arch_op_stats_t update;
+	nvm_arch_op_stats_t append;
+	nvm_arch_op_stats_t open;
+	nvm_arch_op_stats_t close;
+	nvm_arch_op_stats_t extend;
+	nvm_arch_op_stats_t sync;
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	uint64_t verify_failures;
+} nvm_arch_stats_t;
+
+/**
+ * @brief      NVM device.
+ * 
+ * The nvm_arch_read, nvm_arch_update and nvm_arch_append functions use the default device,
+ * other devices are opened with nvm_arch_open and used with the nvm_arch_dev_* functions.
+ */
+typedef struct nvm_arch_dev nvm_arch_dev_t;
+
+/**
+ * @brief      Buffer of a vectored update.
+ * 
+ */
+typedef struct nvm_arch_iovec {
+	const void *base;
+	size_t len;
+} nvm_arch_iovec_t;
+
+/**
+ * @brief      Backend of NVM devices.
+ * 
+ * Open returns the context of a new device, which is passed to all other functions and released by close.
+ * The functions return 0 on success and 1 on error. Reads may run concurrently with one writer, the
+ * device interface counts the operations and their bytes in nvm_arch_stats_t.
+ * updatev may be NULL, the buffers are then written with update one by one. sync may be NULL when the
+ * backend has nothing to make durable, it may be called by several threads at once. The statistics functions
+ * may be NULL when the backend has no such counters.
+ * view may be NULL when the backend doesn't keep the NVM in memory, see nvm_arch_dev_view.
+ * size returns the number of bytes in the NVM, it may be NULL when the backend can't tell.
+ */
+typedef struct nvm_arch_backend {
+	const char *name;
+	void* (*open)(const nvm_arch_config_t *config);
+	int (*close)(void *ctx);
+	int (*read)(void *ctx, long int offset, size_t len, void *ptr);
+	int (*update)(void *ctx, long int offset, size_t len, const void *ptr);
+	int (*updatev)(void *ctx, long int offset, const nvm_arch_iovec_t *iov, uint32_t iovcnt);
+	int (*append)(void *ctx, long int offset, size_t len, const void *ptr);
+	const void* (*view)(void *ctx, long int offset, size_t len);
+	size_t (*size)(const void *ctx);
+	int (*sync)(void *ctx);
+	void (*get_verify_stats)(const void *ctx, nvm_arch_verify_stats_t *stats);
+	void (*get_io_stats)(const void *ctx, nvm_arch_io_stats_t *stats);
+	void (*get_flash_stats)(const void *ctx, nvm_arch_flash_stats_t *stats);
+	uint32_t (*get_erase_counts)(const void *ctx, uint32_t *counts, uint32_t max_counts);
+} nvm_arch_backend_t;
+
+/**
+ * @brief      Backend that keeps the NVM in a file, see nvm-file.c.
+ * 
+ */
+extern const nvm_arch_backend_t nvm_arch_file_backend;
+
+/**
+ * @brief      Backend that keeps the NVM in RAM, see nvm-ram.c.
+ * 
+ */
+extern const nvm_arch_backend_t nvm_arch_ram_backend;
+
+/**
+ * @brief      Open the NVM device once so it can serve all subsequent operations.
+ * 
+ * Calling this function is optional, the first read, update or append operation
+ * opens the device with the default configuration when it was not opened before.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_init(const nvm_arch_config_t *config);
+
+/**
+ * @brief      Release the NVM device, flushing a mapped view if needed.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_deinit(void);
+
+/**
+ * @brief      Copy the write verification counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_verify_stats(nvm_arch_verify_stats_t *stats);
+
+/**
+ * @brief      Copy the I/O counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_io_stats(nvm_arch_io_stats_t *stats);
+
+/**
+ * @brief      Copy the flash emulation counters of the NVM device.
+ *
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_get_flash_stats(nvm_arch_flash_stats_t *stats);
+
+/**
+ * @brief      Copy the statistics of all NVM devices.
+ *
+ * Every thread counts in its own counters, they are summed here. The counters are never reset.
+ *
+ * @param[out] stats  Pointer were the statistics can be stored.
+ */
+void
+nvm_arch_get_stats(nvm_arch_stats_t *stats);
+
+/**
+ * @brief      Return the default NVM device, opening it with the default configuration when needed.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     nvm_arch_dev_t*: Pointer to the default device.
+ */
+nvm_arch_dev_t*
+nvm_arch_default_dev(void);
+
+/**
+ * @brief      Open an NVM device that is independent of the default device.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     nvm_arch_dev_t*: Pointer to the device, release it with nvm_arch_close.
+ */
+nvm_arch_dev_t*
+nvm_arch_open(const nvm_arch_config_t *config);
+
+/**
+ * @brief      Release an NVM device opened with nvm_arch_open.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_close(nvm_arch_dev_t *dev);
+
+/**
+ * @brief      Copy the write verification counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_verify_stats(	const nvm_arch_dev_t *dev,
+								nvm_arch_verify_stats_t *stats);
+
+/**
+ * @brief      Copy the I/O counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_io_stats(	const nvm_arch_dev_t *dev,
+							nvm_arch_io_stats_t *stats);
+
+/**
+ * @brief      Copy the flash emulation counters of an NVM device.
+ *
+ * @param[in]  dev    The NVM device.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_arch_dev_get_flash_stats(	const nvm_arch_dev_t *dev,
+								nvm_arch_flash_stats_t *stats);
+
+/**
+ * @brief      Copy the erase count of every block of an NVM device that emulates flash.
+ *
+ * @param[in]  dev         The NVM device.
+ * @param[out] counts      Array were the erase counts can be stored.
+ * @param[in]  max_counts  The length of the array.
+ *
+ * @return     The number of blocks, this may be more than max_counts.
+ */
+uint32_t
+nvm_arch_dev_get_erase_counts(	const nvm_arch_dev_t *dev,
+								uint32_t *counts,
+								uint32_t max_counts);
+
+/**
+ * @brief      Copy len bytes into pointer from an NVM device starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_read(	nvm_arch_dev_t *dev,
+					long int offset,
+					size_t len,
+					void *ptr);
+
+/**
+ * @brief      Update an NVM device by copying len bytes read from pointer starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_update(nvm_arch_dev_t *dev,
+					long int offset,
+					size_t len,
+					const void *ptr);
+
+/**
+ * @brief      Update an NVM device by copying iovcnt buffers back to back starting from offset.
+ * 
+ * The buffers are written with one vectored write where the platform supports it.
+ * Every buffer is verified as a separate write.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_updatev(	nvm_arch_dev_t *dev,
+						long int offset,
+						const nvm_arch_iovec_t *iov,
+						uint32_t iovcnt);
+
+/**
+ * @brief      Append to an NVM device by copying len bytes read from pointer starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the append operation should start.
+ * @param[in]  len     The length of the append operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_append(nvm_arch_dev_t *dev,
+					long int offset,
+					size_t len,
+					const void *ptr);
+
+/**
+ * @brief      Return a read-only pointer to len bytes of an NVM device starting at offset, without copying them.
+ *
+ * Only backends that keep the NVM in memory support this: the file backend in the NVM_ARCH_IO_MMAP mode
+ * and the RAM backend. The pointer stays valid until the device is closed, also when the device grows,
+ * but the bytes change with every update of the range.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the view should start.
+ * @param[in]  len     The length of the view (number of bytes).
+ *
+ * @return     NULL: The backend has no view or the range is beyond the end of the NVM.
+ * @return     const void*: Pointer to the bytes.
+ */
+const void*
+nvm_arch_dev_view(	nvm_arch_dev_t *dev,
+					long int offset,
+					size_t len);
+
+/**
+ * @brief      Get the number of bytes in an NVM device, reads up to that size don't fail because of the size.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     The size in bytes, SIZE_MAX when the backend can't tell.
+ */
+size_t
+nvm_arch_dev_size(const nvm_arch_dev_t *dev);
+
+/**
+ * @brief      Make the writes to an NVM device durable according to its durability level.
+ *
+ * This may be called without holding the lock of the writer, so with group commit the syncs of several
+ * threads are served by one flush. It returns when all writes that completed before the call are durable.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_arch_dev_sync(nvm_arch_dev_t *dev);
+
 /**
  * @brief      Copy len bytes into pointer from NVM starting from offset.
  *
@@ -0,0 +1,51 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-backend.h
+ * \brief Header file for the helpers the device interface offers to the NVM backends.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The device interface counts every operation of a backend in nvm_arch_stats_t. Backends add the
+ * counters that only they can see, like verify failures and extends, with these helpers.
+ */
+
+#ifndef __NVM_BACKEND_H__
+#define __NVM_BACKEND_H__
+
+#include "nvm-arch.h"
+#include "nvm-stats.h"
+
+/**
+ * @brief      Return the statistics counters of the calling thread.
+ *
+ */
+nvm_arch_stats_t*
+nvm_backend_stats(void);
+
+/**
+ * @brief      Start timing an operation.
+ *
+ * @return     The start time, 0 when the statistics are disabled.
+ */
+uint64_t
+nvm_backend_op_begin(void);
+
+/**
+ * @brief      Count an operation that started at start.
+ *
+ * @param[in]  op     The counters of the operation in the counters of the calling thread.
+ * @param[in]  start  The start time returned by nvm_backend_op_begin.
+ * @param[in]  ret    The result of the operation.
+ *
+ * @return     The result of the operation.
+ */
+int
+nvm_backend_op_end(	nvm_arch_op_stats_t *op,
+					uint64_t start,
+					int ret);
+
+#endif /*__NVM_BACKEND_H__ */
+/** @} */
@@ -4,60 +4,182 @@
  */
 
 /**
- * \file  nvm-arch.c
- * \brief Implementation of the architecture specific NVM device interface.
+ * \file  nvm-file.c
+ * \brief Implementation of the file backend of the architecture specific NVM device interface.
  * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The NVM file is opened once and kept open until the device is closed.
+ * Depending on the configured I/O mode, operations are served with pread/pwrite
+ * on the persistent file descriptor or with memcpy on a shared mapping of the file.
+ * Writes are made durable by the sync function according to the durability level of the device: with
+ * fsync or fdatasync, or msync for a mapped view. Concurrent syncs are served by one flush, which is
+ * done by the first thread that syncs (the leader) while the others wait for it. With group commit the
+ * leader first waits for the writes of other threads, so their syncs share its flush.
  */
 
 // Implements following header(s)
 #include "nvm-arch.h"
 
 // Uses following header(s)
+#include "nvm-backend.h"
+#include "nvm-verify.h"
+#include "nvm-flash.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+
+/**
+ * @brief      Minimum length of the mapped view, the view grows in powers of two.
+ *
+ */
+#define NVM_FILE_MIN_MAP_SIZE 4096
 
 /**
- * @brief      This operation checks if the value that was written is correct after the write operation.
+ * @brief      Maximum number of views that are kept after the view grew.
  *
- * @param[in]  offset  The offset in the NVM were the attribute was written.
- * @param[in]  len     The length of the attribute (number of bytes).
- * @param[in]  ptr_in  The pointer were the value was copied from.
- * @param[in]  nvm     Pointer to the nvm FILE
+ */
+#define NVM_FILE_MAX_RETIRED_MAPS 48
+
+/**
+ * @brief      Maximum number of buffers per vectored write, well below IOV_MAX of any platform.
+ *
+ */
+#define NVM_FILE_MAX_IOV 64
+
+/**
+ * @brief      NVM file device.
+ *
+ * This structure keeps the open file descriptor, the size of the file, the mapped view (if any) and
+ * the state of the flash emulation.
+ * Reads may run concurrently with a write that grows the file, so the size is published after the view
+ * and replaced views are only unmapped when the device is released.
+ * Written counts the completed writes, synced the writes that were made durable. Both only grow, a sync
+ * returns once synced reaches the value written had when the sync started.
+ */
+typedef struct nvm_file_dev {
+  int fd;
+  nvm_arch_io_mode_t io_mode;
+  size_t size;
+  uint8_t *map;
+  size_t map_size;
+  nvm_verify_t verify;
+  nvm_flash_t flash;
+  nvm_arch_io_stats_t io;
+  struct {
+    uint8_t *map;
+    size_t map_size;
+  } retired[NVM_FILE_MAX_RETIRED_MAPS];
+  uint32_t num_retired;
+  nvm_arch_durability_t durability;
+  uint32_t sync_interval_ms;
+  uint32_t sync_batch;
+  uint64_t written;
+  uint64_t synced;
+#if NVM_CONF_THREADS
+  pthread_mutex_t sync_lock;
+  pthread_cond_t sync_gather;
+  pthread_cond_t sync_done;
+  int syncing;
+#else
+  uint64_t last_sync_ns;
+#endif
+} nvm_file_dev_t;
+
+/**
+ * @brief      Add to an I/O counter, reads of several threads may count concurrently.
+ *
+ */
+#define NVM_FILE_COUNT(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+
+/**
+ * @brief      Make sure the mapped view covers at least size bytes.
+ *
+ * @param[in]  dev   The NVM file device.
+ * @param[in]  size  The minimum length of the mapped view.
  *
  * @return     0: SUCCESS
  * @return     1: ERROR
  */
-int
-_nvm_arch_check_write_operation(long int offset,
-                                size_t len,
-                                const void* ptr_in,
-                                FILE *nvm)
+static int
+_nvm_file_map(nvm_file_dev_t *dev, size_t size)
 {
-  // skip offset from beginning and check if offset is correct
-  int ret = fseek(nvm, offset, SEEK_SET);
-  if( ret ){
-    fprintf(stderr, "Illegal offset, err %d\n", ret);
+  if( dev->map != NULL && size <= dev->map_size ){
+    return 0;
+  }
+
+  // grow the view geometrically so appends don't remap every time
+  size_t map_size = NVM_FILE_MIN_MAP_SIZE;
+  while( map_size < size ){
+    map_size <<= 1;
+  }
+
+  // the view may extend beyond the end of the file, only [0, size) is ever accessed
+  void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, dev->fd, 0);
+  NVM_FILE_COUNT(dev->io.syscalls, 1);
+  if( map == MAP_FAILED ){
+    fprintf(stderr, "Can't map NVM file, err %d\n", errno);
     return 1;
   }
-  int i = 0;
-  while( i<len ){
-    uint8_t data = 0;
-    size_t nmemb = fread(&data, 1, 1, nvm);
-    if( nmemb != 1 ){
-      fprintf(stderr, "iter %d Num memb don't match can't read: %lu\n",i , nmemb);
-      return 1;
+
+  // a concurrent read may still copy from the old view, it is unmapped when the device is released
+  if( dev->map != NULL ){
+    if( dev->num_retired < NVM_FILE_MAX_RETIRED_MAPS ){
+      dev->retired[dev->num_retired].map = dev->map;
+      dev->retired[dev->num_retired].map_size = dev->map_size;
+      dev->num_retired++;
+    } else {
+      munmap(dev->map, dev->map_size);
     }
-    if( data != ((uint8_t*) ptr_in)[i] ){
-      fprintf(stderr, "data doesnt match: %u != %u\n", data, ((uint8_t*) ptr_in)[i]);
-      return 1;
+  }
+  __atomic_store_n(&dev->map, (uint8_t*) map, __ATOMIC_RELEASE);
+  dev->map_size = map_size;
+  return 0;
+}
+
+/**
+ * @brief      Grow the NVM file so it contains at least end bytes.
+ *
+ * @param[in]  dev   The NVM file device.
+ * @param[in]  end   The offset of the last byte that is written plus one.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_extend(nvm_file_dev_t *dev, size_t end)
+{
+  if( end <= dev->size ){
+    return 0;
+  }
+  if( dev->io_mode == NVM_ARCH_IO_MMAP ){
+    uint64_t start = nvm_backend_op_begin();
+    // pages of the view beyond the end of the file can't be written
+    NVM_FILE_COUNT(dev->io.syscalls, 1);
+    if( ftruncate(dev->fd, end) != 0 ){
+      fprintf(stderr, "Can't grow NVM file, err %d\n", errno);
+      return nvm_backend_op_end(&nvm_backend_stats()->extend, start, 1);
     }
-    i++;
+    if( _nvm_file_map(dev, end) != 0 ){
+      return nvm_backend_op_end(&nvm_backend_stats()->extend, start, 1);
+    }
+    nvm_backend_op_end(&nvm_backend_stats()->extend, start, 0);
   }
+  // readers that see the new size also see the view that covers it
+  __atomic_store_n(&dev->size, end, __ATOMIC_RELEASE);
   return 0;
 }
 
 /**
- * @brief      Copy len bytes into pointer from NVM starting at offset.
+ * @brief      Copy len bytes from the NVM file starting at offset.
  *
+ * @param[in]  dev     The NVM file device.
  * @param[in]  offset  The offset in the NVM were the read operation should start.
  * @param[in]  len     The length of the read operation (number of bytes).
  * @param[out] ptr     The pointer to which len bytes should be copied.
@@ -65,94 +187,528 @@ _nvm_arch_check_write_operation(long int offset,
  * @return     0: SUCCESS
  * @return     1: ERROR
  */
-int
-nvm_arch_read(long int offset,
-              size_t len,
-              void *ptr)
-{
-  // open file in binary read mode.
-  FILE *nvm = fopen("nvm.bin", "rb");
-  
-  // check if file exists
-  if( nvm == NULL ){
-    fprintf(stderr, "Can't open NVM file\n");
+static int
+_nvm_file_read(nvm_file_dev_t *dev,
+               long int offset,
+               size_t len,
+               void *ptr)
+{
+  // check if offset is correct and the record is inside the file
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
     return 1;
   }
-
-  // skip offset from beginning and check if offset is correct
-  int ret = fseek(nvm, offset, SEEK_SET);
-  if( ret ){
-    fprintf(stderr, "Illegal offset, err %d\n", ret);
-    fclose(nvm);
+  if( (size_t) offset + len > __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE) ){
+    fprintf(stderr, "Can't read %lu bytes at offset %ld beyond end of NVM\n", len, offset);
     return 1;
   }
-  
-  // now we can read the record from the file
-  size_t nmemb = fread(ptr, len, 1, nvm);
-  if( nmemb != 1 ){
-    fprintf(stderr, "Num memb don't match can't read: %lu\n", nmemb);
-    fclose(nvm);
-    return 1;
+  NVM_FILE_COUNT(dev->io.bytes_read, len);
+
+  if( dev->io_mode == NVM_ARCH_IO_MMAP ){
+    memcpy(ptr, __atomic_load_n(&dev->map, __ATOMIC_ACQUIRE) + offset, len);
+    return 0;
   }
 
-  fclose(nvm);
+  size_t done = 0;
+  while( done < len ){
+    ssize_t n = pread(dev->fd, (uint8_t*) ptr + done, len - done, offset + done);
+    NVM_FILE_COUNT(dev->io.syscalls, 1);
+    if( n < 0 && errno == EINTR ){
+      continue;
+    }
+    if( n <= 0 ){
+      fprintf(stderr, "Can't read NVM at offset %ld, err %d\n", offset, errno);
+      return 1;
+    }
+    done += n;
+  }
   return 0;
 }
 
 /**
- * @brief      Update NVM by copying len bytes read from pointer to NVM starting at offset.
+ * @brief      Copy len bytes to the NVM file starting at offset, growing the file when needed.
  *
- * @param[in]  offset  The offset in the NVM were the update operation should start.
- * @param[in]  len     The length of the update operation (number of bytes).
- * @param[out] ptr     The pointer from which len bytes should be copied.
+ * @param[in]  dev     The NVM file device.
+ * @param[in]  offset  The offset in the NVM were the write operation should start.
+ * @param[in]  len     The length of the write operation (number of bytes).
+ * @param[in]  ptr     The pointer from which len bytes should be copied.
  *
  * @return     0: SUCCESS
  * @return     1: ERROR
  */
-int
-nvm_arch_update(long int offset,
+static int
+_nvm_file_write(nvm_file_dev_t *dev,
+                long int offset,
                 size_t len,
                 const void *ptr)
 {
-  // open file in binary read/write mode for updating.
-  FILE *nvm = fopen("nvm.bin", "r+b");
-  
-  // check if file exists
-  if( nvm == NULL ){
-    fprintf(stderr, "Can't open NVM file\n");
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
+    return 1;
+  }
+  NVM_FILE_COUNT(dev->io.bytes_written, len);
+
+  if( dev->io_mode == NVM_ARCH_IO_MMAP ){
+    if( _nvm_file_extend(dev, offset + len) != 0 ){
+      return 1;
+    }
+    memcpy(dev->map + offset, ptr, len);
+    return 0;
+  }
+
+  size_t done = 0;
+  while( done < len ){
+    ssize_t n = pwrite(dev->fd, (const uint8_t*) ptr + done, len - done, offset + done);
+    NVM_FILE_COUNT(dev->io.syscalls, 1);
+    if( n < 0 && errno == EINTR ){
+      continue;
+    }
+    if( n <= 0 ){
+      fprintf(stderr, "Can't write NVM at offset %ld, err %d\n", offset, errno);
+      return 1;
+    }
+    done += n;
+  }
+  return _nvm_file_extend(dev, offset + len);
+}
+
+/**
+ * @brief      Copy iovcnt buffers back to back to the NVM file starting at offset, growing the file when needed.
+ *
+ * With a file descriptor the buffers are written with pwritev, at most NVM_FILE_MAX_IOV buffers per call.
+ *
+ * @param[in]  dev     The NVM file device.
+ * @param[in]  offset  The offset in the NVM were the write operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_writev(nvm_file_dev_t *dev,
+                 long int offset,
+                 const nvm_arch_iovec_t *iov,
+                 uint32_t iovcnt)
+{
+  struct iovec vec[NVM_FILE_MAX_IOV];
+  size_t len = 0;
+
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
     return 1;
   }
+  for( uint32_t i = 0; i<iovcnt; i++ ){
+    len += iov[i].len;
+  }
+  NVM_FILE_COUNT(dev->io.bytes_written, len);
+
+  if( dev->io_mode == NVM_ARCH_IO_MMAP ){
+    if( _nvm_file_extend(dev, offset + len) != 0 ){
+      return 1;
+    }
+    uint8_t *p = dev->map + offset;
+    for( uint32_t i = 0; i<iovcnt; i++ ){
+      memcpy(p, iov[i].base, iov[i].len);
+      p += iov[i].len;
+    }
+    return 0;
+  }
+
+  // i is the next buffer, skip the bytes of it that were already written by a short write
+  uint32_t i = 0;
+  size_t skip = 0;
+  long int pos = offset;
+  while( i < iovcnt ){
+    if( iov[i].len == skip ){
+      i++;
+      skip = 0;
+      continue;
+    }
+    uint32_t cnt = 0;
+    for( uint32_t j = i; j<iovcnt && cnt < sizeof(vec) / sizeof(vec[0]); j++, cnt++ ){
+      vec[cnt].iov_base = (uint8_t*) iov[j].base + (j == i ? skip : 0);
+      vec[cnt].iov_len = iov[j].len - (j == i ? skip : 0);
+    }
+    ssize_t n = pwritev(dev->fd, vec, cnt, pos);
+    NVM_FILE_COUNT(dev->io.syscalls, 1);
+    if( n < 0 && errno == EINTR ){
+      continue;
+    }
+    if( n <= 0 ){
+      fprintf(stderr, "Can't write NVM at offset %ld, err %d\n", pos, errno);
+      return 1;
+    }
+    pos += n;
+    // advance over the buffers that were written completely
+    n += skip;
+    while( i < iovcnt && (size_t) n >= iov[i].len ){
+      n -= iov[i].len;
+      i++;
+    }
+    skip = n;
+  }
+  return _nvm_file_extend(dev, offset + len);
+}
+
+/**
+ * @brief      Read callback used by the write verification policy and the flash emulation.
+ *
+ */
+static int
+_nvm_file_verify_read(void *dev, long int offset, size_t len, void *ptr)
+{
+  return _nvm_file_read(dev, offset, len, ptr);
+}
+
+/**
+ * @brief      Write callback used by the flash emulation.
+ *
+ */
+static int
+_nvm_file_flash_write(void *dev, long int offset, size_t len, const void *ptr)
+{
+  return _nvm_file_write(dev, offset, len, ptr);
+}
+
+/**
+ * @brief      Write len bytes at offset, through the flash emulation when it is enabled.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_program(nvm_file_dev_t *dev,
+                  long int offset,
+                  size_t len,
+                  const void *ptr)
+{
+  if( NVM_FLASH_ENABLED(&dev->flash) ){
+    return nvm_flash_write(&dev->flash, _nvm_file_verify_read, _nvm_file_flash_write, dev, dev->size, offset, len, ptr);
+  }
+  return _nvm_file_write(dev, offset, len, ptr);
+}
 
-  // skip offset from beginning and check if offset is correct
-  int ret = fseek(nvm, offset, SEEK_SET);
-  if( ret ){
-    fprintf(stderr, "Illegal offset, err %d\n", ret);
-    fclose(nvm);
+/**
+ * @brief      Flush the written data of the NVM file to the storage.
+ *
+ * Only fsync also flushes metadata that isn't needed to read the data back, like the modification time.
+ *
+ * @param[in]  dev   The NVM file device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_flush(nvm_file_dev_t *dev)
+{
+  int ret = 0;
+  NVM_FILE_COUNT(dev->io.syscalls, 1);
+  NVM_FILE_COUNT(dev->io.syncs, 1);
+  if( dev->io_mode == NVM_ARCH_IO_MMAP ){
+    // the view is only unmapped when the device is released, also when the file grows meanwhile
+    size_t size = __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE);
+    if( size > 0 ){
+      ret = msync(__atomic_load_n(&dev->map, __ATOMIC_ACQUIRE), size, MS_SYNC);
+    }
+  } else if( dev->durability == NVM_ARCH_DURABILITY_FSYNC ){
+    ret = fsync(dev->fd);
+  } else {
+    ret = fdatasync(dev->fd);
+  }
+  if( ret != 0 ){
+    fprintf(stderr, "Can't sync NVM file, err %d\n", errno);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief      Count a completed write, a group commit stops waiting when a complete group is pending.
+ *
+ * @param[in]  dev   The NVM file device.
+ */
+static void
+_nvm_file_written(nvm_file_dev_t *dev)
+{
+  uint64_t written = __atomic_add_fetch(&dev->written, 1, __ATOMIC_RELEASE);
+#if NVM_CONF_THREADS
+  // the leader checks the pending writes with the lock held, so taking it here can't miss its wait
+  if( dev->durability == NVM_ARCH_DURABILITY_GROUP &&
+      written - __atomic_load_n(&dev->synced, __ATOMIC_ACQUIRE) >= dev->sync_batch ){
+    pthread_mutex_lock(&dev->sync_lock);
+    pthread_cond_signal(&dev->sync_gather);
+    pthread_mutex_unlock(&dev->sync_lock);
+  }
+#else
+  (void) written;
+#endif
+}
+
+/**
+ * @brief      Open the NVM file of a device.
+ *
+ * @param[out] dev     The NVM file device.
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_open(nvm_file_dev_t *dev, const nvm_arch_config_t *config)
+{
+  const char *path = NVM_ARCH_DEFAULT_PATH;
+  nvm_arch_config_t defaults = { 0 };
+  if( config == NULL ){
+    config = &defaults;
+  }
+  if( config->path != NULL ){
+    path = config->path;
+  }
+  nvm_arch_io_mode_t io_mode = config->io_mode;
+
+  // open file in binary read/write mode, the file has to exist
+  int fd = open(path, O_RDWR);
+  if( fd < 0 ){
+    fprintf(stderr, "Can't open NVM file %s\n", path);
     return 1;
   }
-  
+
+  struct stat st;
+  if( fstat(fd, &st) != 0 ){
+    fprintf(stderr, "Can't stat NVM file, err %d\n", errno);
+    close(fd);
+    return 1;
+  }
+
+  dev->fd = fd;
+  dev->io_mode = io_mode;
+  dev->size = st.st_size;
+  dev->map = NULL;
+  dev->map_size = 0;
+  dev->num_retired = 0;
+  memset(&dev->io, 0, sizeof(dev->io));
+  nvm_verify_init(&dev->verify, config->verify_mode, config->verify_interval);
+  dev->durability = config->durability;
+  dev->sync_interval_ms = config->sync_interval_ms > 0 ? config->sync_interval_ms : NVM_ARCH_DEFAULT_SYNC_INTERVAL_MS;
+  dev->sync_batch = config->sync_batch > 0 ? config->sync_batch : NVM_ARCH_DEFAULT_SYNC_BATCH;
+  dev->written = 0;
+  dev->synced = 0;
+
+  if( nvm_flash_init(&dev->flash, &config->flash) != 0 ||
+      (io_mode == NVM_ARCH_IO_MMAP && _nvm_file_map(dev, dev->size) != 0) ){
+    nvm_flash_deinit(&dev->flash);
+    close(fd);
+    dev->fd = -1;
+    return 1;
+  }
+
+#if NVM_CONF_THREADS
+  // the wait of a group commit is timed with the monotonic clock
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&dev->sync_lock, NULL);
+  pthread_cond_init(&dev->sync_gather, &attr);
+  pthread_cond_init(&dev->sync_done, NULL);
+  pthread_condattr_destroy(&attr);
+  dev->syncing = 0;
+#else
+  dev->last_sync_ns = nvm_stats_now_ns();
+#endif
+  return 0;
+}
+
+/**
+ * @brief      Close the NVM file of a device, flushing a mapped view if needed.
+ *
+ * @param[in]  dev   The NVM file device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_close(nvm_file_dev_t *dev)
+{
+  int ret = 0;
+  if( dev->fd < 0 ){
+    return 0;
+  }
+  // the writes that no sync covered yet are made durable, a mapped view is flushed below
+  if( dev->durability != NVM_ARCH_DURABILITY_NONE && dev->io_mode != NVM_ARCH_IO_MMAP &&
+      dev->synced < dev->written && _nvm_file_flush(dev) != 0 ){
+    ret = 1;
+  }
+  if( dev->map != NULL ){
+    NVM_FILE_COUNT(dev->io.syscalls, 1);
+    if( dev->size > 0 && msync(dev->map, dev->size, MS_SYNC) != 0 ){
+      fprintf(stderr, "Can't sync NVM file, err %d\n", errno);
+      ret = 1;
+    }
+    munmap(dev->map, dev->map_size);
+    dev->map = NULL;
+    dev->map_size = 0;
+  }
+  for( uint32_t i = 0; i<dev->num_retired; i++ ){
+    munmap(dev->retired[i].map, dev->retired[i].map_size);
+  }
+  dev->num_retired = 0;
+  nvm_flash_deinit(&dev->flash);
+#if NVM_CONF_THREADS
+  pthread_cond_destroy(&dev->sync_done);
+  pthread_cond_destroy(&dev->sync_gather);
+  pthread_mutex_destroy(&dev->sync_lock);
+#endif
+  if( close(dev->fd) != 0 ){
+    ret = 1;
+  }
+  dev->fd = -1;
+  return ret;
+}
+
+
+/**
+ * @brief      Open a file device, see nvm_arch_backend_t.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     void*: Pointer to the device.
+ */
+static void*
+_nvm_file_backend_open(const nvm_arch_config_t *config)
+{
+  nvm_file_dev_t *dev = calloc(1, sizeof(nvm_file_dev_t));
+  if( dev == NULL ){
+    return NULL;
+  }
+  dev->fd = -1;
+  if( _nvm_file_open(dev, config) != 0 ){
+    free(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+/**
+ * @brief      Close a file device, flushing a mapped view if needed.
+ *
+ * @param[in]  ctx   The NVM file device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_backend_close(void *ctx)
+{
+  int ret = _nvm_file_close(ctx);
+  free(ctx);
+  return ret;
+}
+
+/**
+ * @brief      Copy len bytes into pointer from a file device starting at offset.
+ *
+ * @param[in]  ctx     The NVM file device.
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_backend_read(void *ctx,
+                       long int offset,
+                       size_t len,
+                       void *ptr)
+{
+  return _nvm_file_read(ctx, offset, len, ptr);
+}
+
+/**
+ * @brief      Update a file device by copying len bytes read from pointer starting at offset.
+ *
+ * @param[in]  ctx     The NVM file device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_backend_update(void *ctx,
+                         long int offset,
+                         size_t len,
+                         const void *ptr)
+{
+  nvm_file_dev_t *dev = ctx;
+
   // now we can write the record to the file
-  size_t nmemb = fwrite(ptr, len, 1, nvm);
-  if( nmemb != 1 ){
-    fprintf(stderr, "Num memb don't match can't write: %lu\n", nmemb);
-    fclose(nvm);
+  if( _nvm_file_program(dev, offset, len, ptr) != 0 ){
     return 1;
   }
 
   //check if the write operation was successful
-  if( _nvm_arch_check_write_operation(offset, len, ptr, nvm) != 0 ){
+  if( nvm_verify_write(&dev->verify, _nvm_file_verify_read, dev, offset, len, ptr) != 0 ){
     fprintf(stderr, "Incorrect data after write\n");
-    fclose(nvm);
-    return 1;    
+    NVM_STATS_ADD(nvm_backend_stats()->verify_failures, 1);
+    return 1;
   }
+  _nvm_file_written(dev);
+  return 0;
+}
 
-  fclose(nvm);
+/**
+ * @brief      Update a file device by copying iovcnt buffers back to back starting at offset.
+ *
+ * @param[in]  ctx     The NVM file device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_backend_updatev(void *ctx,
+                          long int offset,
+                          const nvm_arch_iovec_t *iov,
+                          uint32_t iovcnt)
+{
+  nvm_file_dev_t *dev = ctx;
+
+  // all buffers are written with one system call, the flash emulation programs them one by one
+  if( NVM_FLASH_ENABLED(&dev->flash) ){
+    long int pos = offset;
+    for( uint32_t i = 0; i<iovcnt; i++ ){
+      if( _nvm_file_program(dev, pos, iov[i].len, iov[i].base) != 0 ){
+        return 1;
+      }
+      pos += iov[i].len;
+    }
+  } else if( _nvm_file_writev(dev, offset, iov, iovcnt) != 0 ){
+    return 1;
+  }
+
+  //check if the write operation was successful
+  for( uint32_t i = 0; i<iovcnt; i++ ){
+    if( nvm_verify_write(&dev->verify, _nvm_file_verify_read, dev, offset, iov[i].len, iov[i].base) != 0 ){
+      fprintf(stderr, "Incorrect data after write\n");
+      NVM_STATS_ADD(nvm_backend_stats()->verify_failures, 1);
+      return 1;
+    }
+    offset += iov[i].len;
+  }
+  _nvm_file_written(dev);
   return 0;
 }
 
 /**
- * @brief      Append to NVM by copying len bytes read from pointer to NVM starting at offset.
+ * @brief      Append to a file device by copying len bytes read from pointer starting at offset.
  *
+ * @param[in]  ctx     The NVM file device.
  * @param[in]  offset  The offset in the NVM were the append operation should start.
  * @param[in]  len     The length of the append operation (number of bytes).
  * @param[out] ptr     The pointer from which len bytes should be copied.
@@ -160,37 +716,195 @@ nvm_arch_update(long int offset,
  * @return     0: SUCCESS
  * @return     1: ERROR
  */
-int
-nvm_arch_append(long int offset,
-                size_t len,
-                const void *ptr)
+static int
+_nvm_file_backend_append(void *ctx,
+                         long int offset,
+                         size_t len,
+                         const void *ptr)
 {
-  // open file in binary read/write mode for appending.
-  FILE *nvm = fopen("nvm.bin", "a+b");
+  nvm_file_dev_t *dev = ctx;
 
-  // check if file exists
-  if( nvm == NULL ){
-    fprintf(stderr, "Can't open NVM file\n");
+  // appends always go to the end of the file, like a file opened in append mode
+  if( (size_t) offset != dev->size ){
+    fprintf(stderr, "Append offset %ld doesn't match end of NVM %lu\n", offset, dev->size);
     return 1;
   }
+  return _nvm_file_backend_update(dev, offset, len, ptr);
+}
 
-  // now we can append the record to the file
-  size_t nmemb = fwrite(ptr, len, 1, nvm);
-  if( nmemb != 1 ){
-    fprintf(stderr, "Num memb don't match can't write: %lu\n", nmemb);
-    fclose(nvm);
-    return 1;
+/**
+ * @brief      Make the writes to a file device durable according to its durability level.
+ *
+ * Without NVM_CONF_THREADS there are no other threads to wait for, so a group commit only flushes when
+ * sync_batch writes are pending or sync_interval_ms passed since the last flush and returns right away
+ * otherwise. This bounds the writes that can be lost instead of making every write durable.
+ *
+ * @param[in]  ctx   The NVM file device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_file_backend_sync(void *ctx)
+{
+  nvm_file_dev_t *dev = ctx;
+  int ret = 0;
+
+  if( dev->durability == NVM_ARCH_DURABILITY_NONE ){
+    return 0;
+  }
+#if NVM_CONF_THREADS
+  pthread_mutex_lock(&dev->sync_lock);
+  uint64_t target = __atomic_load_n(&dev->written, __ATOMIC_ACQUIRE);
+  while( dev->synced < target && ret == 0 ){
+    // a flush is running, it may cover our writes too
+    if( dev->syncing ){
+      pthread_cond_wait(&dev->sync_done, &dev->sync_lock);
+      continue;
+    }
+    dev->syncing = 1;
+    if( dev->durability == NVM_ARCH_DURABILITY_GROUP ){
+      struct timespec deadline;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += dev->sync_interval_ms / 1000;
+      deadline.tv_nsec += (long) (dev->sync_interval_ms % 1000) * 1000000;
+      if( deadline.tv_nsec >= 1000000000 ){
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+      while( __atomic_load_n(&dev->written, __ATOMIC_ACQUIRE) - dev->synced < dev->sync_batch ){
+        if( pthread_cond_timedwait(&dev->sync_gather, &dev->sync_lock, &deadline) == ETIMEDOUT ){
+          break;
+        }
+      }
+    }
+    // the writes that completed until now are covered by the flush
+    uint64_t written = __atomic_load_n(&dev->written, __ATOMIC_ACQUIRE);
+    pthread_mutex_unlock(&dev->sync_lock);
+    ret = _nvm_file_flush(dev);
+    pthread_mutex_lock(&dev->sync_lock);
+    if( ret == 0 ){
+      NVM_FILE_COUNT(dev->io.synced_writes, written - dev->synced);
+      __atomic_store_n(&dev->synced, written, __ATOMIC_RELEASE);
+    }
+    dev->syncing = 0;
+    pthread_cond_broadcast(&dev->sync_done);
+  }
+  pthread_mutex_unlock(&dev->sync_lock);
+#else
+  uint64_t now = nvm_stats_now_ns();
+  if( dev->synced == dev->written ||
+      (dev->durability == NVM_ARCH_DURABILITY_GROUP && dev->written - dev->synced < dev->sync_batch &&
+       now - dev->last_sync_ns < (uint64_t) dev->sync_interval_ms * 1000000) ){
+    return 0;
+  }
+  ret = _nvm_file_flush(dev);
+  if( ret == 0 ){
+    NVM_FILE_COUNT(dev->io.synced_writes, dev->written - dev->synced);
+    dev->synced = dev->written;
+    dev->last_sync_ns = now;
   }
+#endif
+  return ret;
+}
 
-  //check if the write operation was successful
-  if( _nvm_arch_check_write_operation(offset, len, ptr, nvm) != 0 ){
-    fprintf(stderr, "Incorrect data after write\n");
-    fclose(nvm);
-    return 1;    
+/**
+ * @brief      Return a pointer into the mapped view of a file device, NULL when it isn't mapped.
+ *
+ * Views that were replaced when the file grew are only unmapped when the device is closed.
+ */
+static const void*
+_nvm_file_backend_view(void *ctx,
+                       long int offset,
+                       size_t len)
+{
+  nvm_file_dev_t *dev = ctx;
+  if( dev->io_mode != NVM_ARCH_IO_MMAP || (size_t) offset + len > __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE) ){
+    return NULL;
   }
+  return __atomic_load_n(&dev->map, __ATOMIC_ACQUIRE) + offset;
+}
 
-  fclose(nvm);
-  return 0;
+/**
+ * @brief      Get the size of the file of a device.
+ *
+ */
+static size_t
+_nvm_file_backend_size(const void *ctx)
+{
+  const nvm_file_dev_t *dev = ctx;
+  return __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief      Copy the write verification counters of a file device.
+ *
+ */
+static void
+_nvm_file_backend_get_verify_stats(const void *ctx, nvm_arch_verify_stats_t *stats)
+{
+  *stats = ((const nvm_file_dev_t*) ctx)->verify.stats;
+}
+
+/**
+ * @brief      Copy the I/O counters of a file device.
+ *
+ */
+static void
+_nvm_file_backend_get_io_stats(const void *ctx, nvm_arch_io_stats_t *stats)
+{
+  const nvm_file_dev_t *dev = ctx;
+  stats->syscalls = __atomic_load_n(&dev->io.syscalls, __ATOMIC_RELAXED);
+  stats->syncs = __atomic_load_n(&dev->io.syncs, __ATOMIC_RELAXED);
+  stats->synced_writes = __atomic_load_n(&dev->io.synced_writes, __ATOMIC_RELAXED);
+  stats->bytes_read = __atomic_load_n(&dev->io.bytes_read, __ATOMIC_RELAXED);
+  stats->bytes_written = __atomic_load_n(&dev->io.bytes_written, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief      Copy the flash emulation counters of a file device.
+ *
+ */
+static void
+_nvm_file_backend_get_flash_stats(const void *ctx, nvm_arch_flash_stats_t *stats)
+{
+  nvm_flash_get_stats(&((const nvm_file_dev_t*) ctx)->flash, stats);
+}
+
+/**
+ * @brief      Copy the erase count of every block of a file device that emulates flash.
+ *
+ */
+static uint32_t
+_nvm_file_backend_get_erase_counts(const void *ctx, uint32_t *counts, uint32_t max_counts)
+{
+  const nvm_flash_t *flash = &((const nvm_file_dev_t*) ctx)->flash;
+  uint32_t n = flash->num_blocks < max_counts ? flash->num_blocks : max_counts;
+  if( n > 0 ){
+    memcpy(counts, flash->erase_counts, n * sizeof(uint32_t));
+  }
+  return flash->num_blocks;
 }
 
-/** @} */
\ No newline at end of file
+/**
+ * @brief      Backend that keeps the NVM in a file.
+ *
+ */
+const nvm_arch_backend_t nvm_arch_file_backend = {
+  .name = "file",
+  .open = _nvm_file_backend_open,
+  .close = _nvm_file_backend_close,
+  .read = _nvm_file_backend_read,
+  .update = _nvm_file_backend_update,
+  .updatev = _nvm_file_backend_updatev,
+  .append = _nvm_file_backend_append,
+  .view = _nvm_file_backend_view,
+  .size = _nvm_file_backend_size,
+  .sync = _nvm_file_backend_sync,
+  .get_verify_stats = _nvm_file_backend_get_verify_stats,
+  .get_io_stats = _nvm_file_backend_get_io_stats,
+  .get_flash_stats = _nvm_file_backend_get_flash_stats,
+  .get_erase_counts = _nvm_file_backend_get_erase_counts,
+};
+
+/** @} */
@@ -0,0 +1,311 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-flash.c
+ * \brief Implementation of the flash emulation.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "nvm-flash.h"
+
+// Uses following header(s)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief      Value of an erased byte.
+ *
+ */
+#define NVM_FLASH_ERASED 0xff
+
+/**
+ * @brief      Check if len bytes are erased.
+ *
+ */
+static int
+_nvm_flash_is_erased(const uint8_t *data, size_t len)
+{
+  for( size_t i = 0; i<len; i++ ){
+    if( data[i] != NVM_FLASH_ERASED ){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief      Make sure there is an erase counter for block.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_flash_track(nvm_flash_t *flash, uint32_t block)
+{
+  if( block >= flash->max_blocks ){
+    uint32_t max_blocks = flash->max_blocks ? flash->max_blocks : 16;
+    while( max_blocks <= block ){
+      max_blocks <<= 1;
+    }
+    uint32_t *erase_counts = realloc(flash->erase_counts, max_blocks * sizeof(uint32_t));
+    if( erase_counts == NULL ){
+      return 1;
+    }
+    memset(erase_counts + flash->max_blocks, 0, (max_blocks - flash->max_blocks) * sizeof(uint32_t));
+    flash->erase_counts = erase_counts;
+    flash->max_blocks = max_blocks;
+  }
+  if( block >= flash->num_blocks ){
+    flash->num_blocks = block + 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief      Check if data can be programmed on the current contents of a block.
+ *
+ * NOR flash can only clear bits. A NAND page can only be programmed when it is erased, so
+ * the complete pages that overlap the data have to be erased.
+ *
+ * @param[in]  flash  The flash emulation, its block buffer holds the current contents of the block.
+ * @param[in]  lo     The offset of the data in the block.
+ * @param[in]  len    The length of the data (number of bytes).
+ * @param[in]  data   The data.
+ */
+static int
+_nvm_flash_can_program(const nvm_flash_t *flash, uint32_t lo, uint32_t len, const uint8_t *data)
+{
+  if( flash->config.type == NVM_ARCH_FLASH_NOR ){
+    for( uint32_t i = 0; i<len; i++ ){
+      if( (flash->block[lo + i] & data[i]) != data[i] ){
+        return 0;
+      }
+    }
+    return 1;
+  }
+  uint32_t page_size = flash->config.page_size;
+  uint32_t first = lo / page_size * page_size;
+  return _nvm_flash_is_erased(flash->block + first, (lo + len + page_size - 1) / page_size * page_size - first);
+}
+
+/**
+ * @brief      Number of pages that overlap len bytes at offset lo of a block.
+ *
+ */
+static uint32_t
+_nvm_flash_pages(const nvm_flash_t *flash, uint32_t lo, uint32_t len)
+{
+  uint32_t page_size = flash->config.page_size;
+  return (lo + len + page_size - 1) / page_size - lo / page_size;
+}
+
+/**
+ * @brief      Simulate the time the flash is busy.
+ *
+ */
+static void
+_nvm_flash_busy(nvm_flash_t *flash, uint64_t us)
+{
+  if( us == 0 ){
+    return;
+  }
+  flash->stats.busy_us += us;
+  struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+  while( nanosleep(&ts, &ts) != 0 ){
+  }
+}
+
+/**
+ * @brief      Initialize the flash emulation and clear its counters.
+ *
+ * @param[out] flash   The flash emulation.
+ * @param[in]  config  The configuration, the emulation is disabled for NVM_ARCH_FLASH_NONE.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (invalid configuration or out of memory)
+ */
+int
+nvm_flash_init(nvm_flash_t *flash, const nvm_arch_flash_config_t *config)
+{
+  memset(flash, 0, sizeof(nvm_flash_t));
+  flash->config = *config;
+  if( !NVM_FLASH_ENABLED(flash) ){
+    return 0;
+  }
+  if( flash->config.page_size == 0 ){
+    flash->config.page_size = NVM_FLASH_DEFAULT_PAGE_SIZE;
+  }
+  if( flash->config.block_size == 0 ){
+    flash->config.block_size = NVM_FLASH_DEFAULT_BLOCK_SIZE;
+  }
+  if( flash->config.block_size % flash->config.page_size != 0 ){
+    fprintf(stderr, "Flash block size %u isn't a multiple of page size %u\n", flash->config.block_size, flash->config.page_size);
+    return 1;
+  }
+  flash->block = malloc(flash->config.block_size);
+  flash->erased = malloc(flash->config.block_size);
+  if( flash->block == NULL || flash->erased == NULL ){
+    nvm_flash_deinit(flash);
+    return 1;
+  }
+  memset(flash->erased, NVM_FLASH_ERASED, flash->config.block_size);
+  return 0;
+}
+
+/**
+ * @brief      Release the memory of the flash emulation.
+ *
+ * @param[in]  flash  The flash emulation.
+ */
+void
+nvm_flash_deinit(nvm_flash_t *flash)
+{
+  free(flash->erase_counts);
+  free(flash->block);
+  free(flash->erased);
+  flash->erase_counts = NULL;
+  flash->block = NULL;
+  flash->erased = NULL;
+  flash->num_blocks = 0;
+  flash->max_blocks = 0;
+}
+
+/**
+ * @brief      Write len bytes at offset, erasing the blocks that can't be programmed.
+ *
+ * Every block is handled on its own: the data for the block is programmed when the block allows it,
+ * otherwise the block is erased and programmed with its old contents merged with the data.
+ *
+ * @param[in]  flash   The flash emulation.
+ * @param[in]  read    The read callback of the device.
+ * @param[in]  write   The write callback of the device.
+ * @param[in]  dev     The device passed to the callbacks.
+ * @param[in]  size    The current size of the device, the bytes beyond it are erased.
+ * @param[in]  offset  The offset in the NVM were the data should be written.
+ * @param[in]  len     The length of the data (number of bytes).
+ * @param[in]  ptr     The pointer were the data is copied from.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_flash_write(nvm_flash_t *flash,
+                nvm_flash_read_fn_t read,
+                nvm_flash_write_fn_t write,
+                void *dev,
+                size_t size,
+                long int offset,
+                size_t len,
+                const void *ptr)
+{
+  const nvm_arch_flash_config_t *config = &flash->config;
+  size_t end = offset + len;
+  uint64_t busy = 0;
+
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
+    return 1;
+  }
+  flash->stats.bytes_requested += len;
+
+  // the bytes between the end of the device and the data are erased
+  while( size < (size_t) offset ){
+    size_t n = (size_t) offset - size < config->block_size ? (size_t) offset - size : config->block_size;
+    if( write(dev, size, n, flash->erased) != 0 ){
+      return 1;
+    }
+    size += n;
+  }
+
+  size_t pos = offset;
+  while( pos < end ){
+    uint32_t block = pos / config->block_size;
+    size_t block_start = (size_t) block * config->block_size;
+    uint32_t lo = pos - block_start;
+    uint32_t n = end - pos < config->block_size - lo ? end - pos : config->block_size - lo;
+    const uint8_t *data = (const uint8_t*) ptr + (pos - offset);
+    if( _nvm_flash_track(flash, block) != 0 ){
+      return 1;
+    }
+
+    // the current contents of the block, erased beyond the end of the device
+    uint32_t have = size > block_start ? (size - block_start < config->block_size ? size - block_start : config->block_size) : 0;
+    if( have > 0 && read(dev, block_start, have, flash->block) != 0 ){
+      return 1;
+    }
+    memset(flash->block + have, NVM_FLASH_ERASED, config->block_size - have);
+
+    if( _nvm_flash_can_program(flash, lo, n, data) ){
+      if( write(dev, pos, n, data) != 0 ){
+        return 1;
+      }
+      uint32_t pages = _nvm_flash_pages(flash, lo, n);
+      flash->stats.page_programs += pages;
+      flash->stats.bytes_programmed += config->type == NVM_ARCH_FLASH_NOR ? n : pages * config->page_size;
+      busy += (uint64_t) pages * config->program_time_us;
+    } else {
+      // erase the block and program the pages that aren't erased afterwards
+      uint32_t used = lo + n > have ? lo + n : have;
+      memcpy(flash->block + lo, data, n);
+      if( write(dev, block_start, have, flash->erased) != 0 ){
+        return 1;
+      }
+      flash->erase_counts[block]++;
+      flash->stats.erases++;
+      flash->stats.rewrites++;
+      busy += config->erase_time_us;
+      if( write(dev, block_start, used, flash->block) != 0 ){
+        return 1;
+      }
+      for( uint32_t page = 0; page<used; page += config->page_size ){
+        uint32_t page_len = used - page < config->page_size ? used - page : config->page_size;
+        if( !_nvm_flash_is_erased(flash->block + page, page_len) ){
+          flash->stats.page_programs++;
+          flash->stats.bytes_programmed += config->page_size;
+          busy += config->program_time_us;
+        }
+      }
+    }
+    pos += n;
+    if( pos > size ){
+      size = pos;
+    }
+  }
+  _nvm_flash_busy(flash, busy);
+  return 0;
+}
+
+/**
+ * @brief      Copy the counters of the flash emulation.
+ *
+ * @param[in]  flash  The flash emulation.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_flash_get_stats(const nvm_flash_t *flash, nvm_arch_flash_stats_t *stats)
+{
+  *stats = flash->stats;
+  stats->num_blocks = flash->num_blocks;
+  stats->min_erase_count = 0;
+  stats->max_erase_count = 0;
+  for( uint32_t i = 0; i<flash->num_blocks; i++ ){
+    uint32_t count = flash->erase_counts[i];
+    if( i == 0 || count < stats->min_erase_count ){
+      stats->min_erase_count = count;
+    }
+    if( count > stats->max_erase_count ){
+      stats->max_erase_count = count;
+    }
+  }
+  if( stats->bytes_requested > 0 ){
+    stats->write_amplification = (double) stats->bytes_programmed / stats->bytes_requested;
+  }
+}
+
+/** @} */
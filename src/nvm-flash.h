@@ -0,0 +1,128 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-flash.h
+ * \brief Header file for the flash emulation shared by the NVM device implementations.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A device implementation that emulates flash keeps one nvm_flash_t and passes every write to
+ * nvm_flash_write instead of writing it directly. The emulation reads the blocks the write touches
+ * through the read callback of the device and checks if the write can be programmed on them.
+ * When it can't, the blocks are erased (written with 0xff) and programmed again through the write
+ * callback. Data beyond the end of the device is erased, a write beyond the end first fills the gap
+ * with 0xff.
+ */
+
+#ifndef __NVM_FLASH_H__
+#define __NVM_FLASH_H__
+
+#include "nvm-arch.h"
+
+/**
+ * @brief      Default page size of the flash emulation.
+ *
+ */
+#define NVM_FLASH_DEFAULT_PAGE_SIZE 256
+
+/**
+ * @brief      Default erase block size of the flash emulation.
+ *
+ */
+#define NVM_FLASH_DEFAULT_BLOCK_SIZE 4096
+
+/**
+ * @brief      Read callback used to read the current contents of the flash.
+ *
+ */
+typedef int (*nvm_flash_read_fn_t)(void *dev, long int offset, size_t len, void *ptr);
+
+/**
+ * @brief      Write callback used to erase and program the flash.
+ *
+ */
+typedef int (*nvm_flash_write_fn_t)(void *dev, long int offset, size_t len, const void *ptr);
+
+/**
+ * @brief      Flash emulation state and counters.
+ *
+ * The erase counts cover the blocks up to the last block that was written, room is allocated for max_blocks.
+ * The block buffer holds the contents of one block while a write is checked, the erased buffer
+ * is a block of 0xff.
+ */
+typedef struct nvm_flash {
+	nvm_arch_flash_config_t config;
+	uint32_t *erase_counts;
+	uint32_t num_blocks;
+	uint32_t max_blocks;
+	uint8_t *block;
+	uint8_t *erased;
+	nvm_arch_flash_stats_t stats;
+} nvm_flash_t;
+
+/**
+ * @brief      Initialize the flash emulation and clear its counters.
+ *
+ * @param[out] flash   The flash emulation.
+ * @param[in]  config  The configuration, the emulation is disabled for NVM_ARCH_FLASH_NONE.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (invalid configuration or out of memory)
+ */
+int
+nvm_flash_init(	nvm_flash_t *flash,
+				const nvm_arch_flash_config_t *config);
+
+/**
+ * @brief      Release the memory of the flash emulation.
+ *
+ * @param[in]  flash  The flash emulation.
+ */
+void
+nvm_flash_deinit(nvm_flash_t *flash);
+
+/**
+ * @brief      Check if the flash emulation is enabled.
+ *
+ */
+#define NVM_FLASH_ENABLED(flash) ((flash)->config.type != NVM_ARCH_FLASH_NONE)
+
+/**
+ * @brief      Write len bytes at offset, erasing the blocks that can't be programmed.
+ *
+ * @param[in]  flash   The flash emulation.
+ * @param[in]  read    The read callback of the device.
+ * @param[in]  write   The write callback of the device.
+ * @param[in]  dev     The device passed to the callbacks.
+ * @param[in]  size    The current size of the device, the bytes beyond it are erased.
+ * @param[in]  offset  The offset in the NVM were the data should be written.
+ * @param[in]  len     The length of the data (number of bytes).
+ * @param[in]  ptr     The pointer were the data is copied from.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_flash_write(	nvm_flash_t *flash,
+					nvm_flash_read_fn_t read,
+					nvm_flash_write_fn_t write,
+					void *dev,
+					size_t size,
+					long int offset,
+					size_t len,
+					const void *ptr);
+
+/**
+ * @brief      Copy the counters of the flash emulation.
+ *
+ * @param[in]  flash  The flash emulation.
+ * @param[out] stats  Pointer were the counters can be stored.
+ */
+void
+nvm_flash_get_stats(	const nvm_flash_t *flash,
+						nvm_arch_flash_stats_t *stats);
+
+#endif /*__NVM_FLASH_H__ */
+/** @} */
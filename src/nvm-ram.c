@@ -0,0 +1,423 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-ram.c
+ * \brief Implementation of the RAM backend of the architecture specific NVM device interface.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The NVM is kept in a buffer that grows with the device, no operation makes a system call.
+ * The contents are lost when the device is closed unless the device is snapshotted to a file.
+ */
+
+// Implements following header(s)
+#include "nvm-arch.h"
+
+// Uses following header(s)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/**
+ * @brief      Minimum capacity of the buffer, the buffer grows in powers of two.
+ *
+ */
+#define NVM_RAM_MIN_CAPACITY 4096
+
+/**
+ * @brief      Maximum number of buffers that are kept after the buffer grew.
+ *
+ */
+#define NVM_RAM_MAX_RETIRED 48
+
+/**
+ * @brief      NVM RAM device.
+ *
+ * Reads may run concurrently with a write that grows the buffer, so the size is published after the
+ * buffer and replaced buffers are only freed when the device is closed.
+ */
+typedef struct nvm_ram_dev {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+  char *snapshot;
+  nvm_arch_io_stats_t io;
+  uint8_t *retired[NVM_RAM_MAX_RETIRED];
+  uint32_t num_retired;
+} nvm_ram_dev_t;
+
+/**
+ * @brief      Make sure the buffer can hold end bytes, the new bytes are zero like the holes of a file.
+ *
+ * @param[in]  dev   The NVM RAM device.
+ * @param[in]  end   The offset of the last byte that is written plus one.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_reserve(nvm_ram_dev_t *dev, size_t end)
+{
+  if( end <= dev->capacity ){
+    return 0;
+  }
+  if( dev->num_retired == NVM_RAM_MAX_RETIRED ){
+    fprintf(stderr, "Can't grow NVM RAM beyond %lu bytes\n", dev->capacity);
+    return 1;
+  }
+
+  // grow the buffer geometrically so appends don't copy every time
+  size_t capacity = dev->capacity ? dev->capacity : NVM_RAM_MIN_CAPACITY;
+  while( capacity < end ){
+    capacity <<= 1;
+  }
+  uint8_t *data = calloc(1, capacity);
+  if( data == NULL ){
+    fprintf(stderr, "Can't allocate %lu bytes of NVM RAM\n", capacity);
+    return 1;
+  }
+
+  // a concurrent read may still copy from the old buffer, it is freed when the device is closed
+  if( dev->data != NULL ){
+    memcpy(data, dev->data, dev->size);
+    dev->retired[dev->num_retired++] = dev->data;
+  }
+  __atomic_store_n(&dev->data, data, __ATOMIC_RELEASE);
+  dev->capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief      Copy len bytes to the buffer starting at offset, growing the device when needed.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_write(nvm_ram_dev_t *dev,
+               long int offset,
+               size_t len,
+               const void *ptr)
+{
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
+    return 1;
+  }
+  if( _nvm_ram_reserve(dev, offset + len) != 0 ){
+    return 1;
+  }
+  memcpy(dev->data + offset, ptr, len);
+  __atomic_fetch_add(&dev->io.bytes_written, len, __ATOMIC_RELAXED);
+  if( (size_t) offset + len > dev->size ){
+    __atomic_store_n(&dev->size, offset + len, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+/**
+ * @brief      Load the snapshot file into the buffer, a missing file is an empty device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_load(nvm_ram_dev_t *dev)
+{
+  FILE *fp = fopen(dev->snapshot, "rb");
+  if( fp == NULL ){
+    return errno == ENOENT ? 0 : 1;
+  }
+
+  int ret = 0;
+  long int size = -1;
+  if( fseek(fp, 0, SEEK_END) == 0 ){
+    size = ftell(fp);
+  }
+  if( size < 0 || fseek(fp, 0, SEEK_SET) != 0 || _nvm_ram_reserve(dev, size) != 0 ||
+      fread(dev->data, 1, size, fp) != (size_t) size ){
+    fprintf(stderr, "Can't load NVM snapshot %s\n", dev->snapshot);
+    ret = 1;
+  } else {
+    dev->size = size;
+  }
+  fclose(fp);
+  return ret;
+}
+
+/**
+ * @brief      Save the buffer to the snapshot file.
+ *
+ * The buffer is written to a temporary file that replaces the snapshot, so a crash while saving keeps the
+ * previous snapshot.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_save(nvm_ram_dev_t *dev)
+{
+  size_t len = strlen(dev->snapshot);
+  char *tmp = malloc(len + sizeof(".tmp"));
+  if( tmp == NULL ){
+    return 1;
+  }
+  memcpy(tmp, dev->snapshot, len);
+  memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+  int ret = 1;
+  FILE *fp = fopen(tmp, "wb");
+  if( fp != NULL ){
+    int ok = (dev->size == 0 || fwrite(dev->data, 1, dev->size, fp) == dev->size) && fflush(fp) == 0;
+    if( fclose(fp) == 0 && ok && rename(tmp, dev->snapshot) == 0 ){
+      ret = 0;
+    }
+  }
+  if( ret != 0 ){
+    fprintf(stderr, "Can't save NVM snapshot %s, err %d\n", dev->snapshot, errno);
+    remove(tmp);
+  }
+  free(tmp);
+  return ret;
+}
+
+/**
+ * @brief      Release the memory of a device.
+ *
+ */
+static void
+_nvm_ram_free(nvm_ram_dev_t *dev)
+{
+  for( uint32_t i = 0; i<dev->num_retired; i++ ){
+    free(dev->retired[i]);
+  }
+  free(dev->data);
+  free(dev->snapshot);
+  free(dev);
+}
+
+/**
+ * @brief      Open a RAM device, loading its snapshot when snapshots are enabled.
+ *
+ * @param[in]  config  The device configuration, NULL selects the defaults.
+ *
+ * @return     NULL: The device could not be opened.
+ * @return     void*: Pointer to the device.
+ */
+static void*
+_nvm_ram_open(const nvm_arch_config_t *config)
+{
+  nvm_ram_dev_t *dev = calloc(1, sizeof(nvm_ram_dev_t));
+  if( dev == NULL ){
+    return NULL;
+  }
+  if( config != NULL && config->snapshot ){
+    const char *path = config->path != NULL ? config->path : NVM_ARCH_DEFAULT_PATH;
+    dev->snapshot = strdup(path);
+    if( dev->snapshot == NULL || _nvm_ram_load(dev) != 0 ){
+      _nvm_ram_free(dev);
+      return NULL;
+    }
+  }
+  return dev;
+}
+
+/**
+ * @brief      Close a RAM device, saving its snapshot when snapshots are enabled.
+ *
+ * @param[in]  ctx   The NVM RAM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_close(void *ctx)
+{
+  nvm_ram_dev_t *dev = ctx;
+  int ret = 0;
+  if( dev->snapshot != NULL ){
+    ret = _nvm_ram_save(dev);
+  }
+  _nvm_ram_free(dev);
+  return ret;
+}
+
+/**
+ * @brief      Copy len bytes into pointer from a RAM device starting at offset.
+ *
+ * @param[in]  ctx     The NVM RAM device.
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_read(void *ctx,
+              long int offset,
+              size_t len,
+              void *ptr)
+{
+  nvm_ram_dev_t *dev = ctx;
+
+  // check if offset is correct and the record is inside the device
+  if( offset < 0 ){
+    fprintf(stderr, "Illegal offset %ld\n", offset);
+    return 1;
+  }
+  if( (size_t) offset + len > __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE) ){
+    fprintf(stderr, "Can't read %lu bytes at offset %ld beyond end of NVM\n", len, offset);
+    return 1;
+  }
+  memcpy(ptr, __atomic_load_n(&dev->data, __ATOMIC_ACQUIRE) + offset, len);
+  __atomic_fetch_add(&dev->io.bytes_read, len, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/**
+ * @brief      Update a RAM device by copying len bytes read from pointer starting at offset.
+ *
+ * @param[in]  ctx     The NVM RAM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_update(void *ctx,
+                long int offset,
+                size_t len,
+                const void *ptr)
+{
+  return _nvm_ram_write(ctx, offset, len, ptr);
+}
+
+/**
+ * @brief      Update a RAM device by copying iovcnt buffers back to back starting at offset.
+ *
+ * @param[in]  ctx     The NVM RAM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_updatev(void *ctx,
+                 long int offset,
+                 const nvm_arch_iovec_t *iov,
+                 uint32_t iovcnt)
+{
+  nvm_ram_dev_t *dev = ctx;
+  size_t len = 0;
+  for( uint32_t i = 0; i<iovcnt; i++ ){
+    len += iov[i].len;
+  }
+
+  // grow once for all buffers
+  if( offset < 0 || _nvm_ram_reserve(dev, offset + len) != 0 ){
+    return 1;
+  }
+  for( uint32_t i = 0; i<iovcnt; i++ ){
+    if( _nvm_ram_write(dev, offset, iov[i].len, iov[i].base) != 0 ){
+      return 1;
+    }
+    offset += iov[i].len;
+  }
+  return 0;
+}
+
+/**
+ * @brief      Append to a RAM device by copying len bytes read from pointer starting at offset.
+ *
+ * @param[in]  ctx     The NVM RAM device.
+ * @param[in]  offset  The offset in the NVM were the append operation should start.
+ * @param[in]  len     The length of the append operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_ram_append(void *ctx,
+                long int offset,
+                size_t len,
+                const void *ptr)
+{
+  nvm_ram_dev_t *dev = ctx;
+  if( (size_t) offset != dev->size ){
+    fprintf(stderr, "Append offset %ld doesn't match end of NVM %lu\n", offset, dev->size);
+    return 1;
+  }
+  return _nvm_ram_write(dev, offset, len, ptr);
+}
+
+/**
+ * @brief      Return a pointer into the buffer of a RAM device.
+ *
+ * Buffers that were replaced when the device grew are only freed when the device is closed.
+ */
+static const void*
+_nvm_ram_view(void *ctx,
+              long int offset,
+              size_t len)
+{
+  nvm_ram_dev_t *dev = ctx;
+  if( (size_t) offset + len > __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE) ){
+    return NULL;
+  }
+  return __atomic_load_n(&dev->data, __ATOMIC_ACQUIRE) + offset;
+}
+
+/**
+ * @brief      Get the size of the memory of a device.
+ *
+ */
+static size_t
+_nvm_ram_size(const void *ctx)
+{
+  const nvm_ram_dev_t *dev = ctx;
+  return __atomic_load_n(&dev->size, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief      Copy the I/O counters of a RAM device, it never makes a system call.
+ *
+ */
+static void
+_nvm_ram_get_io_stats(const void *ctx, nvm_arch_io_stats_t *stats)
+{
+  const nvm_ram_dev_t *dev = ctx;
+  stats->syscalls = 0;
+  stats->syncs = 0;
+  stats->synced_writes = 0;
+  stats->bytes_read = __atomic_load_n(&dev->io.bytes_read, __ATOMIC_RELAXED);
+  stats->bytes_written = __atomic_load_n(&dev->io.bytes_written, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief      Backend that keeps the NVM in memory.
+ *
+ * Writes aren't verified and flash isn't emulated, the verification and flash options of the configuration
+ * are ignored.
+ */
+const nvm_arch_backend_t nvm_arch_ram_backend = {
+  .name = "ram",
+  .open = _nvm_ram_open,
+  .close = _nvm_ram_close,
+  .read = _nvm_ram_read,
+  .update = _nvm_ram_update,
+  .updatev = _nvm_ram_updatev,
+  .append = _nvm_ram_append,
+  .view = _nvm_ram_view,
+  .size = _nvm_ram_size,
+  .get_io_stats = _nvm_ram_get_io_stats,
+};
+
+/** @} */
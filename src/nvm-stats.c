@@ -0,0 +1,132 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-stats.c
+ * \brief Implementation of the per-thread statistics counters.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "nvm-stats.h"
+
+// Uses following header(s)
+#include <stdlib.h>
+#include <time.h>
+
+#if NVM_CONF_THREADS
+/**
+ * @brief      Thread-specific key holding the chain of blocks of a thread, over all counter sets.
+ *
+ */
+static pthread_key_t nvm_stats_key;
+static pthread_once_t nvm_stats_once = PTHREAD_ONCE_INIT;
+static int nvm_stats_key_created;
+
+/**
+ * @brief      Give up the blocks of an exiting thread, their counters stay in the sums.
+ *
+ */
+static void
+_nvm_stats_release(void *arg)
+{
+  nvm_stats_block_t *block = arg;
+  while( block != NULL ){
+    nvm_stats_block_t *next = block->thread_next;
+    __atomic_store_n(&block->owned, 0, __ATOMIC_RELEASE);
+    block = next;
+  }
+}
+
+/**
+ * @brief      Create the thread-specific key, once per process.
+ *
+ */
+static void
+_nvm_stats_create_key(void)
+{
+  nvm_stats_key_created = pthread_key_create(&nvm_stats_key, _nvm_stats_release) == 0;
+}
+#endif
+
+/**
+ * @brief      Return the counters of the calling thread, a block is taken from the set the first time.
+ *
+ * A block given up by an exiting thread is reused before a new one is allocated.
+ * When no block can be allocated the shared counters are returned, concurrent counts on them may get lost.
+ *
+ * @param[in]  stats  The counter set.
+ *
+ * @return     Pointer to the counters, laid out like the structure passed to NVM_STATS_INITIALIZER.
+ */
+uint64_t*
+nvm_stats_thread_counters(nvm_stats_t *stats)
+{
+#if NVM_CONF_THREADS
+  pthread_once(&nvm_stats_once, _nvm_stats_create_key);
+  if( !nvm_stats_key_created ){
+    return stats->shared;
+  }
+
+  pthread_mutex_lock(&stats->lock);
+  nvm_stats_block_t *block = stats->blocks;
+  while( block != NULL && __atomic_load_n(&block->owned, __ATOMIC_ACQUIRE) ){
+    block = block->next;
+  }
+  if( block == NULL ){
+    block = calloc(1, sizeof(nvm_stats_block_t) + stats->num_counters * sizeof(uint64_t));
+    if( block == NULL ){
+      pthread_mutex_unlock(&stats->lock);
+      return stats->shared;
+    }
+    block->next = stats->blocks;
+    stats->blocks = block;
+  }
+  block->owned = 1;
+  block->thread_next = pthread_getspecific(nvm_stats_key);
+  pthread_setspecific(nvm_stats_key, block);
+  pthread_mutex_unlock(&stats->lock);
+  return block->counters;
+#else
+  return stats->shared;
+#endif
+}
+
+/**
+ * @brief      Sum the counters of all threads.
+ *
+ * @param[in]  stats  The counter set.
+ * @param[out] sums   The sums, laid out like the structure passed to NVM_STATS_INITIALIZER.
+ */
+void
+nvm_stats_sum(nvm_stats_t *stats, uint64_t *sums)
+{
+  for( uint32_t i = 0; i<stats->num_counters; i++ ){
+    sums[i] = __atomic_load_n(&stats->shared[i], __ATOMIC_RELAXED);
+  }
+#if NVM_CONF_THREADS
+  pthread_mutex_lock(&stats->lock);
+  for( nvm_stats_block_t *block = stats->blocks; block != NULL; block = block->next ){
+    for( uint32_t i = 0; i<stats->num_counters; i++ ){
+      sums[i] += __atomic_load_n(&block->counters[i], __ATOMIC_RELAXED);
+    }
+  }
+  pthread_mutex_unlock(&stats->lock);
+#endif
+}
+
+/**
+ * @brief      Monotonic time in nanoseconds, used to time operations.
+ *
+ */
+uint64_t
+nvm_stats_now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** @} */
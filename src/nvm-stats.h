@@ -0,0 +1,118 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-stats.h
+ * \brief Header file for the per-thread statistics counters shared by the NVM layers.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A counter set is a structure of uint64_t counters. Every thread counts in its own block of the set,
+ * so counting needs no atomic read-modify-write and no shared cache line. Reading the statistics sums
+ * the blocks of all threads. When a thread exits its block is kept and reused by the next thread that
+ * starts counting, so the sums never go back.
+ */
+
+#ifndef __NVM_STATS_H__
+#define __NVM_STATS_H__
+
+#include <stdint.h>
+
+/**
+ * @brief      Set to 0 to build without statistics, the counters then stay 0.
+ *
+ */
+#ifndef NVM_CONF_STATS
+#define NVM_CONF_STATS 1
+#endif
+
+/**
+ * @brief      Set to 0 to build for a single thread without pthreads, all counting goes to one block.
+ *
+ */
+#ifndef NVM_CONF_THREADS
+#define NVM_CONF_THREADS 1
+#endif
+
+#if NVM_CONF_THREADS
+#include <pthread.h>
+#endif
+
+/**
+ * @brief      Block of counters of one thread.
+ *
+ */
+typedef struct nvm_stats_block {
+	struct nvm_stats_block *next;
+	struct nvm_stats_block *thread_next;
+	int owned;
+	uint64_t counters[];
+} nvm_stats_block_t;
+
+/**
+ * @brief      Counter set.
+ *
+ * The shared counters are used by threads that couldn't get a block of their own.
+ */
+typedef struct nvm_stats {
+	uint32_t num_counters;
+	uint64_t *shared;
+#if NVM_CONF_THREADS
+	pthread_mutex_t lock;
+#endif
+	nvm_stats_block_t *blocks;
+} nvm_stats_t;
+
+/**
+ * @brief      Static initializer of a counter set, shared is a structure of uint64_t counters.
+ *
+ */
+#if NVM_CONF_THREADS
+#define NVM_STATS_INITIALIZER(shared) { sizeof(*(shared)) / sizeof(uint64_t), (uint64_t*) (shared), PTHREAD_MUTEX_INITIALIZER, NULL }
+#else
+#define NVM_STATS_INITIALIZER(shared) { sizeof(*(shared)) / sizeof(uint64_t), (uint64_t*) (shared), NULL }
+#endif
+
+/**
+ * @brief      Add to a counter of the block of the calling thread.
+ *
+ * Only the owner writes the counter, readers may load it at any time.
+ */
+#if NVM_CONF_STATS
+#define NVM_STATS_ADD(counter, n) __atomic_store_n(&(counter), __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (n), __ATOMIC_RELAXED)
+#else
+#define NVM_STATS_ADD(counter, n) ((void) (counter), (void) (n))
+#endif
+
+/**
+ * @brief      Return the counters of the calling thread, a block is taken from the set the first time.
+ *
+ * The caller keeps the pointer in a thread-local variable, so this is only called once per thread.
+ *
+ * @param[in]  stats  The counter set.
+ *
+ * @return     Pointer to the counters, laid out like the structure passed to NVM_STATS_INITIALIZER.
+ */
+uint64_t*
+nvm_stats_thread_counters(nvm_stats_t *stats);
+
+/**
+ * @brief      Sum the counters of all threads.
+ *
+ * @param[in]  stats  The counter set.
+ * @param[out] sums   The sums, laid out like the structure passed to NVM_STATS_INITIALIZER.
+ */
+void
+nvm_stats_sum(	nvm_stats_t *stats,
+				uint64_t *sums);
+
+/**
+ * @brief      Monotonic time in nanoseconds, used to time operations.
+ *
+ */
+uint64_t
+nvm_stats_now_ns(void);
+
+#endif /*__NVM_STATS_H__ */
+/** @} */
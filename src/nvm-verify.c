@@ -0,0 +1,127 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-verify.c
+ * \brief Implementation of the write verification policy.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+// Implements following header(s)
+#include "nvm-verify.h"
+
+// Uses following header(s)
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief      Size of the buffer used to read back data.
+ *
+ */
+#define NVM_VERIFY_CHUNK_SIZE 4096
+
+/**
+ * @brief      Read back the data in chunks and compare it with memcmp.
+ *
+ * @param[in]  read    The read callback of the device.
+ * @param[in]  dev     The device passed to the read callback.
+ * @param[in]  offset  The offset in the NVM were the data was written.
+ * @param[in]  len     The length of the data (number of bytes).
+ * @param[in]  ptr     The pointer were the data was copied from.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+_nvm_verify_read_back(nvm_verify_read_fn_t read,
+                      void *dev,
+                      long int offset,
+                      size_t len,
+                      const uint8_t *ptr)
+{
+  uint8_t buf[NVM_VERIFY_CHUNK_SIZE];
+  size_t done = 0;
+  while( done < len ){
+    size_t n = len - done < sizeof(buf) ? len - done : sizeof(buf);
+    if( read(dev, offset + done, n, buf) != 0 ){
+      fprintf(stderr, "Can't read back data at offset %ld\n", offset + (long int) done);
+      return 1;
+    }
+    if( memcmp(buf, ptr + done, n) != 0 ){
+      fprintf(stderr, "data doesnt match at offset %ld\n", offset + (long int) done);
+      return 1;
+    }
+    done += n;
+  }
+  return 0;
+}
+
+/**
+ * @brief      Initialize the verification policy and clear its counters.
+ *
+ * @param[out] verify    The verification policy.
+ * @param[in]  mode      The verification mode.
+ * @param[in]  interval  The sample interval for NVM_ARCH_VERIFY_SAMPLED, 0 selects the default.
+ */
+void
+nvm_verify_init(nvm_verify_t *verify,
+                nvm_arch_verify_mode_t mode,
+                uint32_t interval)
+{
+  memset(verify, 0, sizeof(nvm_verify_t));
+  verify->mode = mode;
+  verify->interval = interval ? interval : NVM_VERIFY_DEFAULT_INTERVAL;
+  verify->countdown = verify->interval;
+}
+
+/**
+ * @brief      Verify len bytes written at offset according to the policy.
+ *
+ * @param[in]  verify  The verification policy.
+ * @param[in]  read    The read callback of the device.
+ * @param[in]  dev     The device passed to the read callback.
+ * @param[in]  offset  The offset in the NVM were the data was written.
+ * @param[in]  len     The length of the data (number of bytes).
+ * @param[in]  ptr     The pointer were the data was copied from.
+ *
+ * @return     0: SUCCESS (verified or skipped)
+ * @return     1: ERROR
+ */
+int
+nvm_verify_write(nvm_verify_t *verify,
+                 nvm_verify_read_fn_t read,
+                 void *dev,
+                 long int offset,
+                 size_t len,
+                 const void *ptr)
+{
+  verify->stats.writes++;
+
+  switch( verify->mode ){
+    case NVM_ARCH_VERIFY_OFF:
+      verify->stats.skipped++;
+      return 0;
+    case NVM_ARCH_VERIFY_SAMPLED:
+      if( --verify->countdown != 0 ){
+        verify->stats.skipped++;
+        return 0;
+      }
+      verify->countdown = verify->interval;
+      break;
+    case NVM_ARCH_VERIFY_BULK:
+    default:
+      break;
+  }
+
+  verify->stats.verified++;
+  verify->stats.bytes_verified += len;
+  if( _nvm_verify_read_back(read, dev, offset, len, ptr) != 0 ){
+    verify->stats.failures++;
+    return 1;
+  }
+  return 0;
+}
+
+/** @} */
@@ -0,0 +1,78 @@
+/**
+ * \addtogroup nvm-arch
+ * @{
+ */
+
+/**
+ * \file  nvm-verify.h
+ * \brief Header file for the write verification policy shared by the NVM device implementations.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * A device implementation keeps one nvm_verify_t and calls nvm_verify_write after every write.
+ * The policy decides if the write has to be verified and reads back the data through the read
+ * callback of the device in chunks, so no buffer of the full write length is needed.
+ */
+
+#ifndef __NVM_VERIFY_H__
+#define __NVM_VERIFY_H__
+
+#include "nvm-arch.h"
+
+/**
+ * @brief      Default number of writes between two verified writes in sampled mode.
+ *
+ */
+#define NVM_VERIFY_DEFAULT_INTERVAL 16
+
+/**
+ * @brief      Read callback used to read back the written data.
+ *
+ */
+typedef int (*nvm_verify_read_fn_t)(void *dev, long int offset, size_t len, void *ptr);
+
+/**
+ * @brief      Write verification policy and counters.
+ *
+ */
+typedef struct nvm_verify {
+	nvm_arch_verify_mode_t mode;
+	uint32_t interval;
+	uint32_t countdown;
+	nvm_arch_verify_stats_t stats;
+} nvm_verify_t;
+
+/**
+ * @brief      Initialize the verification policy and clear its counters.
+ *
+ * @param[out] verify    The verification policy.
+ * @param[in]  mode      The verification mode.
+ * @param[in]  interval  The sample interval for NVM_ARCH_VERIFY_SAMPLED, 0 selects the default.
+ */
+void
+nvm_verify_init(	nvm_verify_t *verify,
+					nvm_arch_verify_mode_t mode,
+					uint32_t interval);
+
+/**
+ * @brief      Verify len bytes written at offset according to the policy.
+ *
+ * @param[in]  verify  The verification policy.
+ * @param[in]  read    The read callback of the device.
+ * @param[in]  dev     The device passed to the read callback.
+ * @param[in]  offset  The offset in the NVM were the data was written.
+ * @param[in]  len     The length of the data (number of bytes).
+ * @param[in]  ptr     The pointer were the data was copied from.
+ *
+ * @return     0: SUCCESS (verified or skipped)
+ * @return     1: ERROR
+ */
+int
+nvm_verify_write(	nvm_verify_t *verify,
+					nvm_verify_read_fn_t read,
+					void *dev,
+					long int offset,
+					size_t len,
+					const void *ptr);
+
+#endif /*__NVM_VERIFY_H__ */
+/** @} */
@@ -21,6 +21,19 @@
 #define __NVM_H__
 
 #include <stdint.h>
+#include "nvm-arch.h"
+
+/**
+ * @brief      NVM device, see nvm-arch.h.
+ *
+ */
+typedef struct nvm_arch_dev nvm_dev_t;
+
+/**
+ * @brief      Buffer of a vectored update, see nvm-arch.h.
+ *
+ */
+typedef struct nvm_arch_iovec nvm_iovec_t;
 
 /**
  * @brief      Copy len bytes into pointer from NVM starting from offset.
@@ -34,7 +47,7 @@
  */
 int
 nvm_read(	uint32_t offset,
-			uint8_t len,
+			uint32_t len,
 			void *ptr);
 
 /**
@@ -49,7 +62,7 @@ nvm_read(	uint32_t offset,
  */
 int
 nvm_update(	uint32_t offset,
-			uint8_t len,
+			uint32_t len,
 			const void *ptr);
 
 /**
@@ -64,9 +77,113 @@ nvm_update(	uint32_t offset,
  */
 int
 nvm_append(	uint32_t offset,
-			uint8_t len,
+			uint32_t len,
 			const void *ptr);
 
+/**
+ * @brief      Copy len bytes into pointer from an NVM device starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the read operation should start.
+ * @param[in]  len     The length of the read operation (number of bytes).
+ * @param[out] ptr     The pointer to which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_dev_read(	nvm_dev_t *dev,
+				uint32_t offset,
+				uint32_t len,
+				void *ptr);
+
+/**
+ * @brief      Update an NVM device by copying len bytes read from pointer starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  len     The length of the update operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_dev_update(	nvm_dev_t *dev,
+				uint32_t offset,
+				uint32_t len,
+				const void *ptr);
+
+/**
+ * @brief      Update an NVM device by copying iovcnt buffers back to back starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the update operation should start.
+ * @param[in]  iov     The buffers.
+ * @param[in]  iovcnt  The number of buffers.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_dev_updatev(	nvm_dev_t *dev,
+					uint32_t offset,
+					const nvm_iovec_t *iov,
+					uint32_t iovcnt);
+
+/**
+ * @brief      Append to an NVM device by copying len bytes read from pointer starting from offset.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the append operation should start.
+ * @param[in]  len     The length of the append operation (number of bytes).
+ * @param[out] ptr     The pointer from which len bytes should be copied.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_dev_append(	nvm_dev_t *dev,
+				uint32_t offset,
+				uint32_t len,
+				const void *ptr);
+
+/**
+ * @brief      Return a read-only pointer to len bytes of an NVM device starting from offset, see nvm_arch_dev_view.
+ *
+ * @param[in]  dev     The NVM device.
+ * @param[in]  offset  The offset in the NVM were the view should start.
+ * @param[in]  len     The length of the view (number of bytes).
+ *
+ * @return     NULL: The device can't be viewed without copying.
+ * @return     const void*: Pointer to the bytes.
+ */
+const void*
+nvm_dev_view(	nvm_dev_t *dev,
+				uint32_t offset,
+				uint32_t len);
+
+/**
+ * @brief      Get the number of bytes in an NVM device, see nvm_arch_dev_size.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     The size in bytes, UINT32_MAX when it is larger or unknown.
+ */
+uint32_t
+nvm_dev_size(const nvm_dev_t *dev);
+
+/**
+ * @brief      Make the writes to an NVM device durable, see nvm_arch_dev_sync.
+ *
+ * @param[in]  dev   The NVM device.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+int
+nvm_dev_sync(nvm_dev_t *dev);
+
 #endif /*__NVM_H__ */
 /** @} */
 /** @} */
\ No newline at end of file
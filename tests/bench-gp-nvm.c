@@ -0,0 +1,1111 @@
+/**
+ * 	\addtogroup nvm-exercise
+ * @{
+ */
+
+/**
+ * \defgroup gp-nvm-bench Benchmark for the general purpose NVM library.
+ * @{
+ *
+ * Benchmark of the \ref gp-nvm-lib with different workloads.
+ *
+ * Every workload runs against every storage engine and every backend of the NVM device: a file accessed with
+ * a file descriptor or a mapped view, a file that emulates NOR or NAND flash, and RAM.
+ *   * read-heavy: 95% gets and 5% sets of existing attributes with 32-byte values.
+ *   * write-heavy: 5% gets and 95% sets of existing attributes with 32-byte values.
+ *   * insert-storm: sets of new attributes only, starting from an empty NVM.
+ *   * mixed-sizes: 50% gets and 50% sets with value sizes from 1 byte to the maximum.
+ *   * counter-update: range updates of a 4-byte counter in existing attributes with values of the maximum size.
+ *   * large-sets: sets of existing attributes with values of the maximum size filled with one byte.
+ *   * large-compressed: large-sets with compression of values of at least COMPRESS_MIN_LEN bytes.
+ * For every run the throughput, the p50/p99/p999 latency, a latency histogram, the system calls of the
+ * NVM device per operation and the bytes written to the NVM per value byte set are reported.
+ * For flash the erases per operation and the bytes programmed per byte written to the device are reported too.
+ * The cost of the durability levels of the NVM device is measured separately: DURABILITY_THREADS threads set
+ * existing attributes with 32-byte values on a file accessed with a file descriptor, without syncs, with fsync
+ * or fdatasync after every set, and with group commit where a group is complete when every thread waits for it.
+ * For every level the throughput, the p50/p99/p999 latency and the syncs per set are reported.
+ * Large values are measured separately too: for every storage engine STREAM_VALUES values of STREAM_VALUE_LEN
+ * bytes are written with a stream in chunks of STREAM_CHUNK_LEN bytes on a file accessed with a file descriptor,
+ * and read back with range gets of the same chunks. The throughput of both and the bytes written to the NVM
+ * per value byte are reported.
+ * Enumerating the store is measured for every storage engine on NUM_ATTRS attributes with 32-byte values: probing
+ * PROBE_FACTOR times as many attribute IDs with gets, iterating the attributes in ID order, exporting them to a
+ * buffer in RAM and importing that export in an empty NVM. The time and the system calls of each are reported.
+ * The static attributes of bench-schema.h are compared with dynamic attributes for every storage engine: the
+ * STATIC_ATTRS attributes of 32 bytes are set and get in turn with their slots, and the same number of dynamic
+ * attributes with their IDs. The time per operation and the system calls of each are reported.
+ * Deletion is measured for every storage engine on NUM_ATTRS attributes with 32-byte values, with log segments
+ * of DELETE_SEGMENT_SIZE bytes: every other attribute is deleted and the space is reclaimed by compaction steps
+ * of at most DELETE_STEP_BYTES bytes until a step changes nothing. The time per delete, the number of steps,
+ * their total and longest time, the bytes moved and reclaimed and the NVM bytes in use before and after the
+ * compaction are reported. The attributes are checked after the NVM is opened again.
+ * The warm-up after a restart is measured for every storage engine on NUM_ATTRS attributes with 32-byte values
+ * on a file accessed with a file descriptor: the NVM is opened again without and with preload and every attribute
+ * is get once. The time and the system calls of the open and of the gets are reported, and a set after the gets
+ * has to be read back.
+ * A summary is printed and all results are written as JSON, so they can be compared between versions.
+ * The benchmark creates and truncates bench-gp-nvm.bin in this directory for every run.
+ *
+ * Usage: ./bench-gp-nvm [num_ops] [json_file]
+ *
+ */
+
+/**
+ * \file  bench-gp-nvm.c
+ * \brief Benchmark for the \ref gp-nvm-lib.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gp-nvm.h"
+#include "nvm-arch.h"
+
+#define BENCH_PATH "bench-gp-nvm.bin"
+#define JSON_PATH "bench-gp-nvm.json"
+#define NUM_OPS 20000
+#define NUM_ATTRS 1024
+#define MAX_VALUE_LEN 255
+#define NUM_BUCKETS 32
+#define DURABILITY_THREADS 4
+#define COMPRESS_MIN_LEN 64
+#define STREAM_VALUES 16
+#define STREAM_VALUE_LEN (256 * 1024)
+#define STREAM_CHUNK_LEN 4096
+#define STREAM_SEGMENT_SIZE (1024 * 1024)
+#define PROBE_FACTOR 4
+#define STATIC_ATTRS GP_NVM_NUM_SLOTS
+#define DELETE_SEGMENT_SIZE 16384
+#define DELETE_STEP_BYTES 1024
+#define DELETE_MAX_STEPS 100000
+#define PRELOAD_VALUE_LEN 32
+
+typedef struct {
+	const char *name;
+	int get_pct;
+	int insert;
+	uint8_t min_len;
+	uint8_t max_len;
+	uint8_t range_len;
+	uint32_t compress_min_len;
+} workload_t;
+
+typedef struct {
+	const char *name;
+	gp_nvm_engine_t engine;
+} engine_t;
+
+typedef struct {
+	const char *name;
+	nvm_arch_io_mode_t io_mode;
+	nvm_arch_flash_type_t flash;
+	const nvm_arch_backend_t *backend;
+} backend_t;
+
+static const workload_t workloads[] = {
+	{ .name = "read-heavy", .get_pct = 95, .min_len = 32, .max_len = 32 },
+	{ .name = "write-heavy", .get_pct = 5, .min_len = 32, .max_len = 32 },
+	{ .name = "insert-storm", .insert = 1, .min_len = 32, .max_len = 32 },
+	{ .name = "mixed-sizes", .get_pct = 50, .min_len = 1, .max_len = MAX_VALUE_LEN },
+	{ .name = "counter-update", .min_len = MAX_VALUE_LEN, .max_len = MAX_VALUE_LEN, .range_len = 4 },
+	{ .name = "large-sets", .min_len = MAX_VALUE_LEN, .max_len = MAX_VALUE_LEN },
+	{ .name = "large-compressed", .min_len = MAX_VALUE_LEN, .max_len = MAX_VALUE_LEN,
+	  .compress_min_len = COMPRESS_MIN_LEN },
+};
+
+static const engine_t engines[] = {
+	{ "in-place", GP_NVM_ENGINE_IN_PLACE },
+	{ "log", GP_NVM_ENGINE_LOG },
+};
+
+static const backend_t backends[] = {
+	{ "fd", NVM_ARCH_IO_FD, NVM_ARCH_FLASH_NONE, &nvm_arch_file_backend },
+	{ "mmap", NVM_ARCH_IO_MMAP, NVM_ARCH_FLASH_NONE, &nvm_arch_file_backend },
+	{ "nor", NVM_ARCH_IO_FD, NVM_ARCH_FLASH_NOR, &nvm_arch_file_backend },
+	{ "nand", NVM_ARCH_IO_FD, NVM_ARCH_FLASH_NAND, &nvm_arch_file_backend },
+	{ "ram", NVM_ARCH_IO_FD, NVM_ARCH_FLASH_NONE, &nvm_arch_ram_backend },
+};
+
+typedef struct {
+	const char *name;
+	nvm_arch_durability_t durability;
+} durability_t;
+
+static const durability_t durabilities[] = {
+	{ "none", NVM_ARCH_DURABILITY_NONE },
+	{ "fsync", NVM_ARCH_DURABILITY_FSYNC },
+	{ "fdatasync", NVM_ARCH_DURABILITY_FDATASYNC },
+	{ "group", NVM_ARCH_DURABILITY_GROUP },
+};
+
+#define NUM_ELEMENTS(a) (sizeof(a) / sizeof(a[0]))
+
+typedef struct {
+	uint64_t ops;
+	uint64_t errors;
+	double seconds;
+	uint32_t p50;
+	uint32_t p99;
+	uint32_t p999;
+	uint32_t max;
+	uint64_t buckets[NUM_BUCKETS];
+	double syscalls_per_op;
+	double bytes_written_per_byte;
+	double erases_per_op;
+	double flash_write_amplification;
+	double syncs_per_op;
+} result_t;
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t errors;
+	double write_seconds;
+	double read_seconds;
+	double bytes_written_per_byte;
+} stream_result_t;
+
+typedef struct {
+	uint64_t errors;
+	double seconds[4];
+	uint64_t syscalls[4];
+	uint64_t export_bytes;
+} export_result_t;
+
+typedef struct {
+	uint8_t *data;
+	uint32_t len;
+	uint32_t size;
+	uint32_t pos;
+} export_buf_t;
+
+static const char *export_steps[] = { "probe", "foreach", "export", "import" };
+
+typedef struct {
+	uint64_t errors;
+	double seconds[4];
+	uint64_t syscalls[4];
+} static_result_t;
+
+static const char *static_steps[] = { "dynamic-set", "dynamic-get", "static-set", "static-get" };
+
+typedef struct {
+	uint64_t errors;
+	double delete_seconds;
+	uint32_t steps;
+	double compact_seconds;
+	double max_step_seconds;
+	uint64_t moved_bytes;
+	uint64_t reclaimed_bytes;
+	uint64_t used_before;
+	uint64_t used_after;
+} delete_result_t;
+
+typedef struct {
+	uint64_t errors;
+	double open_seconds[2];
+	uint64_t open_syscalls[2];
+	double get_seconds[2];
+	uint64_t get_syscalls[2];
+} preload_result_t;
+
+static const char *preload_modes[] = { "cold", "preload" };
+
+typedef struct {
+	uint32_t first_attr;
+	uint32_t num_ops;
+	uint32_t *latencies;
+	uint64_t errors;
+} writer_t;
+
+static uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*) a;
+	uint32_t y = *(const uint32_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief      Histogram bucket of a latency, bucket i holds latencies below 2^(i+1) ns.
+ *
+ */
+static uint32_t
+bucket_of(uint32_t ns)
+{
+	uint32_t i = 0;
+	while( i < NUM_BUCKETS - 1 && ns >= (2u << i) ){
+		i++;
+	}
+	return i;
+}
+
+static uint8_t
+value_len(const workload_t *workload, unsigned int *seed)
+{
+	return workload->min_len + rand_r(seed) % (workload->max_len - workload->min_len + 1);
+}
+
+/**
+ * @brief      Run a workload on an empty NVM.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run(const workload_t *workload, const engine_t *engine, const backend_t *backend, uint32_t num_ops, uint32_t *latencies, result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH, .io_mode = backend->io_mode, .flash = { .type = backend->flash }, .backend = backend->backend };
+	gp_nvm_config_t config = { .engine = engine->engine, .compress_min_len = workload->compress_min_len };
+	nvm_arch_io_stats_t before, after;
+	nvm_arch_flash_stats_t flash_before, flash_after;
+	uint8_t value[MAX_VALUE_LEN];
+	uint32_t length;
+	uint64_t user_bytes = 0;
+	unsigned int seed = 1;
+
+	memset(result, 0, sizeof(result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+
+	if( !workload->insert ){
+		for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+			memset(value, attr_id, MAX_VALUE_LEN);
+			if( gp_nvm_set_attribute(attr_id, value_len(workload, &seed), value) != GP_NVM_SUCCESS ){
+				printf("Failed to set attr %u\n", attr_id);
+				return 1;
+			}
+		}
+	}
+
+	nvm_arch_get_io_stats(&before);
+	nvm_arch_get_flash_stats(&flash_before);
+	uint64_t start = now_ns();
+	for( uint32_t i = 0; i<num_ops; i++ ){
+		int get = (int) (rand_r(&seed) % 100) < workload->get_pct;
+		uint32_t attr_id = workload->insert ? NUM_ATTRS + i : (uint32_t) rand_r(&seed) % NUM_ATTRS;
+		uint8_t len = value_len(workload, &seed);
+		gp_nvm_result_t res;
+
+		uint64_t t = now_ns();
+		if( get ){
+			res = gp_nvm_get_attribute(attr_id, sizeof(value), &length, value);
+		} else if( workload->range_len > 0 ){
+			// the value length of the workload is fixed, so the range always lies within the value
+			uint8_t offset = rand_r(&seed) % (len - workload->range_len + 1);
+			memset(value, i, workload->range_len);
+			res = gp_nvm_update_attribute_range(attr_id, offset, workload->range_len, value);
+			user_bytes += workload->range_len;
+		} else {
+			memset(value, i, len);
+			res = gp_nvm_set_attribute(attr_id, len, value);
+			user_bytes += len;
+		}
+		t = now_ns() - t;
+
+		latencies[i] = t > UINT32_MAX ? UINT32_MAX : t;
+		result->buckets[bucket_of(latencies[i])]++;
+		if( res != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+	}
+	result->seconds = (now_ns() - start) / 1e9;
+	nvm_arch_get_io_stats(&after);
+	nvm_arch_get_flash_stats(&flash_after);
+	nvm_arch_deinit();
+
+	qsort(latencies, num_ops, sizeof(uint32_t), cmp_u32);
+	result->ops = num_ops;
+	result->p50 = latencies[num_ops / 2];
+	result->p99 = latencies[(uint64_t) num_ops * 99 / 100];
+	result->p999 = latencies[(uint64_t) num_ops * 999 / 1000];
+	result->max = latencies[num_ops - 1];
+	result->syscalls_per_op = (double) (after.syscalls - before.syscalls) / num_ops;
+	if( user_bytes > 0 ){
+		result->bytes_written_per_byte = (double) (after.bytes_written - before.bytes_written) / user_bytes;
+	}
+	result->erases_per_op = (double) (flash_after.erases - flash_before.erases) / num_ops;
+	if( flash_after.bytes_requested > flash_before.bytes_requested ){
+		result->flash_write_amplification = (double) (flash_after.bytes_programmed - flash_before.bytes_programmed) /
+				(flash_after.bytes_requested - flash_before.bytes_requested);
+	}
+	return 0;
+}
+
+/**
+ * @brief      Set existing attributes of one writer thread of a durability run.
+ *
+ */
+static void*
+durability_writer(void *arg)
+{
+	writer_t *writer = arg;
+	uint8_t value[32];
+	unsigned int seed = writer->first_attr + 1;
+
+	for( uint32_t i = 0; i<writer->num_ops; i++ ){
+		// every writer has its own attributes, so the writers only share the writer mutex and the syncs
+		uint32_t attr_id = writer->first_attr + (uint32_t) rand_r(&seed) % (NUM_ATTRS / DURABILITY_THREADS);
+		memset(value, i, sizeof(value));
+		uint64_t t = now_ns();
+		if( gp_nvm_set_attribute(attr_id, sizeof(value), value) != GP_NVM_SUCCESS ){
+			writer->errors++;
+		}
+		t = now_ns() - t;
+		writer->latencies[i] = t > UINT32_MAX ? UINT32_MAX : t;
+	}
+	return NULL;
+}
+
+/**
+ * @brief      Run concurrent sets on an NVM file with a durability level.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run_durability(const durability_t *durability, uint32_t num_ops, uint32_t *latencies, result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH, .durability = durability->durability, .sync_batch = DURABILITY_THREADS };
+	gp_nvm_config_t config = { .engine = GP_NVM_ENGINE_IN_PLACE };
+	writer_t writers[DURABILITY_THREADS];
+	pthread_t threads[DURABILITY_THREADS];
+	nvm_arch_io_stats_t before, after;
+	uint8_t value[32] = { 0 };
+	uint32_t ops_per_writer = num_ops > DURABILITY_THREADS ? num_ops / DURABILITY_THREADS : 1;
+
+	memset(result, 0, sizeof(result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+		if( gp_nvm_set_attribute(attr_id, sizeof(value), value) != GP_NVM_SUCCESS ){
+			printf("Failed to set attr %u\n", attr_id);
+			return 1;
+		}
+	}
+
+	nvm_arch_get_io_stats(&before);
+	uint64_t start = now_ns();
+	for( uint32_t t = 0; t<DURABILITY_THREADS; t++ ){
+		writers[t] = (writer_t) { t * (NUM_ATTRS / DURABILITY_THREADS), ops_per_writer, latencies + t * ops_per_writer, 0 };
+		pthread_create(&threads[t], NULL, durability_writer, &writers[t]);
+	}
+	for( uint32_t t = 0; t<DURABILITY_THREADS; t++ ){
+		pthread_join(threads[t], NULL);
+		result->errors += writers[t].errors;
+	}
+	result->seconds = (now_ns() - start) / 1e9;
+	nvm_arch_get_io_stats(&after);
+	nvm_arch_deinit();
+
+	num_ops = ops_per_writer * DURABILITY_THREADS;
+	for( uint32_t i = 0; i<num_ops; i++ ){
+		result->buckets[bucket_of(latencies[i])]++;
+	}
+	qsort(latencies, num_ops, sizeof(uint32_t), cmp_u32);
+	result->ops = num_ops;
+	result->p50 = latencies[num_ops / 2];
+	result->p99 = latencies[(uint64_t) num_ops * 99 / 100];
+	result->p999 = latencies[(uint64_t) num_ops * 999 / 1000];
+	result->max = latencies[num_ops - 1];
+	result->syscalls_per_op = (double) (after.syscalls - before.syscalls) / num_ops;
+	result->syncs_per_op = (double) (after.syncs - before.syncs) / num_ops;
+	return 0;
+}
+
+/**
+ * @brief      Write large values with streams and read them back in chunks on an empty NVM.
+ *
+ * The values of the attributes are rewritten, so the engine frees or compacts the previous values.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized or a buffer couldn't be allocated)
+ */
+static int
+run_streams(const engine_t *engine, stream_result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH };
+	gp_nvm_config_t config = { .engine = engine->engine, .log_segment_size = STREAM_SEGMENT_SIZE };
+	nvm_arch_io_stats_t before, after;
+	uint8_t chunk[STREAM_CHUNK_LEN];
+
+	memset(result, 0, sizeof(stream_result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+
+	nvm_arch_get_io_stats(&before);
+	uint64_t start = now_ns();
+	for( uint32_t i = 0; i<STREAM_VALUES; i++ ){
+		gp_nvm_stream_t *stream;
+		if( gp_nvm_stream_open(i % 4, STREAM_VALUE_LEN, &stream) != GP_NVM_SUCCESS ){
+			result->errors++;
+			continue;
+		}
+		for( uint32_t offset = 0; offset<STREAM_VALUE_LEN; offset += STREAM_CHUNK_LEN ){
+			memset(chunk, i + offset / STREAM_CHUNK_LEN, STREAM_CHUNK_LEN);
+			if( gp_nvm_stream_write(stream, STREAM_CHUNK_LEN, chunk) != GP_NVM_SUCCESS ){
+				result->errors++;
+			}
+		}
+		if( gp_nvm_stream_commit(stream) != GP_NVM_SUCCESS ){
+			result->errors++;
+			gp_nvm_stream_abort(stream);
+		}
+	}
+	result->write_seconds = (now_ns() - start) / 1e9;
+	nvm_arch_get_io_stats(&after);
+	result->bytes = (uint64_t) STREAM_VALUES * STREAM_VALUE_LEN;
+	result->bytes_written_per_byte = (double) (after.bytes_written - before.bytes_written) / result->bytes;
+
+	// the last 4 values are the values of the attributes
+	start = now_ns();
+	for( uint32_t i = 0; i<STREAM_VALUES; i++ ){
+		uint32_t value = STREAM_VALUES - 4 + i % 4;
+		for( uint32_t offset = 0; offset<STREAM_VALUE_LEN; offset += STREAM_CHUNK_LEN ){
+			if( gp_nvm_get_attribute_range(i % 4, offset, STREAM_CHUNK_LEN, chunk) != GP_NVM_SUCCESS ||
+				chunk[0] != (uint8_t) (value + offset / STREAM_CHUNK_LEN) ){
+				result->errors++;
+			}
+		}
+	}
+	result->read_seconds = (now_ns() - start) / 1e9;
+	nvm_arch_deinit();
+	return 0;
+}
+
+static int
+export_write(const uint8_t *p_data, uint32_t length, void *arg)
+{
+	export_buf_t *buf = arg;
+	if( buf->len + length > buf->size ){
+		uint32_t size = (buf->len + length) * 2;
+		uint8_t *data = realloc(buf->data, size);
+		if( data == NULL ){
+			return 1;
+		}
+		buf->data = data;
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, p_data, length);
+	buf->len += length;
+	return 0;
+}
+
+static int
+export_read(uint8_t *p_data, uint32_t length, void *arg)
+{
+	export_buf_t *buf = arg;
+	if( buf->pos + length > buf->len ){
+		return 1;
+	}
+	memcpy(p_data, buf->data + buf->pos, length);
+	buf->pos += length;
+	return 0;
+}
+
+static int
+count_attr(gp_nvm_attr_id_t attr_id, uint32_t length, const uint8_t *p_value, void *arg)
+{
+	(void) attr_id;
+	(void) length;
+	(void) p_value;
+	(*(uint32_t*) arg)++;
+	return 0;
+}
+
+/**
+ * @brief      Enumerate the attributes of an NVM by probing IDs, iterating, exporting and importing.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run_export(const engine_t *engine, export_result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH };
+	gp_nvm_config_t config = { .engine = engine->engine };
+	nvm_arch_io_stats_t before, after;
+	export_buf_t buf = { 0 };
+	uint8_t value[32] = { 0 };
+	uint32_t length;
+	uint32_t count = 0;
+
+	memset(result, 0, sizeof(export_result_t));
+	for( uint32_t step = 0; step<NUM_ELEMENTS(export_steps); step++ ){
+		// the import starts from an empty NVM
+		if( step == 0 || step == 3 ){
+			FILE *f = fopen(BENCH_PATH, "w");
+			if( f == NULL ){
+				printf("Can't create %s\n", BENCH_PATH);
+				return 1;
+			}
+			fclose(f);
+			if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+				printf("Failed to init gp-nvm\n");
+				return 1;
+			}
+		}
+		if( step == 0 ){
+			for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+				memset(value, attr_id, sizeof(value));
+				if( gp_nvm_set_attribute(attr_id, sizeof(value), value) != GP_NVM_SUCCESS ){
+					result->errors++;
+				}
+			}
+		}
+
+		nvm_arch_get_io_stats(&before);
+		uint64_t start = now_ns();
+		switch( step ){
+			case 0:
+				for( uint32_t attr_id = 0; attr_id<NUM_ATTRS * PROBE_FACTOR; attr_id++ ){
+					gp_nvm_result_t res = gp_nvm_get_attribute(attr_id, sizeof(value), &length, value);
+					if( res != GP_NVM_SUCCESS && (res != GP_NVM_ATTR_NOT_FOUND || attr_id < NUM_ATTRS) ){
+						result->errors++;
+					}
+				}
+				break;
+			case 1:
+				if( gp_nvm_foreach(0, NUM_ATTRS * PROBE_FACTOR, count_attr, &count) != GP_NVM_SUCCESS || count != NUM_ATTRS ){
+					result->errors++;
+				}
+				break;
+			case 2:
+				if( gp_nvm_export(export_write, &buf) != GP_NVM_SUCCESS ){
+					result->errors++;
+				}
+				break;
+			default:
+				if( gp_nvm_import(export_read, &buf) != GP_NVM_SUCCESS ){
+					result->errors++;
+				}
+				break;
+		}
+		result->seconds[step] = (now_ns() - start) / 1e9;
+		nvm_arch_get_io_stats(&after);
+		result->syscalls[step] = after.syscalls - before.syscalls;
+	}
+
+	count = 0;
+	if( gp_nvm_foreach(0, NUM_ATTRS, count_attr, &count) != GP_NVM_SUCCESS || count != NUM_ATTRS ){
+		result->errors++;
+	}
+	nvm_arch_deinit();
+	result->export_bytes = buf.len;
+	free(buf.data);
+	return 0;
+}
+
+/**
+ * @brief      Set and get the static attributes with their slots and as many dynamic attributes with their IDs.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run_static(const engine_t *engine, uint32_t num_ops, static_result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH };
+	gp_nvm_config_t config = { .engine = engine->engine };
+	nvm_arch_io_stats_t before, after;
+	bench_value_t value;
+	uint32_t length;
+
+	memset(result, 0, sizeof(static_result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+
+	for( uint32_t step = 0; step<NUM_ELEMENTS(static_steps); step++ ){
+		nvm_arch_get_io_stats(&before);
+		uint64_t start = now_ns();
+		for( uint32_t i = 0; i<num_ops; i++ ){
+			uint32_t slot = i % STATIC_ATTRS;
+			gp_nvm_result_t res;
+			switch( step ){
+				case 0:
+					memset(&value, i, sizeof(value));
+					res = gp_nvm_set_attribute(slot, sizeof(value), value.bytes);
+					break;
+				case 1:
+					res = gp_nvm_get_attribute(slot, sizeof(value.bytes), &length, value.bytes);
+					break;
+				case 2:
+					memset(&value, i, sizeof(value));
+					res = gp_nvm_set_slot(slot, &value);
+					break;
+				default:
+					res = gp_nvm_get_slot(slot, &value);
+					break;
+			}
+			if( res != GP_NVM_SUCCESS ){
+				result->errors++;
+			}
+		}
+		result->seconds[step] = (now_ns() - start) / 1e9;
+		nvm_arch_get_io_stats(&after);
+		result->syscalls[step] = after.syscalls - before.syscalls;
+	}
+
+	// every attribute keeps the value of its last set
+	for( uint32_t slot = 0; slot<STATIC_ATTRS && slot<num_ops; slot++ ){
+		uint8_t last = num_ops - 1 - (num_ops - 1 - slot) % STATIC_ATTRS;
+		if( gp_nvm_get_slot(slot, &value) != GP_NVM_SUCCESS || value.bytes[0] != last ){
+			result->errors++;
+		}
+	}
+	nvm_arch_deinit();
+	return 0;
+}
+
+/**
+ * @brief      Check that the attributes that weren't deleted keep their value and the deleted ones are gone.
+ *
+ * @return     The number of attributes that are wrong.
+ */
+static uint64_t
+check_deleted(void)
+{
+	uint8_t value[32];
+	uint32_t length;
+	uint64_t errors = 0;
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+		gp_nvm_result_t res = gp_nvm_get_attribute(attr_id, sizeof(value), &length, value);
+		if( attr_id % 2 == 0 ? res != GP_NVM_ATTR_NOT_FOUND : res != GP_NVM_SUCCESS || value[0] != (uint8_t) attr_id ){
+			errors++;
+		}
+	}
+	return errors;
+}
+
+/**
+ * @brief      Delete every other attribute and reclaim the space with bounded compaction steps.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run_delete(const engine_t *engine, delete_result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH };
+	gp_nvm_config_t config = { .engine = engine->engine, .log_segment_size = DELETE_SEGMENT_SIZE };
+	gp_nvm_compact_stats_t before, after;
+	uint8_t value[32];
+
+	memset(result, 0, sizeof(delete_result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+		memset(value, attr_id, sizeof(value));
+		if( gp_nvm_set_attribute(attr_id, sizeof(value), value) != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+	}
+
+	uint64_t start = now_ns();
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id += 2 ){
+		if( gp_nvm_delete_attribute(attr_id) != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+	}
+	result->delete_seconds = (now_ns() - start) / 1e9;
+	if( gp_nvm_delete_attribute(0) != GP_NVM_ATTR_NOT_FOUND ){
+		result->errors++;
+	}
+
+	gp_nvm_get_compact_stats(&before);
+	result->used_before = before.live_bytes + before.stale_bytes;
+	for( ; result->steps<DELETE_MAX_STEPS; result->steps++ ){
+		gp_nvm_get_compact_stats(&before);
+		start = now_ns();
+		if( gp_nvm_compact(DELETE_STEP_BYTES) != GP_NVM_SUCCESS ){
+			result->errors++;
+			break;
+		}
+		double seconds = (now_ns() - start) / 1e9;
+		gp_nvm_get_compact_stats(&after);
+		if( after.compact_bytes == before.compact_bytes && after.reclaimed_bytes == before.reclaimed_bytes ){
+			break;
+		}
+		result->compact_seconds += seconds;
+		if( seconds > result->max_step_seconds ){
+			result->max_step_seconds = seconds;
+		}
+	}
+	result->moved_bytes = after.compact_bytes;
+	result->reclaimed_bytes = after.reclaimed_bytes;
+	result->used_after = after.live_bytes + after.stale_bytes;
+
+	// the deletes and the moved records are found again by the scan or the checkpoint
+	result->errors += check_deleted();
+	nvm_arch_deinit();
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	result->errors += check_deleted();
+	nvm_arch_deinit();
+	return 0;
+}
+
+/**
+ * @brief      Get every attribute once after the NVM is opened again, without and with preload.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR (the library couldn't be initialized)
+ */
+static int
+run_preload(const engine_t *engine, preload_result_t *result)
+{
+	nvm_arch_config_t device = { .path = BENCH_PATH };
+	gp_nvm_config_t config = { .engine = engine->engine };
+	nvm_arch_io_stats_t before, after;
+	uint8_t value[PRELOAD_VALUE_LEN];
+	uint32_t length;
+
+	memset(result, 0, sizeof(preload_result_t));
+	FILE *f = fopen(BENCH_PATH, "w");
+	if( f == NULL ){
+		printf("Can't create %s\n", BENCH_PATH);
+		return 1;
+	}
+	fclose(f);
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+		memset(value, attr_id, sizeof(value));
+		if( gp_nvm_set_attribute(attr_id, sizeof(value), value) != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+	}
+	nvm_arch_deinit();
+
+	for( uint32_t mode = 0; mode<NUM_ELEMENTS(preload_modes); mode++ ){
+		config.preload = mode;
+		if( nvm_arch_init(&device) != 0 ){
+			printf("Failed to init gp-nvm\n");
+			return 1;
+		}
+		nvm_arch_get_io_stats(&before);
+		uint64_t start = now_ns();
+		if( gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+			printf("Failed to init gp-nvm\n");
+			return 1;
+		}
+		result->open_seconds[mode] = (now_ns() - start) / 1e9;
+		nvm_arch_get_io_stats(&after);
+		result->open_syscalls[mode] = after.syscalls - before.syscalls;
+
+		before = after;
+		start = now_ns();
+		for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+			if( gp_nvm_get_attribute(attr_id, sizeof(value), &length, value) != GP_NVM_SUCCESS || length != sizeof(value) || value[0] != (uint8_t) attr_id ){
+				result->errors++;
+			}
+		}
+		result->get_seconds[mode] = (now_ns() - start) / 1e9;
+		nvm_arch_get_io_stats(&after);
+		result->get_syscalls[mode] = after.syscalls - before.syscalls;
+
+		// the first set ends the use of the image, the new value has to come from the NVM
+		memset(value, 0xff, sizeof(value));
+		if( gp_nvm_set_attribute(0, sizeof(value), value) != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+		memset(value, 0, sizeof(value));
+		if( gp_nvm_get_attribute(0, sizeof(value), &length, value) != GP_NVM_SUCCESS || value[0] != 0xff ||
+			gp_nvm_get_attribute(1, sizeof(value), &length, value) != GP_NVM_SUCCESS || value[0] != 1 ){
+			result->errors++;
+		}
+		memset(value, 0, sizeof(value));
+		if( gp_nvm_set_attribute(0, sizeof(value), value) != GP_NVM_SUCCESS ){
+			result->errors++;
+		}
+		nvm_arch_deinit();
+	}
+	return 0;
+}
+
+static void
+write_json(FILE *f, const workload_t *workload, const engine_t *engine, const backend_t *backend, const result_t *result, int last)
+{
+	fprintf(f, "    {\"workload\": \"%s\", \"engine\": \"%s\", \"backend\": \"%s\", ", workload->name, engine->name, backend->name);
+	fprintf(f, "\"ops\": %lu, \"errors\": %lu, \"seconds\": %.6f, \"ops_per_sec\": %.1f, ",
+			result->ops, result->errors, result->seconds, result->ops / result->seconds);
+	fprintf(f, "\"latency_ns\": {\"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}, ",
+			result->p50, result->p99, result->p999, result->max);
+	fprintf(f, "\"syscalls_per_op\": %.3f, \"bytes_written_per_byte\": %.3f, ", result->syscalls_per_op, result->bytes_written_per_byte);
+	if( backend->flash != NVM_ARCH_FLASH_NONE ){
+		fprintf(f, "\"erases_per_op\": %.3f, \"flash_write_amplification\": %.3f, ", result->erases_per_op, result->flash_write_amplification);
+	}
+	// only buckets with latencies are written, as [upper bound in ns, count]
+	fprintf(f, "\"histogram\": [");
+	int first = 1;
+	for( uint32_t i = 0; i<NUM_BUCKETS; i++ ){
+		if( result->buckets[i] > 0 ){
+			fprintf(f, "%s[%lu, %lu]", first ? "" : ", ", 2ul << i, result->buckets[i]);
+			first = 0;
+		}
+	}
+	fprintf(f, "]}%s\n", last ? "" : ",");
+}
+
+static void
+write_durability_json(FILE *f, const durability_t *durability, const result_t *result, int last)
+{
+	fprintf(f, "    {\"durability\": \"%s\", \"threads\": %u, ", durability->name, DURABILITY_THREADS);
+	fprintf(f, "\"ops\": %lu, \"errors\": %lu, \"seconds\": %.6f, \"ops_per_sec\": %.1f, ",
+			result->ops, result->errors, result->seconds, result->ops / result->seconds);
+	fprintf(f, "\"latency_ns\": {\"p50\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}, ",
+			result->p50, result->p99, result->p999, result->max);
+	fprintf(f, "\"syscalls_per_op\": %.3f, \"syncs_per_op\": %.3f}%s\n", result->syscalls_per_op, result->syncs_per_op, last ? "" : ",");
+}
+
+static void
+write_streams_json(FILE *f, const engine_t *engine, const stream_result_t *result, int last)
+{
+	fprintf(f, "    {\"engine\": \"%s\", \"values\": %u, \"value_len\": %u, \"chunk_len\": %u, ",
+			engine->name, STREAM_VALUES, STREAM_VALUE_LEN, STREAM_CHUNK_LEN);
+	fprintf(f, "\"errors\": %lu, \"write_mb_per_sec\": %.1f, \"read_mb_per_sec\": %.1f, \"bytes_written_per_byte\": %.3f}%s\n",
+			result->errors, result->bytes / result->write_seconds / 1e6, result->bytes / result->read_seconds / 1e6,
+			result->bytes_written_per_byte, last ? "" : ",");
+}
+
+static void
+write_export_json(FILE *f, const engine_t *engine, const export_result_t *result, int last)
+{
+	fprintf(f, "    {\"engine\": \"%s\", \"attrs\": %u, \"probed_ids\": %u, \"export_bytes\": %lu, \"errors\": %lu",
+			engine->name, NUM_ATTRS, NUM_ATTRS * PROBE_FACTOR, result->export_bytes, result->errors);
+	for( uint32_t step = 0; step<NUM_ELEMENTS(export_steps); step++ ){
+		fprintf(f, ", \"%s\": {\"seconds\": %.6f, \"syscalls\": %lu}", export_steps[step], result->seconds[step], result->syscalls[step]);
+	}
+	fprintf(f, "}%s\n", last ? "" : ",");
+}
+
+static void
+write_static_json(FILE *f, const engine_t *engine, uint32_t num_ops, const static_result_t *result, int last)
+{
+	fprintf(f, "    {\"engine\": \"%s\", \"attrs\": %u, \"ops\": %u, \"errors\": %lu", engine->name, STATIC_ATTRS, num_ops, result->errors);
+	for( uint32_t step = 0; step<NUM_ELEMENTS(static_steps); step++ ){
+		fprintf(f, ", \"%s\": {\"ns_per_op\": %.1f, \"syscalls\": %lu}", static_steps[step], result->seconds[step] * 1e9 / num_ops, result->syscalls[step]);
+	}
+	fprintf(f, "}%s\n", last ? "" : ",");
+}
+
+static void
+write_preload_json(FILE *f, const engine_t *engine, const preload_result_t *result, int last)
+{
+	fprintf(f, "    {\"engine\": \"%s\", \"attrs\": %u, \"value_len\": %u, \"errors\": %lu",
+			engine->name, NUM_ATTRS, PRELOAD_VALUE_LEN, result->errors);
+	for( uint32_t mode = 0; mode<NUM_ELEMENTS(preload_modes); mode++ ){
+		fprintf(f, ", \"%s\": {\"open_ms\": %.3f, \"open_syscalls\": %lu, \"get_ms\": %.3f, \"get_syscalls\": %lu}",
+				preload_modes[mode], result->open_seconds[mode] * 1e3, result->open_syscalls[mode],
+				result->get_seconds[mode] * 1e3, result->get_syscalls[mode]);
+	}
+	fprintf(f, "}%s\n", last ? "" : ",");
+}
+
+static void
+write_delete_json(FILE *f, const engine_t *engine, const delete_result_t *result, int last)
+{
+	fprintf(f, "    {\"engine\": \"%s\", \"attrs\": %u, \"deletes\": %u, \"errors\": %lu, \"delete_ns_per_op\": %.1f, ",
+			engine->name, NUM_ATTRS, NUM_ATTRS / 2, result->errors, result->delete_seconds * 1e9 / (NUM_ATTRS / 2));
+	fprintf(f, "\"step_bytes\": %u, \"steps\": %u, \"compact_ms\": %.3f, \"max_step_us\": %.1f, ",
+			DELETE_STEP_BYTES, result->steps, result->compact_seconds * 1e3, result->max_step_seconds * 1e6);
+	fprintf(f, "\"moved_bytes\": %lu, \"reclaimed_bytes\": %lu, \"used_bytes_before\": %lu, \"used_bytes_after\": %lu}%s\n",
+			result->moved_bytes, result->reclaimed_bytes, result->used_before, result->used_after, last ? "" : ",");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t num_ops = argc > 1 ? (uint32_t) atoi(argv[1]) : NUM_OPS;
+	const char *json_path = argc > 2 ? argv[2] : JSON_PATH;
+	uint64_t total_errors = 0;
+	result_t result;
+	stream_result_t stream_result;
+	export_result_t export_result;
+	static_result_t static_result;
+	delete_result_t delete_result;
+	preload_result_t preload_result;
+
+	if( num_ops == 0 ){
+		num_ops = NUM_OPS;
+	}
+	// the durability runs need at least one latency per writer
+	uint32_t *latencies = malloc((num_ops + DURABILITY_THREADS) * sizeof(uint32_t));
+	FILE *json = fopen(json_path, "w");
+	if( latencies == NULL || json == NULL ){
+		printf("Can't create %s\n", json_path);
+		return 1;
+	}
+	fprintf(json, "{\n  \"num_ops\": %u,\n  \"num_attrs\": %u,\n  \"results\": [\n", num_ops, NUM_ATTRS);
+
+	printf("workload\tengine\t\tbackend\tops/s\t\tp50 ns\tp99 ns\tp999 ns\tsyscalls/op\tbytes/byte\n");
+	for( uint32_t w = 0; w<NUM_ELEMENTS(workloads); w++ ){
+		for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+			for( uint32_t m = 0; m<NUM_ELEMENTS(backends); m++ ){
+				if( run(&workloads[w], &engines[e], &backends[m], num_ops, latencies, &result) != 0 ){
+					return 1;
+				}
+				int last = w == NUM_ELEMENTS(workloads) - 1 && e == NUM_ELEMENTS(engines) - 1 && m == NUM_ELEMENTS(backends) - 1;
+				write_json(json, &workloads[w], &engines[e], &backends[m], &result, last);
+				printf("%-12s\t%-8s\t%s\t%-10.0f\t%u\t%u\t%u\t%.2f\t\t%.2f\n", workloads[w].name, engines[e].name, backends[m].name,
+						result.ops / result.seconds, result.p50, result.p99, result.p999, result.syscalls_per_op, result.bytes_written_per_byte);
+				total_errors += result.errors;
+			}
+		}
+	}
+
+	fprintf(json, "  ],\n  \"durability\": [\n");
+	printf("\ndurability\tthreads\tops/s\t\tp50 ns\tp99 ns\tp999 ns\tsyncs/op\n");
+	for( uint32_t d = 0; d<NUM_ELEMENTS(durabilities); d++ ){
+		if( run_durability(&durabilities[d], num_ops, latencies, &result) != 0 ){
+			return 1;
+		}
+		write_durability_json(json, &durabilities[d], &result, d == NUM_ELEMENTS(durabilities) - 1);
+		printf("%-10s\t%u\t%-10.0f\t%u\t%u\t%u\t%.2f\n", durabilities[d].name, DURABILITY_THREADS,
+				result.ops / result.seconds, result.p50, result.p99, result.p999, result.syncs_per_op);
+		total_errors += result.errors;
+	}
+
+	fprintf(json, "  ],\n  \"streams\": [\n");
+	printf("\nstreams		values	value len	write MB/s	read MB/s	bytes/byte\n");
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		if( run_streams(&engines[e], &stream_result) != 0 ){
+			return 1;
+		}
+		write_streams_json(json, &engines[e], &stream_result, e == NUM_ELEMENTS(engines) - 1);
+		printf("%-8s	%u	%u		%-10.1f	%-10.1f	%.2f\n", engines[e].name, STREAM_VALUES, STREAM_VALUE_LEN,
+				stream_result.bytes / stream_result.write_seconds / 1e6, stream_result.bytes / stream_result.read_seconds / 1e6,
+				stream_result.bytes_written_per_byte);
+		total_errors += stream_result.errors;
+	}
+
+	fprintf(json, "  ],\n  \"export\": [\n");
+	printf("\nexport\t\tprobe ms\tsyscalls\tforeach ms\tsyscalls\texport ms\tsyscalls\timport ms\tsyscalls\n");
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		if( run_export(&engines[e], &export_result) != 0 ){
+			return 1;
+		}
+		write_export_json(json, &engines[e], &export_result, e == NUM_ELEMENTS(engines) - 1);
+		printf("%-8s", engines[e].name);
+		for( uint32_t step = 0; step<NUM_ELEMENTS(export_steps); step++ ){
+			printf("\t%-10.3f\t%lu\t", export_result.seconds[step] * 1e3, export_result.syscalls[step]);
+		}
+		printf("\n");
+		total_errors += export_result.errors;
+	}
+
+	fprintf(json, "  ],\n  \"static\": [\n");
+	printf("\nstatic\t\tdynamic set ns\tsyscalls\tdynamic get ns\tsyscalls\tstatic set ns\tsyscalls\tstatic get ns\tsyscalls\n");
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		if( run_static(&engines[e], num_ops, &static_result) != 0 ){
+			return 1;
+		}
+		write_static_json(json, &engines[e], num_ops, &static_result, e == NUM_ELEMENTS(engines) - 1);
+		printf("%-8s", engines[e].name);
+		for( uint32_t step = 0; step<NUM_ELEMENTS(static_steps); step++ ){
+			printf("\t%-10.1f\t%lu\t", static_result.seconds[step] * 1e9 / num_ops, static_result.syscalls[step]);
+		}
+		printf("\n");
+		total_errors += static_result.errors;
+	}
+
+	fprintf(json, "  ],\n  \"delete\": [\n");
+	printf("\ndelete\t\tdeletes\tns/op\tsteps\tcompact ms\tmax step us\tmoved\treclaimed\tused before\tused after\n");
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		if( run_delete(&engines[e], &delete_result) != 0 ){
+			return 1;
+		}
+		write_delete_json(json, &engines[e], &delete_result, e == NUM_ELEMENTS(engines) - 1);
+		printf("%-8s\t%u\t%-6.1f\t%u\t%-10.3f\t%-10.1f\t%lu\t%lu\t\t%lu\t\t%lu\n", engines[e].name, NUM_ATTRS / 2,
+				delete_result.delete_seconds * 1e9 / (NUM_ATTRS / 2), delete_result.steps, delete_result.compact_seconds * 1e3,
+				delete_result.max_step_seconds * 1e6, delete_result.moved_bytes, delete_result.reclaimed_bytes,
+				delete_result.used_before, delete_result.used_after);
+		total_errors += delete_result.errors;
+	}
+
+	fprintf(json, "  ],\n  \"preload\": [\n");
+	printf("\npreload\t\tcold open ms\tsyscalls\tget ms\t\tsyscalls\tpreload open ms\tsyscalls\tget ms\t\tsyscalls\n");
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		if( run_preload(&engines[e], &preload_result) != 0 ){
+			return 1;
+		}
+		write_preload_json(json, &engines[e], &preload_result, e == NUM_ELEMENTS(engines) - 1);
+		printf("%-8s", engines[e].name);
+		for( uint32_t mode = 0; mode<NUM_ELEMENTS(preload_modes); mode++ ){
+			printf("\t%-10.3f\t%lu\t\t%-10.3f\t%lu\t", preload_result.open_seconds[mode] * 1e3, preload_result.open_syscalls[mode],
+					preload_result.get_seconds[mode] * 1e3, preload_result.get_syscalls[mode]);
+		}
+		printf("\n");
+		total_errors += preload_result.errors;
+	}
+
+	fprintf(json, "  ]\n}\n");
+	fclose(json);
+	free(latencies);
+	remove(BENCH_PATH);
+
+	if( total_errors > 0 ){
+		printf("%lu operations failed\n", total_errors);
+		return 1;
+	}
+	return 0;
+}
+
+/** @} */
+/** @} */
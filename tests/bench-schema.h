@@ -0,0 +1,23 @@
+/**
+ * \file  bench-schema.h
+ * \brief Static schema of the benchmark for the \ref gp-nvm-lib, see GP_NVM_CONF_SCHEMA.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ *
+ * The IDs are beyond the attributes of the workloads, so the static attributes don't change their results.
+ */
+
+#ifndef __BENCH_SCHEMA_H__
+#define __BENCH_SCHEMA_H__
+typedef struct {
+	uint8_t bytes[32];
+} bench_value_t;
+#endif
+
+GP_NVM_SCHEMA_ATTR(bench_0, 0x40000000, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_1, 0x40000001, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_2, 0x40000002, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_3, 0x40000003, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_4, 0x40000004, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_5, 0x40000005, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_6, 0x40000006, bench_value_t)
+GP_NVM_SCHEMA_ATTR(bench_7, 0x40000007, bench_value_t)
@@ -0,0 +1,1008 @@
+/**
+ * 	\addtogroup nvm-exercise
+ * @{
+ */
+
+/**
+ * \defgroup gp-nvm-check Regression checks for the general purpose NVM library.
+ * @{
+ *
+ * Checks of the \ref gp-nvm-lib that compare the state after an operation, a reopen or a simulated crash
+ * with the expected state. A failed check prints its file, line and expression, the program returns 1 when
+ * any check failed.
+ *
+ * A crash is simulated with a backend that forwards to the file backend and drops every write after the
+ * crash point, so the NVM looks like the power failed there, see crash_point_t.
+ * The checks create and truncate check-gp-nvm.bin in this directory and remove it at the end.
+ *
+ * Usage: ./check-gp-nvm
+ *
+ */
+
+/**
+ * \file  check-gp-nvm.c
+ * \brief Regression checks for the \ref gp-nvm-lib.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gp-nvm.h"
+#include "gp-nvm-store.h"
+#include "gp-nvm-crc.h"
+#include "nvm-arch.h"
+
+#define CHECK_PATH "check-gp-nvm.bin"
+#define VALUE_LEN 16
+#define MAX_ATTRS 256
+#define CKPT_ATTRS 200
+
+#define CHECK(expr) _check((expr), __FILE__, __LINE__, #expr)
+
+/**
+ * @brief      Point of a simulated crash.
+ *
+ */
+typedef enum crash_point {
+	CRASH_NONE,				/**< Don't crash. */
+	CRASH_BEFORE_COMMIT,	/**< Drop the commit record of a batch and every write after it. */
+	CRASH_TORN_COMMIT,		/**< Write the commit record with a cleared magic number, like a partly programmed header, and drop every write after it. */
+	CRASH_AFTER_COMMIT,		/**< Drop every write after the commit record of a batch. */
+	CRASH_BEFORE_FREE,		/**< Drop the first header of a free record and every write after it, like a move that didn't free the moved record. */
+} crash_point_t;
+
+static const gp_nvm_engine_t engines[] = { GP_NVM_ENGINE_IN_PLACE, GP_NVM_ENGINE_LOG };
+static const char *engine_names[] = { "in-place", "log" };
+
+static int failures;
+static crash_point_t crash_point;
+static int crashed;
+static uint64_t reads;
+
+#define NUM_ELEMENTS(a) (sizeof(a) / sizeof(a[0]))
+
+static void
+_check(int ok, const char *file, int line, const char *expr)
+{
+	if( !ok ){
+		printf("%s:%d: check failed: %s\n", file, line, expr);
+		failures++;
+	}
+}
+
+/**
+ * @brief      Decide if a write is dropped because of the crash point.
+ *
+ * The commit record of a batch and the header of a record that becomes free are written on their own.
+ *
+ * @return     0: the write reaches the NVM
+ * @return     1: the write is dropped
+ */
+static int
+crash_drop(const void *ptr, size_t len)
+{
+	const gp_nvm_record_hdr_t *hdr = ptr;
+	if( crashed ){
+		return 1;
+	}
+	if( crash_point != CRASH_NONE && crash_point != CRASH_BEFORE_FREE && len == sizeof(gp_nvm_record_hdr_t) &&
+		hdr->magic == GP_NVM_RECORD_MAGIC && hdr->type == GP_NVM_RECORD_COMMIT ){
+		crashed = 1;
+		return crash_point == CRASH_BEFORE_COMMIT;
+	}
+	if( crash_point == CRASH_BEFORE_FREE && len == sizeof(gp_nvm_record_hdr_t) &&
+		hdr->magic == GP_NVM_RECORD_MAGIC && hdr->type == GP_NVM_RECORD_FREE ){
+		crashed = 1;
+		return 1;
+	}
+	return 0;
+}
+
+static void*
+crash_open(const nvm_arch_config_t *config)
+{
+	return nvm_arch_file_backend.open(config);
+}
+
+static int
+crash_close(void *ctx)
+{
+	return nvm_arch_file_backend.close(ctx);
+}
+
+static int
+crash_read(void *ctx, long int offset, size_t len, void *ptr)
+{
+	reads++;
+	return nvm_arch_file_backend.read(ctx, offset, len, ptr);
+}
+
+static int
+crash_update(void *ctx, long int offset, size_t len, const void *ptr)
+{
+	if( crash_drop(ptr, len) ){
+		return 0;
+	}
+	if( crashed && crash_point == CRASH_TORN_COMMIT ){
+		gp_nvm_record_hdr_t torn = *(const gp_nvm_record_hdr_t*) ptr;
+		torn.magic = 0;
+		return nvm_arch_file_backend.update(ctx, offset, len, &torn);
+	}
+	return nvm_arch_file_backend.update(ctx, offset, len, ptr);
+}
+
+static int
+crash_updatev(void *ctx, long int offset, const nvm_arch_iovec_t *iov, uint32_t iovcnt)
+{
+	if( crashed ){
+		return 0;
+	}
+	return nvm_arch_file_backend.updatev(ctx, offset, iov, iovcnt);
+}
+
+static int
+crash_append(void *ctx, long int offset, size_t len, const void *ptr)
+{
+	if( crash_drop(ptr, len) ){
+		return 0;
+	}
+	return nvm_arch_file_backend.append(ctx, offset, len, ptr);
+}
+
+static size_t
+crash_size(const void *ctx)
+{
+	return nvm_arch_file_backend.size(ctx);
+}
+
+static int
+crash_sync(void *ctx)
+{
+	return nvm_arch_file_backend.sync(ctx);
+}
+
+/**
+ * @brief      File backend that drops the writes after the crash point.
+ *
+ */
+static const nvm_arch_backend_t crash_backend = {
+	.name = "crash",
+	.open = crash_open,
+	.close = crash_close,
+	.read = crash_read,
+	.update = crash_update,
+	.updatev = crash_updatev,
+	.append = crash_append,
+	.size = crash_size,
+	.sync = crash_sync,
+};
+
+/**
+ * @brief      Open the NVM with the crash backend, an empty NVM when fresh is set.
+ *
+ * @return     0: SUCCESS
+ * @return     1: ERROR
+ */
+static int
+open_nvm(const gp_nvm_config_t *config, int fresh)
+{
+	nvm_arch_config_t device = { .path = CHECK_PATH, .backend = &crash_backend };
+	if( fresh ){
+		FILE *f = fopen(CHECK_PATH, "w");
+		if( f == NULL ){
+			return 1;
+		}
+		fclose(f);
+	}
+	if( nvm_arch_init(&device) != 0 || gp_nvm_init_with_config(config) != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Close the NVM, a crash that happened is over.
+ *
+ */
+static void
+close_nvm(void)
+{
+	nvm_arch_deinit();
+	crash_point = CRASH_NONE;
+	crashed = 0;
+}
+
+/**
+ * @brief      Check that an attribute holds VALUE_LEN bytes of fill.
+ *
+ */
+static int
+has_value(uint32_t attr_id, uint8_t fill)
+{
+	uint8_t value[VALUE_LEN];
+	uint32_t length;
+	if( gp_nvm_get_attribute(attr_id, sizeof(value), &length, value) != GP_NVM_SUCCESS || length != VALUE_LEN ){
+		return 0;
+	}
+	for( uint32_t i = 0; i<VALUE_LEN; i++ ){
+		if( value[i] != fill ){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @brief      Check that an attribute isn't found.
+ *
+ */
+static int
+is_missing(uint32_t attr_id)
+{
+	uint8_t value[VALUE_LEN];
+	uint32_t length;
+	return gp_nvm_get_attribute(attr_id, sizeof(value), &length, value) == GP_NVM_ATTR_NOT_FOUND;
+}
+
+/**
+ * @brief      Set an attribute to VALUE_LEN bytes of fill.
+ *
+ */
+static gp_nvm_result_t
+set_value(uint32_t attr_id, uint8_t fill)
+{
+	uint8_t value[VALUE_LEN];
+	memset(value, fill, sizeof(value));
+	return gp_nvm_set_attribute(attr_id, sizeof(value), value);
+}
+
+/**
+ * @brief      Commit a batch that crashes at a crash point and check after a reopen that all or none of it applied.
+ *
+ * Attributes 1 and 2 exist before the batch, attribute 3 is new.
+ */
+static void
+check_batch_crash(gp_nvm_engine_t engine, crash_point_t point, int applied)
+{
+	gp_nvm_config_t config = { .engine = engine };
+	uint8_t value[VALUE_LEN];
+
+	if( open_nvm(&config, 1) != 0 ){
+		failures++;
+		return;
+	}
+	CHECK(set_value(1, 0x11) == GP_NVM_SUCCESS);
+	CHECK(set_value(2, 0x11) == GP_NVM_SUCCESS);
+
+	crash_point = point;
+	memset(value, 0x22, sizeof(value));
+	CHECK(gp_nvm_batch_begin() == GP_NVM_SUCCESS);
+	for( uint32_t attr_id = 1; attr_id<=3; attr_id++ ){
+		CHECK(gp_nvm_batch_set(attr_id, sizeof(value), value) == GP_NVM_SUCCESS);
+	}
+	CHECK(gp_nvm_batch_commit() == GP_NVM_SUCCESS);
+	CHECK(crashed);
+	close_nvm();
+
+	if( open_nvm(&config, 0) != 0 ){
+		failures++;
+		return;
+	}
+	if( applied ){
+		CHECK(has_value(1, 0x22));
+		CHECK(has_value(2, 0x22));
+		CHECK(has_value(3, 0x22));
+	} else {
+		CHECK(has_value(1, 0x11));
+		CHECK(has_value(2, 0x11));
+		CHECK(is_missing(3));
+	}
+	// the recovery left the store usable
+	CHECK(set_value(3, 0x33) == GP_NVM_SUCCESS);
+	close_nvm();
+	if( open_nvm(&config, 0) != 0 ){
+		failures++;
+		return;
+	}
+	CHECK(has_value(3, 0x33));
+	CHECK(has_value(1, applied ? 0x22 : 0x11));
+	close_nvm();
+}
+
+/**
+ * @brief      A batch is applied completely or not at all after a crash during its commit.
+ *
+ */
+static void
+check_batch(void)
+{
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		printf("batch %s\n", engine_names[e]);
+		check_batch_crash(engines[e], CRASH_BEFORE_COMMIT, 0);
+		check_batch_crash(engines[e], CRASH_TORN_COMMIT, 0);
+		// the in-place engine still has to clear the batch flags of the records
+		check_batch_crash(engines[e], CRASH_AFTER_COMMIT, 1);
+	}
+}
+
+/**
+ * @brief      Expected value of every attribute ID, -1 when the attribute doesn't exist.
+ *
+ */
+typedef struct {
+	int fill[MAX_ATTRS];
+	uint32_t found;
+	uint32_t wrong;
+} expected_t;
+
+static int
+check_attr(gp_nvm_attr_id_t attr_id, uint32_t length, const uint8_t *p_value, void *arg)
+{
+	expected_t *expected = arg;
+	expected->found++;
+	if( attr_id >= MAX_ATTRS || expected->fill[attr_id] < 0 || length != VALUE_LEN ||
+		p_value[0] != expected->fill[attr_id] || p_value[VALUE_LEN - 1] != expected->fill[attr_id] ){
+		expected->wrong++;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Set an attribute and remember its value.
+ *
+ */
+static void
+expect_set(expected_t *expected, uint32_t attr_id, uint8_t fill)
+{
+	CHECK(set_value(attr_id, fill) == GP_NVM_SUCCESS);
+	expected->fill[attr_id] = fill;
+}
+
+/**
+ * @brief      Check that the index holds exactly the expected attributes, with foreach and with gets.
+ *
+ */
+static void
+check_contents(expected_t *expected)
+{
+	uint32_t num_expected = 0;
+	expected->found = 0;
+	expected->wrong = 0;
+	CHECK(gp_nvm_foreach(0, MAX_ATTRS, check_attr, expected) == GP_NVM_SUCCESS);
+	for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+		if( expected->fill[attr_id] >= 0 ){
+			num_expected++;
+			CHECK(has_value(attr_id, expected->fill[attr_id]));
+		} else {
+			CHECK(is_missing(attr_id));
+		}
+	}
+	CHECK(expected->found == num_expected);
+	CHECK(expected->wrong == 0);
+}
+
+/**
+ * @brief      Read the complete NVM file.
+ *
+ * @return     The contents, NULL when the file can't be read. The caller frees them.
+ */
+static uint8_t*
+read_nvm_file(long int *p_size)
+{
+	FILE *f = fopen(CHECK_PATH, "rb");
+	if( f == NULL ){
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	*p_size = ftell(f);
+	uint8_t *data = malloc(*p_size);
+	fseek(f, 0, SEEK_SET);
+	if( data != NULL && fread(data, 1, *p_size, f) != (size_t) *p_size ){
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+/**
+ * @brief      Check whether a valid record header of a type is at offset of the NVM file contents.
+ *
+ * Only the value has to be in the file, the capacity of the last record can reach beyond its end.
+ */
+static int
+is_record(const uint8_t *data, long int size, long int offset, uint8_t type, gp_nvm_record_hdr_t *hdr)
+{
+	if( offset + (long int) sizeof(*hdr) > size ){
+		return 0;
+	}
+	memcpy(hdr, data + offset, sizeof(*hdr));
+	return hdr->magic == GP_NVM_RECORD_MAGIC && hdr->type == type &&
+		hdr->hdr_crc == gp_nvm_crc32c(0, hdr, offsetof(gp_nvm_record_hdr_t, hdr_crc)) &&
+		offset + (long int) sizeof(*hdr) + (long int) hdr->len <= size;
+}
+
+/**
+ * @brief      Count the valid attribute records of an attribute on the NVM, with any value.
+ *
+ * @param[in]  attr_id     The attribute identifier.
+ * @param[out] p_last_seq  Pointer were the highest sequence number of the records can be stored.
+ */
+static uint32_t
+count_records(uint32_t attr_id, uint32_t *p_last_seq)
+{
+	uint32_t count = 0;
+	long int size;
+	uint8_t *data = read_nvm_file(&size);
+	*p_last_seq = 0;
+	for( long int offset = 0; data != NULL && offset<size; offset++ ){
+		gp_nvm_record_hdr_t hdr;
+		if( is_record(data, size, offset, GP_NVM_RECORD_ATTR, &hdr) && hdr.attr_id == attr_id ){
+			count++;
+			*p_last_seq = hdr.seq > *p_last_seq ? hdr.seq : *p_last_seq;
+		}
+	}
+	free(data);
+	return count;
+}
+
+/**
+ * @brief      Invalidate every checkpoint record on the NVM by flipping a byte of its value.
+ *
+ * @return     The number of checkpoint records that were found.
+ */
+static uint32_t
+corrupt_checkpoints(void)
+{
+	uint32_t count = 0;
+	long int size;
+	uint8_t *data = read_nvm_file(&size);
+	if( data == NULL ){
+		return 0;
+	}
+	for( long int offset = 0; offset<size; offset++ ){
+		gp_nvm_record_hdr_t hdr;
+		if( is_record(data, size, offset, GP_NVM_RECORD_CHECKPOINT, &hdr) && hdr.len > 0 ){
+			data[offset + sizeof(hdr)] ^= 0xff;
+			count++;
+		}
+	}
+	FILE *f = fopen(CHECK_PATH, "r+b");
+	if( f != NULL ){
+		fwrite(data, 1, size, f);
+		fclose(f);
+	}
+	free(data);
+	return count;
+}
+
+/**
+ * @brief      Reopen the NVM and count the reads of the open.
+ *
+ * @return     The number of reads, UINT64_MAX when the NVM couldn't be opened.
+ */
+static uint64_t
+reopen_nvm(const gp_nvm_config_t *config)
+{
+	close_nvm();
+	reads = 0;
+	if( open_nvm(config, 0) != 0 ){
+		failures++;
+		return UINT64_MAX;
+	}
+	return reads;
+}
+
+/**
+ * @brief      The index is restored from a checkpoint, the records after it are replayed and a corrupt
+ *             checkpoint falls back to a full scan.
+ *
+ * A full scan reads the header of every record, a restore reads the checkpoint and the records after it,
+ * so the number of reads of the open tells which one was used.
+ */
+static void
+check_checkpoint(void)
+{
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		gp_nvm_config_t config = { .engine = engines[e] };
+		expected_t expected;
+		uint64_t open_reads;
+
+		printf("checkpoint %s\n", engine_names[e]);
+		for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+			expected.fill[attr_id] = -1;
+		}
+		if( open_nvm(&config, 1) != 0 ){
+			failures++;
+			continue;
+		}
+		for( uint32_t attr_id = 0; attr_id<CKPT_ATTRS; attr_id++ ){
+			expect_set(&expected, attr_id, attr_id);
+		}
+		CHECK(gp_nvm_checkpoint() == GP_NVM_SUCCESS);
+
+		// nothing changed after the checkpoint
+		open_reads = reopen_nvm(&config);
+		CHECK(open_reads < CKPT_ATTRS / 4);
+		check_contents(&expected);
+
+		// the log engine replays the records after the checkpoint, the in-place engine scans
+		for( uint32_t attr_id = 0; attr_id<10; attr_id++ ){
+			expect_set(&expected, attr_id, attr_id + 0x80);
+		}
+		for( uint32_t attr_id = CKPT_ATTRS; attr_id<CKPT_ATTRS + 20; attr_id++ ){
+			expect_set(&expected, attr_id, attr_id);
+		}
+		open_reads = reopen_nvm(&config);
+		if( engines[e] == GP_NVM_ENGINE_LOG ){
+			CHECK(open_reads < CKPT_ATTRS / 2);
+		}
+		check_contents(&expected);
+
+		// without a valid checkpoint every record is scanned
+		CHECK(gp_nvm_checkpoint() == GP_NVM_SUCCESS);
+		close_nvm();
+		CHECK(corrupt_checkpoints() > 0);
+		open_reads = reopen_nvm(&config);
+		CHECK(open_reads != UINT64_MAX && open_reads >= CKPT_ATTRS);
+		check_contents(&expected);
+
+		// a checkpoint written after the fallback is used again
+		CHECK(gp_nvm_checkpoint() == GP_NVM_SUCCESS);
+		open_reads = reopen_nvm(&config);
+		CHECK(open_reads < CKPT_ATTRS / 4);
+		check_contents(&expected);
+		close_nvm();
+	}
+}
+
+/**
+ * @brief      A stream commit fails when the attribute was set while the stream was open.
+ *
+ * The set overwrites the record in place with the in-place engine and stays dirty in the cache when the
+ * cache is enabled, the value of the set is kept in every case, also after a reopen.
+ */
+static void
+check_stream_set(void)
+{
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		for( uint32_t cache = 0; cache<=1; cache++ ){
+			gp_nvm_config_t config = { .engine = engines[e], .cache_size = cache ? 4096 : 0 };
+			uint8_t value[VALUE_LEN];
+			gp_nvm_stream_t *stream;
+
+			printf("stream set %s%s\n", engine_names[e], cache ? " cached" : "");
+			if( open_nvm(&config, 1) != 0 ){
+				failures++;
+				continue;
+			}
+			CHECK(set_value(1, 0x11) == GP_NVM_SUCCESS);
+			CHECK(gp_nvm_flush() == GP_NVM_SUCCESS);
+			CHECK(gp_nvm_stream_open(1, VALUE_LEN, &stream) == GP_NVM_SUCCESS);
+			CHECK(set_value(1, 0x22) == GP_NVM_SUCCESS);
+			memset(value, 0x33, sizeof(value));
+			CHECK(gp_nvm_stream_write(stream, sizeof(value), value) == GP_NVM_SUCCESS);
+			CHECK(gp_nvm_stream_commit(stream) == GP_NVM_FAIL);
+			CHECK(has_value(1, 0x22));
+
+			// a stream without a set in between still commits
+			CHECK(gp_nvm_stream_open(1, VALUE_LEN, &stream) == GP_NVM_SUCCESS);
+			CHECK(gp_nvm_stream_write(stream, sizeof(value), value) == GP_NVM_SUCCESS);
+			CHECK(gp_nvm_stream_commit(stream) == GP_NVM_SUCCESS);
+			CHECK(has_value(1, 0x33));
+			CHECK(gp_nvm_flush() == GP_NVM_SUCCESS);
+			close_nvm();
+
+			if( open_nvm(&config, 0) != 0 ){
+				failures++;
+				continue;
+			}
+			CHECK(has_value(1, 0x33));
+			close_nvm();
+		}
+	}
+}
+
+/**
+ * @brief      A get into a buffer that is too small returns the length the value needs and writes nothing.
+ *
+ * This is checked for a short value that can be cached and a long value that is compressed, nothing is
+ * counted as a CRC error.
+ */
+static void
+check_small_buffer(void)
+{
+	static const uint32_t lengths[] = { VALUE_LEN, 1000 };
+
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		for( uint32_t cache = 0; cache<=1; cache++ ){
+			gp_nvm_config_t config = { .engine = engines[e], .cache_size = cache ? 4096 : 0, .compress_min_len = 64 };
+			uint8_t value[1000];
+			uint8_t small[sizeof(value)];
+			gp_nvm_stats_t before;
+			gp_nvm_stats_t after;
+			uint32_t length;
+
+			printf("small buffer %s%s\n", engine_names[e], cache ? " cached" : "");
+			if( open_nvm(&config, 1) != 0 ){
+				failures++;
+				continue;
+			}
+			memset(value, 0x44, sizeof(value));
+			gp_nvm_get_stats(&before);
+			for( uint32_t l = 0; l<NUM_ELEMENTS(lengths); l++ ){
+				CHECK(gp_nvm_set_attribute(1, lengths[l], value) == GP_NVM_SUCCESS);
+				memset(small, 0xee, sizeof(small));
+				length = 0;
+				CHECK(gp_nvm_get_attribute(1, lengths[l] - 1, &length, small) == GP_NVM_ATTR_LEN_DIFF);
+				CHECK(length == lengths[l]);
+				CHECK(small[0] == 0xee && small[lengths[l] - 1] == 0xee);
+				length = 0;
+				CHECK(gp_nvm_get_attribute(1, sizeof(value), &length, value) == GP_NVM_SUCCESS);
+				CHECK(length == lengths[l]);
+			}
+			gp_nvm_get_stats(&after);
+			CHECK(after.crc_errors == before.crc_errors);
+			close_nvm();
+		}
+	}
+}
+
+/**
+ * @brief      Deleted attributes stay deleted after a reopen, an attribute set again after its delete is back.
+ *
+ */
+static void
+check_delete(void)
+{
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		gp_nvm_config_t config = { .engine = engines[e] };
+		expected_t expected;
+
+		printf("delete %s\n", engine_names[e]);
+		for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+			expected.fill[attr_id] = -1;
+		}
+		if( open_nvm(&config, 1) != 0 ){
+			failures++;
+			continue;
+		}
+		for( uint32_t attr_id = 1; attr_id<=10; attr_id++ ){
+			expect_set(&expected, attr_id, attr_id);
+		}
+		CHECK(gp_nvm_delete_attribute(2) == GP_NVM_SUCCESS);
+		CHECK(gp_nvm_delete_attribute(5) == GP_NVM_SUCCESS);
+		CHECK(gp_nvm_delete_attribute(10) == GP_NVM_SUCCESS);
+		CHECK(gp_nvm_delete_attribute(11) == GP_NVM_ATTR_NOT_FOUND);
+		expected.fill[2] = expected.fill[5] = expected.fill[10] = -1;
+		check_contents(&expected);
+		CHECK(reopen_nvm(&config) != UINT64_MAX);
+		check_contents(&expected);
+
+		expect_set(&expected, 5, 0x55);
+		CHECK(gp_nvm_delete_attribute(1) == GP_NVM_SUCCESS);
+		expected.fill[1] = -1;
+		CHECK(reopen_nvm(&config) != UINT64_MAX);
+		check_contents(&expected);
+		close_nvm();
+	}
+}
+
+/**
+ * @brief      The log engine drops the tombstones of deleted attributes once compaction erased their older records.
+ *
+ * A tombstone counts as live bytes, so after the compaction only the record of the attribute that wasn't
+ * deleted is live. The deleted attributes don't come back when the log is scanned at a reopen.
+ * An attribute that was deleted after a checkpoint keeps its tombstone until the next checkpoint, else the
+ * index of the checkpoint brings it back at a reopen once compaction erased its record.
+ */
+static void
+check_log_tombstones(void)
+{
+	gp_nvm_config_t config = { .engine = GP_NVM_ENGINE_LOG, .log_segment_size = 1024 };
+	gp_nvm_compact_stats_t stats;
+	expected_t expected;
+	uint64_t one_record;
+
+	printf("log tombstones\n");
+	for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+		expected.fill[attr_id] = -1;
+	}
+	if( open_nvm(&config, 1) != 0 ){
+		failures++;
+		return;
+	}
+	expect_set(&expected, 100, 0x10);
+	gp_nvm_get_compact_stats(&stats);
+	one_record = stats.live_bytes;
+
+	for( uint32_t attr_id = 1; attr_id<=20; attr_id++ ){
+		CHECK(set_value(attr_id, attr_id) == GP_NVM_SUCCESS);
+	}
+	for( uint32_t attr_id = 1; attr_id<=20; attr_id++ ){
+		CHECK(gp_nvm_delete_attribute(attr_id) == GP_NVM_SUCCESS);
+	}
+	gp_nvm_get_compact_stats(&stats);
+	CHECK(stats.live_bytes > one_record);
+
+	// move the tail away from the segments of the deletes, so they can be compacted
+	for( uint32_t i = 0; i<100; i++ ){
+		expect_set(&expected, 100, i);
+	}
+	for( uint32_t i = 0; i<64; i++ ){
+		CHECK(gp_nvm_compact(0) == GP_NVM_SUCCESS);
+	}
+	gp_nvm_get_compact_stats(&stats);
+	CHECK(stats.live_bytes == one_record);
+	check_contents(&expected);
+
+	CHECK(reopen_nvm(&config) != UINT64_MAX);
+	gp_nvm_get_compact_stats(&stats);
+	CHECK(stats.live_bytes == one_record);
+	check_contents(&expected);
+
+	expect_set(&expected, 30, 0x30);
+	CHECK(gp_nvm_checkpoint() == GP_NVM_SUCCESS);
+	CHECK(gp_nvm_delete_attribute(30) == GP_NVM_SUCCESS);
+	expected.fill[30] = -1;
+	for( uint32_t i = 0; i<100; i++ ){
+		expect_set(&expected, 100, i);
+	}
+	for( uint32_t i = 0; i<64; i++ ){
+		CHECK(gp_nvm_compact(0) == GP_NVM_SUCCESS);
+	}
+	check_contents(&expected);
+	CHECK(reopen_nvm(&config) != UINT64_MAX);
+	check_contents(&expected);
+	close_nvm();
+}
+
+/**
+ * @brief      A restore forgets the entries of the checkpoint in segments that were erased after it.
+ *
+ * The tombstones of the checkpoint are dropped by compaction and their segment is opened again, the live bytes
+ * counted by the restore are those before the reopen and the deleted attributes stay deleted. The records that
+ * were relocated are replayed.
+ */
+static void
+check_log_reused_segments(void)
+{
+	gp_nvm_config_t config = { .engine = GP_NVM_ENGINE_LOG, .log_segment_size = 1024 };
+	gp_nvm_compact_stats_t before;
+	gp_nvm_compact_stats_t after;
+	expected_t expected;
+
+	printf("log reused segments\n");
+	for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+		expected.fill[attr_id] = -1;
+	}
+	if( open_nvm(&config, 1) != 0 ){
+		failures++;
+		return;
+	}
+	for( uint32_t attr_id = 1; attr_id<=20; attr_id++ ){
+		expect_set(&expected, attr_id, attr_id);
+	}
+	for( uint32_t attr_id = 1; attr_id<=10; attr_id++ ){
+		CHECK(gp_nvm_delete_attribute(attr_id) == GP_NVM_SUCCESS);
+		expected.fill[attr_id] = -1;
+	}
+	// the checkpoint holds the tombstones, compaction drops them and opens their segment again
+	CHECK(gp_nvm_checkpoint() == GP_NVM_SUCCESS);
+	for( uint32_t i = 0; i<200; i++ ){
+		expect_set(&expected, 100, i);
+		if( i % 10 == 0 ){
+			CHECK(gp_nvm_compact(0) == GP_NVM_SUCCESS);
+		}
+	}
+	check_contents(&expected);
+	gp_nvm_get_compact_stats(&before);
+	CHECK(reopen_nvm(&config) != UINT64_MAX);
+	gp_nvm_get_compact_stats(&after);
+	CHECK(after.live_bytes == before.live_bytes);
+	check_contents(&expected);
+	close_nvm();
+}
+
+/**
+ * @brief      In-place compaction cuts the free space at the end of the data region off and moves the record at
+ *             the end into a hole before it.
+ *
+ * Attribute 10 at the end and attribute 3 are deleted: the end is cut to attribute 9, which moves to the hole
+ * of attribute 3, after which the data region ends with attribute 8.
+ */
+static void
+check_heap_compact(void)
+{
+	gp_nvm_config_t config = { .engine = GP_NVM_ENGINE_IN_PLACE };
+	gp_nvm_alloc_stats_t alloc;
+	gp_nvm_stats_t before;
+	gp_nvm_stats_t after;
+	expected_t expected;
+	uint32_t data_end = 0;
+
+	printf("in-place compact\n");
+	for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+		expected.fill[attr_id] = -1;
+	}
+	if( open_nvm(&config, 1) != 0 ){
+		failures++;
+		return;
+	}
+	for( uint32_t attr_id = 1; attr_id<=10; attr_id++ ){
+		expect_set(&expected, attr_id, attr_id);
+		if( attr_id == 8 ){
+			gp_nvm_get_alloc_stats(&alloc);
+			data_end = alloc.data_end;
+		}
+	}
+	CHECK(gp_nvm_delete_attribute(3) == GP_NVM_SUCCESS);
+	CHECK(gp_nvm_delete_attribute(10) == GP_NVM_SUCCESS);
+	expected.fill[3] = expected.fill[10] = -1;
+
+	gp_nvm_get_stats(&before);
+	CHECK(gp_nvm_compact(0) == GP_NVM_SUCCESS);
+	gp_nvm_get_stats(&after);
+	CHECK(after.record_moves == before.record_moves + 1);
+	gp_nvm_get_alloc_stats(&alloc);
+	CHECK(alloc.data_end == data_end);
+	check_contents(&expected);
+
+	CHECK(reopen_nvm(&config) != UINT64_MAX);
+	gp_nvm_get_alloc_stats(&alloc);
+	CHECK(alloc.data_end == data_end);
+	check_contents(&expected);
+	close_nvm();
+}
+
+/**
+ * @brief      A move of the in-place compaction that crashes before the moved record is freed leaves two
+ *             records of the attribute, the reopen keeps the newer one and frees the other.
+ *
+ * The reopen preloads the NVM, so the freed record has to be written to the image as well.
+ */
+static void
+check_interrupted_move(void)
+{
+	gp_nvm_config_t config = { .engine = GP_NVM_ENGINE_IN_PLACE, .preload = 1 };
+	expected_t expected;
+	uint32_t moved_seq;
+	uint32_t kept_seq;
+
+	printf("interrupted move\n");
+	for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+		expected.fill[attr_id] = -1;
+	}
+	if( open_nvm(&config, 1) != 0 ){
+		failures++;
+		return;
+	}
+	for( uint32_t attr_id = 1; attr_id<=10; attr_id++ ){
+		expect_set(&expected, attr_id, attr_id);
+	}
+	// attribute 10 at the end moves to the hole of attribute 3, which fits it exactly
+	CHECK(gp_nvm_delete_attribute(3) == GP_NVM_SUCCESS);
+	expected.fill[3] = -1;
+	crash_point = CRASH_BEFORE_FREE;
+	CHECK(gp_nvm_compact(0) == GP_NVM_SUCCESS);
+	CHECK(crashed);
+	close_nvm();
+	CHECK(count_records(10, &moved_seq) == 2);
+
+	if( open_nvm(&config, 0) != 0 ){
+		failures++;
+		return;
+	}
+	CHECK(count_records(10, &kept_seq) == 1);
+	CHECK(kept_seq == moved_seq);
+	check_contents(&expected);
+	CHECK(reopen_nvm(&config) != UINT64_MAX);
+	check_contents(&expected);
+	close_nvm();
+}
+
+/**
+ * @brief      A preloaded open reads the NVM once and rebuilds the same index as an open without preload.
+ *
+ * A set after the open isn't hidden by the image.
+ */
+static void
+check_preload(void)
+{
+	for( uint32_t e = 0; e<NUM_ELEMENTS(engines); e++ ){
+		gp_nvm_config_t config = { .engine = engines[e] };
+		expected_t expected;
+
+		printf("preload %s\n", engine_names[e]);
+		for( uint32_t attr_id = 0; attr_id<MAX_ATTRS; attr_id++ ){
+			expected.fill[attr_id] = -1;
+		}
+		if( open_nvm(&config, 1) != 0 ){
+			failures++;
+			continue;
+		}
+		for( uint32_t attr_id = 0; attr_id<100; attr_id++ ){
+			expect_set(&expected, attr_id, attr_id);
+		}
+		for( uint32_t attr_id = 0; attr_id<100; attr_id += 3 ){
+			CHECK(gp_nvm_delete_attribute(attr_id) == GP_NVM_SUCCESS);
+			expected.fill[attr_id] = -1;
+		}
+
+		config.preload = 1;
+		CHECK(reopen_nvm(&config) == 1);
+		check_contents(&expected);
+		expect_set(&expected, 1, 0x81);
+		check_contents(&expected);
+		close_nvm();
+	}
+}
+
+/**
+ * @brief      The patched CRC32C of a changed range equals the CRC32C of the changed data.
+ *
+ * The ranges cover an empty range, ranges at the start and at the end of the data, and ranges and tails
+ * longer than the chunk of the patch.
+ */
+static void
+check_crc_patch(void)
+{
+	static const size_t lengths[] = { 0, 1, 3, 63, 64, 65, 200, 1000 };
+	uint8_t old_data[4096];
+	uint8_t new_data[sizeof(old_data)];
+
+	printf("crc patch\n");
+	srand(1);
+	for( size_t i = 0; i<sizeof(old_data); i++ ){
+		old_data[i] = rand();
+	}
+	for( uint32_t l = 0; l<NUM_ELEMENTS(lengths); l++ ){
+		for( uint32_t r = 0; r<NUM_ELEMENTS(lengths); r++ ){
+			for( uint32_t t = 0; t<NUM_ELEMENTS(lengths); t++ ){
+				size_t head = lengths[l];
+				size_t len = lengths[r];
+				size_t tail = lengths[t];
+				size_t total = head + len + tail;
+
+				memcpy(new_data, old_data, total);
+				for( size_t i = head; i<head + len; i++ ){
+					new_data[i] = rand();
+				}
+				uint32_t crc = gp_nvm_crc32c(0, old_data, total);
+				uint32_t patched = gp_nvm_crc32c_patch(crc, old_data + head, new_data + head, len, tail);
+				CHECK(patched == gp_nvm_crc32c(0, new_data, total));
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	check_crc_patch();
+	check_batch();
+	check_checkpoint();
+	check_stream_set();
+	check_small_buffer();
+	check_delete();
+	check_log_tombstones();
+	check_log_reused_segments();
+	check_heap_compact();
+	check_interrupted_move();
+	check_preload();
+
+	remove(CHECK_PATH);
+	if( failures > 0 ){
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
+
+/** @} */
+/** @} */
@@ -0,0 +1,340 @@
+/**
+ * 	\addtogroup nvm-exercise
+ * @{
+ */
+
+/**
+ * \defgroup gp-nvm-stress Multi-threaded stress benchmark for the general purpose NVM library.
+ * @{
+ *
+ * Stress benchmark using the \ref gp-nvm-lib from several threads.
+ *
+ * One writer thread keeps updating NUM_ATTRS attributes while a growing number of reader threads
+ * get random attributes for DURATION_MS milliseconds. Every value carries its attribute ID and a
+ * version byte, so a reader that sees a torn or mixed-up value is counted as an error.
+ * The get throughput is printed for every number of readers, it should scale with the number of cores.
+ * Then the writer switches NUM_RESIZE_ATTRS attributes between RESIZE_SHORT_LEN and RESIZE_LONG_LEN bytes,
+ * while the readers size their buffer with gp_nvm_get_attribute_length before every get, once without and once
+ * with compression. A get that finds a longer value than the buffer holds has to return GP_NVM_ATTR_LEN_DIFF,
+ * these are counted as retries.
+ * The benchmark fails if there is no nvm.bin file in this directory or a reader saw an error.
+ *
+ * Usage: ./stress-gp-nvm [max_readers] [duration_ms]
+ *
+ */
+
+/**
+ * \file  stress-gp-nvm.c
+ * \brief Multi-threaded stress benchmark for the \ref gp-nvm-lib.
+ * \author  Peter Ruckebusch <peter.ruckebusch@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "gp-nvm.h"
+
+#define NUM_ATTRS 256
+#define MAX_READERS 64
+#define DURATION_MS 1000
+#define HDR_LEN 5
+#define MAX_VALUE_LEN (HDR_LEN + 32)
+#define NUM_RESIZE_ATTRS 4
+#define RESIZE_SHORT_LEN HDR_LEN
+#define RESIZE_LONG_LEN 4096
+
+static volatile int running;
+
+typedef struct {
+	unsigned int seed;
+	uint64_t gets;
+	uint64_t errors;
+	uint64_t retries;
+} reader_t;
+
+static uint64_t writer_sets;
+
+/**
+ * @brief      Fill a value: attribute ID, version and a payload of which the length depends on the version.
+ *
+ */
+static uint8_t
+make_value(uint32_t attr_id, uint8_t version, uint8_t *value)
+{
+	uint8_t length = HDR_LEN + version % 32;
+	memcpy(value, &attr_id, sizeof(attr_id));
+	memset(value + sizeof(attr_id), version, length - sizeof(attr_id));
+	return length;
+}
+
+/**
+ * @brief      Check that a value was produced by make_value for the attribute.
+ *
+ */
+static int
+check_value(uint32_t attr_id, uint8_t length, const uint8_t *value)
+{
+	uint32_t id;
+	memcpy(&id, value, sizeof(id));
+	if( length < HDR_LEN || id != attr_id || length != HDR_LEN + value[HDR_LEN - 1] % 32 ){
+		return 1;
+	}
+	for( uint8_t i = HDR_LEN; i<length; i++ ){
+		if( value[i] != value[HDR_LEN - 1] ){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void*
+reader_main(void *arg)
+{
+	reader_t *reader = arg;
+	uint8_t value[255];
+	uint32_t length;
+	while( running ){
+		uint32_t attr_id = rand_r(&reader->seed) % NUM_ATTRS;
+		if( gp_nvm_get_attribute(attr_id, sizeof(value), &length, value) != GP_NVM_SUCCESS || check_value(attr_id, length, value) ){
+			reader->errors++;
+		}
+		reader->gets++;
+	}
+	return NULL;
+}
+
+/**
+ * @brief      Fill a value of which the length switches with the version between short and long.
+ *
+ */
+static uint32_t
+make_resize_value(uint32_t attr_id, uint8_t version, uint8_t *value)
+{
+	uint32_t length = version % 2 ? RESIZE_LONG_LEN : RESIZE_SHORT_LEN;
+	memcpy(value, &attr_id, sizeof(attr_id));
+	memset(value + sizeof(attr_id), version, length - sizeof(attr_id));
+	return length;
+}
+
+/**
+ * @brief      Check that a value was produced by make_resize_value for the attribute.
+ *
+ */
+static int
+check_resize_value(uint32_t attr_id, uint32_t length, const uint8_t *value)
+{
+	uint32_t id;
+	memcpy(&id, value, sizeof(id));
+	if( length < HDR_LEN || id != attr_id ||
+		length != (value[HDR_LEN - 1] % 2 ? RESIZE_LONG_LEN : RESIZE_SHORT_LEN) ){
+		return 1;
+	}
+	for( uint32_t i = HDR_LEN; i<length; i++ ){
+		if( value[i] != value[HDR_LEN - 1] ){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Get with a buffer of the length the value had just before, like a caller that doesn't know the length.
+ *
+ */
+static void*
+resize_reader_main(void *arg)
+{
+	reader_t *reader = arg;
+	uint32_t length;
+	while( running ){
+		uint32_t attr_id = rand_r(&reader->seed) % NUM_RESIZE_ATTRS;
+		uint32_t size;
+		if( gp_nvm_get_attribute_length(attr_id, &size) != GP_NVM_SUCCESS ){
+			reader->errors++;
+			continue;
+		}
+		uint8_t *value = malloc(size);
+		if( value == NULL ){
+			reader->errors++;
+			continue;
+		}
+		gp_nvm_result_t res = gp_nvm_get_attribute(attr_id, size, &length, value);
+		if( res == GP_NVM_ATTR_LEN_DIFF && length > size ){
+			reader->retries++;
+		} else if( res != GP_NVM_SUCCESS || check_resize_value(attr_id, length, value) ){
+			reader->errors++;
+		}
+		free(value);
+		reader->gets++;
+	}
+	return NULL;
+}
+
+static void*
+resize_writer_main(void *arg)
+{
+	static uint8_t value[RESIZE_LONG_LEN];
+	uint8_t version = 0;
+	(void) arg;
+	while( running ){
+		version++;
+		for( uint32_t attr_id = 0; attr_id<NUM_RESIZE_ATTRS && running; attr_id++ ){
+			uint32_t length = make_resize_value(attr_id, version, value);
+			if( gp_nvm_set_attribute(attr_id, length, value) != GP_NVM_SUCCESS ){
+				printf("Writer failed to set attr %u\n", attr_id);
+				running = 0;
+			}
+			writer_sets++;
+		}
+	}
+	return NULL;
+}
+
+static void*
+writer_main(void *arg)
+{
+	uint8_t value[MAX_VALUE_LEN];
+	uint8_t version = 0;
+	(void) arg;
+	while( running ){
+		version++;
+		for( uint32_t attr_id = 0; attr_id<NUM_ATTRS && running; attr_id++ ){
+			uint8_t length = make_value(attr_id, version, value);
+			if( gp_nvm_set_attribute(attr_id, length, value) != GP_NVM_SUCCESS ){
+				printf("Writer failed to set attr %u\n", attr_id);
+				running = 0;
+			}
+			writer_sets++;
+		}
+	}
+	return NULL;
+}
+
+static uint64_t
+now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t value[MAX_VALUE_LEN];
+	reader_t readers[MAX_READERS];
+	pthread_t threads[MAX_READERS];
+	pthread_t writer;
+	uint64_t total_errors = 0;
+
+	int max_readers = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+	int duration = argc > 2 ? atoi(argv[2]) : DURATION_MS;
+	if( max_readers < 1 ){
+		max_readers = 1;
+	}
+	if( max_readers > MAX_READERS ){
+		max_readers = MAX_READERS;
+	}
+
+	if( gp_nvm_init() != GP_NVM_SUCCESS ){
+		printf("Failed to init gp-nvm\n");
+		return 1;
+	}
+	for( uint32_t attr_id = 0; attr_id<NUM_ATTRS; attr_id++ ){
+		uint8_t length = make_value(attr_id, 0, value);
+		if( gp_nvm_set_attribute(attr_id, length, value) != GP_NVM_SUCCESS ){
+			printf("Failed to set attr %u\n", attr_id);
+			return 1;
+		}
+	}
+
+	printf("readers\tgets/s\t\tsets/s\t\terrors\n");
+	for( int num_readers = 1; ; num_readers = num_readers * 2 < max_readers ? num_readers * 2 : max_readers ){
+		running = 1;
+		writer_sets = 0;
+		for( int i = 0; i<num_readers; i++ ){
+			readers[i].seed = i + 1;
+			readers[i].gets = 0;
+			readers[i].errors = 0;
+			pthread_create(&threads[i], NULL, reader_main, &readers[i]);
+		}
+		pthread_create(&writer, NULL, writer_main, NULL);
+
+		uint64_t start = now_ms();
+		usleep(duration * 1000);
+		running = 0;
+		pthread_join(writer, NULL);
+
+		uint64_t gets = 0, errors = 0;
+		for( int i = 0; i<num_readers; i++ ){
+			pthread_join(threads[i], NULL);
+			gets += readers[i].gets;
+			errors += readers[i].errors;
+		}
+		double seconds = (now_ms() - start) / 1000.0;
+		printf("%d\t%.0f\t%.0f\t\t%lu\n", num_readers, gets / seconds, writer_sets / seconds, errors);
+		total_errors += errors;
+
+		if( num_readers == max_readers ){
+			break;
+		}
+	}
+
+	// the attributes change their length with every set, the readers only know the length from before the get
+	printf("\nresize\t\tgets/s\t\tsets/s\t\tretries\t\terrors\n");
+	for( uint32_t compress = 0; compress<=1; compress++ ){
+		gp_nvm_config_t config = { .compress_min_len = compress ? RESIZE_SHORT_LEN + 1 : 0 };
+		if( gp_nvm_init_with_config(&config) != GP_NVM_SUCCESS ){
+			printf("Failed to init gp-nvm\n");
+			return 1;
+		}
+		for( uint32_t attr_id = 0; attr_id<NUM_RESIZE_ATTRS; attr_id++ ){
+			uint8_t resize_value[RESIZE_SHORT_LEN];
+			uint32_t length = make_resize_value(attr_id, 0, resize_value);
+			if( gp_nvm_set_attribute(attr_id, length, resize_value) != GP_NVM_SUCCESS ){
+				printf("Failed to set attr %u\n", attr_id);
+				return 1;
+			}
+		}
+		running = 1;
+		writer_sets = 0;
+		for( int i = 0; i<max_readers; i++ ){
+			readers[i].seed = i + 1;
+			readers[i].gets = 0;
+			readers[i].errors = 0;
+			readers[i].retries = 0;
+			pthread_create(&threads[i], NULL, resize_reader_main, &readers[i]);
+		}
+		pthread_create(&writer, NULL, resize_writer_main, NULL);
+
+		uint64_t start = now_ms();
+		usleep(duration * 1000);
+		running = 0;
+		pthread_join(writer, NULL);
+
+		uint64_t gets = 0, errors = 0, retries = 0;
+		for( int i = 0; i<max_readers; i++ ){
+			pthread_join(threads[i], NULL);
+			gets += readers[i].gets;
+			errors += readers[i].errors;
+			retries += readers[i].retries;
+		}
+		double seconds = (now_ms() - start) / 1000.0;
+		printf("%s\t%.0f\t\t%.0f\t\t%lu\t\t%lu\n", compress ? "compressed" : "plain\t", gets / seconds,
+				writer_sets / seconds, retries, errors);
+		total_errors += errors;
+	}
+
+	if( total_errors > 0 ){
+		printf("Readers saw %lu errors\n", total_errors);
+		return 1;
+	}
+	return 0;
+}
+
+/** @} */
+/** @} */
@@ -66,7 +66,7 @@ uint8_t length_array[NUM_TEST_DATA_EL] = {sizeof(data1), sizeof(data2), sizeof(d
 int main () {
 	int i,j;
 	time_t t;
-	uint8_t length;
+	uint32_t length;
 
 	gp_nvm_result_t result;
 	void* test_list[NUM_TEST_DATA_EL] = {&data1, &data2, &data3, &data4, &array1, &array2, &array3, &array4, &test_struct1};
@@ -82,10 +82,10 @@ int main () {
 		
 		// try to get attribute
 		printf("GET ATTRIBUTE 1:\n");
-		result = gp_nvm_get_attribute(rvalue+1, &length, &res_array[0]);
+		result = gp_nvm_get_attribute(rvalue+1, sizeof(res_array), &length, &res_array[0]);
 		if( result == 0){
 			printf("\t(size %u): ", length);
-			for( j=0; j<length; j++){
+			for( j=0; j<(int) length; j++){
 				printf("%u ", res_array[j]);
 			}
 			printf("\n");
@@ -109,10 +109,10 @@ int main () {
 
 		//try to get attribute again
 		printf("GET ATTRIBUTE 2:\n");
-		result = gp_nvm_get_attribute(rvalue+1, &length, &res_array[0]);
+		result = gp_nvm_get_attribute(rvalue+1, sizeof(res_array), &length, &res_array[0]);
 		if( result == 0 ){
 			printf("\t(size %u): ", length);
-			for( j=0; j<length; j++ ){
+			for( j=0; j<(int) length; j++ ){
 				printf("%u ", res_array[j]);
 			}
 			printf("\n");